@@ -0,0 +1,128 @@
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//
+
+#include "pch.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace LogMonitorTests
+{
+    ///
+    /// Tests of the CheckpointStore class, used to resume the log files
+    /// after a restart.
+    ///
+    TEST_CLASS(CheckpointStoreTests)
+    {
+        std::wstring tempDirectory;
+        std::wstring checkpointPath;
+
+        static FILE_ID_INFO MakeFileId(BYTE Seed)
+        {
+            FILE_ID_INFO fileId = {};
+            fileId.VolumeSerialNumber = 0x1234;
+            fileId.FileId.Identifier[0] = Seed;
+
+            return fileId;
+        }
+
+    public:
+        TEST_METHOD_INITIALIZE(InitializeCheckpointStoreTests)
+        {
+            tempDirectory = CreateTempDirectory();
+            checkpointPath = tempDirectory + L"\\checkpoint.json";
+        }
+
+        TEST_METHOD_CLEANUP(CleanupCheckpointStoreTests)
+        {
+            DeleteFileW(checkpointPath.c_str());
+            RemoveDirectoryW(tempDirectory.c_str());
+        }
+
+        ///
+        /// Check that the checkpoints saved by Flush are restored by Load, and
+        /// that a missing checkpoint file isn't an error.
+        ///
+        TEST_METHOD(TestFlushAndLoad)
+        {
+            CheckpointStore store(checkpointPath);
+            Assert::AreEqual((int)ERROR_SUCCESS, (int)store.Load());
+
+            FileCheckpoint checkpoint;
+            checkpoint.FileName = L"app\\log1.log";
+            checkpoint.Offset = 5000000000ULL;
+            checkpoint.EncodingType = LM_FILETYPE::UTF16LE;
+            checkpoint.FingerprintSize = 1024;
+            checkpoint.Fingerprint = 0xcbf29ce484222325ULL;
+
+            store.Update(CheckpointStore::GetKey(MakeFileId(1), checkpoint.FileName), checkpoint);
+            Assert::AreEqual((int)ERROR_SUCCESS, (int)store.Flush());
+
+            CheckpointStore restoredStore(checkpointPath);
+            Assert::AreEqual((int)ERROR_SUCCESS, (int)restoredStore.Load());
+
+            //
+            // Files are found by id, whatever their current name.
+            //
+            FileCheckpoint restored;
+            Assert::IsTrue(restoredStore.Find(CheckpointStore::GetKey(MakeFileId(1), L"renamed.log"), restored));
+            Assert::AreEqual(L"app\\log1.log", restored.FileName.c_str());
+            Assert::IsTrue(restored.Offset == checkpoint.Offset);
+            Assert::IsTrue(restored.EncodingType == LM_FILETYPE::UTF16LE);
+            Assert::AreEqual((int)checkpoint.FingerprintSize, (int)restored.FingerprintSize);
+            Assert::IsTrue(restored.Fingerprint == checkpoint.Fingerprint);
+
+            Assert::IsFalse(restoredStore.Find(CheckpointStore::GetKey(MakeFileId(2), L"app\\log1.log"), restored));
+        }
+
+        ///
+        /// Check that files without id are found by name, and that Prune and
+        /// Remove drop the checkpoints.
+        ///
+        TEST_METHOD(TestRemoveAndPrune)
+        {
+            const FILE_ID_INFO emptyFileId = {};
+            const std::wstring keyByName = CheckpointStore::GetKey(emptyFileId, L"log1.log");
+            const std::wstring keyById1 = CheckpointStore::GetKey(MakeFileId(1), L"log2.log");
+            const std::wstring keyById2 = CheckpointStore::GetKey(MakeFileId(2), L"log3.log");
+
+            Assert::AreNotEqual(keyByName.c_str(), CheckpointStore::GetKey(emptyFileId, L"log2.log").c_str());
+
+            CheckpointStore store(checkpointPath);
+            FileCheckpoint checkpoint;
+
+            store.Update(keyByName, checkpoint);
+            store.Update(keyById1, checkpoint);
+            store.Update(keyById2, checkpoint);
+
+            store.Remove(keyById2);
+            store.Prune({ keyByName });
+
+            Assert::IsTrue(store.Find(keyByName, checkpoint));
+            Assert::IsFalse(store.Find(keyById1, checkpoint));
+            Assert::IsFalse(store.Find(keyById2, checkpoint));
+        }
+
+        ///
+        /// Check that a corrupted checkpoint file is reported and ignored.
+        ///
+        TEST_METHOD(TestCorruptedCheckpoint)
+        {
+            HANDLE file = CreateFileW(
+                checkpointPath.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+            Assert::IsTrue(file != INVALID_HANDLE_VALUE);
+
+            const char contents[] = "{\"version\": 1, \"files\": [{\"key\": ";
+            DWORD bytesWritten = 0;
+            WriteFile(file, contents, sizeof(contents) - 1, &bytesWritten, nullptr);
+            CloseHandle(file);
+
+            CheckpointStore store(checkpointPath);
+            FileCheckpoint checkpoint;
+
+            Assert::AreEqual((int)ERROR_INVALID_DATA, (int)store.Load());
+            Assert::IsFalse(store.Find(CheckpointStore::GetKey(MakeFileId(1), L"log1.log"), checkpoint));
+        }
+    };
+}
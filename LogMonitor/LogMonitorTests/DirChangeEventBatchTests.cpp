@@ -0,0 +1,160 @@
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//
+
+#include "pch.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace LogMonitorTests
+{
+    ///
+    /// Tests of the DirChangeEventBatch class, used to pass the directory
+    /// change events to the change handler thread.
+    ///
+    TEST_CLASS(DirChangeEventBatchTests)
+    {
+    public:
+        ///
+        /// Check that the events are returned in order, with their file names.
+        ///
+        TEST_METHOD(TestAddAndGet)
+        {
+            DirChangeEventBatch batch;
+
+            batch.Add(EventAction::Add, L"app.log", 1);
+            batch.Add(EventAction::ReInit, L"", 2);
+            batch.Add(EventAction::Modify, L"sub\\app2.log", 3);
+
+            Assert::AreEqual((size_t)3, batch.Size());
+
+            DirChangeNotificationEvent event;
+
+            batch.Get(0, event);
+            Assert::IsTrue(event.Action == EventAction::Add);
+            Assert::AreEqual(L"app.log", event.FileName.c_str());
+            Assert::AreEqual((UINT64)1, event.Timestamp);
+
+            batch.Get(1, event);
+            Assert::IsTrue(event.Action == EventAction::ReInit);
+            Assert::IsTrue(event.FileName.empty());
+
+            batch.Get(2, event);
+            Assert::IsTrue(event.Action == EventAction::Modify);
+            Assert::AreEqual(L"sub\\app2.log", event.FileName.c_str());
+            Assert::AreEqual((UINT64)3, event.Timestamp);
+        }
+
+        ///
+        /// Check that appending a batch keeps the file names of both, and
+        /// that swapping exchanges the events.
+        ///
+        TEST_METHOD(TestAppendAndSwap)
+        {
+            DirChangeEventBatch batch1;
+            DirChangeEventBatch batch2;
+
+            batch1.Add(EventAction::Modify, L"first.log", 1);
+            batch2.Add(EventAction::Remove, L"second.log", 2);
+            batch2.Add(EventAction::RenameNew, L"third.log", 3);
+
+            batch1.Append(batch2);
+
+            Assert::AreEqual((size_t)3, batch1.Size());
+
+            DirChangeNotificationEvent event;
+
+            batch1.Get(0, event);
+            Assert::AreEqual(L"first.log", event.FileName.c_str());
+
+            batch1.Get(2, event);
+            Assert::IsTrue(event.Action == EventAction::RenameNew);
+            Assert::AreEqual(L"third.log", event.FileName.c_str());
+
+            DirChangeEventBatch batch3;
+            batch3.Swap(batch1);
+
+            Assert::IsTrue(batch1.Empty());
+            Assert::AreEqual((size_t)3, batch3.Size());
+
+            batch3.Clear();
+            Assert::IsTrue(batch3.Empty());
+
+            batch3.Add(EventAction::Add, L"fourth.log", 4);
+            batch3.Get(0, event);
+            Assert::AreEqual(L"fourth.log", event.FileName.c_str());
+        }
+
+        ///
+        /// Check that the Modify events of a file are coalesced, ignoring
+        /// the case of its name, and keep the latest timestamp.
+        ///
+        TEST_METHOD(TestCoalesceModify)
+        {
+            DirChangeEventBatch batch;
+
+            Assert::IsTrue(batch.Add(EventAction::Modify, L"app.log", 1));
+            Assert::IsTrue(batch.Add(EventAction::Modify, L"other.log", 2));
+            Assert::IsFalse(batch.Add(EventAction::Modify, L"app.log", 3));
+            Assert::IsFalse(batch.Add(EventAction::Modify, L"APP.LOG", 4));
+
+            Assert::AreEqual((size_t)2, batch.Size());
+
+            DirChangeNotificationEvent event;
+
+            batch.Get(0, event);
+            Assert::AreEqual(L"app.log", event.FileName.c_str());
+            Assert::AreEqual((UINT64)4, event.Timestamp);
+
+            //
+            // Modifications coming from another batch are coalesced too.
+            //
+            DirChangeEventBatch otherBatch;
+            otherBatch.Add(EventAction::Modify, L"other.log", 5);
+            otherBatch.Add(EventAction::Modify, L"new.log", 6);
+
+            batch.Append(otherBatch);
+
+            Assert::AreEqual((size_t)3, batch.Size());
+
+            batch.Get(1, event);
+            Assert::AreEqual(L"other.log", event.FileName.c_str());
+            Assert::AreEqual((UINT64)5, event.Timestamp);
+        }
+
+        ///
+        /// Check that a Modify event isn't coalesced across another event of
+        /// the same file, so the order of the changes is kept.
+        ///
+        TEST_METHOD(TestNoCoalesceAcrossOtherEvents)
+        {
+            DirChangeEventBatch batch;
+
+            batch.Add(EventAction::Modify, L"app.log", 1);
+            batch.Add(EventAction::Remove, L"app.log", 2);
+            batch.Add(EventAction::Modify, L"app.log", 3);
+            batch.Add(EventAction::RenameNew, L"app.log", 4);
+            batch.Add(EventAction::Modify, L"app.log", 5);
+            batch.Add(EventAction::Modify, L"app.log", 6);
+
+            Assert::AreEqual((size_t)5, batch.Size());
+
+            DirChangeNotificationEvent event;
+
+            batch.Get(1, event);
+            Assert::IsTrue(event.Action == EventAction::Remove);
+
+            batch.Get(4, event);
+            Assert::IsTrue(event.Action == EventAction::Modify);
+            Assert::AreEqual((UINT64)6, event.Timestamp);
+
+            //
+            // After Clear, nothing is coalesced with the previous events.
+            //
+            batch.Clear();
+
+            Assert::IsTrue(batch.Add(EventAction::Modify, L"app.log", 7));
+        }
+    };
+}
@@ -0,0 +1,124 @@
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//
+
+#include "pch.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace LogMonitorTests
+{
+    ///
+    /// Tests of the DirectoryEnumerator class, used to rescan the log
+    /// directory in steps after change notifications were lost.
+    ///
+    TEST_CLASS(DirectoryEnumeratorTests)
+    {
+        std::wstring tempDirectory;
+        std::vector<std::wstring> createdFiles;
+        std::vector<std::wstring> createdDirectories;
+
+        void CreateTestDirectory(const std::wstring& Path)
+        {
+            Assert::IsTrue(CreateDirectoryW(Path.c_str(), NULL) != 0);
+            createdDirectories.push_back(Path);
+        }
+
+        void CreateTestFile(const std::wstring& Path, const std::string& Contents)
+        {
+            HANDLE file = CreateFileW(Path.c_str(), GENERIC_WRITE, 0, NULL, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, NULL);
+            Assert::IsTrue(file != INVALID_HANDLE_VALUE);
+
+            DWORD bytesWritten = 0;
+            WriteFile(file, Contents.c_str(), static_cast<DWORD>(Contents.size()), &bytesWritten, NULL);
+            CloseHandle(file);
+
+            createdFiles.push_back(Path);
+        }
+
+        std::map<std::wstring, UINT64> ListFiles(bool IncludeSubfolders)
+        {
+            std::map<std::wstring, UINT64> files;
+            DirectoryEnumerator enumerator(tempDirectory, IncludeSubfolders);
+
+            std::wstring filePath;
+            WIN32_FIND_DATAW findData;
+
+            while (enumerator.Next(filePath, findData))
+            {
+                files[filePath] = (static_cast<UINT64>(findData.nFileSizeHigh) << 32) | findData.nFileSizeLow;
+            }
+
+            Assert::AreEqual((int)ERROR_SUCCESS, (int)enumerator.GetStatus());
+
+            return files;
+        }
+
+    public:
+        TEST_METHOD_INITIALIZE(InitializeDirectoryEnumeratorTests)
+        {
+            tempDirectory = CreateTempDirectory();
+            createdFiles.clear();
+            createdDirectories.clear();
+        }
+
+        TEST_METHOD_CLEANUP(CleanupDirectoryEnumeratorTests)
+        {
+            for (const auto& file : createdFiles)
+            {
+                DeleteFileW(file.c_str());
+            }
+
+            for (auto it = createdDirectories.rbegin(); it != createdDirectories.rend(); ++it)
+            {
+                RemoveDirectoryW(it->c_str());
+            }
+
+            RemoveDirectoryW(tempDirectory.c_str());
+        }
+
+        ///
+        /// Check that the files of the directory and its subdirectories are
+        /// listed with their size, and that the subdirectories whose name
+        /// starts with a dot are skipped.
+        ///
+        TEST_METHOD(TestListFilesInSubfolders)
+        {
+            CreateTestDirectory(tempDirectory + L"\\sub");
+            CreateTestDirectory(tempDirectory + L"\\sub\\nested");
+            CreateTestDirectory(tempDirectory + L"\\.hidden");
+
+            CreateTestFile(tempDirectory + L"\\root.log", "root");
+            CreateTestFile(tempDirectory + L"\\sub\\sub.log", "sub log");
+            CreateTestFile(tempDirectory + L"\\sub\\nested\\nested.log", "");
+            CreateTestFile(tempDirectory + L"\\.hidden\\hidden.log", "hidden");
+
+            std::map<std::wstring, UINT64> files = ListFiles(true);
+
+            Assert::AreEqual((size_t)3, files.size());
+            Assert::AreEqual((UINT64)4, files[tempDirectory + L"\\root.log"]);
+            Assert::AreEqual((UINT64)7, files[tempDirectory + L"\\sub\\sub.log"]);
+            Assert::IsTrue(files.count(tempDirectory + L"\\sub\\nested\\nested.log") == 1);
+
+            files = ListFiles(false);
+
+            Assert::AreEqual((size_t)1, files.size());
+            Assert::IsTrue(files.count(tempDirectory + L"\\root.log") == 1);
+        }
+
+        ///
+        /// Check that listing a directory that doesn't exist fails.
+        ///
+        TEST_METHOD(TestMissingDirectory)
+        {
+            DirectoryEnumerator enumerator(tempDirectory + L"\\missing", true);
+
+            std::wstring filePath;
+            WIN32_FIND_DATAW findData;
+
+            Assert::IsFalse(enumerator.Next(filePath, findData));
+            Assert::AreNotEqual((int)ERROR_SUCCESS, (int)enumerator.GetStatus());
+        }
+    };
+}
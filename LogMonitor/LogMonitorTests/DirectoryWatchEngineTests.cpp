@@ -0,0 +1,182 @@
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//
+
+#include "pch.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace LogMonitorTests
+{
+    ///
+    /// Tests of the DirectoryWatchEngine class, that runs the directory reads
+    /// and the work of all the File sources in a shared pool of threads.
+    ///
+    TEST_CLASS(DirectoryWatchEngineTests)
+    {
+        const DWORD WAIT_TIME_WORK_MAX = 5000;
+
+        ///
+        /// Source counting the runs of its work, and whether two of them
+        /// overlapped.
+        ///
+        class TestClient final : public DirectoryWatchEngine::Client
+        {
+         public:
+            std::function<void()> Work;
+
+            std::atomic<int> Runs{ 0 };
+            std::atomic<bool> IsRunning{ false };
+            std::atomic<bool> HasOverlappingRuns{ false };
+
+            void OnDirectoryChangesCompleted(_In_ DWORD, _In_ DWORD) override
+            {
+            }
+
+            void OnWork() override
+            {
+                if (IsRunning.exchange(true))
+                {
+                    HasOverlappingRuns = true;
+                }
+
+                Runs++;
+
+                if (Work)
+                {
+                    Work();
+                }
+
+                IsRunning = false;
+            }
+        };
+
+    public:
+        ///
+        /// Check that a source signaled while its work runs is run again once
+        /// it finishes, and never by two workers at the same time.
+        ///
+        TEST_METHOD(TestSignalWhileRunning)
+        {
+            HANDLE firstRunStarted = CreateEvent(NULL, TRUE, FALSE, NULL);
+            HANDLE sourceSignaled = CreateEvent(NULL, TRUE, FALSE, NULL);
+            HANDLE runsCompleted = CreateEvent(NULL, TRUE, FALSE, NULL);
+            Assert::IsTrue(firstRunStarted != NULL && sourceSignaled != NULL && runsCompleted != NULL);
+
+            TestClient client;
+
+            client.Work = [&]()
+            {
+                if (client.Runs == 1)
+                {
+                    SetEvent(firstRunStarted);
+                    WaitForSingleObject(sourceSignaled, WAIT_TIME_WORK_MAX);
+                }
+                else
+                {
+                    SetEvent(runsCompleted);
+                }
+            };
+
+            {
+                DirectoryWatchEngine engine(4);
+                auto source = engine.Register(&client);
+
+                engine.Signal(source);
+                Assert::AreEqual(
+                    (int)WAIT_OBJECT_0,
+                    (int)WaitForSingleObject(firstRunStarted, WAIT_TIME_WORK_MAX));
+
+                engine.Signal(source);
+                engine.Signal(source);
+                SetEvent(sourceSignaled);
+
+                Assert::AreEqual(
+                    (int)WAIT_OBJECT_0,
+                    (int)WaitForSingleObject(runsCompleted, WAIT_TIME_WORK_MAX));
+
+                engine.Unregister(source);
+            }
+
+            CloseHandle(firstRunStarted);
+            CloseHandle(sourceSignaled);
+            CloseHandle(runsCompleted);
+
+            Assert::AreEqual(2, client.Runs.load());
+            Assert::IsFalse(client.HasOverlappingRuns.load());
+        }
+
+        ///
+        /// Check that the work of a source runs when its timer is due, and
+        /// that a timer armed again replaces the previous due time.
+        ///
+        TEST_METHOD(TestTimerRunsWork)
+        {
+            HANDLE workRan = CreateEvent(NULL, TRUE, FALSE, NULL);
+            Assert::IsTrue(workRan != NULL);
+
+            TestClient client;
+            UINT64 runTimestamp = 0;
+
+            client.Work = [&]()
+            {
+                runTimestamp = GetTickCount64();
+                SetEvent(workRan);
+            };
+
+            {
+                DirectoryWatchEngine engine(1);
+                auto source = engine.Register(&client);
+
+                const UINT64 armTimestamp = GetTickCount64();
+
+                engine.SetTimer(source, armTimestamp + 50);
+                engine.SetTimer(source, armTimestamp + 500);
+
+                Assert::AreEqual(
+                    (int)WAIT_OBJECT_0,
+                    (int)WaitForSingleObject(workRan, WAIT_TIME_WORK_MAX));
+
+                Assert::IsTrue(runTimestamp >= armTimestamp + 500);
+
+                engine.Unregister(source);
+            }
+
+            CloseHandle(workRan);
+
+            Assert::AreEqual(1, client.Runs.load());
+        }
+
+        ///
+        /// Check that the work of an unregistered source isn't run anymore.
+        ///
+        TEST_METHOD(TestUnregisteredSourceIsNotRun)
+        {
+            TestClient client;
+
+            DirectoryWatchEngine engine(2);
+            auto source = engine.Register(&client);
+
+            engine.SetTimer(source, GetTickCount64() + 100);
+
+            engine.Unregister(source);
+
+            engine.Signal(source);
+            Sleep(300);
+
+            Assert::AreEqual(0, client.Runs.load());
+        }
+
+        ///
+        /// Check that the sources share the engine while one of them uses it.
+        ///
+        TEST_METHOD(TestSharedEngine)
+        {
+            auto engine = DirectoryWatchEngine::Acquire();
+
+            Assert::IsTrue(engine == DirectoryWatchEngine::Acquire());
+            Assert::IsTrue(engine->GetWorkerCount() <= DirectoryWatchEngine::DEFAULT_MAX_WORKER_COUNT);
+        }
+    };
+}
@@ -0,0 +1,114 @@
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//
+
+#include "pch.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace LogMonitorTests
+{
+    ///
+    /// Tests of the FileFilter class, used to match the log files of a File
+    /// source with its filter.
+    ///
+    TEST_CLASS(FileFilterTests)
+    {
+    public:
+        ///
+        /// Check that a file matches any of several patterns, ignoring case,
+        /// and that patterns without a separator match in any subdirectory.
+        ///
+        TEST_METHOD(TestMultiplePatterns)
+        {
+            FileFilter filter(L"*.log; *.txt ;u_ex*.LOG");
+
+            Assert::IsTrue(filter.Matches(L"app.log"));
+            Assert::IsTrue(filter.Matches(L"APP.LOG"));
+            Assert::IsTrue(filter.Matches(L"notes.txt"));
+            Assert::IsTrue(filter.Matches(L"W3SVC1\\u_ex230101.log"));
+            Assert::IsFalse(filter.Matches(L"app.json"));
+            Assert::IsFalse(filter.Matches(L"app.log.1"));
+        }
+
+        ///
+        /// Check that an empty filter, "*" and "*.*" match all the files.
+        ///
+        TEST_METHOD(TestMatchAll)
+        {
+            for (const auto& filterText : { L"", L"*", L"*.*", L" ; " })
+            {
+                FileFilter filter(filterText);
+
+                Assert::IsTrue(filter.Matches(L"app.log"));
+                Assert::IsTrue(filter.Matches(L"sub\\noextension"));
+            }
+        }
+
+        ///
+        /// Check the '?' and '*' wildcards in the middle of a pattern.
+        ///
+        TEST_METHOD(TestWildcards)
+        {
+            FileFilter filter(L"app?-*.log");
+
+            Assert::IsTrue(filter.Matches(L"app1-2023.log"));
+            Assert::IsTrue(filter.Matches(L"app1-.log"));
+            Assert::IsFalse(filter.Matches(L"app-2023.log"));
+            Assert::IsFalse(filter.Matches(L"app12-2023.txt"));
+
+            FileFilter literal(L"access.log");
+
+            Assert::IsTrue(literal.Matches(L"sub\\ACCESS.log"));
+            Assert::IsFalse(literal.Matches(L"access.log.old"));
+        }
+
+        ///
+        /// Check that the files matching a pattern starting with '!' are
+        /// excluded, and that a filter with exclusions only includes all the
+        /// other files.
+        ///
+        TEST_METHOD(TestExclusions)
+        {
+            FileFilter filter(L"*.log;!debug*.log");
+
+            Assert::IsTrue(filter.Matches(L"app.log"));
+            Assert::IsFalse(filter.Matches(L"debug.log"));
+            Assert::IsFalse(filter.Matches(L"sub\\Debug-1.log"));
+
+            FileFilter excludeOnly(L"!*.tmp");
+
+            Assert::IsTrue(excludeOnly.Matches(L"app.log"));
+            Assert::IsFalse(excludeOnly.Matches(L"app.TMP"));
+        }
+
+        ///
+        /// Check that patterns with separators match the relative path, with
+        /// "**" matching any number of subdirectories.
+        ///
+        TEST_METHOD(TestPathPatterns)
+        {
+            FileFilter filter(L"W3SVC*\\u_ex*.log");
+
+            Assert::IsTrue(filter.Matches(L"w3svc1\\u_ex230101.log"));
+            Assert::IsFalse(filter.Matches(L"u_ex230101.log"));
+            Assert::IsFalse(filter.Matches(L"W3SVC1\\old\\u_ex230101.log"));
+
+            FileFilter anyDepth(L"**/archive/*.log");
+
+            Assert::IsTrue(anyDepth.Matches(L"archive\\app.log"));
+            Assert::IsTrue(anyDepth.Matches(L"a\\b\\archive\\app.log"));
+            Assert::IsFalse(anyDepth.Matches(L"archive\\sub\\app.log"));
+            Assert::IsFalse(anyDepth.Matches(L"app.log"));
+
+            FileFilter subtree(L"logs\\**;!logs\\**\\*.tmp");
+
+            Assert::IsTrue(subtree.Matches(L"logs\\app.log"));
+            Assert::IsTrue(subtree.Matches(L"Logs\\a\\b\\app.log"));
+            Assert::IsFalse(subtree.Matches(L"logs\\a\\app.tmp"));
+            Assert::IsFalse(subtree.Matches(L"logs"));
+            Assert::IsFalse(subtree.Matches(L"other\\app.log"));
+        }
+    };
+}
@@ -163,6 +163,392 @@ namespace LogMonitorTests
             Assert::AreEqual(300.0, src2->WaitInSeconds);
         }
 
+        ///
+        /// readerThreads and maxFilesInFlight on a File source must be parsed
+        /// and stored correctly. When omitted the default values must be used.
+        ///
+        TEST_METHOD(JsonProcessor_ParsesReaderPoolSettings)
+        {
+            auto path = WriteTempConfig(R"({
+                "LogConfig": {
+                    "sources": [{
+                        "type": "File",
+                        "directory": "C:\\logs",
+                        "filter": "*.log",
+                        "readerThreads": 8,
+                        "maxFilesInFlight": 32
+                    }, {
+                        "type": "File",
+                        "directory": "C:\\other-logs"
+                    }]
+                }
+            })");
+
+            LoggerSettings settings;
+            bool success = ReadConfigFile((PWCHAR)path.c_str(), settings);
+
+            Assert::IsTrue(success);
+            Assert::AreEqual((size_t)2, settings.Sources.size());
+
+            auto src = std::reinterpret_pointer_cast<SourceFile>(settings.Sources[0]);
+            Assert::AreEqual(8, (int)src->Tuning.ReaderThreads);
+            Assert::AreEqual(32, (int)src->Tuning.MaxFilesInFlight);
+
+            const FileMonitorTuning defaultTuning;
+
+            auto src2 = std::reinterpret_pointer_cast<SourceFile>(settings.Sources[1]);
+            Assert::AreEqual((int)defaultTuning.ReaderThreads, (int)src2->Tuning.ReaderThreads);
+            Assert::AreEqual((int)defaultTuning.MaxFilesInFlight, (int)src2->Tuning.MaxFilesInFlight);
+        }
+
+        ///
+        /// The change coalescing window, the sweep interval and the latency
+        /// report interval must be parsed, and a sweep interval that isn't
+        /// greater than zero must be rejected.
+        ///
+        TEST_METHOD(JsonProcessor_ParsesEventDrivenTailingSettings)
+        {
+            auto path = WriteTempConfig(R"({
+                "LogConfig": {
+                    "sources": [{
+                        "type": "File",
+                        "directory": "C:\\logs",
+                        "modifyCoalescingWindowInMilliseconds": 20,
+                        "sweepIntervalInSeconds": 30,
+                        "latencyReportIntervalInSeconds": 60
+                    }, {
+                        "type": "File",
+                        "directory": "C:\\other-logs"
+                    }, {
+                        "type": "File",
+                        "directory": "C:\\bad-logs",
+                        "sweepIntervalInSeconds": 0
+                    }]
+                }
+            })");
+
+            LoggerSettings settings;
+            bool success = ReadConfigFile((PWCHAR)path.c_str(), settings);
+
+            Assert::IsTrue(success);
+            Assert::AreEqual((size_t)2, settings.Sources.size());
+
+            auto src = std::reinterpret_pointer_cast<SourceFile>(settings.Sources[0]);
+            Assert::AreEqual(20, (int)src->Tuning.ModifyCoalescingWindowInMilliseconds);
+            Assert::AreEqual(30.0, src->Tuning.SweepIntervalInSeconds);
+            Assert::AreEqual(60, (int)src->Tuning.LatencyReportIntervalInSeconds);
+
+            const FileMonitorTuning defaultTuning;
+
+            auto src2 = std::reinterpret_pointer_cast<SourceFile>(settings.Sources[1]);
+            Assert::AreEqual(
+                (int)defaultTuning.ModifyCoalescingWindowInMilliseconds,
+                (int)src2->Tuning.ModifyCoalescingWindowInMilliseconds);
+            Assert::AreEqual(defaultTuning.SweepIntervalInSeconds, src2->Tuning.SweepIntervalInSeconds);
+            Assert::AreEqual(0, (int)src2->Tuning.LatencyReportIntervalInSeconds);
+        }
+
+        ///
+        /// checkpointFile and checkpointIntervalInSeconds must be parsed, and
+        /// checkpoints must be disabled when checkpointFile is omitted.
+        ///
+        TEST_METHOD(JsonProcessor_ParsesCheckpointSettings)
+        {
+            auto path = WriteTempConfig(R"({
+                "LogConfig": {
+                    "sources": [{
+                        "type": "File",
+                        "directory": "C:\\logs",
+                        "checkpointFile": "C:\\checkpoints\\logs.json",
+                        "checkpointIntervalInSeconds": 10
+                    }, {
+                        "type": "File",
+                        "directory": "C:\\other-logs"
+                    }]
+                }
+            })");
+
+            LoggerSettings settings;
+            bool success = ReadConfigFile((PWCHAR)path.c_str(), settings);
+
+            Assert::IsTrue(success);
+            Assert::AreEqual((size_t)2, settings.Sources.size());
+
+            auto src = std::reinterpret_pointer_cast<SourceFile>(settings.Sources[0]);
+            Assert::AreEqual(L"C:\\checkpoints\\logs.json", src->Tuning.CheckpointFile.c_str());
+            Assert::AreEqual(10, (int)src->Tuning.CheckpointIntervalInSeconds);
+
+            auto src2 = std::reinterpret_pointer_cast<SourceFile>(settings.Sources[1]);
+            Assert::IsTrue(src2->Tuning.CheckpointFile.empty());
+            Assert::AreEqual(
+                (int)FileMonitorTuning().CheckpointIntervalInSeconds,
+                (int)src2->Tuning.CheckpointIntervalInSeconds);
+        }
+
+        ///
+        /// notificationBufferSizeInKB, maxNotificationBufferSizeInKB and
+        /// headerFingerprintSizeInBytes must be parsed, and default when omitted.
+        ///
+        TEST_METHOD(JsonProcessor_ParsesNotificationBufferSettings)
+        {
+            auto path = WriteTempConfig(R"({
+                "LogConfig": {
+                    "sources": [{
+                        "type": "File",
+                        "directory": "C:\\logs",
+                        "notificationBufferSizeInKB": 32,
+                        "maxNotificationBufferSizeInKB": 256,
+                        "headerFingerprintSizeInBytes": 512
+                    }, {
+                        "type": "File",
+                        "directory": "C:\\other-logs"
+                    }]
+                }
+            })");
+
+            LoggerSettings settings;
+            bool success = ReadConfigFile((PWCHAR)path.c_str(), settings);
+
+            Assert::IsTrue(success);
+            Assert::AreEqual((size_t)2, settings.Sources.size());
+
+            auto src = std::reinterpret_pointer_cast<SourceFile>(settings.Sources[0]);
+            Assert::AreEqual(32, (int)src->Tuning.NotificationBufferSizeInKB);
+            Assert::AreEqual(256, (int)src->Tuning.MaxNotificationBufferSizeInKB);
+            Assert::AreEqual(512, (int)src->Tuning.HeaderFingerprintSizeInBytes);
+
+            const FileMonitorTuning defaultTuning;
+
+            auto src2 = std::reinterpret_pointer_cast<SourceFile>(settings.Sources[1]);
+            Assert::AreEqual(
+                (int)defaultTuning.NotificationBufferSizeInKB,
+                (int)src2->Tuning.NotificationBufferSizeInKB);
+            Assert::AreEqual(
+                (int)defaultTuning.MaxNotificationBufferSizeInKB,
+                (int)src2->Tuning.MaxNotificationBufferSizeInKB);
+            Assert::AreEqual(
+                (int)defaultTuning.HeaderFingerprintSizeInBytes,
+                (int)src2->Tuning.HeaderFingerprintSizeInBytes);
+        }
+
+        ///
+        /// readBudgetInKB and priorities must be parsed, and default when
+        /// omitted. A priority without a weight invalidates the source.
+        ///
+        TEST_METHOD(JsonProcessor_ParsesReadBudgetSettings)
+        {
+            auto path = WriteTempConfig(R"({
+                "LogConfig": {
+                    "sources": [{
+                        "type": "File",
+                        "directory": "C:\\logs",
+                        "readBudgetInKB": 256,
+                        "priorities": [
+                            { "filter": "u_ex*.log", "weight": 4 },
+                            { "filter": "debug\\*", "weight": 1 }
+                        ]
+                    }, {
+                        "type": "File",
+                        "directory": "C:\\other-logs"
+                    }, {
+                        "type": "File",
+                        "directory": "C:\\invalid-logs",
+                        "priorities": [ { "filter": "*.log" } ]
+                    }]
+                }
+            })");
+
+            LoggerSettings settings;
+            bool success = ReadConfigFile((PWCHAR)path.c_str(), settings);
+
+            Assert::IsTrue(success);
+            Assert::AreEqual((size_t)2, settings.Sources.size());
+
+            auto src = std::reinterpret_pointer_cast<SourceFile>(settings.Sources[0]);
+            Assert::AreEqual(256, (int)src->Tuning.ReadBudgetInKB);
+            Assert::AreEqual((size_t)2, src->Tuning.Priorities.size());
+            Assert::AreEqual(L"u_ex*.log", src->Tuning.Priorities[0].Filter.c_str());
+            Assert::AreEqual(4, (int)src->Tuning.Priorities[0].Weight);
+            Assert::AreEqual(L"debug\\*", src->Tuning.Priorities[1].Filter.c_str());
+            Assert::AreEqual(1, (int)src->Tuning.Priorities[1].Weight);
+
+            auto src2 = std::reinterpret_pointer_cast<SourceFile>(settings.Sources[1]);
+            Assert::AreEqual((int)FileMonitorTuning().ReadBudgetInKB, (int)src2->Tuning.ReadBudgetInKB);
+            Assert::IsTrue(src2->Tuning.Priorities.empty());
+        }
+
+        ///
+        /// The output flush interval and size must be parsed, and default when
+        /// the output section is omitted. A flush size of zero is rejected.
+        ///
+        TEST_METHOD(JsonProcessor_ParsesOutputSettings)
+        {
+            auto path = WriteTempConfig(R"({
+                "LogConfig": {
+                    "output": {
+                        "flushIntervalInMilliseconds": 20,
+                        "flushSizeInKB": 256
+                    },
+                    "sources": [{
+                        "type": "File",
+                        "directory": "C:\\logs"
+                    }]
+                }
+            })");
+
+            LoggerSettings settings;
+            Assert::IsTrue(ReadConfigFile((PWCHAR)path.c_str(), settings));
+            Assert::AreEqual(20, (int)settings.Output.FlushIntervalInMilliseconds);
+            Assert::AreEqual(256, (int)settings.Output.FlushSizeInKB);
+
+            auto path2 = WriteTempConfig(R"({
+                "LogConfig": {
+                    "sources": [{
+                        "type": "File",
+                        "directory": "C:\\logs"
+                    }]
+                }
+            })");
+
+            LoggerSettings settings2;
+            Assert::IsTrue(ReadConfigFile((PWCHAR)path2.c_str(), settings2));
+            Assert::AreEqual(
+                (int)OutputSettings().FlushIntervalInMilliseconds,
+                (int)settings2.Output.FlushIntervalInMilliseconds);
+            Assert::AreEqual((int)OutputSettings().FlushSizeInKB, (int)settings2.Output.FlushSizeInKB);
+
+            auto path3 = WriteTempConfig(R"({
+                "LogConfig": {
+                    "output": { "flushSizeInKB": 0 },
+                    "sources": [{
+                        "type": "File",
+                        "directory": "C:\\logs"
+                    }]
+                }
+            })");
+
+            LoggerSettings settings3;
+            Assert::IsFalse(ReadConfigFile((PWCHAR)path3.c_str(), settings3));
+        }
+
+        ///
+        /// Check that the queue size and overflow policy of the output are
+        /// parsed, and that an unknown policy is rejected.
+        ///
+        TEST_METHOD(JsonProcessor_ParsesOutputOverflowPolicy)
+        {
+            auto path = WriteTempConfig(R"({
+                "LogConfig": {
+                    "output": {
+                        "queueSizeInKB": 1024,
+                        "overflowPolicy": "DropOldest",
+                        "sampleRate": 4,
+                        "dropReportIntervalInSeconds": 30
+                    },
+                    "sources": [{
+                        "type": "File",
+                        "directory": "C:\\logs"
+                    }]
+                }
+            })");
+
+            LoggerSettings settings;
+            Assert::IsTrue(ReadConfigFile((PWCHAR)path.c_str(), settings));
+            Assert::AreEqual(1024, (int)settings.Output.QueueSizeInKB);
+            Assert::IsTrue(settings.Output.OverflowPolicy == OutputOverflowPolicy::DropOldest);
+            Assert::AreEqual(4, (int)settings.Output.SampleRate);
+            Assert::AreEqual(30, (int)settings.Output.DropReportIntervalInSeconds);
+
+            auto path2 = WriteTempConfig(R"({
+                "LogConfig": {
+                    "output": { "overflowPolicy": "discard" },
+                    "sources": [{
+                        "type": "File",
+                        "directory": "C:\\logs"
+                    }]
+                }
+            })");
+
+            LoggerSettings settings2;
+            Assert::IsFalse(ReadConfigFile((PWCHAR)path2.c_str(), settings2));
+        }
+
+        ///
+        /// Check that the spill settings of the output are parsed.
+        ///
+        TEST_METHOD(JsonProcessor_ParsesOutputSpillSettings)
+        {
+            auto path = WriteTempConfig(R"({
+                "LogConfig": {
+                    "output": {
+                        "overflowPolicy": "spill",
+                        "spillDirectory": "D:\\spill",
+                        "spillMaxSizeInMB": 64,
+                        "spillMaxAgeInSeconds": 120
+                    },
+                    "sources": [{
+                        "type": "File",
+                        "directory": "C:\\logs"
+                    }]
+                }
+            })");
+
+            LoggerSettings settings;
+            Assert::IsTrue(ReadConfigFile((PWCHAR)path.c_str(), settings));
+            Assert::IsTrue(settings.Output.OverflowPolicy == OutputOverflowPolicy::Spill);
+            Assert::AreEqual(std::wstring(L"D:\\spill"), settings.Output.SpillDirectory);
+            Assert::AreEqual(64, (int)settings.Output.SpillMaxSizeInMB);
+            Assert::AreEqual(120, (int)settings.Output.SpillMaxAgeInSeconds);
+        }
+
+        ///
+        /// Check that the output file settings are parsed, and that stdout
+        /// can only be disabled with an output file.
+        ///
+        TEST_METHOD(JsonProcessor_ParsesOutputFileSettings)
+        {
+            auto path = WriteTempConfig(R"({
+                "LogConfig": {
+                    "output": {
+                        "stdout": false,
+                        "file": {
+                            "path": "D:\\logs\\logmonitor.log",
+                            "maxSizeInMB": 50,
+                            "rotationIntervalInMinutes": 60,
+                            "maxFiles": 3,
+                            "compress": true
+                        }
+                    },
+                    "sources": [{
+                        "type": "File",
+                        "directory": "C:\\logs"
+                    }]
+                }
+            })");
+
+            LoggerSettings settings;
+            Assert::IsTrue(ReadConfigFile((PWCHAR)path.c_str(), settings));
+            Assert::IsFalse(settings.Output.WriteToStdout);
+            Assert::AreEqual(std::wstring(L"D:\\logs\\logmonitor.log"), settings.Output.File.Path);
+            Assert::AreEqual(50, (int)settings.Output.File.MaxSizeInMB);
+            Assert::AreEqual(60, (int)settings.Output.File.RotationIntervalInMinutes);
+            Assert::AreEqual(3, (int)settings.Output.File.MaxFiles);
+            Assert::IsTrue(settings.Output.File.Compress);
+
+            auto path2 = WriteTempConfig(R"({
+                "LogConfig": {
+                    "output": { "stdout": false },
+                    "sources": [{
+                        "type": "File",
+                        "directory": "C:\\logs"
+                    }]
+                }
+            })");
+
+            LoggerSettings settings2;
+            Assert::IsFalse(ReadConfigFile((PWCHAR)path2.c_str(), settings2));
+        }
+
         ///
         /// A source with an unknown type must be skipped with an error logged,
         /// but valid sources in the same config must still be processed.
@@ -0,0 +1,81 @@
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//
+
+#include "pch.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace LogMonitorTests
+{
+    ///
+    /// Tests of the LatencyHistogram class, used to report the latency of
+    /// the lines read from log files.
+    ///
+    TEST_CLASS(LatencyHistogramTests)
+    {
+    public:
+        ///
+        /// Check that an empty histogram reports 0, and that small values
+        /// are reported exactly.
+        ///
+        TEST_METHOD(TestSmallValues)
+        {
+            LatencyHistogram histogram;
+
+            Assert::AreEqual(0, (int)histogram.Percentile(50));
+
+            histogram.Record(1);
+            histogram.Record(2);
+            histogram.Record(3);
+
+            Assert::AreEqual(3, (int)histogram.Count());
+            Assert::AreEqual(1, (int)histogram.Percentile(0));
+            Assert::AreEqual(2, (int)histogram.Percentile(50));
+            Assert::AreEqual(3, (int)histogram.Percentile(100));
+        }
+
+        ///
+        /// Check that percentiles of large values are within a quarter of
+        /// the real value, and never below it.
+        ///
+        TEST_METHOD(TestLargeValuesPrecision)
+        {
+            const int values[] = { 5, 17, 100, 999, 1000, 65537, 3600000 };
+
+            for (int value : values)
+            {
+                LatencyHistogram histogram;
+                histogram.Record(value);
+
+                const int percentile = (int)histogram.Percentile(50);
+
+                Assert::IsTrue(percentile >= value);
+                Assert::IsTrue(percentile <= value + value / 4);
+            }
+        }
+
+        ///
+        /// Check that the count of a value weights the percentiles, and that
+        /// Clear removes all the values.
+        ///
+        TEST_METHOD(TestWeightedPercentiles)
+        {
+            LatencyHistogram histogram;
+
+            histogram.Record(2, 98);
+            histogram.Record(1000, 2);
+
+            Assert::AreEqual(100, (int)histogram.Count());
+            Assert::AreEqual(2, (int)histogram.Percentile(50));
+            Assert::AreEqual(2, (int)histogram.Percentile(98));
+            Assert::IsTrue(histogram.Percentile(99) >= 1000);
+
+            histogram.Clear();
+
+            Assert::AreEqual(0, (int)histogram.Count());
+            Assert::AreEqual(0, (int)histogram.Percentile(99));
+        }
+    };
+}
@@ -0,0 +1,126 @@
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//
+
+#include "pch.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace LogMonitorTests
+{
+    ///
+    /// Tests of the LineFramer class, used to split the content read from
+    /// log files into lines.
+    ///
+    TEST_CLASS(LineFramerTests)
+    {
+        std::vector<std::wstring> lines;
+
+        ///
+        /// Pushes a text to a framer, storing the lines in the lines vector.
+        ///
+        void Push(LineFramer<wchar_t>& Framer, const std::wstring& Text)
+        {
+            Framer.Push(
+                Text.data(),
+                Text.size(),
+                [this](std::wstring_view Line) { lines.emplace_back(Line); });
+        }
+
+    public:
+        TEST_METHOD_INITIALIZE(InitializeLineFramerTests)
+        {
+            lines.clear();
+        }
+
+        ///
+        /// Check that LF, CR LF, LF CR and CR new lines are supported, and
+        /// that empty lines are skipped.
+        ///
+        TEST_METHOD(TestNewLineTypes)
+        {
+            LineFramer<wchar_t> framer;
+
+            Push(framer, L"lf\ncrlf\r\nlfcr\n\rcr\r\n\n\r\nlast\n");
+
+            Assert::AreEqual((size_t)5, lines.size());
+            Assert::AreEqual(L"lf", lines[0].c_str());
+            Assert::AreEqual(L"crlf", lines[1].c_str());
+            Assert::AreEqual(L"lfcr", lines[2].c_str());
+            Assert::AreEqual(L"cr", lines[3].c_str());
+            Assert::AreEqual(L"last", lines[4].c_str());
+            Assert::IsFalse(framer.HasPartialLine());
+        }
+
+        ///
+        /// Check that incomplete lines are carried to the next push, including
+        /// a CR LF new line split between two pushes.
+        ///
+        TEST_METHOD(TestPartialLines)
+        {
+            LineFramer<wchar_t> framer;
+
+            Push(framer, L"first li");
+            Assert::AreEqual((size_t)0, lines.size());
+            Assert::IsTrue(framer.HasPartialLine());
+
+            Push(framer, L"ne\r");
+            Assert::AreEqual((size_t)1, lines.size());
+            Assert::AreEqual(L"first line", lines[0].c_str());
+
+            Push(framer, L"\nsecond");
+            Push(framer, L" line");
+            Assert::AreEqual((size_t)1, lines.size());
+
+            framer.Flush([this](std::wstring_view Line) { lines.emplace_back(Line); });
+            Assert::AreEqual((size_t)2, lines.size());
+            Assert::AreEqual(L"second line", lines[1].c_str());
+            Assert::IsFalse(framer.HasPartialLine());
+        }
+
+        ///
+        /// Check that with LineBreakMode::Lf, LF, CR LF and LF CR new lines
+        /// are supported, including when split between two pushes, and that
+        /// a CR alone is kept in the line.
+        ///
+        TEST_METHOD(TestLfNewLines)
+        {
+            LineFramer<wchar_t> framer(LineBreakMode::Lf);
+
+            Push(framer, L"lf\ncrlf\r\nlfcr\n\rlone\rcr\n\r\n\nsplit crlf\r");
+            Assert::AreEqual((size_t)4, lines.size());
+            Assert::AreEqual(L"lf", lines[0].c_str());
+            Assert::AreEqual(L"crlf", lines[1].c_str());
+            Assert::AreEqual(L"lfcr", lines[2].c_str());
+            Assert::AreEqual(L"lone\rcr", lines[3].c_str());
+
+            Push(framer, L"\nsplit lfcr\n");
+            Push(framer, L"\rlast\r");
+            Assert::AreEqual((size_t)6, lines.size());
+            Assert::AreEqual(L"split crlf", lines[4].c_str());
+            Assert::AreEqual(L"split lfcr", lines[5].c_str());
+
+            framer.Flush([this](std::wstring_view Line) { lines.emplace_back(Line); });
+            Assert::AreEqual((size_t)7, lines.size());
+            Assert::AreEqual(L"last", lines[6].c_str());
+            Assert::IsFalse(framer.HasPartialLine());
+        }
+
+        ///
+        /// Check that ForEachLine splits a whole text, including the text
+        /// after the last new line.
+        ///
+        TEST_METHOD(TestForEachLine)
+        {
+            LineFramer<char>::ForEachLine(
+                "first\r\nsecond\n\nthird",
+                [this](std::string_view Line) { lines.emplace_back(Line.begin(), Line.end()); });
+
+            Assert::AreEqual((size_t)3, lines.size());
+            Assert::AreEqual(L"first", lines[0].c_str());
+            Assert::AreEqual(L"second", lines[1].c_str());
+            Assert::AreEqual(L"third", lines[2].c_str());
+        }
+    };
+}
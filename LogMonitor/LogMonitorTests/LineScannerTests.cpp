@@ -0,0 +1,167 @@
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//
+
+#include "pch.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace LogMonitorTests
+{
+    ///
+    /// Tests of the LineScanner class, used to find complete lines in the
+    /// raw content of log files.
+    ///
+    TEST_CLASS(LineScannerTests)
+    {
+    public:
+        ///
+        /// Check that the last CR or LF is found in byte buffers.
+        ///
+        TEST_METHOD(TestFindLastLineBreakBytes)
+        {
+            std::string content = "first line\r\nsecond line\nincomplete";
+
+            const char* begin = content.data();
+            const char* end = content.data() + content.size();
+
+            const char* lastLineBreak = LineScanner::FindLastLineBreak(begin, end, '\r', '\n');
+            Assert::AreEqual(content.find_last_of("\r\n"), static_cast<size_t>(lastLineBreak - begin));
+
+            //
+            // CR only new lines are line breaks too.
+            //
+            content = "first line\rsecond";
+            begin = content.data();
+            end = content.data() + content.size();
+
+            lastLineBreak = LineScanner::FindLastLineBreak(begin, end, '\r', '\n');
+            Assert::AreEqual(static_cast<size_t>(10), static_cast<size_t>(lastLineBreak - begin));
+        }
+
+        ///
+        /// Check that End is returned when there is no line break.
+        ///
+        TEST_METHOD(TestFindLastLineBreakNotFound)
+        {
+            std::string content = "a line without line breaks";
+
+            const char* begin = content.data();
+            const char* end = content.data() + content.size();
+
+            Assert::IsTrue(LineScanner::FindLastLineBreak(begin, end, '\r', '\n') == end);
+            Assert::IsTrue(LineScanner::FindLastLineBreak(begin, begin, '\r', '\n') == begin);
+        }
+
+        ///
+        /// Check that line breaks are found in UTF-16 buffers, in both
+        /// little and big endian.
+        ///
+        TEST_METHOD(TestFindLastLineBreakUtf16)
+        {
+            std::vector<uint16_t> content = { L'a', L'\r', L'\n', L'b', L'c' };
+
+            const uint16_t* begin = content.data();
+            const uint16_t* end = content.data() + content.size();
+
+            const uint16_t* lastLineBreak = LineScanner::FindLastLineBreak<uint16_t>(begin, end, L'\r', L'\n');
+            Assert::AreEqual(static_cast<size_t>(2), static_cast<size_t>(lastLineBreak - begin));
+
+            for (auto& unit : content)
+            {
+                unit = LineScanner::SwapBytes(unit);
+            }
+
+            lastLineBreak = LineScanner::FindLastLineBreak<uint16_t>(
+                begin,
+                end,
+                LineScanner::SwapBytes(L'\r'),
+                LineScanner::SwapBytes(L'\n'));
+            Assert::AreEqual(static_cast<size_t>(2), static_cast<size_t>(lastLineBreak - begin));
+        }
+
+        ///
+        /// Check that the first and last line breaks are found at every
+        /// position of buffers longer than a block, so both the block scan
+        /// and the scan of the remaining units are covered.
+        ///
+        TEST_METHOD(TestFindLineBreaksAcrossBlocks)
+        {
+            const size_t size = LineScanner::BLOCK_SIZE * 3 + 5;
+
+            for (size_t position = 0; position < size; position++)
+            {
+                std::string bytes(size, 'a');
+                std::vector<uint16_t> units(size, L'a');
+
+                bytes[position] = '\n';
+                units[position] = L'\r';
+
+                const char* bytesBegin = bytes.data();
+                const char* bytesEnd = bytes.data() + bytes.size();
+                const uint16_t* unitsBegin = units.data();
+                const uint16_t* unitsEnd = units.data() + units.size();
+
+                Assert::IsTrue(
+                    LineScanner::FindNextLineBreak(bytesBegin, bytesEnd, '\r', '\n') == bytesBegin + position);
+                Assert::IsTrue(
+                    LineScanner::FindLastLineBreak(bytesBegin, bytesEnd, '\r', '\n') == bytesBegin + position);
+                Assert::IsTrue(
+                    LineScanner::FindNextLineBreak<uint16_t>(unitsBegin, unitsEnd, L'\r', L'\n') ==
+                    unitsBegin + position);
+                Assert::IsTrue(
+                    LineScanner::FindLastLineBreak<uint16_t>(unitsBegin, unitsEnd, L'\r', L'\n') ==
+                    unitsBegin + position);
+            }
+        }
+
+        ///
+        /// Check that the mask of a block computed with each instruction set
+        /// supported by the machine matches the scalar one. The UTF-16 units include
+        /// values whose low or high byte is CR or LF, which must not match.
+        ///
+        TEST_METHOD(TestLineBreakMaskMatchesScalar)
+        {
+            const uint16_t unitValues[] = { L'a', L'\r', L'\n', 0x0D00, 0x0A0D, 0xFF0A, 0x8000 };
+
+            uint8_t bytes[LineScanner::BLOCK_SIZE];
+            uint16_t units[LineScanner::BLOCK_SIZE];
+            unsigned int seed = 1;
+
+            for (int iteration = 0; iteration < 1000; iteration++)
+            {
+                for (size_t i = 0; i < LineScanner::BLOCK_SIZE; i++)
+                {
+                    seed = seed * 1103515245 + 12345;
+                    const unsigned int value = seed >> 16;
+
+                    bytes[i] = static_cast<uint8_t>(value % 4 == 0 ? '\n' : value % 7 == 0 ? '\r' : value);
+                    units[i] = unitValues[value % (sizeof(unitValues) / sizeof(unitValues[0]))];
+                }
+
+                Assert::IsTrue(
+                    LineScanner::LineBreakMaskScalar<uint8_t>(bytes, '\r', '\n') ==
+                    LineScanner::LineBreakMask<uint8_t>(bytes, '\r', '\n'));
+                Assert::IsTrue(
+                    LineScanner::LineBreakMaskScalar<uint16_t>(units, L'\r', L'\n') ==
+                    LineScanner::LineBreakMask<uint16_t>(units, L'\r', L'\n'));
+
+                //
+                // Also check the kernels below the one of the machine.
+                //
+                for (int level = 0; level <= static_cast<int>(LineScanner::GetSimdLevel()); level++)
+                {
+                    const auto simdLevel = static_cast<LineScanner::SimdLevel>(level);
+
+                    Assert::IsTrue(
+                        LineScanner::LineBreakMaskScalar<uint8_t>(bytes, '\r', '\n') ==
+                        LineScanner::LineBreakMask<uint8_t>(bytes, '\r', '\n', simdLevel));
+                    Assert::IsTrue(
+                        LineScanner::LineBreakMaskScalar<uint16_t>(units, L'\r', L'\n') ==
+                        LineScanner::LineBreakMask<uint16_t>(units, L'\r', L'\n', simdLevel));
+                }
+            }
+        }
+    };
+}
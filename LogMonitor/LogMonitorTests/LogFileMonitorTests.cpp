@@ -1062,5 +1062,1181 @@ namespace LogMonitorTests
                 Assert::IsTrue(output.find(TO_WSTR(content)) != std::wstring::npos);
             }
         }
+
+        ///
+        /// Check that a file being tailed can still be deleted and renamed,
+        /// and that a new file created with the same name is read from the
+        /// beginning.
+        ///
+        TEST_METHOD(TestDeleteAndRenameTailedFile)
+        {
+            std::wstring output;
+
+            std::wstring tempDirectory = CreateTempDirectory();
+            Assert::IsFalse(tempDirectory.empty());
+
+            directoriesToDeleteAtCleanup.push_back(tempDirectory);
+
+            std::wstring filename = tempDirectory + L"\\tailed.log";
+            std::string oldContent = "Old content";
+
+            WriteToFile(filename, oldContent.c_str(), oldContent.length());
+
+            //
+            // Start the monitor
+            //
+            SourceFile sourceFile;
+            sourceFile.Directory = tempDirectory;
+            sourceFile.Filter = L"*.log";
+            sourceFile.IncludeSubdirectories = false;
+            sourceFile.WaitInSeconds = 10;
+
+            fflush(stdout);
+            ZeroMemory(bigOutBuf, sizeof(bigOutBuf));
+
+            std::shared_ptr<LogFileMonitor> logfileMon = std::make_shared<LogFileMonitor>(sourceFile.Directory, sourceFile.Filter, sourceFile.IncludeSubdirectories, sourceFile.WaitInSeconds, L"json", L"");
+            Sleep(WAIT_TIME_LOGFILEMONITOR_START);
+
+            output = RecoverOuput();
+            Assert::AreEqual(L"", output.c_str());
+
+            //
+            // Write to the file, so the monitor keeps it open.
+            //
+            {
+                fflush(stdout);
+                ZeroMemory(bigOutBuf, sizeof(bigOutBuf));
+
+                std::string content = "Tailed content";
+
+                WriteToFile(filename, content.c_str(), content.length());
+
+                int retries = 0;
+                do {
+                    retries++;
+                    Sleep(WAIT_TIME_LOGFILEMONITOR_AFTER_WRITE_SHORT);
+                    output = RecoverOuput();
+                } while (output.empty() && retries < READ_OUTPUT_RETRIES);
+
+                Assert::IsTrue(output.find(TO_WSTR(content)) != std::wstring::npos);
+            }
+
+            //
+            // Delete the file and create it again. The new file must be
+            // read from the start.
+            //
+            {
+                Assert::IsTrue(DeleteFileW(filename.c_str()) != 0);
+                Sleep(WAIT_TIME_LOGFILEMONITOR_AFTER_WRITE_LONG);
+
+                fflush(stdout);
+                ZeroMemory(bigOutBuf, sizeof(bigOutBuf));
+
+                std::string content = "Recreated content";
+
+                //
+                // The name is released once the monitor closes its handle
+                // to the deleted file, which happens in its next read.
+                //
+                DWORD writeStatus = 0;
+                int retries = 0;
+                do {
+                    retries++;
+                    writeStatus = WriteToFile(filename, content.c_str(), content.length());
+                    if (writeStatus != 0)
+                    {
+                        Sleep(WAIT_TIME_LOGFILEMONITOR_AFTER_WRITE_SHORT);
+                    }
+                } while (writeStatus != 0 && retries < READ_OUTPUT_RETRIES);
+
+                Assert::AreEqual(0UL, writeStatus);
+
+                retries = 0;
+                do {
+                    retries++;
+                    Sleep(WAIT_TIME_LOGFILEMONITOR_AFTER_WRITE_SHORT);
+                    output = RecoverOuput();
+                } while (output.empty() && retries < READ_OUTPUT_RETRIES);
+
+                Assert::IsTrue(output.find(TO_WSTR(content)) != std::wstring::npos);
+            }
+
+            //
+            // Rotate the file: rename it and create a new one with the
+            // same name.
+            //
+            {
+                std::wstring rotatedFilename = tempDirectory + L"\\tailed.log.1";
+
+                bool success = MoveFile(filename.c_str(), rotatedFilename.c_str());
+                Assert::IsTrue(success);
+                Sleep(WAIT_TIME_LOGFILEMONITOR_AFTER_WRITE_LONG);
+
+                fflush(stdout);
+                ZeroMemory(bigOutBuf, sizeof(bigOutBuf));
+
+                std::string content = "Rotated content";
+
+                Assert::AreEqual(0UL, WriteToFile(filename, content.c_str(), content.length()));
+
+                int retries = 0;
+                do {
+                    retries++;
+                    Sleep(WAIT_TIME_LOGFILEMONITOR_AFTER_WRITE_SHORT);
+                    output = RecoverOuput();
+                } while (output.empty() && retries < READ_OUTPUT_RETRIES);
+
+                Assert::IsTrue(output.find(TO_WSTR(content)) != std::wstring::npos);
+            }
+        }
+
+        ///
+        /// Check that a file truncated in place is read again from the
+        /// beginning.
+        ///
+        TEST_METHOD(TestTruncatedFile)
+        {
+            std::wstring output;
+
+            std::wstring tempDirectory = CreateTempDirectory();
+            Assert::IsFalse(tempDirectory.empty());
+
+            directoriesToDeleteAtCleanup.push_back(tempDirectory);
+
+            std::wstring filename = tempDirectory + L"\\truncated.log";
+            std::string oldContent = "Old content, longer than the new one";
+
+            WriteToFile(filename, oldContent.c_str(), oldContent.length());
+
+            //
+            // Start the monitor
+            //
+            SourceFile sourceFile;
+            sourceFile.Directory = tempDirectory;
+            sourceFile.Filter = L"*.log";
+            sourceFile.IncludeSubdirectories = false;
+            sourceFile.WaitInSeconds = 10;
+
+            fflush(stdout);
+            ZeroMemory(bigOutBuf, sizeof(bigOutBuf));
+
+            std::shared_ptr<LogFileMonitor> logfileMon = std::make_shared<LogFileMonitor>(sourceFile.Directory, sourceFile.Filter, sourceFile.IncludeSubdirectories, sourceFile.WaitInSeconds, L"json", L"");
+            Sleep(WAIT_TIME_LOGFILEMONITOR_START);
+
+            output = RecoverOuput();
+            Assert::AreEqual(L"", output.c_str());
+
+            //
+            // Truncate the file and write less content than it had.
+            //
+            {
+                fflush(stdout);
+                ZeroMemory(bigOutBuf, sizeof(bigOutBuf));
+
+                HANDLE hFile = CreateFile(
+                    filename.c_str(),
+                    GENERIC_WRITE,
+                    FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                    NULL,
+                    TRUNCATE_EXISTING,
+                    FILE_ATTRIBUTE_NORMAL,
+                    NULL);
+                Assert::IsTrue(hFile != INVALID_HANDLE_VALUE);
+                CloseHandle(hFile);
+
+                std::string content = "New content";
+
+                WriteToFile(filename, content.c_str(), content.length());
+
+                int retries = 0;
+                do {
+                    retries++;
+                    Sleep(WAIT_TIME_LOGFILEMONITOR_AFTER_WRITE_SHORT);
+                    output = RecoverOuput();
+                } while (output.empty() && retries < READ_OUTPUT_RETRIES);
+
+                Assert::IsTrue(output.find(TO_WSTR(content)) != std::wstring::npos);
+            }
+        }
+
+        ///
+        /// Check that, with a header fingerprint, a file truncated and written
+        /// again past the last read offset before it's read again is read
+        /// from the beginning, instead of from the old offset.
+        ///
+        TEST_METHOD(TestRewrittenFile)
+        {
+            std::wstring output;
+
+            std::wstring tempDirectory = CreateTempDirectory();
+            Assert::IsFalse(tempDirectory.empty());
+
+            directoriesToDeleteAtCleanup.push_back(tempDirectory);
+
+            std::wstring filename = tempDirectory + L"\\rewritten.log";
+
+            SourceFile sourceFile;
+            sourceFile.Directory = tempDirectory;
+            sourceFile.Filter = L"*.log";
+            sourceFile.WaitInSeconds = 10;
+            sourceFile.Tuning.HeaderFingerprintSizeInBytes = 64;
+
+            fflush(stdout);
+            ZeroMemory(bigOutBuf, sizeof(bigOutBuf));
+
+            std::shared_ptr<LogFileMonitor> logfileMon = std::make_shared<LogFileMonitor>(
+                sourceFile.Directory,
+                sourceFile.Filter,
+                sourceFile.IncludeSubdirectories,
+                sourceFile.WaitInSeconds,
+                L"Custom",
+                L"%Message%",
+                sourceFile.Tuning);
+            Sleep(WAIT_TIME_LOGFILEMONITOR_START);
+
+            {
+                std::string content = "Old content\n";
+
+                WriteToFile(filename, content.c_str(), content.length());
+
+                int retries = 0;
+                do {
+                    retries++;
+                    Sleep(WAIT_TIME_LOGFILEMONITOR_AFTER_WRITE_SHORT);
+                    output = RecoverOuput();
+                } while (output.empty() && retries < READ_OUTPUT_RETRIES);
+
+                Assert::IsTrue(output.find(L"Old content") != std::wstring::npos);
+            }
+
+            //
+            // Truncate the file and write more content than it had, with no
+            // wait in between, so the file may never be seen smaller.
+            //
+            {
+                fflush(stdout);
+                ZeroMemory(bigOutBuf, sizeof(bigOutBuf));
+
+                HANDLE hFile = CreateFile(
+                    filename.c_str(),
+                    GENERIC_WRITE,
+                    FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                    NULL,
+                    TRUNCATE_EXISTING,
+                    FILE_ATTRIBUTE_NORMAL,
+                    NULL);
+                Assert::IsTrue(hFile != INVALID_HANDLE_VALUE);
+                CloseHandle(hFile);
+
+                std::string content = "Rewritten content, longer than the old one\n";
+
+                WriteToFile(filename, content.c_str(), content.length());
+
+                int retries = 0;
+                do {
+                    retries++;
+                    Sleep(WAIT_TIME_LOGFILEMONITOR_AFTER_WRITE_SHORT);
+                    output = RecoverOuput();
+                } while (output.empty() && retries < READ_OUTPUT_RETRIES);
+
+                Assert::IsTrue(output.find(L"Rewritten content, longer than the old one") != std::wstring::npos);
+                Assert::AreEqual((UINT64)1, logfileMon->GetRotationCounters().TruncatedFiles);
+            }
+        }
+
+        ///
+        /// Check that with a read budget smaller than the files, and a higher
+        /// weight for some of them, the files are read in several rounds with
+        /// every line printed once, in order and not split, and that no file
+        /// is behind its end once they were read.
+        ///
+        TEST_METHOD(TestReadBudget)
+        {
+            const int linesCount = 200;
+            const std::vector<std::string> fileNames = { "high", "low" };
+
+            std::wstring output;
+
+            std::wstring tempDirectory = CreateTempDirectory();
+            Assert::IsFalse(tempDirectory.empty());
+
+            directoriesToDeleteAtCleanup.push_back(tempDirectory);
+
+            SourceFile sourceFile;
+            sourceFile.Directory = tempDirectory;
+            sourceFile.Filter = L"*.log";
+            sourceFile.WaitInSeconds = 10;
+            sourceFile.Tuning.ReaderThreads = 1;
+            sourceFile.Tuning.ReadBudgetInKB = 1;
+            sourceFile.Tuning.Priorities.push_back({ L"high*.log", 2 });
+
+            fflush(stdout);
+            ZeroMemory(bigOutBuf, sizeof(bigOutBuf));
+
+            std::shared_ptr<LogFileMonitor> logfileMon = std::make_shared<LogFileMonitor>(
+                sourceFile.Directory,
+                sourceFile.Filter,
+                sourceFile.IncludeSubdirectories,
+                sourceFile.WaitInSeconds,
+                L"Custom",
+                L"%Message%",
+                sourceFile.Tuning);
+            Sleep(WAIT_TIME_LOGFILEMONITOR_START);
+
+            //
+            // Write each file at once, so a single read would get all of it.
+            //
+            for (const auto& fileName : fileNames)
+            {
+                std::string content;
+
+                for (int line = 0; line < linesCount; line++)
+                {
+                    content += fileName + "-line" + std::to_string(line) + "\n";
+                }
+
+                WriteToFile(tempDirectory + L"\\" + TO_WSTR(fileName) + L".log", content.c_str(), content.length());
+            }
+
+            int retries = 0;
+            do {
+                retries++;
+                Sleep(WAIT_TIME_LOGFILEMONITOR_AFTER_WRITE_LONG);
+                output = RecoverOuput();
+            } while ((output.find(L"high-line" + std::to_wstring(linesCount - 1)) == std::wstring::npos ||
+                      output.find(L"low-line" + std::to_wstring(linesCount - 1)) == std::wstring::npos) &&
+                     retries < READ_OUTPUT_RETRIES);
+
+            for (const auto& fileName : fileNames)
+            {
+                const std::wstring linePrefix = TO_WSTR(fileName) + L"-line";
+                size_t previousPosition = 0;
+
+                for (int line = 0; line < linesCount; line++)
+                {
+                    //
+                    // Include the new line, so line1 doesn't match line10.
+                    //
+                    std::wstring expectedLine = linePrefix + std::to_wstring(line) + L"\n";
+
+                    size_t position = output.find(expectedLine);
+
+                    Assert::IsTrue(position != std::wstring::npos);
+                    Assert::IsTrue(line == 0 || position > previousPosition);
+                    Assert::IsTrue(output.find(expectedLine, position + 1) == std::wstring::npos);
+
+                    previousPosition = position;
+                }
+            }
+
+            Assert::AreEqual((UINT64)0, logfileMon->GetReadLag().TotalBytes);
+        }
+
+        ///
+        /// Check that when several files are read by the reader pool, with
+        /// fewer files in flight than files written, all the lines are printed
+        /// and the lines of each file keep their order.
+        ///
+        TEST_METHOD(TestFilesReadConcurrently)
+        {
+            const int filesCount = 3;
+            const int linesCount = 20;
+
+            std::wstring output;
+
+            std::wstring tempDirectory = CreateTempDirectory();
+            Assert::IsFalse(tempDirectory.empty());
+
+            directoriesToDeleteAtCleanup.push_back(tempDirectory);
+
+            //
+            // Start the monitor
+            //
+            SourceFile sourceFile;
+            sourceFile.Directory = tempDirectory;
+            sourceFile.Filter = L"*.log";
+            sourceFile.IncludeSubdirectories = false;
+            sourceFile.WaitInSeconds = 10;
+
+            sourceFile.Tuning.ReaderThreads = 2;
+            sourceFile.Tuning.MaxFilesInFlight = 1;
+
+            fflush(stdout);
+            ZeroMemory(bigOutBuf, sizeof(bigOutBuf));
+
+            std::shared_ptr<LogFileMonitor> logfileMon = std::make_shared<LogFileMonitor>(
+                sourceFile.Directory,
+                sourceFile.Filter,
+                sourceFile.IncludeSubdirectories,
+                sourceFile.WaitInSeconds,
+                L"json",
+                L"",
+                sourceFile.Tuning);
+            Sleep(WAIT_TIME_LOGFILEMONITOR_START);
+
+            output = RecoverOuput();
+            Assert::AreEqual(L"", output.c_str());
+
+            //
+            // Interleave the writes to the files.
+            //
+            for (int line = 0; line < linesCount; line++)
+            {
+                for (int file = 0; file < filesCount; file++)
+                {
+                    std::wstring filename = tempDirectory + L"\\file" + std::to_wstring(file) + L".log";
+                    std::string content = "file" + std::to_string(file) + "-line" + std::to_string(line) + "\n";
+
+                    WriteToFile(filename, content.c_str(), content.length());
+                }
+            }
+
+            std::wstring lastLine =
+                L"file" + std::to_wstring(filesCount - 1) + L"-line" + std::to_wstring(linesCount - 1);
+
+            int retries = 0;
+            do {
+                retries++;
+                Sleep(WAIT_TIME_LOGFILEMONITOR_AFTER_WRITE_LONG);
+                output = RecoverOuput();
+            } while (output.find(lastLine + L"\"") == std::wstring::npos && retries < READ_OUTPUT_RETRIES);
+
+            for (int file = 0; file < filesCount; file++)
+            {
+                size_t previousPosition = 0;
+
+                for (int line = 0; line < linesCount; line++)
+                {
+                    //
+                    // Include the closing quote, so line1 doesn't match line10.
+                    //
+                    std::wstring expectedLine =
+                        L"file" + std::to_wstring(file) + L"-line" + std::to_wstring(line) + L"\"";
+
+                    size_t position = output.find(expectedLine);
+
+                    Assert::IsTrue(position != std::wstring::npos);
+                    Assert::IsTrue(line == 0 || position > previousPosition);
+
+                    previousPosition = position;
+                }
+            }
+        }
+
+        ///
+        /// Check that with a checkpoint file, a restarted monitor prints the
+        /// lines written while it was stopped, and doesn't print again the
+        /// lines printed before it was stopped.
+        ///
+        TEST_METHOD(TestResumeFromCheckpoint)
+        {
+            std::wstring output;
+
+            std::wstring tempDirectory = CreateTempDirectory();
+            Assert::IsFalse(tempDirectory.empty());
+
+            directoriesToDeleteAtCleanup.push_back(tempDirectory);
+
+            SourceFile sourceFile;
+            sourceFile.Directory = tempDirectory;
+            sourceFile.Filter = L"*.log";
+            sourceFile.Tuning.CheckpointFile = tempDirectory + L"\\checkpoint.json";
+
+            const std::wstring filename = tempDirectory + L"\\test.log";
+            const std::string lineBeforeStop = "line-before-stop\n";
+            const std::string lineWhileStopped = "line-while-stopped\n";
+
+            fflush(stdout);
+            ZeroMemory(bigOutBuf, sizeof(bigOutBuf));
+
+            std::shared_ptr<LogFileMonitor> logfileMon = std::make_shared<LogFileMonitor>(
+                sourceFile.Directory,
+                sourceFile.Filter,
+                sourceFile.IncludeSubdirectories,
+                sourceFile.WaitInSeconds,
+                L"json",
+                L"",
+                sourceFile.Tuning);
+            Sleep(WAIT_TIME_LOGFILEMONITOR_START);
+
+            WriteToFile(filename, lineBeforeStop.c_str(), lineBeforeStop.length());
+
+            int retries = 0;
+            do {
+                retries++;
+                Sleep(WAIT_TIME_LOGFILEMONITOR_AFTER_WRITE_SHORT);
+                output = RecoverOuput();
+            } while (output.find(L"line-before-stop") == std::wstring::npos && retries < READ_OUTPUT_RETRIES);
+
+            Assert::IsTrue(output.find(L"line-before-stop") != std::wstring::npos);
+
+            //
+            // Stopping the monitor saves the checkpoint.
+            //
+            logfileMon.reset();
+
+            WriteToFile(filename, lineWhileStopped.c_str(), lineWhileStopped.length());
+
+            fflush(stdout);
+            ZeroMemory(bigOutBuf, sizeof(bigOutBuf));
+
+            logfileMon = std::make_shared<LogFileMonitor>(
+                sourceFile.Directory,
+                sourceFile.Filter,
+                sourceFile.IncludeSubdirectories,
+                sourceFile.WaitInSeconds,
+                L"json",
+                L"",
+                sourceFile.Tuning);
+
+            retries = 0;
+            do {
+                retries++;
+                Sleep(WAIT_TIME_LOGFILEMONITOR_AFTER_WRITE_SHORT);
+                output = RecoverOuput();
+            } while (output.find(L"line-while-stopped") == std::wstring::npos && retries < READ_OUTPUT_RETRIES);
+
+            Assert::IsTrue(output.find(L"line-while-stopped") != std::wstring::npos);
+            Assert::IsTrue(output.find(L"line-before-stop") == std::wstring::npos);
+        }
+
+        ///
+        /// Stress the change notifications by creating and appending to
+        /// thousands of files as fast as possible. Notifications lost because
+        /// the buffer overflowed are counted, and every line must still be
+        /// printed, as the directory is rescanned after an overflow.
+        ///
+        TEST_METHOD(TestNotificationsUnderLoad)
+        {
+            const int filesCount = 2000;
+
+            std::wstring output;
+
+            std::wstring tempDirectory = CreateTempDirectory();
+            Assert::IsFalse(tempDirectory.empty());
+
+            directoriesToDeleteAtCleanup.push_back(tempDirectory);
+
+            SourceFile sourceFile;
+            sourceFile.Directory = tempDirectory;
+            sourceFile.Filter = L"*.log";
+            sourceFile.WaitInSeconds = 10;
+
+            fflush(stdout);
+            ZeroMemory(bigOutBuf, sizeof(bigOutBuf));
+
+            //
+            // Print only the lines, so the output of all the files fits in
+            // the buffer.
+            //
+            std::shared_ptr<LogFileMonitor> logfileMon = std::make_shared<LogFileMonitor>(
+                sourceFile.Directory,
+                sourceFile.Filter,
+                sourceFile.IncludeSubdirectories,
+                sourceFile.WaitInSeconds,
+                L"Custom",
+                L"%Message%",
+                sourceFile.Tuning);
+            Sleep(WAIT_TIME_LOGFILEMONITOR_START);
+
+            auto lineOf = [](char Prefix, int File) {
+                char line[16];
+                sprintf_s(line, "%c%04d", Prefix, File);
+                return std::string(line);
+            };
+
+            const UINT64 startTimestamp = GetTickCount64();
+
+            for (int file = 0; file < filesCount; file++)
+            {
+                std::wstring filename = tempDirectory + L"\\file" + std::to_wstring(file) + L".log";
+                std::string content = lineOf('c', file) + "\n";
+
+                WriteToFile(filename, content.c_str(), content.length());
+            }
+
+            for (int file = 0; file < filesCount; file++)
+            {
+                std::wstring filename = tempDirectory + L"\\file" + std::to_wstring(file) + L".log";
+                std::string content = lineOf('a', file) + "\n";
+
+                WriteToFile(filename, content.c_str(), content.length());
+            }
+
+            const UINT64 elapsedMillis = GetTickCount64() - startTimestamp;
+
+            auto countMissingLines = [&]() {
+                int missingLines = 0;
+
+                for (int file = 0; file < filesCount; file++)
+                {
+                    for (char prefix : { 'c', 'a' })
+                    {
+                        std::wstring line = Utility::StringToWString(lineOf(prefix, file));
+
+                        if (output.find(line) == std::wstring::npos)
+                        {
+                            missingLines++;
+                        }
+                    }
+                }
+
+                return missingLines;
+            };
+
+            int missingLines = 0;
+            int retries = 0;
+            do {
+                retries++;
+                Sleep(WAIT_TIME_LOGFILEMONITOR_AFTER_WRITE_LONG);
+                output = RecoverOuput();
+                missingLines = countMissingLines();
+            } while (missingLines > 0 && retries < 4 * READ_OUTPUT_RETRIES);
+
+            Logger::WriteMessage(
+                Utility::FormatString(
+                    L"%d writes in %llu ms, lost notifications: %llu, missing lines: %d\n",
+                    2 * filesCount,
+                    elapsedMillis,
+                    logfileMon->GetNotificationOverflows(),
+                    missingLines
+                ).c_str());
+
+            Assert::AreEqual(0, missingLines);
+        }
+
+        ///
+        /// Overflow the change notifications with changes of files out of the
+        /// filter. The rescan that follows must find the monitored files
+        /// unchanged, as their directory entries were recorded when the
+        /// directory was first listed, so none of them is opened or read.
+        ///
+        TEST_METHOD(TestRescanOfUnchangedDirectory)
+        {
+            const int logFilesCount = 100;
+            const int otherFilesPerRound = 500;
+            const int maxRounds = 20;
+
+            std::wstring output;
+
+            std::wstring tempDirectory = CreateTempDirectory();
+            Assert::IsFalse(tempDirectory.empty());
+
+            directoriesToDeleteAtCleanup.push_back(tempDirectory);
+
+            SourceFile sourceFile;
+            sourceFile.Directory = tempDirectory;
+            sourceFile.Filter = L"*.log";
+            sourceFile.Tuning.NotificationBufferSizeInKB = 4;
+            sourceFile.Tuning.MaxNotificationBufferSizeInKB = 4;
+
+            const std::string content = "unchanged-line\n";
+
+            for (int file = 0; file < logFilesCount; file++)
+            {
+                std::wstring filename = tempDirectory + L"\\file" + std::to_wstring(file) + L".log";
+
+                Assert::AreEqual((DWORD)0, WriteToFile(filename, content.c_str(), content.length()));
+            }
+
+            fflush(stdout);
+            ZeroMemory(bigOutBuf, sizeof(bigOutBuf));
+
+            std::shared_ptr<LogFileMonitor> logfileMon = std::make_shared<LogFileMonitor>(
+                sourceFile.Directory,
+                sourceFile.Filter,
+                sourceFile.IncludeSubdirectories,
+                sourceFile.WaitInSeconds,
+                L"Custom",
+                L"%Message%",
+                sourceFile.Tuning);
+            Sleep(WAIT_TIME_LOGFILEMONITOR_START);
+
+            const std::string otherContent = "x";
+
+            for (int round = 0; round < maxRounds && logfileMon->GetNotificationOverflows() == 0; round++)
+            {
+                for (int file = 0; file < otherFilesPerRound; file++)
+                {
+                    std::wstring filename = tempDirectory + L"\\not-a-log-file-with-a-long-name-" +
+                        std::to_wstring(round) + L"-" + std::to_wstring(file) + L".tmp";
+
+                    WriteToFile(filename, otherContent.c_str(), otherContent.length());
+                }
+            }
+
+            Assert::IsTrue(logfileMon->GetNotificationOverflows() > 0);
+
+            int retries = 0;
+            do {
+                retries++;
+                Sleep(WAIT_TIME_LOGFILEMONITOR_AFTER_WRITE_SHORT);
+            } while (logfileMon->GetRescanCounters().Rescans == 0 && retries < READ_OUTPUT_RETRIES);
+
+            const LogFileRescanCounters rescans = logfileMon->GetRescanCounters();
+
+            Assert::IsTrue(rescans.Rescans > 0);
+            Assert::IsTrue(rescans.ListedFiles >= (UINT64)logFilesCount);
+            Assert::AreEqual((UINT64)0, rescans.ChangedFiles);
+            Assert::AreEqual((UINT64)0, rescans.AddedFiles);
+
+            output = RecoverOuput();
+            Assert::IsTrue(output.find(L"unchanged-line") == std::wstring::npos);
+        }
+
+        ///
+        /// Rotate a log file at a high rate, with a fixed sequence of renames
+        /// out of the filter, renames inside the filter and truncations, and
+        /// writes before and after each rotation. Every line must be printed:
+        /// the lines written before a rename are read from the renamed file,
+        /// and the new file is read from its start.
+        ///
+        TEST_METHOD(TestRotationsUnderLoad)
+        {
+            const int roundsCount = 400;
+
+            std::wstring output;
+
+            std::wstring tempDirectory = CreateTempDirectory();
+            Assert::IsFalse(tempDirectory.empty());
+
+            directoriesToDeleteAtCleanup.push_back(tempDirectory);
+
+            SourceFile sourceFile;
+            sourceFile.Directory = tempDirectory;
+            sourceFile.Filter = L"*.log";
+            sourceFile.WaitInSeconds = 10;
+
+            fflush(stdout);
+            ZeroMemory(bigOutBuf, sizeof(bigOutBuf));
+
+            std::shared_ptr<LogFileMonitor> logfileMon = std::make_shared<LogFileMonitor>(
+                sourceFile.Directory,
+                sourceFile.Filter,
+                sourceFile.IncludeSubdirectories,
+                sourceFile.WaitInSeconds,
+                L"Custom",
+                L"%Message%",
+                sourceFile.Tuning);
+            Sleep(WAIT_TIME_LOGFILEMONITOR_START);
+
+            std::wstring filename = tempDirectory + L"\\app.log";
+            std::vector<std::wstring> expectedLines;
+
+            auto writeLine = [&](const std::wstring& FileName, int Round, char Step) {
+                char line[16];
+                sprintf_s(line, "r%04d%c", Round, Step);
+
+                std::string content = std::string(line) + "\n";
+
+                Assert::AreEqual(0UL, WriteToFile(FileName, content.c_str(), content.length()));
+
+                expectedLines.push_back(Utility::StringToWString(line));
+            };
+
+            auto countMissingLines = [&]() {
+                output = RecoverOuput();
+
+                int missingLines = 0;
+
+                for (const auto& line : expectedLines)
+                {
+                    if (output.find(line) == std::wstring::npos)
+                    {
+                        missingLines++;
+                    }
+                }
+
+                return missingLines;
+            };
+
+            //
+            // The lines that weren't read when a file is truncated are lost,
+            // and the truncation is only seen if the file is read before it
+            // grows back, so wait for the lines before and after truncating.
+            //
+            auto waitForLines = [&]() {
+                int retries = 0;
+
+                while (countMissingLines() > 0 && retries < 100)
+                {
+                    retries++;
+                    Sleep(50);
+                }
+            };
+
+            int truncationsCount = 0;
+
+            for (int round = 0; round < roundsCount; round++)
+            {
+                writeLine(filename, round, 'a');
+
+                switch (round % 4)
+                {
+                    case 0:
+                    {
+                        //
+                        // Rename out of the filter, like a rolling appender.
+                        //
+                        std::wstring rotatedFilename = filename + L"." + std::to_wstring(round);
+
+                        Assert::IsTrue(MoveFile(filename.c_str(), rotatedFilename.c_str()) != 0);
+                        break;
+                    }
+
+                    case 1:
+                    {
+                        //
+                        // Rename inside the filter, and keep writing to the
+                        // renamed file.
+                        //
+                        std::wstring rotatedFilename = tempDirectory + L"\\app-" + std::to_wstring(round) + L".log";
+
+                        Assert::IsTrue(MoveFile(filename.c_str(), rotatedFilename.c_str()) != 0);
+
+                        writeLine(rotatedFilename, round, 'b');
+                        break;
+                    }
+
+                    case 2:
+                    {
+                        //
+                        // Truncate in place, like copytruncate.
+                        //
+                        waitForLines();
+
+                        HANDLE hFile = CreateFile(
+                            filename.c_str(),
+                            GENERIC_WRITE,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                            NULL,
+                            TRUNCATE_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL,
+                            NULL);
+                        Assert::IsTrue(hFile != INVALID_HANDLE_VALUE);
+                        CloseHandle(hFile);
+
+                        truncationsCount++;
+                        break;
+                    }
+
+                    default:
+                        break;
+                }
+
+                writeLine(filename, round, 'c');
+
+                if (round % 4 == 2)
+                {
+                    waitForLines();
+                }
+            }
+
+            int missingLines = 0;
+            int retries = 0;
+            do {
+                retries++;
+                Sleep(WAIT_TIME_LOGFILEMONITOR_AFTER_WRITE_LONG);
+                missingLines = countMissingLines();
+            } while (missingLines > 0 && retries < 4 * READ_OUTPUT_RETRIES);
+
+            const LogFileRotationCounters rotations = logfileMon->GetRotationCounters();
+
+            Logger::WriteMessage(
+                Utility::FormatString(
+                    L"%d lines, missing lines: %d. Renamed: %llu, replaced: %llu, truncated: %llu,"
+                    L" drained bytes: %llu\n",
+                    static_cast<int>(expectedLines.size()),
+                    missingLines,
+                    rotations.RenamedFiles,
+                    rotations.ReplacedFiles,
+                    rotations.TruncatedFiles,
+                    rotations.DrainedBytes
+                ).c_str());
+
+            Assert::AreEqual(0, missingLines);
+            Assert::AreEqual((UINT64)truncationsCount, rotations.TruncatedFiles);
+        }
+
+        ///
+        /// Check that a line written in two writes is printed whole, and that
+        /// a line without a new line at its end is printed once the file
+        /// isn't written to anymore.
+        ///
+        TEST_METHOD(TestLineWrittenInTwoWrites)
+        {
+            std::wstring output;
+
+            std::wstring tempDirectory = CreateTempDirectory();
+            Assert::IsFalse(tempDirectory.empty());
+
+            directoriesToDeleteAtCleanup.push_back(tempDirectory);
+
+            std::wstring filename = tempDirectory + L"\\partial.log";
+
+            SourceFile sourceFile;
+            sourceFile.Directory = tempDirectory;
+            sourceFile.Filter = L"*.log";
+            sourceFile.WaitInSeconds = 10;
+
+            fflush(stdout);
+            ZeroMemory(bigOutBuf, sizeof(bigOutBuf));
+
+            std::shared_ptr<LogFileMonitor> logfileMon = std::make_shared<LogFileMonitor>(
+                sourceFile.Directory,
+                sourceFile.Filter,
+                sourceFile.IncludeSubdirectories,
+                sourceFile.WaitInSeconds,
+                L"Custom",
+                L"[%Message%]",
+                sourceFile.Tuning);
+            Sleep(WAIT_TIME_LOGFILEMONITOR_START);
+
+            //
+            // The second half is written before the first one is idle long
+            // enough to be printed on its own.
+            //
+            {
+                fflush(stdout);
+                ZeroMemory(bigOutBuf, sizeof(bigOutBuf));
+
+                std::string firstHalf = "first half, ";
+                std::string secondHalf = "second half\n";
+
+                WriteToFile(filename, firstHalf.c_str(), firstHalf.length());
+                Sleep(200);
+                WriteToFile(filename, secondHalf.c_str(), secondHalf.length());
+
+                int retries = 0;
+                do {
+                    retries++;
+                    Sleep(WAIT_TIME_LOGFILEMONITOR_AFTER_WRITE_SHORT);
+                    output = RecoverOuput();
+                } while (output.empty() && retries < READ_OUTPUT_RETRIES);
+
+                Assert::IsTrue(output.find(L"[first half, second half]") != std::wstring::npos);
+                Assert::IsTrue(output.find(L"[first half, ]") == std::wstring::npos);
+            }
+
+            {
+                fflush(stdout);
+                ZeroMemory(bigOutBuf, sizeof(bigOutBuf));
+
+                std::string content = "unterminated line";
+
+                WriteToFile(filename, content.c_str(), content.length());
+
+                int retries = 0;
+                do {
+                    retries++;
+                    Sleep(WAIT_TIME_LOGFILEMONITOR_AFTER_WRITE_SHORT);
+                    output = RecoverOuput();
+                } while (output.empty() && retries < READ_OUTPUT_RETRIES);
+
+                Assert::IsTrue(output.find(L"[unterminated line]") != std::wstring::npos);
+            }
+        }
+
+        ///
+        /// Check that a character written in two writes, so it's cut by the
+        /// end of a read, is decoded whole once the rest of it is read.
+        ///
+        TEST_METHOD(TestCharacterSplitAcrossReads)
+        {
+            std::wstring output;
+
+            std::wstring tempDirectory = CreateTempDirectory();
+            Assert::IsFalse(tempDirectory.empty());
+
+            directoriesToDeleteAtCleanup.push_back(tempDirectory);
+
+            SourceFile sourceFile;
+            sourceFile.Directory = tempDirectory;
+            sourceFile.Filter = L"*.log";
+            sourceFile.WaitInSeconds = 10;
+
+            fflush(stdout);
+            ZeroMemory(bigOutBuf, sizeof(bigOutBuf));
+
+            std::shared_ptr<LogFileMonitor> logfileMon = std::make_shared<LogFileMonitor>(
+                sourceFile.Directory,
+                sourceFile.Filter,
+                sourceFile.IncludeSubdirectories,
+                sourceFile.WaitInSeconds,
+                L"Custom",
+                L"[%Message%]",
+                sourceFile.Tuning);
+            Sleep(WAIT_TIME_LOGFILEMONITOR_START);
+
+            //
+            // UTF-8, with the write ending after the first two bytes of the
+            // euro sign.
+            //
+            {
+                fflush(stdout);
+                ZeroMemory(bigOutBuf, sizeof(bigOutBuf));
+
+                std::wstring filename = tempDirectory + L"\\utf8.log";
+                std::string firstPart = "\xef\xbb\xbf" "euro \xe2\x82";
+                std::string secondPart = "\xac sign\n";
+
+                WriteToFile(filename, firstPart.c_str(), firstPart.length());
+                Sleep(200);
+                WriteToFile(filename, secondPart.c_str(), secondPart.length());
+
+                int retries = 0;
+                do {
+                    retries++;
+                    Sleep(WAIT_TIME_LOGFILEMONITOR_AFTER_WRITE_SHORT);
+                    output = RecoverOuput();
+                } while (output.empty() && retries < READ_OUTPUT_RETRIES);
+
+                Assert::IsTrue(output.find(L"[euro \u20AC sign]") != std::wstring::npos);
+                Assert::IsTrue(output.find(L"\uFFFD") == std::wstring::npos);
+            }
+
+            //
+            // UTF-16, with the write ending between the two surrogates of an
+            // emoji and then in the middle of a code unit.
+            //
+            {
+                fflush(stdout);
+                ZeroMemory(bigOutBuf, sizeof(bigOutBuf));
+
+                std::wstring filename = tempDirectory + L"\\utf16.log";
+                std::wstring content = ((WCHAR)BYTE_ORDER_MARK) + std::wstring(L"smile \U0001F600 face\n");
+
+                const BYTE* bytes = reinterpret_cast<const BYTE*>(content.c_str());
+                const size_t contentSize = content.length() * sizeof(WCHAR);
+                const size_t lowSurrogateOffset = (content.find(L" face") - 1) * sizeof(WCHAR);
+
+                WriteToFile(filename, bytes, lowSurrogateOffset);
+                Sleep(200);
+                WriteToFile(filename, bytes + lowSurrogateOffset, 1);
+                Sleep(200);
+                WriteToFile(filename, bytes + lowSurrogateOffset + 1, contentSize - lowSurrogateOffset - 1);
+
+                int retries = 0;
+                do {
+                    retries++;
+                    Sleep(WAIT_TIME_LOGFILEMONITOR_AFTER_WRITE_SHORT);
+                    output = RecoverOuput();
+                } while (output.empty() && retries < READ_OUTPUT_RETRIES);
+
+                Assert::IsTrue(output.find(L"[smile \U0001F600 face]") != std::wstring::npos);
+                Assert::IsTrue(output.find(L"\uFFFD") == std::wstring::npos);
+            }
+        }
+
+        ///
+        /// Check that a file can be truncated by its writer while its backlog
+        /// is read through a mapping, and that it's read again afterwards.
+        ///
+        TEST_METHOD(TestTruncateDuringMappedRead)
+        {
+            const DWORD TRUNCATE_MAX_WAIT_MILLIS = 5000;
+
+            std::wstring output;
+
+            std::wstring tempDirectory = CreateTempDirectory();
+            Assert::IsFalse(tempDirectory.empty());
+
+            directoriesToDeleteAtCleanup.push_back(tempDirectory);
+
+            std::wstring filename = tempDirectory + L"\\mapped.log";
+
+            SourceFile sourceFile;
+            sourceFile.Directory = tempDirectory;
+            sourceFile.Filter = L"*.log";
+            sourceFile.WaitInSeconds = 10;
+
+            std::shared_ptr<LogFileMonitor> logfileMon = std::make_shared<LogFileMonitor>(
+                sourceFile.Directory,
+                sourceFile.Filter,
+                sourceFile.IncludeSubdirectories,
+                sourceFile.WaitInSeconds,
+                L"Custom",
+                L"%Message%",
+                sourceFile.Tuning);
+            Sleep(WAIT_TIME_LOGFILEMONITOR_START);
+
+            //
+            // A new file is read from its start, so a backlog larger than the
+            // mapped read threshold is read through the mapping.
+            //
+            std::string backlog;
+            const std::string line = std::string(99, 'b') + "\n";
+
+            while (backlog.size() < 16 * 1024 * 1024)
+            {
+                backlog += line;
+            }
+
+            Assert::AreEqual((DWORD)ERROR_SUCCESS, WriteToFile(filename, backlog.c_str(), backlog.size()));
+
+            //
+            // Truncate the file like a copytruncate rotation does, retrying
+            // while a window of the file is mapped.
+            //
+            HANDLE hFile = CreateFile(
+                filename.c_str(),
+                GENERIC_WRITE,
+                FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                NULL,
+                OPEN_EXISTING,
+                FILE_ATTRIBUTE_NORMAL,
+                NULL);
+            Assert::IsTrue(hFile != INVALID_HANDLE_VALUE);
+
+            const ULONGLONG deadline = GetTickCount64() + TRUNCATE_MAX_WAIT_MILLIS;
+            int mappedFailures = 0;
+            bool isTruncated = false;
+
+            while (!isTruncated && GetTickCount64() < deadline)
+            {
+                isTruncated = SetEndOfFile(hFile);
+
+                if (!isTruncated)
+                {
+                    Assert::AreEqual((DWORD)ERROR_USER_MAPPED_FILE, GetLastError());
+
+                    mappedFailures++;
+                    Sleep(1);
+                }
+            }
+
+            CloseHandle(hFile);
+
+            Logger::WriteMessage(
+                Utility::FormatString(L"Truncation attempts that found the file mapped: %d\n", mappedFailures).c_str());
+
+            Assert::IsTrue(isTruncated);
+
+            //
+            // Once the monitor caught up with the truncated file, a new line
+            // is read from its start.
+            //
+            int retries = 0;
+            do {
+                retries++;
+                Sleep(WAIT_TIME_LOGFILEMONITOR_AFTER_WRITE_SHORT);
+            } while (logfileMon->GetReadLag().TotalBytes > 0 && retries < READ_OUTPUT_RETRIES);
+
+            fflush(stdout);
+            ZeroMemory(bigOutBuf, sizeof(bigOutBuf));
+
+            std::string content = "After truncation\n";
+
+            WriteToFile(filename, content.c_str(), content.length());
+
+            retries = 0;
+            do {
+                retries++;
+                Sleep(WAIT_TIME_LOGFILEMONITOR_AFTER_WRITE_SHORT);
+                output = RecoverOuput();
+            } while (output.find(L"After truncation") == std::wstring::npos && retries < READ_OUTPUT_RETRIES);
+
+            Assert::IsTrue(output.find(L"After truncation") != std::wstring::npos);
+        }
     };
 }
\ No newline at end of file
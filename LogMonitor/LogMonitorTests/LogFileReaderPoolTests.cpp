@@ -0,0 +1,310 @@
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//
+
+#include "pch.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace LogMonitorTests
+{
+    ///
+    /// Tests of the LogFileReaderPool class, that reads the log files of the
+    /// File sources in worker threads.
+    ///
+    TEST_CLASS(LogFileReaderPoolTests)
+    {
+        const DWORD WAIT_TIME_READS_MAX = 5000;
+
+        static std::shared_ptr<LogFileInformation> CreateLogFile(const std::wstring& FileName)
+        {
+            auto logFileInfo = std::make_shared<LogFileInformation>();
+            logFileInfo->FileName = FileName;
+
+            return logFileInfo;
+        }
+
+    public:
+        ///
+        /// Check that a file whose read stops before its end goes to the back
+        /// of the queue, so the other queued files are read before it's read
+        /// again.
+        ///
+        TEST_METHOD(TestIncompleteReadsAreRoundRobin)
+        {
+            auto fileA = CreateLogFile(L"a.log");
+            auto fileB = CreateLogFile(L"b.log");
+
+            HANDLE fileBScheduled = CreateEvent(NULL, TRUE, FALSE, NULL);
+            HANDLE readsCompleted = CreateEvent(NULL, TRUE, FALSE, NULL);
+            Assert::IsTrue(fileBScheduled != NULL && readsCompleted != NULL);
+
+            //
+            // Only written by the single worker of the pool.
+            //
+            std::vector<std::wstring> readOrder;
+            int remainingReadsOfA = 4;
+
+            {
+                LogFileReaderPool pool;
+
+                auto source = pool.Register(
+                    [&](const std::shared_ptr<LogFileInformation>& LogFileInfo)
+                    {
+                        readOrder.push_back(LogFileInfo->FileName);
+
+                        if (LogFileInfo == fileB)
+                        {
+                            return false;
+                        }
+
+                        //
+                        // Keep the first read of A running until B is queued.
+                        //
+                        if (readOrder.size() == 1)
+                        {
+                            WaitForSingleObject(fileBScheduled, WAIT_TIME_READS_MAX);
+                        }
+
+                        if (--remainingReadsOfA > 0)
+                        {
+                            return true;
+                        }
+
+                        SetEvent(readsCompleted);
+                        return false;
+                    },
+                    1,
+                    16);
+
+                Assert::IsTrue(pool.Schedule(source, fileA));
+                Assert::IsTrue(pool.Schedule(source, fileB));
+                SetEvent(fileBScheduled);
+
+                Assert::AreEqual(
+                    (int)WAIT_OBJECT_0,
+                    (int)WaitForSingleObject(readsCompleted, WAIT_TIME_READS_MAX));
+
+                pool.Unregister(source);
+            }
+
+            CloseHandle(fileBScheduled);
+            CloseHandle(readsCompleted);
+
+            const std::vector<std::wstring> expectedOrder = { L"a.log", L"b.log", L"a.log", L"a.log", L"a.log" };
+
+            Assert::AreEqual(expectedOrder.size(), readOrder.size());
+
+            for (size_t i = 0; i < expectedOrder.size(); i++)
+            {
+                Assert::AreEqual(expectedOrder[i].c_str(), readOrder[i].c_str());
+            }
+
+            Assert::IsFalse(fileA->IsReadQueued || fileA->IsBeingRead);
+            Assert::IsFalse(fileB->IsReadQueued || fileB->IsBeingRead);
+        }
+
+        ///
+        /// Check that a file scheduled while it's being read is read again
+        /// once the read finishes.
+        ///
+        TEST_METHOD(TestScheduleWhileBeingRead)
+        {
+            auto file = CreateLogFile(L"a.log");
+
+            HANDLE firstReadStarted = CreateEvent(NULL, TRUE, FALSE, NULL);
+            HANDLE fileRescheduled = CreateEvent(NULL, TRUE, FALSE, NULL);
+            HANDLE readsCompleted = CreateEvent(NULL, TRUE, FALSE, NULL);
+            Assert::IsTrue(firstReadStarted != NULL && fileRescheduled != NULL && readsCompleted != NULL);
+
+            int reads = 0;
+
+            {
+                LogFileReaderPool pool;
+
+                auto source = pool.Register(
+                    [&](const std::shared_ptr<LogFileInformation>&)
+                    {
+                        if (++reads == 1)
+                        {
+                            SetEvent(firstReadStarted);
+                            WaitForSingleObject(fileRescheduled, WAIT_TIME_READS_MAX);
+                        }
+                        else
+                        {
+                            SetEvent(readsCompleted);
+                        }
+
+                        return false;
+                    },
+                    2,
+                    16);
+
+                Assert::IsTrue(pool.Schedule(source, file));
+                Assert::AreEqual(
+                    (int)WAIT_OBJECT_0,
+                    (int)WaitForSingleObject(firstReadStarted, WAIT_TIME_READS_MAX));
+
+                Assert::IsTrue(pool.Schedule(source, file));
+                SetEvent(fileRescheduled);
+
+                Assert::AreEqual(
+                    (int)WAIT_OBJECT_0,
+                    (int)WaitForSingleObject(readsCompleted, WAIT_TIME_READS_MAX));
+
+                pool.Unregister(source);
+            }
+
+            CloseHandle(firstReadStarted);
+            CloseHandle(fileRescheduled);
+            CloseHandle(readsCompleted);
+
+            Assert::AreEqual(2, reads);
+        }
+
+        ///
+        /// Check that scheduling a file while its source has its max files in
+        /// flight doesn't wait, and that the file is read once a file of the
+        /// source is done.
+        ///
+        TEST_METHOD(TestScheduleDefersPastMaxFilesInFlight)
+        {
+            auto fileA = CreateLogFile(L"a.log");
+            auto fileB = CreateLogFile(L"b.log");
+            auto fileC = CreateLogFile(L"c.log");
+
+            HANDLE firstReadStarted = CreateEvent(NULL, TRUE, FALSE, NULL);
+            HANDLE filesScheduled = CreateEvent(NULL, TRUE, FALSE, NULL);
+            HANDLE readsCompleted = CreateEvent(NULL, TRUE, FALSE, NULL);
+            Assert::IsTrue(firstReadStarted != NULL && filesScheduled != NULL && readsCompleted != NULL);
+
+            std::vector<std::wstring> readOrder;
+
+            {
+                LogFileReaderPool pool;
+
+                auto source = pool.Register(
+                    [&](const std::shared_ptr<LogFileInformation>& LogFileInfo)
+                    {
+                        readOrder.push_back(LogFileInfo->FileName);
+
+                        if (LogFileInfo == fileA)
+                        {
+                            SetEvent(firstReadStarted);
+                            WaitForSingleObject(filesScheduled, WAIT_TIME_READS_MAX);
+                        }
+                        else if (LogFileInfo == fileC)
+                        {
+                            SetEvent(readsCompleted);
+                        }
+
+                        return false;
+                    },
+                    4,
+                    1);
+
+                Assert::IsTrue(pool.Schedule(source, fileA));
+                Assert::AreEqual(
+                    (int)WAIT_OBJECT_0,
+                    (int)WaitForSingleObject(firstReadStarted, WAIT_TIME_READS_MAX));
+
+                //
+                // A is in flight, so B and C are deferred, and Schedule
+                // returns while A is still being read.
+                //
+                const UINT64 startTimestamp = GetTickCount64();
+
+                Assert::IsTrue(pool.Schedule(source, fileB));
+                Assert::IsTrue(pool.Schedule(source, fileC));
+                Assert::IsTrue(pool.Schedule(source, fileB));
+
+                Assert::IsTrue(GetTickCount64() - startTimestamp < WAIT_TIME_READS_MAX);
+                Assert::IsTrue(fileB->IsReadQueued && fileC->IsReadQueued);
+
+                SetEvent(filesScheduled);
+
+                Assert::AreEqual(
+                    (int)WAIT_OBJECT_0,
+                    (int)WaitForSingleObject(readsCompleted, WAIT_TIME_READS_MAX));
+
+                pool.Unregister(source);
+            }
+
+            CloseHandle(firstReadStarted);
+            CloseHandle(filesScheduled);
+            CloseHandle(readsCompleted);
+
+            const std::vector<std::wstring> expectedOrder = { L"a.log", L"b.log", L"c.log" };
+
+            Assert::AreEqual(expectedOrder.size(), readOrder.size());
+
+            for (size_t i = 0; i < expectedOrder.size(); i++)
+            {
+                Assert::AreEqual(expectedOrder[i].c_str(), readOrder[i].c_str());
+            }
+        }
+
+        ///
+        /// Check that the sources share the workers of the pool, so the
+        /// workers don't grow with the number of sources.
+        ///
+        TEST_METHOD(TestSourcesShareWorkers)
+        {
+            const size_t sourceCount = 8;
+            const size_t filesPerSource = 8;
+
+            HANDLE readsCompleted = CreateEvent(NULL, TRUE, FALSE, NULL);
+            Assert::IsTrue(readsCompleted != NULL);
+
+            std::atomic<size_t> reads{ 0 };
+            size_t workerCount = 0;
+
+            {
+                LogFileReaderPool pool;
+
+                std::vector<std::shared_ptr<LogFileReaderPool::Registration>> sources;
+                std::vector<std::shared_ptr<LogFileInformation>> files;
+
+                for (size_t i = 0; i < sourceCount; i++)
+                {
+                    sources.push_back(pool.Register(
+                        [&](const std::shared_ptr<LogFileInformation>&)
+                        {
+                            Sleep(10);
+
+                            if (++reads == sourceCount * filesPerSource)
+                            {
+                                SetEvent(readsCompleted);
+                            }
+
+                            return false;
+                        },
+                        2,
+                        filesPerSource));
+
+                    for (size_t j = 0; j < filesPerSource; j++)
+                    {
+                        files.push_back(CreateLogFile(std::to_wstring(i) + L"_" + std::to_wstring(j) + L".log"));
+                        Assert::IsTrue(pool.Schedule(sources.back(), files.back()));
+                    }
+                }
+
+                Assert::AreEqual(
+                    (int)WAIT_OBJECT_0,
+                    (int)WaitForSingleObject(readsCompleted, WAIT_TIME_READS_MAX));
+
+                workerCount = pool.GetWorkerCount();
+
+                for (const auto& source : sources)
+                {
+                    pool.Unregister(source);
+                }
+            }
+
+            CloseHandle(readsCompleted);
+
+            Assert::IsTrue(workerCount >= 1 && workerCount <= 2);
+        }
+    };
+}
@@ -0,0 +1,151 @@
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//
+
+#include "pch.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace LogMonitorTests
+{
+    ///
+    /// Tests of the LogFileTable class, used to look up the monitored files
+    /// by long path, short path and file id.
+    ///
+    TEST_CLASS(LogFileTableTests)
+    {
+        static FILE_ID_INFO MakeFileId(int Seed)
+        {
+            FILE_ID_INFO fileId = {};
+            fileId.VolumeSerialNumber = 0x1234;
+            memcpy(fileId.FileId.Identifier, &Seed, sizeof(Seed));
+
+            return fileId;
+        }
+
+    public:
+        ///
+        /// Check that a file is found by its long path, short path and id,
+        /// ignoring the case of the paths.
+        ///
+        TEST_METHOD(TestFindByAnyKey)
+        {
+            LogFileTable table;
+            auto logFileInfo = std::make_shared<LogFileInformation>();
+
+            table.Insert(L"Logs\\Application Log.txt", L"LOGS\\APPLIC~1.TXT", MakeFileId(1), logFileInfo);
+
+            Assert::IsTrue(table.Find(L"logs\\application log.TXT") == logFileInfo);
+            Assert::IsTrue(table.Find(L"logs\\applic~1.txt") == logFileInfo);
+            Assert::IsFalse(table.Find(L"logs\\application.txt"));
+
+            std::wstring longPath;
+
+            Assert::IsTrue(table.FindLongPath(L"Logs\\Applic~1.txt", longPath));
+            Assert::AreEqual(L"Logs\\Application Log.txt", longPath.c_str());
+
+            longPath.clear();
+
+            Assert::IsTrue(table.FindLongPathById(MakeFileId(1), longPath));
+            Assert::AreEqual(L"Logs\\Application Log.txt", longPath.c_str());
+            Assert::IsFalse(table.FindLongPathById(MakeFileId(2), longPath));
+        }
+
+        ///
+        /// Check that non ASCII paths are compared ignoring their case.
+        ///
+        TEST_METHOD(TestNonAsciiPaths)
+        {
+            LogFileTable table;
+            auto logFileInfo = std::make_shared<LogFileInformation>();
+
+            table.Insert(L"\u00C9v\u00E9nements.log", L"VNEME~1.LOG", MakeFileId(1), logFileInfo);
+
+            Assert::IsTrue(table.Find(L"\u00E9V\u00C9NEMENTS.LOG") == logFileInfo);
+        }
+
+        ///
+        /// Check that removing a file, by its long or short path, removes all
+        /// its keys, and that a renamed file is found by its new keys only.
+        ///
+        TEST_METHOD(TestRemoveAndRename)
+        {
+            LogFileTable table;
+            auto logFileInfo1 = std::make_shared<LogFileInformation>();
+            auto logFileInfo2 = std::make_shared<LogFileInformation>();
+
+            table.Insert(L"first.log", L"FIRST.LOG", MakeFileId(1), logFileInfo1);
+            table.Insert(L"second file.log", L"SECOND~1.LOG", MakeFileId(2), logFileInfo2);
+
+            Assert::IsTrue(table.Remove(L"second~1.log") == logFileInfo2);
+            Assert::IsFalse(table.Find(L"second file.log"));
+
+            std::wstring longPath;
+            Assert::IsFalse(table.FindLongPathById(MakeFileId(2), longPath));
+
+            //
+            // A rename is a removal of the old name and an insertion of the new one.
+            //
+            auto renamedLogFileInfo = table.Remove(L"first.log");
+            table.Insert(L"first.log.1", L"FIRSTL~1.1", MakeFileId(1), renamedLogFileInfo);
+
+            Assert::IsFalse(table.Find(L"first.log"));
+            Assert::IsTrue(table.Find(L"FIRST.LOG.1") == logFileInfo1);
+            Assert::IsTrue(table.FindLongPathById(MakeFileId(1), longPath));
+            Assert::AreEqual(L"first.log.1", longPath.c_str());
+            Assert::AreEqual((size_t)1, table.Size());
+        }
+
+        ///
+        /// Check that a file is found by its new id after it's changed.
+        ///
+        TEST_METHOD(TestChangeFileId)
+        {
+            LogFileTable table;
+            auto logFileInfo = std::make_shared<LogFileInformation>();
+
+            table.Insert(L"app.log", L"APP.LOG", MakeFileId(1), logFileInfo);
+            table.ChangeFileId(MakeFileId(1), MakeFileId(2));
+
+            std::wstring longPath;
+
+            Assert::IsFalse(table.FindLongPathById(MakeFileId(1), longPath));
+            Assert::IsTrue(table.FindLongPathById(MakeFileId(2), longPath));
+            Assert::AreEqual(L"app.log", longPath.c_str());
+        }
+
+        ///
+        /// Check that all the files are found in a table with many files.
+        ///
+        TEST_METHOD(TestManyFiles)
+        {
+            const int filesCount = 100000;
+
+            LogFileTable table;
+
+            for (int i = 0; i < filesCount; i++)
+            {
+                const std::wstring longPath =
+                    L"Dir" + std::to_wstring(i % 100) + L"\\LongFileName" + std::to_wstring(i) + L".log";
+                const std::wstring shortPath =
+                    L"DIR" + std::to_wstring(i % 100) + L"\\LONGFI~" + std::to_wstring(i) + L".LOG";
+
+                table.Insert(longPath, shortPath, MakeFileId(i), std::make_shared<LogFileInformation>());
+            }
+
+            Assert::AreEqual((size_t)filesCount, table.Size());
+            Assert::AreEqual((size_t)filesCount, table.GetAll().size());
+
+            for (int i = 0; i < filesCount; i++)
+            {
+                std::wstring longPath;
+
+                Assert::IsTrue(table.FindLongPath(
+                    L"dir" + std::to_wstring(i % 100) + L"\\longfi~" + std::to_wstring(i) + L".log",
+                    longPath));
+                Assert::IsTrue(table.FindLongPathById(MakeFileId(i), longPath));
+            }
+        }
+    };
+}
@@ -0,0 +1,207 @@
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//
+
+#include "pch.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace LogMonitorTests
+{
+    ///
+    /// Tests of the OutputFileSink class, that writes the log lines to a file
+    /// rotated by size or time.
+    ///
+    TEST_CLASS(OutputFileSinkTests)
+    {
+        const DWORD MAX_TEST_FILES = 4;
+
+        std::wstring tempDirectory;
+        std::wstring outputPath;
+
+        ///
+        /// Reads the content of a file, empty if it doesn't exist.
+        ///
+        std::string ReadFileContent(const std::wstring& Path)
+        {
+            std::ifstream input(Path, std::ios::binary);
+
+            return std::string(
+                (std::istreambuf_iterator<char>(input)),
+                std::istreambuf_iterator<char>());
+        }
+
+        bool FileExists(const std::wstring& Path)
+        {
+            return GetFileAttributesW(Path.c_str()) != INVALID_FILE_ATTRIBUTES;
+        }
+
+    public:
+        TEST_METHOD_INITIALIZE(InitializeOutputFileSinkTests)
+        {
+            tempDirectory = CreateTempDirectory();
+            outputPath = tempDirectory + L"\\output.log";
+        }
+
+        TEST_METHOD_CLEANUP(CleanupOutputFileSinkTests)
+        {
+            DeleteFileW(outputPath.c_str());
+
+            for (DWORD generation = 1; generation <= MAX_TEST_FILES; generation++)
+            {
+                DeleteFileW((outputPath + L"." + std::to_wstring(generation)).c_str());
+            }
+
+            RemoveDirectoryW(tempDirectory.c_str());
+        }
+
+        ///
+        /// Check that the lines are appended to the lines already in the file.
+        ///
+        TEST_METHOD(TestAppendsToExistingFile)
+        {
+            {
+                std::ofstream output(outputPath, std::ios::binary);
+                output << "previous line\n";
+            }
+
+            const std::string line = "new line\n";
+
+            {
+                OutputFileSettings settings;
+                settings.Path = outputPath;
+
+                OutputFileSink sink(settings);
+
+                Assert::AreEqual((int)ERROR_SUCCESS, (int)sink.Write(line.data(), line.size()));
+            }
+
+            Assert::AreEqual(std::string("previous line\n") + line, ReadFileContent(outputPath));
+        }
+
+        ///
+        /// Check that the space allocated ahead of the writes doesn't change
+        /// the size of the file seen by its readers.
+        ///
+        TEST_METHOD(TestAllocationKeepsFileSize)
+        {
+            OutputFileSettings settings;
+            settings.Path = outputPath;
+
+            OutputFileSink sink(settings);
+
+            const std::string line = "a line\n";
+            Assert::AreEqual((int)ERROR_SUCCESS, (int)sink.Write(line.data(), line.size()));
+
+            WIN32_FILE_ATTRIBUTE_DATA attributes;
+            Assert::IsTrue(GetFileAttributesExW(outputPath.c_str(), GetFileExInfoStandard, &attributes));
+
+            Assert::AreEqual((DWORD)0, attributes.nFileSizeHigh);
+            Assert::AreEqual((DWORD)line.size(), attributes.nFileSizeLow);
+            Assert::AreEqual(line, ReadFileContent(outputPath));
+        }
+
+        ///
+        /// Check that the file is rotated once it reaches its max size, and
+        /// that only the max files are kept, newest first.
+        ///
+        TEST_METHOD(TestRotatesBySize)
+        {
+            OutputFileSettings settings;
+            settings.Path = outputPath;
+            settings.MaxSizeInMB = 1;
+            settings.MaxFiles = 2;
+
+            {
+                OutputFileSink sink(settings);
+
+                //
+                // Two batches don't fit in the max size, so each batch after
+                // the first one rotates the file.
+                //
+                for (char batchChar = 'a'; batchChar <= 'e'; batchChar++)
+                {
+                    const std::string batch(600 * 1024, batchChar);
+
+                    Assert::AreEqual((int)ERROR_SUCCESS, (int)sink.Write(batch.data(), batch.size()));
+                }
+            }
+
+            Assert::AreEqual(std::string(600 * 1024, 'e'), ReadFileContent(outputPath));
+            Assert::AreEqual(std::string(600 * 1024, 'd'), ReadFileContent(outputPath + L".1"));
+            Assert::AreEqual(std::string(600 * 1024, 'c'), ReadFileContent(outputPath + L".2"));
+            Assert::IsFalse(FileExists(outputPath + L".3"));
+        }
+
+        ///
+        /// Check that a failed rotation is reported once, and isn't retried
+        /// with the next batches.
+        ///
+        TEST_METHOD(TestFailedRotationIsNotRetriedPerBatch)
+        {
+            OutputFileSettings settings;
+            settings.Path = outputPath;
+            settings.MaxSizeInMB = 1;
+            settings.MaxFiles = 1;
+
+            //
+            // A directory in place of the rotated file makes the rename fail.
+            //
+            const std::wstring rotatedPath = outputPath + L".1";
+            Assert::IsTrue(CreateDirectoryW(rotatedPath.c_str(), NULL));
+
+            {
+                OutputFileSink sink(settings);
+
+                const std::string firstBatch(600 * 1024, 'a');
+                const std::string secondBatch(600 * 1024, 'b');
+                const std::string thirdBatch(600 * 1024, 'c');
+
+                Assert::AreEqual((int)ERROR_SUCCESS, (int)sink.Write(firstBatch.data(), firstBatch.size()));
+                Assert::AreEqual((int)ERROR_SUCCESS, (int)sink.TakeRotationError());
+
+                Assert::AreEqual((int)ERROR_SUCCESS, (int)sink.Write(secondBatch.data(), secondBatch.size()));
+                Assert::AreNotEqual((int)ERROR_SUCCESS, (int)sink.TakeRotationError());
+                Assert::AreEqual((int)ERROR_SUCCESS, (int)sink.TakeRotationError());
+
+                //
+                // The rename would succeed now, but the retry interval didn't
+                // elapse.
+                //
+                Assert::IsTrue(RemoveDirectoryW(rotatedPath.c_str()));
+
+                Assert::AreEqual((int)ERROR_SUCCESS, (int)sink.Write(thirdBatch.data(), thirdBatch.size()));
+                Assert::AreEqual((int)ERROR_SUCCESS, (int)sink.TakeRotationError());
+
+                Assert::AreEqual(firstBatch + secondBatch + thirdBatch, ReadFileContent(outputPath));
+                Assert::IsFalse(FileExists(rotatedPath));
+            }
+        }
+
+        ///
+        /// Check that without rotated files to keep, the file starts again
+        /// empty when it's rotated.
+        ///
+        TEST_METHOD(TestRotatesWithoutRotatedFiles)
+        {
+            OutputFileSettings settings;
+            settings.Path = outputPath;
+            settings.MaxSizeInMB = 1;
+            settings.MaxFiles = 0;
+
+            {
+                OutputFileSink sink(settings);
+
+                const std::string firstBatch(800 * 1024, 'a');
+                const std::string secondBatch(800 * 1024, 'b');
+
+                Assert::AreEqual((int)ERROR_SUCCESS, (int)sink.Write(firstBatch.data(), firstBatch.size()));
+                Assert::AreEqual((int)ERROR_SUCCESS, (int)sink.Write(secondBatch.data(), secondBatch.size()));
+            }
+
+            Assert::AreEqual(std::string(800 * 1024, 'b'), ReadFileContent(outputPath));
+            Assert::IsFalse(FileExists(outputPath + L".1"));
+        }
+    };
+}
@@ -0,0 +1,162 @@
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//
+
+#include "pch.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace LogMonitorTests
+{
+    ///
+    /// Tests of the OutputSpill class, that keeps the lines that don't fit in
+    /// the output queue in segment files, until they are replayed.
+    ///
+    TEST_CLASS(OutputSpillTests)
+    {
+        //
+        // The spill thread writes the staged records once they waited for
+        // its write interval.
+        //
+        const DWORD WAIT_TIME_WRITE = 1500;
+
+        std::wstring tempDirectory;
+
+        ///
+        /// Reads the spill until it's empty.
+        ///
+        std::string ReadAll(OutputSpill& Spill)
+        {
+            std::string lines;
+
+            while (!Spill.IsEmpty())
+            {
+                Spill.Read(lines, 1024);
+            }
+
+            return lines;
+        }
+
+    public:
+        TEST_METHOD_INITIALIZE(InitializeOutputSpillTests)
+        {
+            tempDirectory = CreateTempDirectory();
+        }
+
+        TEST_METHOD_CLEANUP(CleanupOutputSpillTests)
+        {
+            RemoveDirectoryW(tempDirectory.c_str());
+        }
+
+        ///
+        /// Check that the lines are replayed in order, from the segments
+        /// and from the staged records.
+        ///
+        TEST_METHOD(TestLinesReplayedInOrder)
+        {
+            std::string expectedLines;
+
+            {
+                OutputSpill spill(tempDirectory, 64 * 1024 * 1024, 60 * 1000);
+
+                for (int i = 0; i < 1000; i++)
+                {
+                    const std::string line = "written line " + std::to_string(i);
+
+                    Assert::IsTrue(spill.Append(OutputSource::File, line, "\n"));
+                    expectedLines += line + "\n";
+                }
+
+                Sleep(WAIT_TIME_WRITE);
+
+                for (int i = 0; i < 10; i++)
+                {
+                    const std::string line = "staged line " + std::to_string(i);
+
+                    Assert::IsTrue(spill.Append(OutputSource::ETW, line, "\n"));
+                    expectedLines += line + "\n";
+                }
+
+                Assert::IsFalse(spill.IsEmpty());
+                Assert::AreEqual(expectedLines, ReadAll(spill));
+            }
+
+            //
+            // The segments are deleted once they are replayed.
+            //
+            WIN32_FIND_DATAW findData;
+            HANDLE findHandle = FindFirstFileW((tempDirectory + L"\\*.spill").c_str(), &findData);
+
+            Assert::IsTrue(findHandle == INVALID_HANDLE_VALUE);
+        }
+
+        ///
+        /// Check that a line larger than the reads is replayed whole.
+        ///
+        TEST_METHOD(TestLargeLineReplayed)
+        {
+            OutputSpill spill(tempDirectory, 64 * 1024 * 1024, 60 * 1000);
+
+            const std::string line = std::string(10000, 'a');
+
+            Assert::IsTrue(spill.Append(OutputSource::Process, line, "\n"));
+
+            Sleep(WAIT_TIME_WRITE);
+
+            Assert::AreEqual(line + "\n", ReadAll(spill));
+        }
+
+        ///
+        /// Check that the lines that don't fit in the max size are dropped,
+        /// and that the spill takes lines again once it's replayed.
+        ///
+        TEST_METHOD(TestMaxSizeDropsLines)
+        {
+            OutputSpill spill(tempDirectory, 1024, 60 * 1000);
+
+            const std::string line = std::string(99, 'a');
+            int spilledLines = 0;
+
+            for (int i = 0; i < 20; i++)
+            {
+                if (spill.Append(OutputSource::File, line, "\n"))
+                {
+                    spilledLines++;
+                }
+            }
+
+            //
+            // Each record has a header of 8 bytes.
+            //
+            Assert::AreEqual(9, spilledLines);
+            Assert::AreEqual((size_t)9 * 100, ReadAll(spill).size());
+
+            Assert::IsTrue(spill.Append(OutputSource::File, line, "\n"));
+        }
+
+        ///
+        /// Check that the segments older than the max age are discarded, and
+        /// their lines counted as dropped.
+        ///
+        TEST_METHOD(TestMaxAgeDiscardsSegments)
+        {
+            OutputSpill spill(tempDirectory, 64 * 1024 * 1024, 1000);
+
+            for (int i = 0; i < 5; i++)
+            {
+                Assert::IsTrue(spill.Append(OutputSource::EventLog, "old line", "\n"));
+            }
+
+            Sleep(WAIT_TIME_WRITE + 500);
+
+            Assert::IsTrue(spill.Append(OutputSource::EventLog, "new line", "\n"));
+
+            Assert::AreEqual(std::string("new line\n"), ReadAll(spill));
+
+            UINT64 droppedLines[OUTPUT_SOURCE_COUNT] = {};
+            Assert::AreEqual((UINT64)5 * 9, spill.TakeDroppedLines(droppedLines));
+            Assert::AreEqual((UINT64)5, droppedLines[(size_t)OutputSource::EventLog]);
+        }
+    };
+}
@@ -0,0 +1,554 @@
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//
+
+#include "pch.h"
+#include <atomic>
+#include <thread>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace LogMonitorTests
+{
+    ///
+    /// Tests of the OutputWriter class, that writes the log lines to stdout
+    /// in batches from a single writer thread.
+    ///
+    TEST_CLASS(OutputWriterTests)
+    {
+        const DWORD WAIT_TIME_WRITE_MAX = 5000;
+        const DWORD WAIT_TIME_DRAIN_MAX = 60 * 1000;
+
+        std::wstring tempDirectory;
+        std::wstring outputPath;
+        HANDLE outputHandle = INVALID_HANDLE_VALUE;
+
+        ///
+        /// Reads the content written so far to the output file.
+        ///
+        std::string ReadOutput()
+        {
+            std::ifstream input(outputPath, std::ios::binary);
+
+            return std::string(
+                (std::istreambuf_iterator<char>(input)),
+                std::istreambuf_iterator<char>());
+        }
+
+        ///
+        /// Waits for the output file to reach a size.
+        ///
+        bool WaitForOutputSize(size_t Size)
+        {
+            const UINT64 startTimestamp = GetTickCount64();
+
+            do
+            {
+                LARGE_INTEGER fileSize = {};
+                if (GetFileSizeEx(outputHandle, &fileSize) && (size_t)fileSize.QuadPart >= Size)
+                {
+                    return true;
+                }
+
+                Sleep(10);
+            } while (GetTickCount64() - startTimestamp < WAIT_TIME_WRITE_MAX);
+
+            return false;
+        }
+
+    public:
+        TEST_METHOD_INITIALIZE(InitializeOutputWriterTests)
+        {
+            tempDirectory = CreateTempDirectory();
+            outputPath = tempDirectory + L"\\output.log";
+
+            outputHandle = CreateFileW(
+                outputPath.c_str(),
+                GENERIC_WRITE,
+                FILE_SHARE_READ,
+                NULL,
+                CREATE_ALWAYS,
+                FILE_ATTRIBUTE_NORMAL,
+                NULL);
+            Assert::IsTrue(outputHandle != INVALID_HANDLE_VALUE);
+        }
+
+        TEST_METHOD_CLEANUP(CleanupOutputWriterTests)
+        {
+            if (outputHandle != INVALID_HANDLE_VALUE)
+            {
+                CloseHandle(outputHandle);
+                outputHandle = INVALID_HANDLE_VALUE;
+            }
+
+            DeleteFileW(outputPath.c_str());
+            RemoveDirectoryW(tempDirectory.c_str());
+        }
+
+        ///
+        /// Check that the lines of concurrent producers are all written, and
+        /// that the lines of each producer keep their order.
+        ///
+        TEST_METHOD(TestConcurrentProducersKeepLineOrder)
+        {
+            const int producerCount = 8;
+            const int linesPerProducer = 2000;
+
+            OutputSettings settings;
+            settings.FlushSizeInKB = 4;
+
+            {
+                OutputWriter writer(outputHandle, settings);
+
+                std::vector<std::thread> producers;
+                for (int producer = 0; producer < producerCount; producer++)
+                {
+                    producers.emplace_back([&writer, producer, linesPerProducer]()
+                    {
+                        for (int i = 0; i < linesPerProducer; i++)
+                        {
+                            writer.Write(OutputSource::File, std::to_string(producer) + " " + std::to_string(i) + "\n");
+                        }
+                    });
+                }
+
+                for (auto& producer : producers)
+                {
+                    producer.join();
+                }
+
+                Assert::IsTrue(writer.Flush(WAIT_TIME_WRITE_MAX));
+                Assert::AreEqual((int)ERROR_SUCCESS, (int)writer.GetLastWriteError());
+            }
+
+            std::istringstream output(ReadOutput());
+            std::vector<int> nextLine(producerCount, 0);
+            int producer;
+            int line;
+
+            while (output >> producer >> line)
+            {
+                Assert::IsTrue(producer >= 0 && producer < producerCount);
+                Assert::AreEqual(nextLine[producer], line);
+
+                nextLine[producer]++;
+            }
+
+            for (int i = 0; i < producerCount; i++)
+            {
+                Assert::AreEqual(linesPerProducer, nextLine[i]);
+            }
+        }
+
+        ///
+        /// Check that a batch reaching the flush size is written without
+        /// waiting for the flush interval, while a smaller one waits for it.
+        ///
+        TEST_METHOD(TestFlushSizeWritesBatch)
+        {
+            OutputSettings settings;
+            settings.FlushIntervalInMilliseconds = 60 * 1000;
+            settings.FlushSizeInKB = 1;
+
+            OutputWriter writer(outputHandle, settings);
+
+            const std::string shortLine = "short line\n";
+            writer.Write(OutputSource::File, shortLine);
+
+            Sleep(200);
+            Assert::AreEqual((size_t)0, ReadOutput().size());
+
+            const std::string longLine = std::string(2048, 'a') + "\n";
+            writer.Write(OutputSource::File, longLine);
+
+            Assert::IsTrue(WaitForOutputSize(shortLine.size() + longLine.size()));
+            Assert::AreEqual(shortLine + longLine, ReadOutput());
+        }
+
+        ///
+        /// Check that a line is written once the flush interval elapsed, even
+        /// if the batch is smaller than the flush size.
+        ///
+        TEST_METHOD(TestFlushIntervalWritesBatch)
+        {
+            OutputSettings settings;
+            settings.FlushIntervalInMilliseconds = 50;
+            settings.FlushSizeInKB = 1024;
+
+            OutputWriter writer(outputHandle, settings);
+
+            const std::string line = "a line\n";
+            writer.Write(OutputSource::File, line);
+
+            Assert::IsTrue(WaitForOutputSize(line.size()));
+            Assert::AreEqual(line, ReadOutput());
+        }
+
+        ///
+        /// Check that the pending lines are written when the writer is
+        /// destroyed.
+        ///
+        TEST_METHOD(TestPendingLinesWrittenOnDestruction)
+        {
+            OutputSettings settings;
+            settings.FlushIntervalInMilliseconds = 60 * 1000;
+
+            const std::string line = "pending line\n";
+
+            {
+                OutputWriter writer(outputHandle, settings);
+                writer.Write(OutputSource::File, line);
+            }
+
+            Assert::AreEqual(line, ReadOutput());
+        }
+
+        ///
+        /// Check that the writer is destroyed once its writer thread exits,
+        /// even if the output is blocked by a pipe that isn't read.
+        ///
+        TEST_METHOD(TestDestructionWithBlockedOutput)
+        {
+            HANDLE readPipe = NULL;
+            HANDLE writePipe = NULL;
+            Assert::IsTrue(CreatePipe(&readPipe, &writePipe, NULL, 4096));
+
+            OutputSettings settings;
+            settings.FlushSizeInKB = 4;
+
+            {
+                OutputWriter writer(writePipe, settings);
+                writer.Write(OutputSource::File, std::string(64 * 1024, 'x'), "\n");
+
+                Assert::IsFalse(writer.Flush(100));
+            }
+
+            CloseHandle(writePipe);
+            CloseHandle(readPipe);
+        }
+
+        ///
+        /// Check that the drop-oldest policy keeps the newest lines of a full
+        /// queue, counts the dropped ones, and reports them.
+        ///
+        TEST_METHOD(TestDropOldestKeepsNewestLines)
+        {
+            OutputSettings settings;
+            settings.FlushIntervalInMilliseconds = 60 * 1000;
+            settings.FlushSizeInKB = 1024;
+            settings.QueueSizeInKB = 1;
+            settings.OverflowPolicy = OutputOverflowPolicy::DropOldest;
+
+            const std::string line = std::string(99, 'a') + "\n";
+
+            {
+                OutputWriter writer(outputHandle, settings);
+
+                for (int i = 0; i < 30; i++)
+                {
+                    writer.Write(OutputSource::ETW, std::to_string(i % 10) + line.substr(1));
+                }
+
+                //
+                // The queue holds 10 lines of 100 bytes.
+                //
+                Assert::AreEqual((UINT64)20, writer.GetDroppedLines(OutputSource::ETW));
+                Assert::AreEqual((UINT64)0, writer.GetDroppedLines(OutputSource::File));
+            }
+
+            std::string output = ReadOutput();
+
+            Assert::AreEqual(std::string("0") + line.substr(1), output.substr(0, line.size()));
+            Assert::IsTrue(output.find("Lines dropped since the last report: ETW: 20") != std::string::npos);
+        }
+
+        ///
+        /// Check that the drop-newest policy keeps the lines already queued.
+        ///
+        TEST_METHOD(TestDropNewestKeepsQueuedLines)
+        {
+            OutputSettings settings;
+            settings.FlushIntervalInMilliseconds = 60 * 1000;
+            settings.FlushSizeInKB = 1024;
+            settings.QueueSizeInKB = 1;
+            settings.OverflowPolicy = OutputOverflowPolicy::DropNewest;
+
+            const std::string firstLine = std::string(1000, 'a') + "\n";
+            const std::string secondLine = std::string(100, 'b') + "\n";
+
+            {
+                OutputWriter writer(outputHandle, settings);
+
+                writer.Write(OutputSource::Process, firstLine);
+                writer.Write(OutputSource::Process, secondLine);
+
+                Assert::AreEqual((UINT64)1, writer.GetDroppedLines(OutputSource::Process));
+            }
+
+            std::string output = ReadOutput();
+
+            Assert::AreEqual(firstLine, output.substr(0, firstLine.size()));
+            Assert::IsTrue(output.find(secondLine) == std::string::npos);
+            Assert::IsTrue(output.find("Process: 1") != std::string::npos);
+        }
+
+        ///
+        /// Check that the sample policy keeps one line out of the sample rate
+        /// of each source once the queue is half full.
+        ///
+        TEST_METHOD(TestSampleKeepsOneLineOfRate)
+        {
+            OutputSettings settings;
+            settings.FlushIntervalInMilliseconds = 60 * 1000;
+            settings.FlushSizeInKB = 1024;
+            settings.QueueSizeInKB = 4;
+            settings.OverflowPolicy = OutputOverflowPolicy::Sample;
+            settings.SampleRate = 4;
+
+            const std::string line = std::string(99, 'a') + "\n";
+
+            OutputWriter writer(outputHandle, settings);
+
+            //
+            // The first 20 lines fill half of the queue, and 1 line out of 4
+            // of the next 40 ones is kept.
+            //
+            for (int i = 0; i < 60; i++)
+            {
+                writer.Write(OutputSource::EventLog, line);
+            }
+
+            Assert::AreEqual((UINT64)30, writer.GetDroppedLines(OutputSource::EventLog));
+        }
+
+        ///
+        /// Check that the block policy makes the producer wait for the writer
+        /// thread, without dropping lines.
+        ///
+        TEST_METHOD(TestBlockDoesNotDropLines)
+        {
+            OutputSettings settings;
+            settings.FlushIntervalInMilliseconds = 60 * 1000;
+            settings.FlushSizeInKB = 1024;
+            settings.QueueSizeInKB = 1;
+            settings.OverflowPolicy = OutputOverflowPolicy::Block;
+
+            const std::string line = std::string(99, 'a') + "\n";
+            const int lineCount = 100;
+
+            {
+                OutputWriter writer(outputHandle, settings);
+
+                for (int i = 0; i < lineCount; i++)
+                {
+                    writer.Write(OutputSource::File, line);
+                }
+
+                Assert::IsTrue(writer.Flush(WAIT_TIME_WRITE_MAX));
+                Assert::AreEqual((UINT64)0, writer.GetDroppedLines(OutputSource::File));
+            }
+
+            Assert::AreEqual(line.size() * lineCount, ReadOutput().size());
+        }
+
+        ///
+        /// Check that the spill policy writes the lines that don't fit in the
+        /// queue after it, in order, without dropping lines.
+        ///
+        TEST_METHOD(TestSpillKeepsLineOrder)
+        {
+            const std::wstring spillDirectory = tempDirectory + L"\\spill";
+
+            OutputSettings settings;
+            settings.FlushIntervalInMilliseconds = 60 * 1000;
+            settings.FlushSizeInKB = 1024;
+            settings.QueueSizeInKB = 1;
+            settings.OverflowPolicy = OutputOverflowPolicy::Spill;
+            settings.SpillDirectory = spillDirectory;
+
+            std::string expectedOutput;
+
+            {
+                OutputWriter writer(outputHandle, settings);
+
+                for (int i = 0; i < 5000; i++)
+                {
+                    const std::string line = "line " + std::to_string(i) + "\n";
+
+                    writer.Write(OutputSource::File, line);
+                    expectedOutput += line;
+                }
+
+                Assert::IsTrue(writer.Flush(WAIT_TIME_WRITE_MAX));
+                Assert::AreEqual((UINT64)0, writer.GetDroppedLines(OutputSource::File));
+            }
+
+            RemoveDirectoryW(spillDirectory.c_str());
+
+            Assert::AreEqual(expectedOutput, ReadOutput());
+        }
+
+        ///
+        /// Check that, with the spill policy, producers writing faster than a
+        /// throttled reader of the output aren't blocked by it, and that the
+        /// lines of each producer are still written in order.
+        ///
+        TEST_METHOD(TestSpillDoesNotBlockProducersOfThrottledOutput)
+        {
+            const int producerCount = 4;
+            const int linesPerProducer = 5000;
+            const std::string padding(30, 'x');
+
+            //
+            // The reader reads at most 4 KB every 5 ms, about 800 KB/s, from
+            // a pipe with a buffer of 4 KB.
+            //
+            const DWORD readSize = 4096;
+            const DWORD readInterval = 5;
+
+            const std::wstring spillDirectory = tempDirectory + L"\\spill";
+
+            HANDLE readPipe = NULL;
+            HANDLE writePipe = NULL;
+            Assert::IsTrue(CreatePipe(&readPipe, &writePipe, NULL, readSize));
+
+            std::string output;
+            std::atomic<size_t> readBytes = 0;
+
+            std::thread reader([&]()
+            {
+                std::vector<char> buffer(readSize);
+                DWORD bytesRead = 0;
+
+                while (ReadFile(readPipe, buffer.data(), readSize, &bytesRead, NULL) && bytesRead > 0)
+                {
+                    output.append(buffer.data(), bytesRead);
+                    readBytes += bytesRead;
+
+                    Sleep(readInterval);
+                }
+            });
+
+            OutputSettings settings;
+            settings.FlushSizeInKB = 4;
+            settings.QueueSizeInKB = 16;
+            settings.OverflowPolicy = OutputOverflowPolicy::Spill;
+            settings.SpillDirectory = spillDirectory;
+
+            size_t writtenBytes = 0;
+            size_t readBytesWhenWritten = 0;
+
+            {
+                OutputWriter writer(writePipe, settings);
+
+                std::vector<std::thread> producers;
+                for (int producer = 0; producer < producerCount; producer++)
+                {
+                    producers.emplace_back([&writer, producer, linesPerProducer, &padding]()
+                    {
+                        for (int i = 0; i < linesPerProducer; i++)
+                        {
+                            writer.Write(
+                                OutputSource::File,
+                                std::to_string(producer) + " " + std::to_string(i) + " " + padding + "\n");
+                        }
+                    });
+                }
+
+                for (auto& producer : producers)
+                {
+                    producer.join();
+                }
+
+                readBytesWhenWritten = readBytes;
+
+                for (int producer = 0; producer < producerCount; producer++)
+                {
+                    for (int i = 0; i < linesPerProducer; i++)
+                    {
+                        writtenBytes += std::to_string(producer).size() + std::to_string(i).size() + padding.size() + 3;
+                    }
+                }
+
+                Assert::IsTrue(writer.Flush(WAIT_TIME_DRAIN_MAX));
+                Assert::AreEqual((int)ERROR_SUCCESS, (int)writer.GetLastWriteError());
+                Assert::AreEqual((UINT64)0, writer.GetDroppedLines(OutputSource::File));
+            }
+
+            CloseHandle(writePipe);
+            reader.join();
+            CloseHandle(readPipe);
+
+            RemoveDirectoryW(spillDirectory.c_str());
+
+            Logger::WriteMessage(
+                Utility::FormatString(
+                    L"Bytes written: %zu, read by the throttled reader when the producers finished: %zu\n",
+                    writtenBytes,
+                    readBytesWhenWritten
+                ).c_str());
+
+            //
+            // Blocked producers would only finish once the reader got all
+            // but the queue of the lines.
+            //
+            Assert::IsTrue(readBytesWhenWritten < writtenBytes / 2);
+            Assert::AreEqual(writtenBytes, output.size());
+
+            std::istringstream lines(output);
+            std::vector<int> nextLine(producerCount, 0);
+            int producer;
+            int line;
+            std::string linePadding;
+
+            while (lines >> producer >> line >> linePadding)
+            {
+                Assert::IsTrue(producer >= 0 && producer < producerCount);
+                Assert::AreEqual(nextLine[producer], line);
+
+                nextLine[producer]++;
+            }
+
+            for (int i = 0; i < producerCount; i++)
+            {
+                Assert::AreEqual(linesPerProducer, nextLine[i]);
+            }
+        }
+
+        ///
+        /// Check that the lines are only written to the output file when
+        /// stdout isn't written to.
+        ///
+        TEST_METHOD(TestWritesToOutputFileOnly)
+        {
+            const std::wstring filePath = tempDirectory + L"\\sink.log";
+
+            OutputSettings settings;
+            settings.WriteToStdout = false;
+            settings.File.Path = filePath;
+
+            const std::string line = "a line\n";
+
+            {
+                OutputWriter writer(INVALID_HANDLE_VALUE, settings);
+
+                writer.Write(OutputSource::File, line);
+
+                Assert::IsTrue(writer.Flush(WAIT_TIME_WRITE_MAX));
+                Assert::AreEqual((int)ERROR_SUCCESS, (int)writer.GetLastWriteError());
+            }
+
+            std::ifstream input(filePath, std::ios::binary);
+            const std::string fileContent(
+                (std::istreambuf_iterator<char>(input)),
+                std::istreambuf_iterator<char>());
+            input.close();
+
+            DeleteFileW(filePath.c_str());
+
+            Assert::AreEqual(line, fileContent);
+            Assert::AreEqual((size_t)0, ReadOutput().size());
+        }
+    };
+}
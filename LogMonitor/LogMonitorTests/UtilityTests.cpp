@@ -86,5 +86,43 @@ namespace UtilityTests
             Utility::SanitizeJson(str);
             Assert::IsTrue(str == expect, L"should escape \\");
         }
+
+        ///
+        /// Check that control characters are escaped as \\u00xx, except the ones
+        /// with a short escape, and that the text ends at a null character.
+        ///
+        TEST_METHOD(TestSanitizeJsonControlCharacters)
+        {
+            std::wstring str = L"tab\tbell\aend\x1f";
+            std::wstring expect = L"tab\\tbell\\u0007end\\u001f";
+            Utility::SanitizeJson(str);
+            Assert::IsTrue(str == expect, L"should escape control characters");
+
+            str = std::wstring(L"before\0after", 12);
+            expect = L"before";
+            Utility::SanitizeJson(str);
+            Assert::IsTrue(str == expect, L"should end at the null character");
+        }
+
+        ///
+        /// Check that UTF-8 text is escaped like SanitizeJson escapes UTF-16
+        /// text, keeping the non-ASCII characters as they are.
+        ///
+        TEST_METHOD(TestAppendJsonEscaped)
+        {
+            std::string result = "prefix ";
+            Utility::AppendJsonEscaped(result, "say \"\xe3\x83\x86\" at C:\\logs\r\n\x01");
+            Assert::AreEqual(
+                std::string("prefix say \\\"\xe3\x83\x86\\\" at C:\\\\logs\\r\\n\\u0001"),
+                result);
+
+            std::wstring wide = L"say \"\x30c6\" at C:\\logs\r\n\x01";
+            Utility::SanitizeJson(wide);
+            Assert::AreEqual(Utility::WStringToString(wide), result.substr(7));
+
+            result.clear();
+            Utility::AppendJsonEscaped(result, std::string_view("before\0after", 12));
+            Assert::AreEqual(std::string("before"), result);
+        }
     };
 }
@@ -23,6 +23,7 @@
 #include <variant>
 #include <cstdint>
 #include <string>
+#include <string_view>
 #include <algorithm>
 #include <sstream>
 #include <vector>
@@ -57,11 +58,24 @@
 #include "../src/LogMonitor/Parser/ConfigFileParser.h"
 #include "../src/LogMonitor/Parser/LoggerSettings.h"
 #include "../src/LogMonitor/Parser/JsonFileParser.h"
+#include "../src/LogMonitor/Output/OutputWriter.h"
+#include "../src/LogMonitor/Output/OutputSpill.h"
+#include "../src/LogMonitor/Output/OutputFileSink.h"
 #include "../src/LogMonitor/LogWriter.h"
 #include "../src/LogMonitor/EtwMonitor.h"
 #include "../src/LogMonitor/EventMonitor.h"
 #include "../src/LogMonitor/FileMonitor/FileMonitorUtilities.h"
+#include "../src/LogMonitor/FileMonitor/LineScanner.h"
+#include "../src/LogMonitor/FileMonitor/LineFramer.h"
+#include "../src/LogMonitor/FileMonitor/LatencyHistogram.h"
+#include "../src/LogMonitor/FileMonitor/LogFileTable.h"
+#include "../src/LogMonitor/FileMonitor/DirectoryEnumerator.h"
+#include "../src/LogMonitor/FileMonitor/DirChangeEventBatch.h"
+#include "../src/LogMonitor/FileMonitor/FileFilter.h"
+#include "../src/LogMonitor/FileMonitor/DirectoryWatchEngine.h"
+#include "../src/LogMonitor/FileMonitor/LogFileReaderPool.h"
 #include "../src/LogMonitor/LogFileMonitor.h"
+#include "../src/LogMonitor/FileMonitor/CheckpointStore.h"
 #include "../src/LogMonitor/ProcessMonitor.h"
 #include "Utility.h"
 #endif //PCH_H
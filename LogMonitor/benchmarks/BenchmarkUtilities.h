@@ -0,0 +1,144 @@
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+
+#ifndef _WIN32
+#include <ctime>
+#endif
+
+///
+/// Helpers shared by the benchmarks: timing, and generation of log lines that
+/// look like the ones of the containers LogMonitor runs in.
+///
+class BenchmarkUtilities final
+{
+ public:
+    using Clock = std::chrono::steady_clock;
+
+    ///
+    /// Written by the benchmarks with a value computed from their results, so
+    /// the compiler can't drop the work being measured.
+    ///
+    static inline volatile size_t Sink = 0;
+
+    static double SecondsSince(
+        Clock::time_point Start)
+    {
+        return std::chrono::duration<double>(Clock::now() - Start).count();
+    }
+
+    ///
+    /// Runs a function several times and returns the shortest run time, the
+    /// one least disturbed by the rest of the system.
+    ///
+    /// \param Runs     Number of runs.
+    /// \param Function The code to measure.
+    ///
+    /// \return The duration of the fastest run, in seconds.
+    ///
+    template <typename F>
+    static double MeasureBest(
+        int Runs,
+        F Function)
+    {
+        double best = 1e30;
+
+        for (int i = 0; i < Runs; i++)
+        {
+            const Clock::time_point start = Clock::now();
+            Function();
+            best = (std::min)(best, SecondsSince(start));
+        }
+
+        return best;
+    }
+
+    ///
+    /// Gets the CPU time used by the process so far, in all its threads.
+    ///
+    static double GetProcessCpuSeconds()
+    {
+#ifdef _WIN32
+        FILETIME creationTime, exitTime, kernelTime, userTime;
+        if (!GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime))
+        {
+            return 0;
+        }
+
+        const auto toSeconds = [](const FILETIME& Time)
+        {
+            return ((static_cast<unsigned long long>(Time.dwHighDateTime) << 32) | Time.dwLowDateTime) / 1e7;
+        };
+
+        return toSeconds(kernelTime) + toSeconds(userTime);
+#else
+        timespec time;
+        clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time);
+
+        return time.tv_sec + time.tv_nsec / 1e9;
+#endif
+    }
+
+    ///
+    /// Generates lines in the W3C format of the IIS logs, the most common log
+    /// files of Windows containers, ended by CRLF.
+    ///
+    /// \param Size     Minimum size of the text, in bytes.
+    /// \param Lines    Receives the number of lines generated.
+    ///
+    /// \return The lines.
+    ///
+    static std::string MakeW3CLog(
+        size_t Size,
+        size_t& Lines)
+    {
+        static const char* const paths[] = {
+            "/default.htm", "/api/orders/12345", "/images/logo.png",
+            "/scripts/app.min.js", "/account/login", "/health" };
+        static const char* const userAgents[] = {
+            "Mozilla/5.0+(Windows+NT+10.0;+Win64;+x64)+AppleWebKit/537.36+(KHTML,+like+Gecko)+Chrome/120.0.0.0+Safari/537.36",
+            "curl/8.4.0",
+            "Mozilla/5.0+(compatible;+bingbot/2.0)" };
+        static const char* const methods[] = { "GET", "POST", "HEAD" };
+        static const int statuses[] = { 200, 200, 200, 304, 404, 500 };
+
+        std::mt19937 random(42);
+        std::string text;
+        text.reserve(Size + 512);
+        Lines = 0;
+
+        char line[512];
+        while (text.size() < Size)
+        {
+            const int lineSize = snprintf(
+                line,
+                sizeof(line),
+                "2024-05-01 12:%02u:%02u 10.0.0.%u %s %s %s 443 - 192.168.%u.%u %s - %d 0 0 %u\r\n",
+                static_cast<unsigned>(random() % 60),
+                static_cast<unsigned>(random() % 60),
+                static_cast<unsigned>(random() % 255),
+                methods[random() % 3],
+                paths[random() % 6],
+                (random() % 3) ? "-" : "id=42&x=y",
+                static_cast<unsigned>(random() % 255),
+                static_cast<unsigned>(random() % 255),
+                userAgents[random() % 3],
+                statuses[random() % 6],
+                static_cast<unsigned>(random() % 2000));
+
+            text.append(line, lineSize);
+            Lines++;
+        }
+
+        return text;
+    }
+};
@@ -0,0 +1,276 @@
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//
+
+//
+// Overhead of the checkpoint file on the tailing throughput, which should
+// stay under 1%.
+//
+// A LogFileMonitor tails log files written as fast as possible, without
+// checkpoint file, and with one saved at the default interval and every
+// second. The throughput is the size of the files over the time from the
+// first write to the last line written to stdout. The cost of a flush of the
+// checkpoint store is also measured on its own, for the given number of
+// files.
+//
+// Usage: CheckpointOverheadBenchmark [size in MB] [files] [runs]
+//
+
+#include "pch.h"  // NOLINT(build/include_subdir)
+#include "BenchmarkUtilities.h"  // NOLINT(build/include_subdir)
+#include "OutputCapture.h"  // NOLINT(build/include_subdir)
+
+#include <atomic>
+#include <cstdlib>
+#include <vector>
+
+LogWriter logWriter;
+
+static const size_t WRITE_SIZE = 1024 * 1024;
+
+static std::wstring
+GetTempName(
+    _In_ LPCWSTR Name)
+{
+    WCHAR tempPath[MAX_PATH];
+    GetTempPathW(MAX_PATH, tempPath);
+
+    return std::wstring(tempPath) + Name +
+        std::to_wstring(GetCurrentProcessId()) + L"_" + std::to_wstring(GetTickCount64());
+}
+
+///
+/// Tails files written as fast as possible.
+///
+/// \return The tailing throughput in MB/s, or 0 if not all the lines were
+///         written to stdout.
+///
+static double
+MeasureTailing(
+    _In_ const FileMonitorTuning& Tuning,
+    _In_ const std::string& Text,
+    _In_ size_t TextLines,
+    _In_ size_t FilesCount,
+    _In_ size_t SizeInMB,
+    _Out_ double& CpuSeconds)
+{
+    CpuSeconds = 0;
+
+    const std::wstring directory = GetTempName(L"CheckpointOverheadBenchmark");
+    if (!CreateDirectoryW(directory.c_str(), nullptr))
+    {
+        wprintf(L"Failed to create %ls. Error: %lu\n", directory.c_str(), GetLastError());
+        return 0;
+    }
+
+    //
+    // Each file gets the same share of the size, in whole copies of the text.
+    //
+    const size_t copiesPerFile = (std::max<size_t>)(1, (SizeInMB << 20) / Text.size() / FilesCount);
+    const size_t expectedLines = copiesPerFile * TextLines * FilesCount;
+
+    std::atomic<size_t> lines(0);
+    HANDLE doneEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+
+    OutputCapture::Start().SetLineHandler([&](std::string_view Line)
+    {
+        if (Line.find("\"Source\": \"File\"") != std::string_view::npos &&
+            ++lines == expectedLines)
+        {
+            SetEvent(doneEvent);
+        }
+    });
+
+    double seconds = 0;
+    std::vector<std::wstring> paths;
+
+    {
+        LogFileMonitor monitor(directory, L"*.log", false, 300, L"JSON", L"", Tuning);
+
+        //
+        // Let the monitor start watching the directory.
+        //
+        Sleep(2 * 1000);
+
+        std::vector<HANDLE> files;
+        for (size_t i = 0; i < FilesCount; i++)
+        {
+            paths.push_back(directory + L"\\file" + std::to_wstring(i) + L".log");
+            files.push_back(CreateFileW(
+                paths.back().c_str(),
+                FILE_APPEND_DATA,
+                FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                nullptr,
+                CREATE_ALWAYS,
+                FILE_ATTRIBUTE_NORMAL,
+                nullptr));
+        }
+
+        const double startCpuSeconds = BenchmarkUtilities::GetProcessCpuSeconds();
+        const BenchmarkUtilities::Clock::time_point start = BenchmarkUtilities::Clock::now();
+
+        for (size_t copy = 0; copy < copiesPerFile; copy++)
+        {
+            for (HANDLE file : files)
+            {
+                for (size_t offset = 0; offset < Text.size(); offset += WRITE_SIZE)
+                {
+                    DWORD bytesWritten;
+                    WriteFile(
+                        file,
+                        Text.data() + offset,
+                        static_cast<DWORD>((std::min)(WRITE_SIZE, Text.size() - offset)),
+                        &bytesWritten,
+                        nullptr);
+                }
+            }
+        }
+
+        for (HANDLE file : files)
+        {
+            CloseHandle(file);
+        }
+
+        if (WaitForSingleObject(doneEvent, 5 * 60 * 1000) == WAIT_OBJECT_0)
+        {
+            seconds = BenchmarkUtilities::SecondsSince(start);
+            CpuSeconds = BenchmarkUtilities::GetProcessCpuSeconds() - startCpuSeconds;
+        }
+        else
+        {
+            wprintf(L"  Only %zu of %zu lines were written to stdout\n", lines.load(), expectedLines);
+        }
+    }
+
+    OutputCapture::Start().SetLineHandler(nullptr);
+    CloseHandle(doneEvent);
+
+    for (const std::wstring& path : paths)
+    {
+        DeleteFileW(path.c_str());
+    }
+
+    RemoveDirectoryW(directory.c_str());
+
+    if (!Tuning.CheckpointFile.empty())
+    {
+        DeleteFileW(Tuning.CheckpointFile.c_str());
+    }
+
+    return (seconds > 0) ? (copiesPerFile * Text.size() * FilesCount / 1048576.0) / seconds : 0;
+}
+
+int
+wmain(
+    int argc,
+    WCHAR** argv)
+{
+    const size_t sizeInMB = (argc > 1) ? wcstoul(argv[1], nullptr, 10) : 1024;
+    const size_t filesCount = (argc > 2) ? wcstoul(argv[2], nullptr, 10) : 4;
+    const int runs = (argc > 3) ? _wtoi(argv[3]) : 3;
+
+    size_t textLines = 0;
+    const std::string text = BenchmarkUtilities::MakeW3CLog(16 << 20, textLines);
+
+    OutputCapture::Start();
+
+    wprintf(L"%zu MB of W3C lines in %zu files, best of %d runs\n\n", sizeInMB, filesCount, runs);
+    wprintf(L"                                     MB/s   CPU s   throughput overhead\n");
+
+    const std::wstring checkpointFile = GetTempName(L"CheckpointOverheadBenchmark") + L".json";
+
+    FileMonitorTuning withoutCheckpoint;
+
+    FileMonitorTuning defaultCheckpoint;
+    defaultCheckpoint.CheckpointFile = checkpointFile;
+
+    FileMonitorTuning frequentCheckpoint;
+    frequentCheckpoint.CheckpointFile = checkpointFile;
+    frequentCheckpoint.CheckpointIntervalInSeconds = 1;
+
+    const struct
+    {
+        LPCWSTR Name;
+        const FileMonitorTuning& Tuning;
+    } configurations[] = {
+        { L"no checkpoint file", withoutCheckpoint },
+        { L"checkpoint every 5 s (default)", defaultCheckpoint },
+        { L"checkpoint every 1 s", frequentCheckpoint },
+    };
+
+    double baseThroughput = 0;
+
+    for (const auto& configuration : configurations)
+    {
+        double throughput = 0;
+        double cpuSeconds = 0;
+
+        for (int run = 0; run < runs; run++)
+        {
+            double runCpuSeconds;
+            const double runThroughput =
+                MeasureTailing(configuration.Tuning, text, textLines, filesCount, sizeInMB, runCpuSeconds);
+
+            if (runThroughput > throughput)
+            {
+                throughput = runThroughput;
+                cpuSeconds = runCpuSeconds;
+            }
+        }
+
+        if (baseThroughput == 0)
+        {
+            baseThroughput = throughput;
+            wprintf(L"  %-32ls %7.1f  %6.2f\n", configuration.Name, throughput, cpuSeconds);
+        }
+        else
+        {
+            wprintf(L"  %-32ls %7.1f  %6.2f   %6.2f%%\n",
+                configuration.Name,
+                throughput,
+                cpuSeconds,
+                (baseThroughput - throughput) / baseThroughput * 100);
+        }
+    }
+
+    //
+    // The cost of each checkpoint, with an offset updated for every file.
+    //
+    CheckpointStore store(checkpointFile);
+
+    for (size_t files = 10; files <= 10000; files *= 10)
+    {
+        std::vector<std::wstring> keys;
+        for (size_t i = 0; i < files; i++)
+        {
+            FILE_ID_INFO fileId = {};
+            memcpy(fileId.FileId.Identifier, &i, sizeof(i));
+            keys.push_back(CheckpointStore::GetKey(fileId, L"W3SVC1\\u_ex" + std::to_wstring(i) + L".log"));
+        }
+
+        UINT64 offset = 0;
+        const double seconds = BenchmarkUtilities::MeasureBest(5, [&]()
+        {
+            offset++;
+            for (size_t i = 0; i < files; i++)
+            {
+                FileCheckpoint checkpoint;
+                checkpoint.FileName = L"W3SVC1\\u_ex" + std::to_wstring(i) + L".log";
+                checkpoint.Offset = offset;
+                checkpoint.EncodingType = LM_FILETYPE::UTF8;
+                store.Update(keys[i], checkpoint);
+            }
+
+            store.Flush();
+        });
+
+        wprintf(L"\nCheckpoint of %zu files: %.2f ms, %.3f%% of a 5 s interval", files, seconds * 1e3, seconds / 5 * 100);
+    }
+
+    wprintf(L"\n");
+
+    DeleteFileW(checkpointFile.c_str());
+
+    return 0;
+}
@@ -0,0 +1,273 @@
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//
+
+//
+// Cost of passing directory change events from the threads receiving the
+// notifications to the thread handling them, with DirChangeEventBatch,
+// against the queue it replaced, with 1 to N producer threads.
+//
+// Each producer hands its events over every NOTIFICATION_EVENTS events, like
+// a notification buffer. The baseline queues each event with its own
+// std::wstring under the lock, and its consumer drops and re-acquires the
+// lock around every event, like LogFilesChangeHandler did.
+//
+// Usage: DirChangeEventBatchBenchmark [max producers] [events]
+//
+
+#include "pch.h"  // NOLINT(build/include_subdir)
+#include "BenchmarkUtilities.h"  // NOLINT(build/include_subdir)
+#include "DirChangeEventBatch.h"  // NOLINT(build/include_subdir)
+
+#include <condition_variable>
+#include <cstdlib>
+#include <cwchar>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+static const size_t NOTIFICATION_EVENTS = 64;
+
+//
+// Number of files modified by a modify storm.
+//
+static const size_t STORM_FILES = 10;
+
+static std::vector<std::wstring> FileNames;
+
+static const std::wstring&
+GetFileName(
+    bool IsStorm,
+    size_t Event)
+{
+    return FileNames[IsStorm ? (Event % STORM_FILES) : Event];
+}
+
+///
+/// Runs the producers and the consumer of the queue.
+///
+/// \return The number of events handled.
+///
+static size_t
+RunQueue(
+    size_t Producers,
+    size_t Events,
+    bool IsStorm)
+{
+    std::mutex lock;
+    std::condition_variable wakeUp;
+    std::queue<DirChangeNotificationEvent> queue;
+    size_t producersLeft = Producers;
+    size_t handledEvents = 0;
+
+    std::thread consumer([&]()
+    {
+        std::unique_lock<std::mutex> guard(lock);
+
+        for (;;)
+        {
+            wakeUp.wait(guard, [&]() { return producersLeft == 0 || !queue.empty(); });
+
+            while (!queue.empty())
+            {
+                const DirChangeNotificationEvent event = queue.front();
+                queue.pop();
+
+                guard.unlock();
+                handledEvents += !event.FileName.empty();
+                guard.lock();
+            }
+
+            if (producersLeft == 0)
+            {
+                break;
+            }
+        }
+    });
+
+    std::vector<std::thread> producers;
+    for (size_t producer = 0; producer < Producers; producer++)
+    {
+        producers.emplace_back([&, producer]()
+        {
+            for (size_t i = producer; i < Events; i += Producers)
+            {
+                DirChangeNotificationEvent event{
+                    GetFileName(IsStorm, i),
+                    IsStorm ? EventAction::Modify : EventAction::Add,
+                    i };
+
+                std::lock_guard<std::mutex> guard(lock);
+                queue.emplace(event);
+                if (queue.size() == 1)
+                {
+                    wakeUp.notify_one();
+                }
+            }
+
+            std::lock_guard<std::mutex> guard(lock);
+            producersLeft--;
+            wakeUp.notify_one();
+        });
+    }
+
+    for (std::thread& producer : producers)
+    {
+        producer.join();
+    }
+
+    consumer.join();
+
+    return handledEvents;
+}
+
+///
+/// Runs the producers and the consumer of batches, the way
+/// LogFileMonitor passes them.
+///
+/// \return The number of events handled.
+///
+static size_t
+RunBatches(
+    size_t Producers,
+    size_t Events,
+    bool IsStorm)
+{
+    std::mutex lock;
+    std::condition_variable wakeUp;
+    DirChangeEventBatch sharedEvents;
+    size_t producersLeft = Producers;
+    size_t handledEvents = 0;
+
+    std::thread consumer([&]()
+    {
+        DirChangeEventBatch events;
+        DirChangeNotificationEvent event;
+
+        for (;;)
+        {
+            bool isDone;
+
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                wakeUp.wait(guard, [&]() { return producersLeft == 0 || !sharedEvents.Empty(); });
+
+                events.Swap(sharedEvents);
+                isDone = (producersLeft == 0);
+            }
+
+            for (size_t i = 0; i < events.Size(); i++)
+            {
+                events.Get(i, event);
+                handledEvents += !event.FileName.empty();
+            }
+
+            events.Clear();
+
+            if (isDone)
+            {
+                break;
+            }
+        }
+    });
+
+    std::vector<std::thread> producers;
+    for (size_t producer = 0; producer < Producers; producer++)
+    {
+        producers.emplace_back([&, producer]()
+        {
+            DirChangeEventBatch events;
+            size_t notifiedEvents = 0;
+
+            for (size_t i = producer; i < Events; i += Producers)
+            {
+                events.Add(IsStorm ? EventAction::Modify : EventAction::Add, GetFileName(IsStorm, i), i);
+                notifiedEvents++;
+
+                if (notifiedEvents % NOTIFICATION_EVENTS == 0 || i + Producers >= Events)
+                {
+                    std::lock_guard<std::mutex> guard(lock);
+
+                    const bool wasEmpty = sharedEvents.Empty();
+                    if (wasEmpty)
+                    {
+                        sharedEvents.Swap(events);
+                        wakeUp.notify_one();
+                    }
+                    else
+                    {
+                        sharedEvents.Append(events);
+                    }
+
+                    events.Clear();
+                }
+            }
+
+            std::lock_guard<std::mutex> guard(lock);
+            producersLeft--;
+            wakeUp.notify_one();
+        });
+    }
+
+    for (std::thread& producer : producers)
+    {
+        producer.join();
+    }
+
+    consumer.join();
+
+    return handledEvents;
+}
+
+int
+main(
+    int argc,
+    char** argv)
+{
+    const size_t maxProducers = (argc > 1) ? strtoul(argv[1], nullptr, 10) : 4;
+    const size_t events = (argc > 2) ? strtoul(argv[2], nullptr, 10) : 1000000;
+
+    for (size_t i = 0; i < events; i++)
+    {
+        wchar_t fileName[96];
+        swprintf(fileName, 96, L"W3SVC%zu\\u_ex%07zu_application.log", i % 100, i);
+        FileNames.push_back(fileName);
+    }
+
+    printf("%zu events, handed over every %zu events, %u hardware threads\n\n",
+        events,
+        NOTIFICATION_EVENTS,
+        std::thread::hardware_concurrency());
+    printf("                                   ns per event       events handled\n");
+    printf("                      producers   queue   batches     queue   batches\n");
+
+    for (int isStorm = 0; isStorm <= 1; isStorm++)
+    {
+        for (size_t producers = 1; producers <= maxProducers; producers *= 2)
+        {
+            size_t queueEvents = 0;
+            const double queueSeconds = BenchmarkUtilities::MeasureBest(3, [&]()
+            {
+                queueEvents = RunQueue(producers, events, isStorm);
+            });
+
+            size_t batchEvents = 0;
+            const double batchSeconds = BenchmarkUtilities::MeasureBest(3, [&]()
+            {
+                batchEvents = RunBatches(producers, events, isStorm);
+            });
+
+            printf("  %-20s %5zu   %7.0f  %7.0f   %8zu  %8zu\n",
+                isStorm ? "modify storm" : "distinct files",
+                producers,
+                queueSeconds / events * 1e9,
+                batchSeconds / events * 1e9,
+                queueEvents,
+                batchEvents);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,186 @@
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//
+
+//
+// Cost of a sweep over a directory of idle log files, the periodic read of
+// all the files in case a change notification was lost.
+//
+// First, the calls made for each file by a sweep are measured on their own:
+// - the original read, which opened the file, read at the next read offset
+//   and closed it,
+// - a read at the next read offset with the handle kept open, which only
+//   finds out that there is nothing new when it reaches the end of the file,
+// - the metadata query ReadLogFile now makes instead, which skips the read
+//   when the size didn't change.
+// Then a LogFileMonitor sweeps the directory once per second, and the CPU
+// time of the process is measured while the files stay idle.
+//
+// Usage: IdleFilesBenchmark [files] [seconds]
+//
+
+#include "pch.h"  // NOLINT(build/include_subdir)
+#include "BenchmarkUtilities.h"  // NOLINT(build/include_subdir)
+#include "OutputCapture.h"  // NOLINT(build/include_subdir)
+
+#include <cstdlib>
+#include <vector>
+
+LogWriter logWriter;
+
+static const char LOG_LINE[] =
+    "2024-05-01 12:00:00 10.0.0.1 GET /default.htm - 443 - 192.168.0.1 curl/8.4.0 - 200 0 0 15\r\n";
+
+static HANDLE
+OpenLogFile(
+    _In_ const std::wstring& Path)
+{
+    //
+    // The same flags as LogFileMonitor::OpenLogFileHandle.
+    //
+    return CreateFileW(Path.c_str(),
+                       GENERIC_READ,
+                       FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                       nullptr,
+                       OPEN_EXISTING,
+                       FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+                       nullptr);
+}
+
+static bool
+ReadAtOffset(
+    _In_ HANDLE File,
+    _In_ UINT64 Offset)
+{
+    char buffer[4096];
+    OVERLAPPED overlapped = {};
+    overlapped.Offset = static_cast<DWORD>(Offset & 0xFFFFFFFF);
+    overlapped.OffsetHigh = static_cast<DWORD>(Offset >> 32);
+    DWORD bytesRead = 0;
+
+    return ReadFile(File, buffer, sizeof(buffer), &bytesRead, &overlapped) || GetLastError() == ERROR_HANDLE_EOF;
+}
+
+int
+wmain(
+    int argc,
+    WCHAR** argv)
+{
+    const size_t filesCount = (argc > 1) ? wcstoul(argv[1], nullptr, 10) : 10000;
+    const DWORD seconds = (argc > 2) ? wcstoul(argv[2], nullptr, 10) : 20;
+
+    WCHAR tempPath[MAX_PATH];
+    GetTempPathW(MAX_PATH, tempPath);
+    const std::wstring directory =
+        std::wstring(tempPath) + L"IdleFilesBenchmark" + std::to_wstring(GetCurrentProcessId());
+
+    if (!CreateDirectoryW(directory.c_str(), nullptr))
+    {
+        wprintf(L"Failed to create %ls. Error: %lu\n", directory.c_str(), GetLastError());
+        return 1;
+    }
+
+    wprintf(L"Creating %zu files in %ls...\n", filesCount, directory.c_str());
+
+    std::vector<std::wstring> paths;
+    for (size_t i = 0; i < filesCount; i++)
+    {
+        paths.push_back(directory + L"\\u_ex" + std::to_wstring(i) + L".log");
+
+        HANDLE file = CreateFileW(paths.back().c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, 0, nullptr);
+        DWORD bytesWritten;
+        WriteFile(file, LOG_LINE, sizeof(LOG_LINE) - 1, &bytesWritten, nullptr);
+        CloseHandle(file);
+    }
+
+    const UINT64 nextReadOffset = sizeof(LOG_LINE) - 1;
+    const double count = static_cast<double>(filesCount);
+
+    std::vector<HANDLE> handles;
+    for (const std::wstring& path : paths)
+    {
+        handles.push_back(OpenLogFile(path));
+    }
+
+    wprintf(L"\nCalls of a sweep over %zu idle files              ms per sweep   us per file\n", filesCount);
+
+    const auto report = [&](LPCWSTR Name, double Seconds)
+    {
+        wprintf(L"  %-48ls %9.1f  %11.2f\n", Name, Seconds * 1e3, Seconds / count * 1e6);
+    };
+
+    size_t failures = 0;
+
+    report(L"open, read at the offset, close (original)", BenchmarkUtilities::MeasureBest(5, [&]()
+    {
+        for (const std::wstring& path : paths)
+        {
+            HANDLE file = OpenLogFile(path);
+            failures += !ReadAtOffset(file, nextReadOffset);
+            CloseHandle(file);
+        }
+    }));
+
+    report(L"read at the offset, kept handle (before)", BenchmarkUtilities::MeasureBest(5, [&]()
+    {
+        for (HANDLE file : handles)
+        {
+            failures += !ReadAtOffset(file, nextReadOffset);
+        }
+    }));
+
+    report(L"GetFileInformationByHandle, kept handle (now)", BenchmarkUtilities::MeasureBest(5, [&]()
+    {
+        for (HANDLE file : handles)
+        {
+            BY_HANDLE_FILE_INFORMATION fileInformation;
+            failures += !GetFileInformationByHandle(file, &fileInformation) ||
+                fileInformation.nFileSizeLow != nextReadOffset;
+        }
+    }));
+
+    if (failures > 0)
+    {
+        wprintf(L"  %zu calls failed\n", failures);
+    }
+
+    for (HANDLE file : handles)
+    {
+        CloseHandle(file);
+    }
+
+    //
+    // The monitor writes nothing while the files are idle, but its output
+    // mustn't go to the console.
+    //
+    OutputCapture::Start();
+
+    {
+        FileMonitorTuning tuning;
+        tuning.SweepIntervalInSeconds = 1;
+
+        LogFileMonitor monitor(directory, L"*.log", false, 300, L"JSON", L"", tuning);
+
+        //
+        // Let the monitor list the directory and open the files.
+        //
+        Sleep(10 * 1000);
+
+        const double startCpuSeconds = BenchmarkUtilities::GetProcessCpuSeconds();
+        Sleep(seconds * 1000);
+        const double cpuSeconds = BenchmarkUtilities::GetProcessCpuSeconds() - startCpuSeconds;
+
+        wprintf(L"\nLogFileMonitor, %lu sweeps of %zu idle files\n", seconds, filesCount);
+        report(L"process CPU time per sweep", cpuSeconds / seconds);
+    }
+
+    for (const std::wstring& path : paths)
+    {
+        DeleteFileW(path.c_str());
+    }
+
+    RemoveDirectoryW(directory.c_str());
+
+    return 0;
+}
@@ -0,0 +1,100 @@
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//
+
+#pragma once
+
+#include <string>
+
+///
+/// The line splitting ReadLogFile and WriteToConsole did before LineFramer,
+/// on 8-bit text, used as the baseline of the benchmarks. The partial line is
+/// carried by inserting into a string, the complete lines are cut with
+/// find_last_of and copied with substr, and then passed by value to be split
+/// again at each LF, copying every line once more.
+///
+class LegacyLineSplitter final
+{
+ public:
+    size_t Lines = 0;
+    size_t Bytes = 0;
+
+    void Push(
+        const char* Data,
+        size_t Size)
+    {
+        const std::string decodedString(Data, Size);
+
+        const size_t found = decodedString.find_last_of("\n\r");
+        size_t remainingStringIndex = 0;
+
+        if (found != std::string::npos)
+        {
+            remainingStringIndex = found + 1;
+
+            if (!m_currentLineBuffer.empty())
+            {
+                m_currentLineBuffer.insert(
+                    m_currentLineBuffer.end(),
+                    decodedString.begin(),
+                    decodedString.begin() + found);
+                WriteLines(m_currentLineBuffer);
+                m_currentLineBuffer.clear();
+            }
+            else
+            {
+                WriteLines(decodedString.substr(0, found));
+            }
+        }
+
+        if (remainingStringIndex < decodedString.size())
+        {
+            m_currentLineBuffer.insert(
+                m_currentLineBuffer.end(),
+                decodedString.begin() + remainingStringIndex,
+                decodedString.end());
+        }
+    }
+
+    void Flush()
+    {
+        WriteLines(m_currentLineBuffer);
+        m_currentLineBuffer.clear();
+    }
+
+ private:
+    std::string m_currentLineBuffer;
+
+    void WriteLines(
+        std::string Message)
+    {
+        size_t start = 0;
+
+        while (start < Message.size())
+        {
+            const size_t lineBreak = Message.find('\n', start);
+            std::string line = (lineBreak == std::string::npos) ?
+                Message.substr(start) :
+                Message.substr(start, lineBreak - start);
+
+            if (!line.empty() && line.back() == '\r')
+            {
+                line.pop_back();
+            }
+
+            if (!line.empty())
+            {
+                Lines++;
+                Bytes += line.size();
+            }
+
+            if (lineBreak == std::string::npos)
+            {
+                break;
+            }
+
+            start = lineBreak + 1;
+        }
+    }
+};
@@ -0,0 +1,118 @@
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//
+
+//
+// Throughput of LineFramer, against the line splitting ReadLogFile did before
+// it, over IIS W3C lines pushed in reads of the size ReadLogFile uses.
+//
+// Usage: LineFramerBenchmark [size in MB]
+//
+
+#include "pch.h"  // NOLINT(build/include_subdir)
+#include "BenchmarkUtilities.h"  // NOLINT(build/include_subdir)
+#include "LegacyLineSplitter.h"  // NOLINT(build/include_subdir)
+#include "LineFramer.h"  // NOLINT(build/include_subdir)
+
+#include <cstdlib>
+
+static const size_t READ_SIZE = 64 * 1024;
+
+static void
+FrameBaseline(
+    const std::string& Text,
+    size_t& Lines,
+    size_t& Bytes)
+{
+    LegacyLineSplitter splitter;
+
+    for (size_t offset = 0; offset < Text.size(); offset += READ_SIZE)
+    {
+        splitter.Push(Text.data() + offset, (std::min)(READ_SIZE, Text.size() - offset));
+    }
+
+    splitter.Flush();
+
+    Lines = splitter.Lines;
+    Bytes = splitter.Bytes;
+}
+
+static void
+FrameWithLineFramer(
+    const std::string& Text,
+    LineBreakMode Mode,
+    size_t& Lines,
+    size_t& Bytes)
+{
+    LineFramer<char> framer(Mode);
+
+    const auto onLine = [&](std::string_view Line)
+    {
+        Lines++;
+        Bytes += Line.size();
+    };
+
+    for (size_t offset = 0; offset < Text.size(); offset += READ_SIZE)
+    {
+        framer.Push(Text.data() + offset, (std::min)(READ_SIZE, Text.size() - offset), onLine);
+    }
+
+    framer.Flush(onLine);
+}
+
+int
+main(
+    int argc,
+    char** argv)
+{
+    const size_t sizeInMB = (argc > 1) ? strtoul(argv[1], nullptr, 10) : 256;
+
+    size_t lines = 0;
+    const std::string text = BenchmarkUtilities::MakeW3CLog(sizeInMB << 20, lines);
+    const double megabytes = text.size() / 1048576.0;
+
+    printf("%.0f MB of W3C lines, %zu lines, %.0f bytes per line, pushed in %zu KB reads\n\n",
+        megabytes,
+        lines,
+        static_cast<double>(text.size()) / lines,
+        READ_SIZE / 1024);
+
+    const auto report = [&](const char* Name, double Seconds, size_t FramedLines)
+    {
+        printf("  %-34s %7.0f MB/s %7.1f M lines/s%s\n",
+            Name,
+            megabytes / Seconds,
+            lines / Seconds / 1e6,
+            (FramedLines == lines) ? "" : "  (line count differs)");
+    };
+
+    size_t framedLines = 0;
+    size_t framedBytes = 0;
+
+    double seconds = BenchmarkUtilities::MeasureBest(5, [&]()
+    {
+        framedLines = framedBytes = 0;
+        FrameBaseline(text, framedLines, framedBytes);
+    });
+    report("find + substr splitting (before)", seconds, framedLines);
+    BenchmarkUtilities::Sink = framedBytes;
+
+    seconds = BenchmarkUtilities::MeasureBest(5, [&]()
+    {
+        framedLines = framedBytes = 0;
+        FrameWithLineFramer(text, LineBreakMode::Lf, framedLines, framedBytes);
+    });
+    report("LineFramer, LF (log files)", seconds, framedLines);
+    BenchmarkUtilities::Sink = framedBytes;
+
+    seconds = BenchmarkUtilities::MeasureBest(5, [&]()
+    {
+        framedLines = framedBytes = 0;
+        FrameWithLineFramer(text, LineBreakMode::CrOrLf, framedLines, framedBytes);
+    });
+    report("LineFramer, CR or LF (process)", seconds, framedLines);
+    BenchmarkUtilities::Sink = framedBytes;
+
+    return 0;
+}
@@ -0,0 +1,192 @@
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//
+
+//
+// Throughput of the LineScanner kernels finding every CR and LF of IIS W3C
+// lines, against the std::string searches ReadLogFile and ReadFromPipe did
+// before them, on 8-bit and UTF-16 text.
+//
+// Usage: LineScannerBenchmark [size in MB]
+//
+
+#include "pch.h"  // NOLINT(build/include_subdir)
+#include "BenchmarkUtilities.h"  // NOLINT(build/include_subdir)
+#include "LineScanner.h"  // NOLINT(build/include_subdir)
+
+#include <bitset>
+#include <cstdlib>
+
+static const char* const SIMD_LEVEL_NAMES[] = { "scalar", "SSE2", "AVX2" };
+
+///
+/// Counts the line breaks of a text with the mask kernel of an instruction
+/// set, a block at a time.
+///
+template <typename UnitT>
+static size_t
+CountWithMasks(
+    const std::basic_string<UnitT>& Text,
+    LineScanner::SimdLevel Level)
+{
+    const UnitT* units = Text.data();
+    const size_t blocksSize = Text.size() / LineScanner::BLOCK_SIZE * LineScanner::BLOCK_SIZE;
+    size_t count = 0;
+
+    for (size_t i = 0; i < blocksSize; i += LineScanner::BLOCK_SIZE)
+    {
+        count += std::bitset<64>(LineScanner::LineBreakMask(
+            units + i,
+            static_cast<UnitT>('\r'),
+            static_cast<UnitT>('\n'),
+            Level)).count();
+    }
+
+    return count;
+}
+
+///
+/// Counts the line breaks of a text by calling FindNextLineBreak for each
+/// of them, as the readers do.
+///
+template <typename UnitT>
+static size_t
+CountWithFindNext(
+    const std::basic_string<UnitT>& Text)
+{
+    const UnitT* it = Text.data();
+    const UnitT* end = it + Text.size();
+    size_t count = 0;
+
+    while ((it = LineScanner::FindNextLineBreak(it, end, static_cast<UnitT>('\r'), static_cast<UnitT>('\n'))) != end)
+    {
+        count++;
+        it++;
+    }
+
+    return count;
+}
+
+template <typename StringT>
+static size_t
+CountWithFindFirstOf(
+    const StringT& Text,
+    const typename StringT::value_type* LineBreaks)
+{
+    size_t count = 0;
+    size_t position = 0;
+
+    while ((position = Text.find_first_of(LineBreaks, position)) != StringT::npos)
+    {
+        count++;
+        position++;
+    }
+
+    return count;
+}
+
+template <typename StringT>
+static size_t
+CountWithFind(
+    const StringT& Text,
+    typename StringT::value_type LineBreak)
+{
+    size_t count = 0;
+    size_t position = 0;
+
+    while ((position = Text.find(LineBreak, position)) != StringT::npos)
+    {
+        count++;
+        position++;
+    }
+
+    return count;
+}
+
+int
+main(
+    int argc,
+    char** argv)
+{
+    const size_t sizeInMB = (argc > 1) ? strtoul(argv[1], nullptr, 10) : 256;
+
+    size_t lines = 0;
+    const std::string text = BenchmarkUtilities::MakeW3CLog(sizeInMB << 20, lines);
+
+    //
+    // UTF-16 as on Windows, where wchar_t is 16 bits.
+    //
+    const std::u16string wideText(text.begin(), text.end());
+
+    const LineScanner::SimdLevel machineLevel = LineScanner::GetSimdLevel();
+
+    printf("%zu lines of W3C text, %.0f bytes per line, %zu CR and LF\n",
+        lines,
+        static_cast<double>(text.size()) / lines,
+        lines * 2);
+    printf("Kernel selected on this machine: %s\n", SIMD_LEVEL_NAMES[static_cast<int>(machineLevel)]);
+
+    const auto measure = [&](const char* Name, double Megabytes, auto Count)
+    {
+        size_t count = 0;
+        const double seconds = BenchmarkUtilities::MeasureBest(5, [&]()
+        {
+            count = Count();
+        });
+
+        printf("  %-44s %7.0f MB/s\n", Name, Megabytes / seconds);
+        BenchmarkUtilities::Sink = count;
+    };
+
+    const double megabytes = text.size() / 1048576.0;
+    printf("\n8-bit text, %.0f MB\n", megabytes);
+
+    measure("std::string::find_first_of(\"\\r\\n\") (before)", megabytes, [&]()
+    {
+        return CountWithFindFirstOf(text, "\r\n");
+    });
+
+    for (int level = 0; level <= static_cast<int>(machineLevel); level++)
+    {
+        const std::string name = std::string(SIMD_LEVEL_NAMES[level]) + " mask";
+        measure(name.c_str(), megabytes, [&]()
+        {
+            return CountWithMasks(text, static_cast<LineScanner::SimdLevel>(level));
+        });
+    }
+
+    measure("FindNextLineBreak per line break", megabytes, [&]()
+    {
+        return CountWithFindNext(text);
+    });
+
+    const double wideMegabytes = wideText.size() * sizeof(char16_t) / 1048576.0;
+    printf("\nUTF-16 text, %.0f MB\n", wideMegabytes);
+
+    measure("std::wstring::find_first_of(L\"\\n\\r\") (before)", wideMegabytes, [&]()
+    {
+        return CountWithFindFirstOf(wideText, u"\n\r");
+    });
+
+    measure("std::wstring::find(L'\\n') (before)", wideMegabytes, [&]()
+    {
+        return CountWithFind(wideText, u'\n');
+    });
+
+    for (int level = 0; level <= static_cast<int>(machineLevel); level++)
+    {
+        const std::string name = std::string(SIMD_LEVEL_NAMES[level]) + " mask";
+        measure(name.c_str(), wideMegabytes, [&]()
+        {
+            return CountWithMasks(wideText, static_cast<LineScanner::SimdLevel>(level));
+        });
+    }
+
+    measure("FindNextLineBreak per line break", wideMegabytes, [&]()
+    {
+        return CountWithFindNext(wideText);
+    });
+
+    return 0;
+}
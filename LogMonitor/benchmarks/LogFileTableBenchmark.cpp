@@ -0,0 +1,248 @@
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//
+
+//
+// Cost of the lookups and inserts of LogFileTable as the number of files
+// grows, against the three case-insensitive std::map indexes it replaced.
+// Paths look like the ones of IIS sites and are looked up in lower case, in
+// a random order.
+//
+// Usage: LogFileTableBenchmark [max number of files]
+//
+
+#include "pch.h"  // NOLINT(build/include_subdir)
+#include "BenchmarkUtilities.h"  // NOLINT(build/include_subdir)
+#include "LogFileTable.h"  // NOLINT(build/include_subdir)
+
+#include <cstdlib>
+#include <cstring>
+#include <cwchar>
+#include <cwctype>
+#include <map>
+#include <memory>
+#include <vector>
+
+struct LogFileInformation
+{
+    std::wstring FileName;
+};
+
+//
+// The comparers of the indexes LogFileMonitor had before LogFileTable.
+//
+struct ci_less
+{
+    bool operator()(const std::wstring& Path1, const std::wstring& Path2) const
+    {
+#ifdef _WIN32
+        return _wcsicmp(Path1.c_str(), Path2.c_str()) < 0;
+#else
+        return wcscasecmp(Path1.c_str(), Path2.c_str()) < 0;
+#endif
+    }
+};
+
+struct FileIdLess
+{
+    bool operator()(const FILE_ID_INFO& FileId1, const FILE_ID_INFO& FileId2) const
+    {
+        return memcmp(&FileId1, &FileId2, sizeof(FILE_ID_INFO)) < 0;
+    }
+};
+
+struct MapIndexes
+{
+    std::map<std::wstring, std::shared_ptr<LogFileInformation>, ci_less> LogFilesInformation;
+    std::map<std::wstring, std::wstring, ci_less> LongPaths;
+    std::map<FILE_ID_INFO, std::wstring, FileIdLess> FileIds;
+
+    void Insert(
+        const std::wstring& LongPath,
+        const std::wstring& ShortPath,
+        const FILE_ID_INFO& FileId,
+        const std::shared_ptr<LogFileInformation>& LogFileInfo)
+    {
+        LogFilesInformation[LongPath] = LogFileInfo;
+        LongPaths[ShortPath] = LongPath;
+        FileIds[FileId] = LongPath;
+    }
+
+    //
+    // Like GetLogFilesInformationIt: by long path, or else by short path.
+    //
+    std::shared_ptr<LogFileInformation> Find(
+        const std::wstring& Path) const
+    {
+        auto it = LogFilesInformation.find(Path);
+        if (it == LogFilesInformation.end())
+        {
+            auto longPath = LongPaths.find(Path);
+            if (longPath != LongPaths.end())
+            {
+                it = LogFilesInformation.find(longPath->second);
+            }
+        }
+
+        return (it != LogFilesInformation.end()) ? it->second : nullptr;
+    }
+
+    bool FindLongPathById(
+        const FILE_ID_INFO& FileId,
+        std::wstring& LongPath) const
+    {
+        auto it = FileIds.find(FileId);
+        if (it == FileIds.end())
+        {
+            return false;
+        }
+
+        LongPath = it->second;
+        return true;
+    }
+};
+
+struct Files
+{
+    std::vector<std::wstring> LongPaths;
+    std::vector<std::wstring> ShortPaths;
+    std::vector<FILE_ID_INFO> FileIds;
+    std::vector<std::shared_ptr<LogFileInformation>> Information;
+
+    //
+    // Paths to look up, in lower case and in a random order.
+    //
+    std::vector<std::wstring> Queries;
+    std::vector<size_t> Order;
+};
+
+static Files
+MakeFiles(
+    size_t Count)
+{
+    Files files;
+
+    for (size_t i = 0; i < Count; i++)
+    {
+        wchar_t path[128];
+        swprintf(path, 128, L"W3SVC%zu\\u_ex%06zu_application.log", i % 100, i);
+        files.LongPaths.push_back(path);
+
+        swprintf(path, 128, L"W3SVC%zu\\U_EX%04zu~1.LOG", i % 100, i % 10000);
+        files.ShortPaths.push_back(path);
+
+        FILE_ID_INFO fileId;
+        memset(&fileId, 0, sizeof(fileId));
+        fileId.VolumeSerialNumber = 7;
+        memcpy(fileId.FileId.Identifier, &i, sizeof(i));
+        files.FileIds.push_back(fileId);
+
+        files.Information.push_back(std::make_shared<LogFileInformation>());
+        files.Order.push_back(i);
+    }
+
+    std::shuffle(files.Order.begin(), files.Order.end(), std::mt19937(1));
+
+    for (size_t i : files.Order)
+    {
+        std::wstring query = files.LongPaths[i];
+        for (wchar_t& ch : query)
+        {
+            ch = static_cast<wchar_t>(towlower(ch));
+        }
+
+        files.Queries.push_back(query);
+    }
+
+    return files;
+}
+
+///
+/// Measures the inserts, the lookups by path and the lookups by file id of
+/// an index type, in nanoseconds per operation.
+///
+template <typename IndexT>
+static void
+MeasureIndex(
+    const Files& Files,
+    double& InsertNanoseconds,
+    double& FindNanoseconds,
+    double& FindByIdNanoseconds)
+{
+    const double count = static_cast<double>(Files.LongPaths.size());
+    std::unique_ptr<IndexT> index;
+
+    InsertNanoseconds = BenchmarkUtilities::MeasureBest(5, [&]()
+    {
+        index = std::make_unique<IndexT>();
+        for (size_t i = 0; i < Files.LongPaths.size(); i++)
+        {
+            index->Insert(Files.LongPaths[i], Files.ShortPaths[i], Files.FileIds[i], Files.Information[i]);
+        }
+    }) / count * 1e9;
+
+    size_t found = 0;
+
+    FindNanoseconds = BenchmarkUtilities::MeasureBest(5, [&]()
+    {
+        found = 0;
+        for (const std::wstring& query : Files.Queries)
+        {
+            found += (index->Find(query) != nullptr);
+        }
+    }) / count * 1e9;
+
+    if (found != Files.Queries.size())
+    {
+        printf("Not all the files were found by path\n");
+    }
+
+    FindByIdNanoseconds = BenchmarkUtilities::MeasureBest(5, [&]()
+    {
+        std::wstring longPath;
+        found = 0;
+        for (size_t i : Files.Order)
+        {
+            found += index->FindLongPathById(Files.FileIds[i], longPath);
+        }
+    }) / count * 1e9;
+
+    if (found != Files.Order.size())
+    {
+        printf("Not all the files were found by id\n");
+    }
+}
+
+int
+main(
+    int argc,
+    char** argv)
+{
+    const size_t maxCount = (argc > 1) ? strtoul(argv[1], nullptr, 10) : 100000;
+
+    printf("ns per operation    lookup by path      lookup by id        insert\n");
+    printf("                    maps     table      maps     table      maps     table\n");
+
+    for (size_t count = 1000; count <= maxCount; count *= 10)
+    {
+        const Files files = MakeFiles(count);
+
+        double mapInsert, mapFind, mapFindById;
+        MeasureIndex<MapIndexes>(files, mapInsert, mapFind, mapFindById);
+
+        double tableInsert, tableFind, tableFindById;
+        MeasureIndex<LogFileTable>(files, tableInsert, tableFind, tableFindById);
+
+        printf("%7zu files     %7.0f  %7.0f    %7.0f  %7.0f    %7.0f  %7.0f\n",
+            count,
+            mapFind,
+            tableFind,
+            mapFindById,
+            tableFindById,
+            mapInsert,
+            tableInsert);
+    }
+
+    return 0;
+}
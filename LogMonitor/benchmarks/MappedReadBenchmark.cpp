@@ -0,0 +1,336 @@
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//
+
+//
+// Throughput of the catch-up read of a large log file: the 4 KB reads and
+// line splitting ReadLogFile did before, against the mapped windows of
+// ReadLogFileMapped, with the line breaks searched in the mapping and the
+// lines framed without copies. The file is created with IIS W3C lines if it
+// doesn't exist, and read from the page cache.
+//
+// Usage: MappedReadBenchmark <file> [size in GB]
+//
+
+#include "pch.h"  // NOLINT(build/include_subdir)
+#include "BenchmarkUtilities.h"  // NOLINT(build/include_subdir)
+#include "LegacyLineSplitter.h"  // NOLINT(build/include_subdir)
+#include "LineFramer.h"  // NOLINT(build/include_subdir)
+
+#include <cstdlib>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const size_t READ_BUFFER_SIZE = 4096;
+
+//
+// The windows of ReadLogFileMapped, and a larger one for comparison.
+//
+static const size_t MAPPED_WINDOW_SIZES[] = { 4 * 1024 * 1024, 64 * 1024 * 1024 };
+
+///
+/// Minimal read-only file, with the calls of the Windows version on Windows
+/// and their POSIX equivalents elsewhere.
+///
+class BenchmarkFile final
+{
+ public:
+    explicit BenchmarkFile(
+        const char* Path)
+    {
+#ifdef _WIN32
+        m_file = CreateFileA(Path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, 0, nullptr);
+        LARGE_INTEGER size = {};
+        if (m_file == INVALID_HANDLE_VALUE || !GetFileSizeEx(m_file, &size))
+        {
+            fprintf(stderr, "Failed to open %s\n", Path);
+            exit(1);
+        }
+
+        m_size = static_cast<UINT64>(size.QuadPart);
+
+        SYSTEM_INFO systemInfo;
+        GetSystemInfo(&systemInfo);
+        m_granularity = systemInfo.dwAllocationGranularity;
+#else
+        m_file = open(Path, O_RDONLY);
+        struct stat status;
+        if (m_file < 0 || fstat(m_file, &status) != 0)
+        {
+            fprintf(stderr, "Failed to open %s\n", Path);
+            exit(1);
+        }
+
+        m_size = static_cast<UINT64>(status.st_size);
+        m_granularity = static_cast<UINT64>(sysconf(_SC_PAGESIZE));
+#endif
+    }
+
+    BenchmarkFile(const BenchmarkFile&) = delete;
+    BenchmarkFile& operator=(const BenchmarkFile&) = delete;
+
+    ~BenchmarkFile()
+    {
+#ifdef _WIN32
+        CloseHandle(m_file);
+#else
+        close(m_file);
+#endif
+    }
+
+    UINT64 Size() const
+    {
+        return m_size;
+    }
+
+    UINT64 Granularity() const
+    {
+        return m_granularity;
+    }
+
+    size_t Read(
+        char* Buffer,
+        size_t Size)
+    {
+#ifdef _WIN32
+        DWORD bytesRead = 0;
+        if (!ReadFile(m_file, Buffer, static_cast<DWORD>(Size), &bytesRead, nullptr))
+        {
+            return 0;
+        }
+
+        return bytesRead;
+#else
+        const ssize_t bytesRead = read(m_file, Buffer, Size);
+
+        return (bytesRead > 0) ? static_cast<size_t>(bytesRead) : 0;
+#endif
+    }
+
+    ///
+    /// Maps a view of the file, with a mapping of its own like
+    /// ReadLogFileMapped does, so the file can be truncated between views.
+    ///
+    const char* Map(
+        UINT64 Offset,
+        size_t Size)
+    {
+#ifdef _WIN32
+        const UINT64 mappingSize = Offset + Size;
+        HANDLE mapping = CreateFileMappingW(
+            m_file,
+            nullptr,
+            PAGE_READONLY,
+            static_cast<DWORD>(mappingSize >> 32),
+            static_cast<DWORD>(mappingSize & 0xFFFFFFFF),
+            nullptr);
+        if (mapping == NULL)
+        {
+            return nullptr;
+        }
+
+        void* view = MapViewOfFile(
+            mapping,
+            FILE_MAP_READ,
+            static_cast<DWORD>(Offset >> 32),
+            static_cast<DWORD>(Offset & 0xFFFFFFFF),
+            Size);
+        CloseHandle(mapping);
+
+        return static_cast<const char*>(view);
+#else
+        void* view = mmap(nullptr, Size, PROT_READ, MAP_SHARED, m_file, static_cast<off_t>(Offset));
+
+        return (view == MAP_FAILED) ? nullptr : static_cast<const char*>(view);
+#endif
+    }
+
+    static void Unmap(
+        const char* View,
+        size_t Size)
+    {
+#ifdef _WIN32
+        (void)Size;
+        UnmapViewOfFile(View);
+#else
+        munmap(const_cast<char*>(View), Size);
+#endif
+    }
+
+ private:
+#ifdef _WIN32
+    HANDLE m_file;
+#else
+    int m_file;
+#endif
+
+    UINT64 m_size = 0;
+    UINT64 m_granularity = 0;
+};
+
+static void
+CreateLogFile(
+    const char* Path,
+    UINT64 Size)
+{
+    FILE* file = fopen(Path, "rb");
+    if (file != nullptr)
+    {
+        fclose(file);
+        return;
+    }
+
+    printf("Creating %s...\n", Path);
+
+    size_t lines = 0;
+    const std::string text = BenchmarkUtilities::MakeW3CLog(64 << 20, lines);
+
+    file = fopen(Path, "wb");
+    if (file == nullptr)
+    {
+        fprintf(stderr, "Failed to create %s\n", Path);
+        exit(1);
+    }
+
+    for (UINT64 written = 0; written < Size; written += text.size())
+    {
+        fwrite(text.data(), 1, text.size(), file);
+    }
+
+    fclose(file);
+}
+
+static size_t
+ReadWithBuffer(
+    const char* Path)
+{
+    BenchmarkFile file(Path);
+    LegacyLineSplitter splitter;
+    std::vector<char> buffer(READ_BUFFER_SIZE);
+
+    size_t bytesRead;
+    while ((bytesRead = file.Read(buffer.data(), buffer.size())) > 0)
+    {
+        splitter.Push(buffer.data(), bytesRead);
+    }
+
+    splitter.Flush();
+
+    return splitter.Lines;
+}
+
+static size_t
+ReadMapped(
+    const char* Path,
+    size_t WindowSize)
+{
+    BenchmarkFile file(Path);
+    LineFramer<char> framer(LineBreakMode::Lf);
+    size_t lines = 0;
+    UINT64 nextReadOffset = 0;
+
+    const auto onLine = [&](std::string_view)
+    {
+        lines++;
+    };
+
+    while (nextReadOffset < file.Size())
+    {
+        const UINT64 viewOffset = nextReadOffset - (nextReadOffset % file.Granularity());
+        const size_t viewSize = static_cast<size_t>(std::min<UINT64>(WindowSize, file.Size() - viewOffset));
+
+        const char* view = file.Map(viewOffset, viewSize);
+        if (view == nullptr)
+        {
+            fprintf(stderr, "Failed to map the file\n");
+            exit(1);
+        }
+
+        const char* contents = view + (nextReadOffset - viewOffset);
+        const char* end = view + viewSize;
+
+        //
+        // Like GetCompleteLinesSize, only the complete lines are framed. The
+        // next window starts at the partial line.
+        //
+        const char* lastLineBreak = LineScanner::FindLastLineBreak(contents, end, '\n', '\n');
+        const size_t completeLinesSize = (lastLineBreak == end) ? 0 : (lastLineBreak - contents + 1);
+
+        framer.Push(contents, completeLinesSize, onLine);
+        BenchmarkFile::Unmap(view, viewSize);
+
+        if (completeLinesSize == 0)
+        {
+            break;
+        }
+
+        nextReadOffset += completeLinesSize;
+    }
+
+    framer.Flush(onLine);
+
+    return lines;
+}
+
+int
+main(
+    int argc,
+    char** argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <file> [size in GB]\n", argv[0]);
+        return 1;
+    }
+
+    const char* path = argv[1];
+    const UINT64 sizeInGB = (argc > 2) ? strtoul(argv[2], nullptr, 10) : 2;
+
+    CreateLogFile(path, sizeInGB << 30);
+
+    //
+    // Get the file in the page cache, so the read paths are measured rather
+    // than the disk.
+    //
+    const size_t lines = ReadWithBuffer(path);
+    const double megabytes = BenchmarkFile(path).Size() / 1048576.0;
+
+    printf("%.0f MB file, %zu lines, read from the page cache\n\n", megabytes, lines);
+
+    const auto measure = [&](const char* Name, auto Read)
+    {
+        size_t readLines = 0;
+        const double seconds = BenchmarkUtilities::MeasureBest(3, [&]()
+        {
+            readLines = Read();
+        });
+
+        printf("  %-44s %7.0f MB/s%s\n",
+            Name,
+            megabytes / seconds,
+            (readLines == lines) ? "" : "  (line count differs)");
+    };
+
+    measure("4 KB reads + find/substr splitting (before)", [&]()
+    {
+        return ReadWithBuffer(path);
+    });
+
+    for (size_t windowSize : MAPPED_WINDOW_SIZES)
+    {
+        const std::string name = std::to_string(windowSize >> 20) + " MB mapped windows + LineFramer";
+        measure(name.c_str(), [&]()
+        {
+            return ReadMapped(path, windowSize);
+        });
+    }
+
+    return 0;
+}
@@ -0,0 +1,96 @@
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//
+
+#pragma once
+
+#include <functional>
+#include <mutex>
+#include <string_view>
+#include <thread>
+
+///
+/// Captures the output of the LogMonitor components run by a benchmark.
+///
+/// stdout is replaced by a pipe before the output writer of logWriter is
+/// started, and a thread reads the pipe like the container runtime would,
+/// passing each line to the handler set by the benchmark. The benchmarks
+/// print their results with wprintf: the CRT stdout still goes to the
+/// original handle, but LogWriter set it to wide text mode.
+///
+/// There is a single capture per process, which lives until it exits, like
+/// the output writer.
+///
+class OutputCapture final
+{
+ public:
+    typedef std::function<void(std::string_view Line)> LineHandler;
+
+    static OutputCapture& Start(
+        _In_ const OutputSettings& Settings = OutputSettings())
+    {
+        static OutputCapture capture(Settings);
+
+        return capture;
+    }
+
+    ///
+    /// Sets the function called with each line of output, without its line
+    /// terminator. It's called by the reading thread.
+    ///
+    void SetLineHandler(
+        _In_ LineHandler Handler)
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+
+        m_handler = std::move(Handler);
+    }
+
+ private:
+    static constexpr DWORD PIPE_SIZE = 1024 * 1024;
+
+    HANDLE m_readPipe = INVALID_HANDLE_VALUE;
+
+    std::mutex m_lock;
+    LineHandler m_handler;
+
+    explicit OutputCapture(
+        _In_ const OutputSettings& Settings)
+    {
+        HANDLE writePipe;
+        if (!CreatePipe(&m_readPipe, &writePipe, nullptr, PIPE_SIZE))
+        {
+            throw std::system_error(GetLastError(), std::system_category(), "CreatePipe");
+        }
+
+        SetStdHandle(STD_OUTPUT_HANDLE, writePipe);
+
+        std::thread(&OutputCapture::ReadPipe, this).detach();
+
+        if (!logWriter.StartOutputWriter(Settings))
+        {
+            throw std::runtime_error("Failed to start the output writer");
+        }
+    }
+
+    void ReadPipe()
+    {
+        std::string buffer(PIPE_SIZE, '\0');
+        LineFramer<char> framer;
+        DWORD bytesRead;
+
+        while (ReadFile(m_readPipe, &buffer[0], PIPE_SIZE, &bytesRead, nullptr) && bytesRead > 0)
+        {
+            std::lock_guard<std::mutex> guard(m_lock);
+
+            framer.Push(buffer.data(), bytesRead, [this](std::string_view Line)
+            {
+                if (m_handler)
+                {
+                    m_handler(Line);
+                }
+            });
+        }
+    }
+};
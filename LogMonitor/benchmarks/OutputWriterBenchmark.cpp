@@ -0,0 +1,170 @@
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//
+
+//
+// Lines per second written to stdout by 1 to 16 producer threads, with the
+// writer thread of OutputWriter, against the way LogWriter wrote each line
+// before it: under an exclusive lock, with wprintf to stdout in UTF-8 text
+// mode, and flushed.
+//
+// stdout is a pipe read by a thread, like the one of a container. The time of
+// a run ends once all the lines were written to the pipe.
+//
+// Usage: OutputWriterBenchmark [lines] [max producers]
+//
+
+#include "pch.h"  // NOLINT(build/include_subdir)
+#include "BenchmarkUtilities.h"  // NOLINT(build/include_subdir)
+#include "PipeReader.h"  // NOLINT(build/include_subdir)
+
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+LogWriter logWriter;
+
+static const DWORD FLUSH_MAX_WAIT_MILLIS = 60 * 1000;
+
+static const char LINE[] =
+    "{\"Source\": \"File\",\"LogEntry\": {\"Logline\": \"2024-05-01 12:00:00 10.0.0.1 GET /api/orders/12345 - 443 -"
+    " 192.168.0.1 curl/8.4.0 - 200 0 0 15\",\"FileName\": \"W3SVC1\\\\u_ex240501.log\"},\"SchemaVersion\":\"1.0.0\"}";
+
+template <typename F>
+static void
+RunProducers(
+    _In_ size_t Producers,
+    _In_ size_t Lines,
+    _In_ F WriteLine)
+{
+    std::vector<std::thread> threads;
+
+    for (size_t producer = 0; producer < Producers; producer++)
+    {
+        threads.emplace_back([&, producer]()
+        {
+            for (size_t i = producer; i < Lines; i += Producers)
+            {
+                WriteLine();
+            }
+        });
+    }
+
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+}
+
+///
+/// The path before OutputWriter. The pipe is opened as a CRT stream, in the
+/// mode LogWriter set on stdout.
+///
+static double
+MeasureLockedWprintf(
+    _In_ size_t Producers,
+    _In_ size_t Lines,
+    _Out_ UINT64& BytesRead)
+{
+    const std::wstring line(LINE, LINE + sizeof(LINE) - 1);
+    SRWLOCK lock = SRWLOCK_INIT;
+
+    PipeReader pipe;
+
+    const int fd = _open_osfhandle(reinterpret_cast<intptr_t>(pipe.ReleaseWritePipe()), _O_WRONLY);
+    FILE* output = _fdopen(fd, "w");
+    _setmode(fd, _O_U8TEXT);
+
+    const BenchmarkUtilities::Clock::time_point start = BenchmarkUtilities::Clock::now();
+
+    RunProducers(Producers, Lines, [&]()
+    {
+        AcquireSRWLockExclusive(&lock);
+
+        fwprintf(output, L"%s\n", line.c_str());
+        fflush(output);
+
+        ReleaseSRWLockExclusive(&lock);
+    });
+
+    const double seconds = BenchmarkUtilities::SecondsSince(start);
+
+    //
+    // Closes the write end of the pipe too.
+    //
+    fclose(output);
+
+    BytesRead = pipe.Close();
+
+    return seconds;
+}
+
+static double
+MeasureOutputWriter(
+    _In_ size_t Producers,
+    _In_ size_t Lines,
+    _Out_ UINT64& BytesRead)
+{
+    PipeReader pipe;
+    double seconds;
+
+    {
+        OutputWriter writer(pipe.WritePipe(), OutputSettings());
+
+        const BenchmarkUtilities::Clock::time_point start = BenchmarkUtilities::Clock::now();
+
+        RunProducers(Producers, Lines, [&]()
+        {
+            writer.Write(OutputSource::File, std::string_view(LINE, sizeof(LINE) - 1), "\r\n");
+        });
+
+        writer.Flush(FLUSH_MAX_WAIT_MILLIS);
+
+        seconds = BenchmarkUtilities::SecondsSince(start);
+    }
+
+    BytesRead = pipe.Close();
+
+    return seconds;
+}
+
+int
+wmain(
+    int argc,
+    WCHAR** argv)
+{
+    const size_t lines = (argc > 1) ? wcstoul(argv[1], nullptr, 10) : 1000000;
+    const size_t maxProducers = (argc > 2) ? wcstoul(argv[2], nullptr, 10) : 16;
+
+    const UINT64 expectedBytes = static_cast<UINT64>(lines) * (sizeof(LINE) - 1 + 2);
+
+    wprintf(L"%zu lines of %zu bytes to a pipe, best of 3 runs, %u hardware threads\n\n",
+        lines,
+        sizeof(LINE) - 1 + 2,
+        std::thread::hardware_concurrency());
+    wprintf(L"  producers   locked wprintf (before)   OutputWriter\n");
+    wprintf(L"                        lines/s             lines/s\n");
+
+    for (size_t producers = 1; producers <= maxProducers; producers *= 2)
+    {
+        UINT64 wprintfBytes = 0;
+        UINT64 writerBytes = 0;
+        double wprintfSeconds = 1e30;
+        double writerSeconds = 1e30;
+
+        for (int run = 0; run < 3; run++)
+        {
+            wprintfSeconds = (std::min)(wprintfSeconds, MeasureLockedWprintf(producers, lines, wprintfBytes));
+            writerSeconds = (std::min)(writerSeconds, MeasureOutputWriter(producers, lines, writerBytes));
+        }
+
+        wprintf(L"  %9zu   %23.0f   %12.0f%ls\n",
+            producers,
+            lines / wprintfSeconds,
+            lines / writerSeconds,
+            (wprintfBytes == expectedBytes && writerBytes == expectedBytes) ? L"" : L"  (bytes differ)");
+    }
+
+    return 0;
+}
@@ -0,0 +1,92 @@
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//
+
+#pragma once
+
+#include <system_error>
+#include <thread>
+#include <vector>
+
+///
+/// A pipe standing for the stdout of a container, and the thread reading
+/// it and counting the bytes written to it.
+///
+class PipeReader final
+{
+ public:
+    PipeReader()
+    {
+        if (!CreatePipe(&m_readPipe, &m_writePipe, nullptr, PIPE_SIZE))
+        {
+            throw std::system_error(GetLastError(), std::system_category(), "CreatePipe");
+        }
+
+        m_thread = std::thread([this]()
+        {
+            std::vector<char> buffer(PIPE_SIZE);
+            DWORD bytesRead;
+
+            while (ReadFile(m_readPipe, buffer.data(), PIPE_SIZE, &bytesRead, nullptr) && bytesRead > 0)
+            {
+                m_bytesRead += bytesRead;
+            }
+        });
+    }
+
+    PipeReader(const PipeReader&) = delete;
+    PipeReader& operator=(const PipeReader&) = delete;
+
+    ~PipeReader()
+    {
+        Close();
+        CloseHandle(m_readPipe);
+    }
+
+    HANDLE WritePipe() const
+    {
+        return m_writePipe;
+    }
+
+    ///
+    /// Gives the write end of the pipe to the caller, who closes it.
+    ///
+    HANDLE ReleaseWritePipe()
+    {
+        HANDLE writePipe = m_writePipe;
+        m_writePipe = INVALID_HANDLE_VALUE;
+
+        return writePipe;
+    }
+
+    ///
+    /// Closes the write end of the pipe, if it wasn't given to the caller,
+    /// and waits for the thread to read everything written to it.
+    ///
+    /// \return The number of bytes read.
+    ///
+    UINT64 Close()
+    {
+        if (m_writePipe != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(m_writePipe);
+            m_writePipe = INVALID_HANDLE_VALUE;
+        }
+
+        if (m_thread.joinable())
+        {
+            m_thread.join();
+        }
+
+        return m_bytesRead;
+    }
+
+ private:
+    static constexpr DWORD PIPE_SIZE = 1024 * 1024;
+
+    HANDLE m_readPipe = INVALID_HANDLE_VALUE;
+    HANDLE m_writePipe = INVALID_HANDLE_VALUE;
+    UINT64 m_bytesRead = 0;
+    std::thread m_thread;
+};
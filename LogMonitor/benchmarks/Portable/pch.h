@@ -0,0 +1,131 @@
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//
+
+#pragma once
+
+//
+// Precompiled header of the portable benchmarks. They build the parts of
+// FileMonitor that only use a few Win32 types and functions, so they can also
+// run on Linux. On other platforms, these are defined here with the same
+// behavior.
+//
+#ifdef _WIN32
+
+#include <windows.h>
+
+#else
+
+#include <cstdint>
+#include <cstring>
+#include <cwctype>
+#include <shared_mutex>
+
+#define _In_
+#define _Out_
+#define _Inout_
+
+#define TRUE 1
+#define CSTR_EQUAL 2
+
+#define LOCALE_NAME_INVARIANT L""
+#define LCMAP_UPPERCASE 0x00000200
+
+typedef uint8_t BYTE;
+typedef uint64_t UINT64;
+
+struct FILE_ID_128
+{
+    BYTE Identifier[16];
+};
+
+struct FILE_ID_INFO
+{
+    UINT64 VolumeSerialNumber;
+    FILE_ID_128 FileId;
+};
+
+typedef std::shared_mutex SRWLOCK;
+
+inline void InitializeSRWLock(SRWLOCK*)
+{
+}
+
+inline void AcquireSRWLockShared(SRWLOCK* Lock)
+{
+    Lock->lock_shared();
+}
+
+inline void ReleaseSRWLockShared(SRWLOCK* Lock)
+{
+    Lock->unlock_shared();
+}
+
+inline void AcquireSRWLockExclusive(SRWLOCK* Lock)
+{
+    Lock->lock();
+}
+
+inline void ReleaseSRWLockExclusive(SRWLOCK* Lock)
+{
+    Lock->unlock();
+}
+
+inline int LCMapStringEx(
+    const wchar_t*,
+    unsigned,
+    const wchar_t* Source,
+    int SourceSize,
+    wchar_t* Destination,
+    int DestinationSize,
+    void*,
+    void*,
+    long)
+{
+    if (DestinationSize < SourceSize)
+    {
+        return 0;
+    }
+
+    for (int i = 0; i < SourceSize; i++)
+    {
+        Destination[i] = static_cast<wchar_t>(towupper(Source[i]));
+    }
+
+    return SourceSize;
+}
+
+inline int CompareStringOrdinal(
+    const wchar_t* String1,
+    int Size1,
+    const wchar_t* String2,
+    int Size2,
+    int IgnoreCase)
+{
+    if (Size1 != Size2)
+    {
+        return CSTR_EQUAL - 1;
+    }
+
+    for (int i = 0; i < Size1; i++)
+    {
+        wchar_t ch1 = String1[i];
+        wchar_t ch2 = String2[i];
+
+        if (IgnoreCase && ch1 != ch2)
+        {
+            ch1 = static_cast<wchar_t>(towupper(ch1));
+            ch2 = static_cast<wchar_t>(towupper(ch2));
+        }
+
+        if (ch1 != ch2)
+        {
+            return CSTR_EQUAL - 1;
+        }
+    }
+
+    return CSTR_EQUAL;
+}
+
+#endif
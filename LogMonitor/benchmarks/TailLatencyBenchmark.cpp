@@ -0,0 +1,297 @@
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//
+
+//
+// Tail latency of each log file of a directory, from the time a line is
+// written to the time LogMonitor writes it to stdout, with writers at
+// different rates.
+//
+// The first writer is chatty: it starts with a backlog, and then writes as
+// fast as it's allowed to. The other writers write 1000, 100 or 10 lines per
+// second. Each line has the time it was written, read back from the output.
+// Two configurations of the readers are compared:
+// - one reader thread, one file at a time, each read to its end, like the
+//   single LogFilesChangeHandler thread of each source did before the pool,
+// - the default reader pool.
+//
+// Usage: TailLatencyBenchmark [writers] [seconds]
+//
+
+#include "pch.h"  // NOLINT(build/include_subdir)
+#include "BenchmarkUtilities.h"  // NOLINT(build/include_subdir)
+#include "OutputCapture.h"  // NOLINT(build/include_subdir)
+
+#include <atomic>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+LogWriter logWriter;
+
+static const size_t CHATTY_BACKLOG_SIZE = 64 * 1024 * 1024;
+static const UINT64 CHATTY_LINES_PER_SECOND = 100000;
+static const UINT64 LINES_PER_SECOND[] = { 1000, 100, 10 };
+
+static LARGE_INTEGER Frequency;
+
+static UINT64
+GetTicks()
+{
+    LARGE_INTEGER ticks;
+    QueryPerformanceCounter(&ticks);
+
+    return static_cast<UINT64>(ticks.QuadPart);
+}
+
+///
+/// Gets the number after a key in a line of output.
+///
+static bool
+ParseNumber(
+    _In_ std::string_view Line,
+    _In_ std::string_view Key,
+    _Out_ UINT64& Value)
+{
+    const size_t position = Line.find(Key);
+    if (position == std::string_view::npos)
+    {
+        return false;
+    }
+
+    Value = 0;
+    for (size_t i = position + Key.size(); i < Line.size() && Line[i] >= '0' && Line[i] <= '9'; i++)
+    {
+        Value = Value * 10 + (Line[i] - '0');
+    }
+
+    return true;
+}
+
+struct FileWriter
+{
+    std::wstring Path;
+    UINT64 LinesPerSecond = 0;
+    size_t BacklogSize = 0;
+
+    UINT64 WrittenLines = 0;
+    LatencyHistogram Latencies;
+};
+
+static void
+WriteLines(
+    _Inout_ FileWriter& Writer,
+    _In_ size_t Index,
+    _In_ const std::atomic<bool>& Stop)
+{
+    HANDLE file = CreateFileW(
+        Writer.Path.c_str(),
+        FILE_APPEND_DATA,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        nullptr,
+        OPEN_ALWAYS,
+        FILE_ATTRIBUTE_NORMAL,
+        nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return;
+    }
+
+    std::string lines;
+    char line[256];
+
+    const auto appendLine = [&]()
+    {
+        const int size = snprintf(
+            line,
+            sizeof(line),
+            "2024-05-01 12:00:00 GET /api/orders/12345 443 - 192.168.0.1 curl/8.4.0 - 200 writer=%zu seq=%llu t=%llu\r\n",
+            Index,
+            Writer.WrittenLines++,
+            GetTicks());
+        lines.append(line, size);
+    };
+
+    const auto writeLines = [&]()
+    {
+        DWORD bytesWritten;
+        WriteFile(file, lines.data(), static_cast<DWORD>(lines.size()), &bytesWritten, nullptr);
+        lines.clear();
+    };
+
+    while (lines.size() < Writer.BacklogSize)
+    {
+        appendLine();
+    }
+
+    writeLines();
+
+    const UINT64 start = GetTicks();
+    const UINT64 backlogLines = Writer.WrittenLines;
+
+    while (!Stop)
+    {
+        const UINT64 elapsedTicks = GetTicks() - start;
+        const UINT64 dueLines = backlogLines + elapsedTicks * Writer.LinesPerSecond / Frequency.QuadPart;
+
+        while (Writer.WrittenLines < dueLines && lines.size() < 64 * 1024)
+        {
+            appendLine();
+        }
+
+        if (!lines.empty())
+        {
+            writeLines();
+        }
+        else
+        {
+            Sleep(1);
+        }
+    }
+
+    CloseHandle(file);
+}
+
+static void
+Run(
+    _In_ LPCWSTR Name,
+    _In_ const FileMonitorTuning& Tuning,
+    _In_ size_t WritersCount,
+    _In_ DWORD Seconds)
+{
+    WCHAR tempPath[MAX_PATH];
+    GetTempPathW(MAX_PATH, tempPath);
+    const std::wstring directory = std::wstring(tempPath) + L"TailLatencyBenchmark" +
+        std::to_wstring(GetCurrentProcessId()) + L"_" + std::to_wstring(GetTickCount64());
+
+    if (!CreateDirectoryW(directory.c_str(), nullptr))
+    {
+        wprintf(L"Failed to create %ls. Error: %lu\n", directory.c_str(), GetLastError());
+        return;
+    }
+
+    std::vector<FileWriter> writers(WritersCount);
+    for (size_t i = 0; i < WritersCount; i++)
+    {
+        writers[i].Path = directory + L"\\writer" + std::to_wstring(i) + L".log";
+
+        if (i == 0)
+        {
+            writers[i].LinesPerSecond = CHATTY_LINES_PER_SECOND;
+            writers[i].BacklogSize = CHATTY_BACKLOG_SIZE;
+        }
+        else
+        {
+            writers[i].LinesPerSecond = LINES_PER_SECOND[(i - 1) % (sizeof(LINES_PER_SECOND) / sizeof(LINES_PER_SECOND[0]))];
+        }
+    }
+
+    UINT64 unknownLines = 0;
+
+    OutputCapture::Start().SetLineHandler([&](std::string_view Line)
+    {
+        UINT64 writer;
+        UINT64 ticks;
+
+        if (!ParseNumber(Line, "writer=", writer) || !ParseNumber(Line, " t=", ticks) || writer >= writers.size())
+        {
+            unknownLines++;
+            return;
+        }
+
+        writers[writer].Latencies.Record((GetTicks() - ticks) * 1000 / Frequency.QuadPart);
+    });
+
+    {
+        LogFileMonitor monitor(directory, L"*.log", false, 300, L"JSON", L"", Tuning);
+
+        //
+        // Let the monitor start watching the directory.
+        //
+        Sleep(2 * 1000);
+
+        std::atomic<bool> stop(false);
+        std::vector<std::thread> threads;
+        for (size_t i = 0; i < WritersCount; i++)
+        {
+            threads.emplace_back(WriteLines, std::ref(writers[i]), i, std::cref(stop));
+        }
+
+        Sleep(Seconds * 1000);
+
+        stop = true;
+        for (std::thread& thread : threads)
+        {
+            thread.join();
+        }
+
+        //
+        // Let the monitor read what's left.
+        //
+        Sleep(10 * 1000);
+        logWriter.FlushOutput();
+    }
+
+    OutputCapture::Start().SetLineHandler(nullptr);
+
+    wprintf(L"\n%ls\n", Name);
+    wprintf(L"  writer  lines/s    written       read     p50 ms     p99 ms     max ms\n");
+
+    for (size_t i = 0; i < WritersCount; i++)
+    {
+        const FileWriter& writer = writers[i];
+
+        wprintf(L"  %6zu  %7llu  %9llu  %9llu  %9llu  %9llu  %9llu%ls\n",
+            i,
+            writer.LinesPerSecond,
+            writer.WrittenLines,
+            writer.Latencies.Count(),
+            writer.Latencies.Percentile(50),
+            writer.Latencies.Percentile(99),
+            writer.Latencies.Percentile(100),
+            (i == 0) ? L"  (backlog)" : L"");
+
+        DeleteFileW(writer.Path.c_str());
+    }
+
+    if (unknownLines > 0)
+    {
+        wprintf(L"  %llu other lines\n", unknownLines);
+    }
+
+    RemoveDirectoryW(directory.c_str());
+}
+
+int
+wmain(
+    int argc,
+    WCHAR** argv)
+{
+    const size_t writersCount = (argc > 1) ? wcstoul(argv[1], nullptr, 10) : 8;
+    const DWORD seconds = (argc > 2) ? wcstoul(argv[2], nullptr, 10) : 20;
+
+    QueryPerformanceFrequency(&Frequency);
+
+    //
+    // The output is flushed often, so the latency is the one of the readers.
+    //
+    OutputSettings outputSettings;
+    outputSettings.FlushIntervalInMilliseconds = 10;
+    OutputCapture::Start(outputSettings);
+
+    wprintf(L"%zu writers for %lu seconds, the first one with a backlog of %zu MB\n",
+        writersCount,
+        seconds,
+        CHATTY_BACKLOG_SIZE >> 20);
+
+    FileMonitorTuning serialTuning;
+    serialTuning.ReaderThreads = 1;
+    serialTuning.MaxFilesInFlight = 1;
+    serialTuning.ReadBudgetInKB = 0;
+
+    Run(L"One reader, files read to the end (before)", serialTuning, writersCount, seconds);
+    Run(L"Reader pool, default tuning", FileMonitorTuning(), writersCount, seconds);
+
+    return 0;
+}
@@ -0,0 +1,234 @@
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//
+
+//
+// Bytes per second and CPU time per line of the formatting and writing of
+// the lines of a UTF-8 log file, from the read buffer to stdout, in JSON:
+// - before: the line decoded to UTF-16, escaped by SanitizeJson through a
+//   UTF-8 round trip, formatted in UTF-16, and written with wprintf to stdout
+//   in UTF-8 text mode, so the CRT converted it back to UTF-8,
+// - the same UTF-16 formatting, converted to UTF-8 once and handed to the
+//   writer thread, as the custom formats still are,
+// - now: the line escaped and formatted in UTF-8 and handed to the writer
+//   thread as it is.
+//
+// stdout is a pipe read by a thread. The CPU time is the one of the whole
+// process, including the writer thread and the thread reading the pipe.
+//
+// Usage: Utf8OutputBenchmark [size in MB]
+//
+
+#include "pch.h"  // NOLINT(build/include_subdir)
+#include "BenchmarkUtilities.h"  // NOLINT(build/include_subdir)
+#include "PipeReader.h"  // NOLINT(build/include_subdir)
+
+#include <cstdlib>
+#include <vector>
+
+LogWriter logWriter;
+
+static const DWORD FLUSH_MAX_WAIT_MILLIS = 60 * 1000;
+
+static const std::wstring FILE_NAME = L"W3SVC1\\\\u_ex240501.log";
+
+//
+// SanitizeJson before it escaped UTF-16 text directly.
+//
+static void
+SanitizeJsonBefore(
+    _Inout_ std::wstring& Str)
+{
+    std::string utf8 = Utility::WStringToString(Str);
+
+    utf8.erase(std::find(utf8.begin(), utf8.end(), '\0'), utf8.end());
+
+    nlohmann::json j = utf8;
+    std::string escapedUtf8 = j.dump();
+
+    if (escapedUtf8.length() >= 2 &&
+        escapedUtf8.front() == '"' &&
+        escapedUtf8.back() == '"')
+    {
+        escapedUtf8 = escapedUtf8.substr(1, escapedUtf8.length() - 2);
+    }
+
+    Str = Utility::StringToWString(escapedUtf8);
+}
+
+//
+// The UTF-16 formatting of the JSON lines before they were formatted in
+// UTF-8, which the custom formats still use.
+//
+static std::wstring
+FormatUtf16(
+    _In_ std::string_view Line)
+{
+    std::wstring message = Utility::StringToWString(std::string(Line));
+
+    SanitizeJsonBefore(message);
+
+    return Utility::FormatString(
+        L"{\"Source\": \"File\","
+        L"\"LogEntry\": {"
+        L"\"Logline\": \"%s\","
+        L"\"FileName\": \"%s\""
+        L"},"
+        L"\"SchemaVersion\":\"1.0.0\""
+        L"}",
+        message.c_str(),
+        FILE_NAME.c_str());
+}
+
+//
+// The formatting of LogFileMonitor::WriteLineToConsole.
+//
+static void
+FormatUtf8(
+    _In_ std::string_view Line,
+    _In_ const std::string& FileNameUtf8,
+    _Inout_ std::string& FormattedLine)
+{
+    FormattedLine.clear();
+    FormattedLine += "{\"Source\": \"File\","
+                     "\"LogEntry\": {"
+                     "\"Logline\": \"";
+    Utility::AppendJsonEscaped(FormattedLine, Line);
+    FormattedLine += "\","
+                     "\"FileName\": \"";
+    FormattedLine += FileNameUtf8;
+    FormattedLine += "\""
+                     "},"
+                     "\"SchemaVersion\":\"1.0.0\""
+                     "}";
+}
+
+static void
+MeasureWideStdout(
+    _In_ const std::vector<std::string_view>& Lines,
+    _Out_ double& Seconds,
+    _Out_ double& CpuSeconds,
+    _Out_ UINT64& BytesWritten)
+{
+    PipeReader pipe;
+
+    const int fd = _open_osfhandle(reinterpret_cast<intptr_t>(pipe.ReleaseWritePipe()), _O_WRONLY);
+    FILE* output = _fdopen(fd, "w");
+    _setmode(fd, _O_U8TEXT);
+
+    const double startCpuSeconds = BenchmarkUtilities::GetProcessCpuSeconds();
+    const BenchmarkUtilities::Clock::time_point start = BenchmarkUtilities::Clock::now();
+
+    for (std::string_view line : Lines)
+    {
+        fwprintf(output, L"%s\n", FormatUtf16(line).c_str());
+        fflush(output);
+    }
+
+    fclose(output);
+    BytesWritten = pipe.Close();
+
+    Seconds = BenchmarkUtilities::SecondsSince(start);
+    CpuSeconds = BenchmarkUtilities::GetProcessCpuSeconds() - startCpuSeconds;
+}
+
+template <typename F>
+static void
+MeasureOutputWriter(
+    _In_ const std::vector<std::string_view>& Lines,
+    _In_ F WriteLine,
+    _Out_ double& Seconds,
+    _Out_ double& CpuSeconds,
+    _Out_ UINT64& BytesWritten)
+{
+    PipeReader pipe;
+
+    const double startCpuSeconds = BenchmarkUtilities::GetProcessCpuSeconds();
+    const BenchmarkUtilities::Clock::time_point start = BenchmarkUtilities::Clock::now();
+
+    {
+        OutputWriter writer(pipe.WritePipe(), OutputSettings());
+
+        for (std::string_view line : Lines)
+        {
+            WriteLine(writer, line);
+        }
+
+        writer.Flush(FLUSH_MAX_WAIT_MILLIS);
+    }
+
+    BytesWritten = pipe.Close();
+
+    Seconds = BenchmarkUtilities::SecondsSince(start);
+    CpuSeconds = BenchmarkUtilities::GetProcessCpuSeconds() - startCpuSeconds;
+}
+
+int
+wmain(
+    int argc,
+    WCHAR** argv)
+{
+    const size_t sizeInMB = (argc > 1) ? wcstoul(argv[1], nullptr, 10) : 256;
+
+    size_t linesCount = 0;
+    const std::string text = BenchmarkUtilities::MakeW3CLog(sizeInMB << 20, linesCount);
+
+    std::vector<std::string_view> lines;
+    LineFramer<char>::ForEachLine(text, [&lines](std::string_view Line) { lines.push_back(Line); });
+
+    const std::string fileNameUtf8 = Utility::WStringToString(FILE_NAME);
+    const double megabytes = text.size() / 1048576.0;
+
+    wprintf(L"%zu MB of W3C lines, %zu lines, best of 3 runs\n\n", sizeInMB, lines.size());
+    wprintf(L"                                              input MB/s   CPU us/line   output MB\n");
+
+    const auto report = [&](LPCWSTR Name, auto Measure)
+    {
+        double seconds = 1e30;
+        double cpuSeconds = 1e30;
+        UINT64 bytesWritten = 0;
+
+        for (int run = 0; run < 3; run++)
+        {
+            double runSeconds;
+            double runCpuSeconds;
+            Measure(runSeconds, runCpuSeconds, bytesWritten);
+
+            seconds = (std::min)(seconds, runSeconds);
+            cpuSeconds = (std::min)(cpuSeconds, runCpuSeconds);
+        }
+
+        wprintf(L"  %-44ls %10.0f   %11.3f   %9.0f\n",
+            Name,
+            megabytes / seconds,
+            cpuSeconds / lines.size() * 1e6,
+            bytesWritten / 1048576.0);
+    };
+
+    report(L"UTF-16 formatting, wprintf (before)", [&](double& Seconds, double& CpuSeconds, UINT64& Bytes)
+    {
+        MeasureWideStdout(lines, Seconds, CpuSeconds, Bytes);
+    });
+
+    report(L"UTF-16 formatting, OutputWriter", [&](double& Seconds, double& CpuSeconds, UINT64& Bytes)
+    {
+        MeasureOutputWriter(lines, [](OutputWriter& Writer, std::string_view Line)
+        {
+            Writer.Write(OutputSource::File, Utility::WStringToString(FormatUtf16(Line)), "\r\n");
+        }, Seconds, CpuSeconds, Bytes);
+    });
+
+    report(L"UTF-8 formatting, OutputWriter (now)", [&](double& Seconds, double& CpuSeconds, UINT64& Bytes)
+    {
+        std::string formattedLine;
+
+        MeasureOutputWriter(lines, [&](OutputWriter& Writer, std::string_view Line)
+        {
+            FormatUtf8(Line, fileNameUtf8, formattedLine);
+            Writer.Write(OutputSource::File, formattedLine, "\r\n");
+        }, Seconds, CpuSeconds, Bytes);
+    });
+
+    return 0;
+}
@@ -860,7 +860,7 @@ EtwMonitor::PrintEvent(
             formattedEvent = EtwJsonFormat(pLogEntry);
         }
 
-        logWriter.WriteConsoleLog(formattedEvent);
+        logWriter.WriteConsoleLog(formattedEvent, OutputSource::ETW);
     }
     catch(std::bad_alloc&)
     {
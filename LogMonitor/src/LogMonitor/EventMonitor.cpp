@@ -609,7 +609,7 @@ EventMonitor::PrintEvent(
                     );
                 }
 
-                logWriter.WriteConsoleLog(formattedEvent);
+                logWriter.WriteConsoleLog(formattedEvent, OutputSource::EventLog);
             }
         }
     }
@@ -0,0 +1,363 @@
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//
+
+#include "pch.h"  // NOLINT(build/include_subdir)
+#include "CheckpointStore.h"  // NOLINT(build/include_subdir)
+
+///
+/// \param FilePath     The checkpoint file. It's created by the first Flush.
+///
+CheckpointStore::CheckpointStore(
+    _In_ const std::wstring& FilePath
+    ) :
+    m_filePath(FilePath)
+{
+    InitializeSRWLock(&m_lock);
+}
+
+///
+/// Gets the key of the checkpoint of a file.
+///
+/// \param FileId       The id of the file. It's empty if the file system doesn't support file ids.
+/// \param FileName     The name of the file, relative to the monitored directory.
+///
+/// \return The key of the checkpoint.
+///
+std::wstring
+CheckpointStore::GetKey(
+    _In_ const FILE_ID_INFO& FileId,
+    _In_ const std::wstring& FileName
+    )
+{
+    const FILE_ID_INFO emptyFileId = {};
+
+    if (memcmp(&FileId, &emptyFileId, sizeof(FILE_ID_INFO)) == 0)
+    {
+        return L"name:" + FileName;
+    }
+
+    std::wstring key = Utility::FormatString(L"id:%016llx-", FileId.VolumeSerialNumber);
+
+    for (BYTE idByte : FileId.FileId.Identifier)
+    {
+        key += Utility::FormatString(L"%02x", idByte);
+    }
+
+    return key;
+}
+
+///
+/// Loads the checkpoints saved by a previous run. A missing checkpoint file
+/// isn't an error, and a corrupted one is ignored.
+///
+/// \return A DWORD representing the status.
+///
+DWORD
+CheckpointStore::Load()
+{
+    DWORD status = ERROR_SUCCESS;
+
+    HANDLE checkpointFile = CreateFileW(
+        m_filePath.c_str(),
+        GENERIC_READ,
+        FILE_SHARE_READ,
+        nullptr,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL,
+        nullptr);
+
+    if (checkpointFile == INVALID_HANDLE_VALUE)
+    {
+        status = GetLastError();
+
+        return (status == ERROR_FILE_NOT_FOUND || status == ERROR_PATH_NOT_FOUND) ? ERROR_SUCCESS : status;
+    }
+
+    std::string contents;
+    LARGE_INTEGER fileSize = {};
+
+    if (!GetFileSizeEx(checkpointFile, &fileSize))
+    {
+        status = GetLastError();
+    }
+    else if (fileSize.QuadPart > 0)
+    {
+        DWORD bytesRead = 0;
+
+        contents.resize(static_cast<size_t>(fileSize.QuadPart));
+
+        if (!ReadFile(checkpointFile, &contents[0], static_cast<DWORD>(contents.size()), &bytesRead, nullptr))
+        {
+            status = GetLastError();
+        }
+
+        contents.resize(bytesRead);
+    }
+
+    CloseHandle(checkpointFile);
+
+    if (status != ERROR_SUCCESS)
+    {
+        return status;
+    }
+
+    std::map<std::wstring, FileCheckpoint> checkpoints;
+
+    try
+    {
+        const nlohmann::json checkpointJson = nlohmann::json::parse(contents);
+
+        if (checkpointJson.at("version").get<int>() != CHECKPOINT_VERSION)
+        {
+            return ERROR_INVALID_DATA;
+        }
+
+        for (const auto& fileJson : checkpointJson.at("files"))
+        {
+            FileCheckpoint checkpoint;
+
+            checkpoint.FileName = Utility::StringToWString(fileJson.at("fileName").get<std::string>());
+            checkpoint.Offset = fileJson.at("offset").get<UINT64>();
+            checkpoint.EncodingType = static_cast<LM_FILETYPE>(fileJson.at("encoding").get<int>());
+
+            //
+            // The fingerprint is optional, checkpoints saved without it are
+            // resumed without the check.
+            //
+            checkpoint.FingerprintSize = fileJson.value("fingerprintSize", static_cast<DWORD>(0));
+            checkpoint.Fingerprint = fileJson.value("fingerprint", static_cast<UINT64>(0));
+
+            checkpoints[Utility::StringToWString(fileJson.at("key").get<std::string>())] = std::move(checkpoint);
+        }
+    }
+    catch (const std::exception&)
+    {
+        return ERROR_INVALID_DATA;
+    }
+
+    AcquireSRWLockExclusive(&m_lock);
+    m_checkpoints = std::move(checkpoints);
+    m_isDirty = false;
+    ReleaseSRWLockExclusive(&m_lock);
+
+    return ERROR_SUCCESS;
+}
+
+///
+/// \param Key          The key of the checkpoint, from GetKey.
+/// \param Checkpoint   Receives the checkpoint.
+///
+/// \return true if there's a checkpoint with the key.
+///
+bool
+CheckpointStore::Find(
+    _In_ const std::wstring& Key,
+    _Out_ FileCheckpoint& Checkpoint
+    )
+{
+    bool found = false;
+
+    AcquireSRWLockShared(&m_lock);
+
+    auto it = m_checkpoints.find(Key);
+
+    if (it != m_checkpoints.end())
+    {
+        Checkpoint = it->second;
+        found = true;
+    }
+
+    ReleaseSRWLockShared(&m_lock);
+
+    return found;
+}
+
+///
+/// Sets the checkpoint of a file. It's saved by the next Flush.
+///
+/// \param Key          The key of the checkpoint, from GetKey.
+/// \param Checkpoint   The read position of the file.
+///
+void
+CheckpointStore::Update(
+    _In_ const std::wstring& Key,
+    _In_ const FileCheckpoint& Checkpoint
+    )
+{
+    AcquireSRWLockExclusive(&m_lock);
+
+    m_checkpoints[Key] = Checkpoint;
+    m_isDirty = true;
+
+    ReleaseSRWLockExclusive(&m_lock);
+}
+
+///
+/// Removes the checkpoint of a file that is no longer monitored.
+///
+/// \param Key          The key of the checkpoint, from GetKey.
+///
+void
+CheckpointStore::Remove(
+    _In_ const std::wstring& Key
+    )
+{
+    AcquireSRWLockExclusive(&m_lock);
+
+    if (m_checkpoints.erase(Key) > 0)
+    {
+        m_isDirty = true;
+    }
+
+    ReleaseSRWLockExclusive(&m_lock);
+}
+
+///
+/// Removes the checkpoints of the files that no longer exist.
+///
+/// \param Keys         The keys of the checkpoints to keep.
+///
+void
+CheckpointStore::Prune(
+    _In_ const std::set<std::wstring>& Keys
+    )
+{
+    AcquireSRWLockExclusive(&m_lock);
+
+    for (auto it = m_checkpoints.begin(); it != m_checkpoints.end();)
+    {
+        if (Keys.find(it->first) == Keys.end())
+        {
+            it = m_checkpoints.erase(it);
+            m_isDirty = true;
+        }
+        else
+        {
+            it++;
+        }
+    }
+
+    ReleaseSRWLockExclusive(&m_lock);
+}
+
+///
+/// Writes the checkpoints to the checkpoint file, if any changed since the
+/// last Flush. It must not be called concurrently.
+///
+/// \return A DWORD representing the status.
+///
+DWORD
+CheckpointStore::Flush()
+{
+    nlohmann::json filesJson = nlohmann::json::array();
+
+    AcquireSRWLockExclusive(&m_lock);
+
+    if (!m_isDirty)
+    {
+        ReleaseSRWLockExclusive(&m_lock);
+        return ERROR_SUCCESS;
+    }
+
+    for (const auto& checkpoint : m_checkpoints)
+    {
+        filesJson.push_back({
+            { "key", Utility::WStringToString(checkpoint.first) },
+            { "fileName", Utility::WStringToString(checkpoint.second.FileName) },
+            { "offset", checkpoint.second.Offset },
+            { "encoding", static_cast<int>(checkpoint.second.EncodingType) },
+            { "fingerprintSize", checkpoint.second.FingerprintSize },
+            { "fingerprint", checkpoint.second.Fingerprint }
+        });
+    }
+
+    m_isDirty = false;
+
+    ReleaseSRWLockExclusive(&m_lock);
+
+    const nlohmann::json checkpointJson = {
+        { "version", CHECKPOINT_VERSION },
+        { "files", std::move(filesJson) }
+    };
+
+    DWORD status = WriteCheckpointFile(checkpointJson.dump());
+
+    if (status != ERROR_SUCCESS)
+    {
+        //
+        // Try again in the next Flush.
+        //
+        AcquireSRWLockExclusive(&m_lock);
+        m_isDirty = true;
+        ReleaseSRWLockExclusive(&m_lock);
+
+        logWriter.TraceError(
+            Utility::FormatString(
+                L"Failed to write log file checkpoint %ws. Error: %lu",
+                m_filePath.c_str(),
+                status
+            ).c_str()
+        );
+    }
+
+    return status;
+}
+
+///
+/// Replaces the checkpoint file. The contents are written and flushed to a
+/// temporary file, which is then moved over the checkpoint file.
+///
+/// \param Contents     The new contents of the checkpoint file.
+///
+/// \return A DWORD representing the status.
+///
+DWORD
+CheckpointStore::WriteCheckpointFile(
+    _In_ const std::string& Contents
+    )
+{
+    DWORD status = ERROR_SUCCESS;
+    const std::wstring tempFilePath = m_filePath + L".tmp";
+
+    HANDLE tempFile = CreateFileW(
+        tempFilePath.c_str(),
+        GENERIC_WRITE,
+        0,
+        nullptr,
+        CREATE_ALWAYS,
+        FILE_ATTRIBUTE_NORMAL,
+        nullptr);
+
+    if (tempFile == INVALID_HANDLE_VALUE)
+    {
+        return GetLastError();
+    }
+
+    DWORD bytesWritten = 0;
+
+    if (!WriteFile(tempFile, Contents.data(), static_cast<DWORD>(Contents.size()), &bytesWritten, nullptr))
+    {
+        status = GetLastError();
+    }
+    else if (!FlushFileBuffers(tempFile))
+    {
+        status = GetLastError();
+    }
+
+    CloseHandle(tempFile);
+
+    if (status == ERROR_SUCCESS &&
+        !MoveFileExW(tempFilePath.c_str(), m_filePath.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+    {
+        status = GetLastError();
+    }
+
+    if (status != ERROR_SUCCESS)
+    {
+        DeleteFileW(tempFilePath.c_str());
+    }
+
+    return status;
+}
@@ -0,0 +1,94 @@
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//
+
+#pragma once
+
+#include <map>
+#include <set>
+#include <string>
+
+///
+/// Read position of a log file saved in a checkpoint.
+///
+struct FileCheckpoint
+{
+    std::wstring FileName;
+    UINT64 Offset = 0;
+    LM_FILETYPE EncodingType = LM_FILETYPE::FileTypeUnknown;
+
+    //
+    // Hash of the first FingerprintSize bytes of the file, used to check
+    // that the file wasn't rewritten while the tool wasn't running. A size
+    // of 0 means there's no fingerprint.
+    //
+    DWORD FingerprintSize = 0;
+    UINT64 Fingerprint = 0;
+};
+
+///
+/// Saves the read offsets of the log files of a directory to a file, so a
+/// restart resumes each file where the previous run stopped, instead of
+/// skipping the lines written while it was down or reading the files again.
+///
+/// Files are identified by their FILE_ID_INFO, so a file renamed while the
+/// tool wasn't running is still resumed. The file name is only used when the
+/// file system doesn't provide file ids.
+///
+/// Updates are kept in memory and written by Flush, which the caller invokes
+/// periodically. The file is replaced atomically: the checkpoint is written to
+/// a temporary file that is then moved over the previous one, so a crash never
+/// leaves a truncated checkpoint.
+///
+class CheckpointStore final
+{
+ public:
+    CheckpointStore() = delete;
+
+    explicit CheckpointStore(
+        _In_ const std::wstring& FilePath);
+
+    CheckpointStore(const CheckpointStore&) = delete;
+    CheckpointStore& operator=(const CheckpointStore&) = delete;
+
+    static std::wstring GetKey(
+        _In_ const FILE_ID_INFO& FileId,
+        _In_ const std::wstring& FileName);
+
+    DWORD Load();
+
+    bool Find(
+        _In_ const std::wstring& Key,
+        _Out_ FileCheckpoint& Checkpoint);
+
+    void Update(
+        _In_ const std::wstring& Key,
+        _In_ const FileCheckpoint& Checkpoint);
+
+    void Remove(
+        _In_ const std::wstring& Key);
+
+    void Prune(
+        _In_ const std::set<std::wstring>& Keys);
+
+    DWORD Flush();
+
+ private:
+    static constexpr int CHECKPOINT_VERSION = 1;
+
+    std::wstring m_filePath;
+
+    //
+    // Guards m_checkpoints and m_isDirty. Flush holds it only to copy the
+    // checkpoints, so the readers aren't blocked while the file is written.
+    //
+    SRWLOCK m_lock;
+
+    std::map<std::wstring, FileCheckpoint> m_checkpoints;
+
+    bool m_isDirty = false;
+
+    DWORD WriteCheckpointFile(
+        _In_ const std::string& Contents);
+};
@@ -0,0 +1,162 @@
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//
+
+#include "pch.h"  // NOLINT(build/include_subdir)
+#include "DirChangeEventBatch.h"  // NOLINT(build/include_subdir)
+
+///
+/// Adds an event at the end of the batch, or coalesces it with the pending
+/// Modify event of the same file.
+///
+/// \param Action       The change.
+/// \param FileName     The relative path of the changed file.
+/// \param Timestamp    When the change was notified.
+///
+/// \return false if the event was coalesced.
+///
+bool
+DirChangeEventBatch::Add(
+    _In_ EventAction Action,
+    _In_ std::wstring_view FileName,
+    _In_ UINT64 Timestamp
+    )
+{
+    const size_t hash = HashFileName(FileName);
+
+    if (Action == EventAction::Modify)
+    {
+        auto it = m_pendingModifies.find(hash);
+
+        if (it != m_pendingModifies.end() && IsFileNameOf(m_events[it->second], FileName))
+        {
+            //
+            // Keep the latest timestamp, so the event isn't skipped as older
+            // than a read that happened before the last modification.
+            //
+            m_events[it->second].Timestamp = Timestamp;
+
+            return false;
+        }
+
+        m_pendingModifies[hash] = m_events.size();
+    }
+    else if (Action == EventAction::ReInit)
+    {
+        m_pendingModifies.clear();
+    }
+    else
+    {
+        m_pendingModifies.erase(hash);
+    }
+
+    m_events.push_back({ Action, Timestamp, m_fileNames.size(), FileName.size() });
+    m_fileNames.append(FileName);
+
+    return true;
+}
+
+///
+/// Adds the events of another batch at the end of this one, coalescing its
+/// Modify events with the pending ones of this batch.
+///
+/// \param Other    The batch to copy the events from.
+///
+void
+DirChangeEventBatch::Append(
+    _In_ const DirChangeEventBatch& Other
+    )
+{
+    for (const Entry& entry : Other.m_events)
+    {
+        Add(
+            entry.Action,
+            std::wstring_view(Other.m_fileNames).substr(entry.FileNameOffset, entry.FileNameLength),
+            entry.Timestamp);
+    }
+}
+
+///
+/// Gets an event of the batch. The file name is assigned to the one of Event,
+/// so its buffer is reused when Event is reused for all the events.
+///
+/// \param Index    The position of the event in the batch.
+/// \param Event    Receives the event.
+///
+void
+DirChangeEventBatch::Get(
+    _In_ size_t Index,
+    _Out_ DirChangeNotificationEvent& Event
+    ) const
+{
+    const Entry& entry = m_events[Index];
+
+    Event.Action = entry.Action;
+    Event.Timestamp = entry.Timestamp;
+    Event.FileName.assign(m_fileNames, entry.FileNameOffset, entry.FileNameLength);
+}
+
+void
+DirChangeEventBatch::Swap(
+    _Inout_ DirChangeEventBatch& Other
+    ) noexcept
+{
+    m_events.swap(Other.m_events);
+    m_fileNames.swap(Other.m_fileNames);
+    m_pendingModifies.swap(Other.m_pendingModifies);
+}
+
+///
+/// Removes all the events, keeping the memory for the next ones.
+///
+void
+DirChangeEventBatch::Clear()
+{
+    m_events.clear();
+    m_fileNames.clear();
+    m_pendingModifies.clear();
+}
+
+bool
+DirChangeEventBatch::IsFileNameOf(
+    _In_ const Entry& Event,
+    _In_ std::wstring_view FileName
+    ) const
+{
+    if (Event.FileNameLength != FileName.size())
+    {
+        return false;
+    }
+
+    return CompareStringOrdinal(
+        m_fileNames.data() + Event.FileNameOffset,
+        static_cast<int>(Event.FileNameLength),
+        FileName.data(),
+        static_cast<int>(FileName.size()),
+        TRUE) == CSTR_EQUAL;
+}
+
+///
+/// Hashes a file name as FNV-1a, ignoring the case of ASCII letters.
+///
+size_t
+DirChangeEventBatch::HashFileName(
+    _In_ std::wstring_view FileName
+    )
+{
+    UINT64 hash = 14695981039346656037ULL;
+
+    for (wchar_t ch : FileName)
+    {
+        if (ch >= L'a' && ch <= L'z')
+        {
+            ch = ch - L'a' + L'A';
+        }
+
+        hash ^= static_cast<UINT64>(ch);
+        hash *= 1099511628211ULL;
+    }
+
+    return static_cast<size_t>(hash);
+}
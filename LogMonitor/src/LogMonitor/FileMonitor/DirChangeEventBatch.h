@@ -0,0 +1,105 @@
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+enum class EventAction
+{
+    Add = 0,
+    Modify = 1,
+    Remove = 2,
+    RenameOld = 3,
+    RenameNew = 4,
+    ReInit = 5,
+    Unknown = 5,
+};
+
+struct DirChangeNotificationEvent
+{
+    std::wstring FileName;
+    EventAction Action;
+    UINT64 Timestamp;
+};
+
+///
+/// Batch of directory change events, passed from the thread receiving the
+/// change notifications to the thread handling them.
+///
+/// The file names of all the events are stored back to back in a single
+/// buffer, so adding an event doesn't allocate once the batch has grown to
+/// the size of the bursts of the directory. Batches are swapped between the
+/// producer and the consumer instead of being copied, and keep their capacity
+/// when cleared, so a burst of changes costs a single lock acquisition on each
+/// side instead of two per event.
+///
+/// Modify events of a file already modified in the batch are coalesced: a
+/// single read gets all the bytes written by the burst. A Modify event is only
+/// coalesced with the previous one if no other event of the file came between
+/// them, so adds, removes and renames keep their order.
+///
+class DirChangeEventBatch final
+{
+ public:
+    bool Add(
+        _In_ EventAction Action,
+        _In_ std::wstring_view FileName,
+        _In_ UINT64 Timestamp);
+
+    void Append(
+        _In_ const DirChangeEventBatch& Other);
+
+    void Get(
+        _In_ size_t Index,
+        _Out_ DirChangeNotificationEvent& Event) const;
+
+    void Swap(
+        _Inout_ DirChangeEventBatch& Other) noexcept;
+
+    void Clear();
+
+    size_t Size() const
+    {
+        return m_events.size();
+    }
+
+    bool Empty() const
+    {
+        return m_events.empty();
+    }
+
+ private:
+    struct Entry
+    {
+        EventAction Action;
+        UINT64 Timestamp;
+        size_t FileNameOffset;
+        size_t FileNameLength;
+    };
+
+    std::vector<Entry> m_events;
+
+    //
+    // File names of all the events, back to back.
+    //
+    std::wstring m_fileNames;
+
+    //
+    // Position of the last Modify event of each file, by hash of the file
+    // name, while no other event of the file followed it.
+    //
+    std::unordered_map<size_t, size_t> m_pendingModifies;
+
+    bool IsFileNameOf(
+        _In_ const Entry& Event,
+        _In_ std::wstring_view FileName) const;
+
+    static size_t HashFileName(
+        _In_ std::wstring_view FileName);
+};
@@ -0,0 +1,116 @@
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//
+
+#include "pch.h"  // NOLINT(build/include_subdir)
+#include "DirectoryEnumerator.h"  // NOLINT(build/include_subdir)
+
+///
+/// \param Directory            The directory to list.
+/// \param IncludeSubfolders    true to list the subdirectories too.
+///
+DirectoryEnumerator::DirectoryEnumerator(
+    _In_ const std::wstring& Directory,
+    _In_ bool IncludeSubfolders
+    ) :
+    m_rootDirectory(Directory),
+    m_includeSubfolders(IncludeSubfolders)
+{
+    m_pendingDirectories.push_back(Directory);
+}
+
+DirectoryEnumerator::~DirectoryEnumerator()
+{
+    if (m_findHandle != INVALID_HANDLE_VALUE)
+    {
+        FindClose(m_findHandle);
+    }
+}
+
+///
+/// Gets the next file of the listing.
+///
+/// \param FilePath     Receives the full path of the file.
+/// \param FindData     Receives the directory entry of the file.
+///
+/// \return false when there are no more files, or the listing failed. Use
+///         GetStatus to tell them apart.
+///
+bool
+DirectoryEnumerator::Next(
+    _Out_ std::wstring& FilePath,
+    _Out_ WIN32_FIND_DATAW& FindData
+    )
+{
+    while (m_status == ERROR_SUCCESS)
+    {
+        if (m_findHandle == INVALID_HANDLE_VALUE)
+        {
+            if (m_pendingDirectories.empty())
+            {
+                return false;
+            }
+
+            m_currentDirectory = std::move(m_pendingDirectories.back());
+            m_pendingDirectories.pop_back();
+
+            const std::wstring toSearch = m_currentDirectory + L"\\*";
+
+            m_findHandle = FindFirstFileExW(
+                toSearch.c_str(),
+                FindExInfoBasic,
+                &FindData,
+                FindExSearchNameMatch,
+                nullptr,
+                FIND_FIRST_EX_LARGE_FETCH);
+
+            if (m_findHandle == INVALID_HANDLE_VALUE)
+            {
+                const DWORD error = GetLastError();
+
+                //
+                // A subdirectory removed after it was listed is just skipped,
+                // its files were removed too.
+                //
+                if (m_currentDirectory == m_rootDirectory ||
+                    (error != ERROR_FILE_NOT_FOUND && error != ERROR_PATH_NOT_FOUND))
+                {
+                    m_status = error;
+                }
+
+                continue;
+            }
+        }
+        else if (!FindNextFileW(m_findHandle, &FindData))
+        {
+            const DWORD error = GetLastError();
+
+            FindClose(m_findHandle);
+            m_findHandle = INVALID_HANDLE_VALUE;
+
+            if (error != ERROR_NO_MORE_FILES)
+            {
+                m_status = error;
+            }
+
+            continue;
+        }
+
+        if (FindData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+        {
+            if (m_includeSubfolders && FindData.cFileName[0] != L'.')
+            {
+                m_pendingDirectories.push_back(m_currentDirectory + L"\\" + FindData.cFileName);
+            }
+
+            continue;
+        }
+
+        FilePath = m_currentDirectory + L"\\" + FindData.cFileName;
+
+        return true;
+    }
+
+    return false;
+}
@@ -0,0 +1,59 @@
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+///
+/// Lists the files of a directory, and optionally of its subdirectories, one
+/// file at a time, so a large tree can be listed in steps without keeping the
+/// whole listing in memory. Subdirectories whose name starts with a dot are
+/// skipped.
+///
+/// The size and last write time of each file come from the directory entry,
+/// so no file is opened.
+///
+class DirectoryEnumerator final
+{
+ public:
+    DirectoryEnumerator() = delete;
+
+    DirectoryEnumerator(
+        _In_ const std::wstring& Directory,
+        _In_ bool IncludeSubfolders);
+
+    ~DirectoryEnumerator();
+
+    DirectoryEnumerator(const DirectoryEnumerator&) = delete;
+    DirectoryEnumerator& operator=(const DirectoryEnumerator&) = delete;
+
+    bool Next(
+        _Out_ std::wstring& FilePath,
+        _Out_ WIN32_FIND_DATAW& FindData);
+
+    ///
+    /// \return The error that stopped the listing, or ERROR_SUCCESS if all
+    ///         the directories were listed.
+    ///
+    DWORD GetStatus() const
+    {
+        return m_status;
+    }
+
+ private:
+    std::wstring m_rootDirectory;
+
+    bool m_includeSubfolders;
+
+    std::vector<std::wstring> m_pendingDirectories;
+
+    std::wstring m_currentDirectory;
+
+    HANDLE m_findHandle = INVALID_HANDLE_VALUE;
+
+    DWORD m_status = ERROR_SUCCESS;
+};
@@ -0,0 +1,674 @@
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//
+
+#include "pch.h"  // NOLINT(build/include_subdir)
+#include "DirectoryWatchEngine.h"  // NOLINT(build/include_subdir)
+
+SRWLOCK DirectoryWatchEngine::s_sharedEngineLock = SRWLOCK_INIT;
+std::weak_ptr<DirectoryWatchEngine> DirectoryWatchEngine::s_sharedEngine;
+
+///
+/// Gets the engine shared by the File sources, and creates it if no source
+/// uses it. It has a worker per processor, up to DEFAULT_MAX_WORKER_COUNT.
+///
+/// \return The shared engine.
+///
+std::shared_ptr<DirectoryWatchEngine>
+DirectoryWatchEngine::Acquire()
+{
+    AcquireSRWLockExclusive(&s_sharedEngineLock);
+
+    std::shared_ptr<DirectoryWatchEngine> engine = s_sharedEngine.lock();
+
+    if (!engine)
+    {
+        try
+        {
+            DWORD workerCount = GetActiveProcessorCount(ALL_PROCESSOR_GROUPS);
+
+            if (workerCount > DEFAULT_MAX_WORKER_COUNT)
+            {
+                workerCount = DEFAULT_MAX_WORKER_COUNT;
+            }
+
+            engine = std::make_shared<DirectoryWatchEngine>(workerCount);
+            s_sharedEngine = engine;
+        }
+        catch (...)
+        {
+            ReleaseSRWLockExclusive(&s_sharedEngineLock);
+            throw;
+        }
+    }
+
+    ReleaseSRWLockExclusive(&s_sharedEngineLock);
+
+    return engine;
+}
+
+///
+/// Creates the completion port, the worker threads and the timer thread of
+/// the engine, and its reader pool.
+///
+/// \param WorkerCount      Number of worker threads. It's limited to MAX_WORKER_COUNT.
+///
+DirectoryWatchEngine::DirectoryWatchEngine(
+    _In_ DWORD WorkerCount
+    )
+{
+    InitializeSRWLock(&m_lock);
+    InitializeConditionVariable(&m_timerChanged);
+    InitializeConditionVariable(&m_sourceIdle);
+
+    if (WorkerCount == 0)
+    {
+        WorkerCount = 1;
+    }
+    else if (WorkerCount > MAX_WORKER_COUNT)
+    {
+        WorkerCount = MAX_WORKER_COUNT;
+    }
+
+    m_readerPool = std::make_unique<LogFileReaderPool>();
+
+    m_completionPort = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, WorkerCount);
+    if (!m_completionPort)
+    {
+        throw std::system_error(std::error_code(GetLastError(), std::system_category()), "CreateIoCompletionPort");
+    }
+
+    for (DWORD i = 0; i < WorkerCount; i++)
+    {
+        HANDLE workerThread = CreateThread(
+            nullptr,
+            0,
+            (LPTHREAD_START_ROUTINE)&DirectoryWatchEngine::WorkerStatic,
+            this,
+            0,
+            nullptr);
+        if (!workerThread)
+        {
+            DWORD status = GetLastError();
+
+            Stop();
+            throw std::system_error(std::error_code(status, std::system_category()), "CreateThread");
+        }
+
+        m_workerThreads.push_back(workerThread);
+    }
+
+    m_timerThread = CreateThread(
+        nullptr,
+        0,
+        (LPTHREAD_START_ROUTINE)&DirectoryWatchEngine::TimerThreadStatic,
+        this,
+        0,
+        nullptr);
+    if (!m_timerThread)
+    {
+        DWORD status = GetLastError();
+
+        Stop();
+        throw std::system_error(std::error_code(status, std::system_category()), "CreateThread");
+    }
+}
+
+DirectoryWatchEngine::~DirectoryWatchEngine()
+{
+    Stop();
+}
+
+///
+/// Registers a source in the engine. Its work isn't run until it's signaled,
+/// or its timer is armed.
+///
+/// \param Owner        The callbacks of the source. They must stay valid until
+///                     the source is unregistered.
+///
+/// \return The registration of the source.
+///
+std::shared_ptr<DirectoryWatchEngine::Registration>
+DirectoryWatchEngine::Register(
+    _In_ Client* Owner
+    )
+{
+    auto source = std::make_shared<Registration>();
+    source->Owner = Owner;
+
+    return source;
+}
+
+///
+/// Associates the directory handle of a source with the completion port, so
+/// its reads complete in the workers of the engine.
+///
+/// \param Source           The source.
+/// \param DirectoryHandle  The directory handle, opened with FILE_FLAG_OVERLAPPED.
+///
+/// \return A DWORD representing the status.
+///
+DWORD
+DirectoryWatchEngine::AssociateDirectory(
+    _In_ const std::shared_ptr<Registration>& Source,
+    _In_ HANDLE DirectoryHandle
+    )
+{
+    if (!CreateIoCompletionPort(DirectoryHandle, m_completionPort, reinterpret_cast<ULONG_PTR>(Source.get()), 0))
+    {
+        return GetLastError();
+    }
+
+    AcquireSRWLockExclusive(&m_lock);
+    Source->DirectoryHandle = DirectoryHandle;
+    ReleaseSRWLockExclusive(&m_lock);
+
+    return ERROR_SUCCESS;
+}
+
+///
+/// Accounts a directory read that is about to be issued, so the source isn't
+/// released while it's pending.
+///
+/// \param Source       The source.
+///
+/// \return false if the source is stopping, and the read must not be issued.
+///
+bool
+DirectoryWatchEngine::BeginDirectoryRead(
+    _In_ const std::shared_ptr<Registration>& Source
+    )
+{
+    bool canRead = false;
+
+    AcquireSRWLockExclusive(&m_lock);
+
+    if (!Source->IsStopping)
+    {
+        Source->PendingReads++;
+        canRead = true;
+    }
+
+    ReleaseSRWLockExclusive(&m_lock);
+
+    return canRead;
+}
+
+///
+/// Accounts a directory read that failed to be issued, after BeginDirectoryRead.
+///
+/// \param Source       The source.
+///
+void
+DirectoryWatchEngine::AbortDirectoryRead(
+    _In_ const std::shared_ptr<Registration>& Source
+    )
+{
+    AcquireSRWLockExclusive(&m_lock);
+
+    Source->PendingReads--;
+
+    if (Source->IsStopping)
+    {
+        WakeAllConditionVariable(&m_sourceIdle);
+    }
+
+    ReleaseSRWLockExclusive(&m_lock);
+}
+
+///
+/// Requests the work of a source to run in a worker.
+///
+/// \param Source       The source.
+///
+void
+DirectoryWatchEngine::Signal(
+    _In_ const std::shared_ptr<Registration>& Source
+    )
+{
+    AcquireSRWLockExclusive(&m_lock);
+
+    QueueWork(Source.get());
+
+    ReleaseSRWLockExclusive(&m_lock);
+}
+
+///
+/// Arms the timer of a source. Its work runs when the timer is due, unless
+/// the timer was armed again meanwhile.
+///
+/// \param Source           The source.
+/// \param DueTimestamp     When the work is due, as a GetTickCount64 value.
+///
+void
+DirectoryWatchEngine::SetTimer(
+    _In_ const std::shared_ptr<Registration>& Source,
+    _In_ UINT64 DueTimestamp
+    )
+{
+    if (DueTimestamp == 0)
+    {
+        DueTimestamp = 1;
+    }
+
+    AcquireSRWLockExclusive(&m_lock);
+
+    if (!Source->IsStopping && Source->TimerDueTimestamp != DueTimestamp)
+    {
+        Source->TimerDueTimestamp = DueTimestamp;
+
+        if (m_timers.empty() || DueTimestamp < m_timers.top().DueTimestamp)
+        {
+            WakeConditionVariable(&m_timerChanged);
+        }
+
+        m_timers.push({ DueTimestamp, Source });
+    }
+
+    ReleaseSRWLockExclusive(&m_lock);
+}
+
+///
+/// Unregisters a source. Its timer is disarmed, its pending directory read is
+/// cancelled, and its work is waited to finish. The state of the source is
+/// used by the workers until then, so it waits until the cancelled read is
+/// dequeued, however long it takes; a wait longer than
+/// UNREGISTER_WARNING_WAIT_MILLIS is traced. It must not be called from the
+/// work of the source.
+///
+/// \param Source       The source.
+///
+void
+DirectoryWatchEngine::Unregister(
+    _In_ const std::shared_ptr<Registration>& Source
+    )
+{
+    const UINT64 startTimestamp = GetTickCount64();
+    bool isWaitTraced = false;
+
+    AcquireSRWLockExclusive(&m_lock);
+
+    Source->IsStopping = true;
+    Source->TimerDueTimestamp = 0;
+
+    while (Source->PendingReads > 0 || Source->IsWorkQueued || Source->IsWorkRunning)
+    {
+        if (!isWaitTraced && GetTickCount64() - startTimestamp >= UNREGISTER_WARNING_WAIT_MILLIS)
+        {
+            logWriter.TraceWarning(L"Still waiting for a log directory watch to stop.");
+            isWaitTraced = true;
+        }
+
+        //
+        // Cancel the reads again at every step, as a read could have been
+        // issued after the first cancellation.
+        //
+        if (Source->PendingReads > 0 && Source->DirectoryHandle != INVALID_HANDLE_VALUE)
+        {
+            CancelIoEx(Source->DirectoryHandle, nullptr);
+        }
+
+        SleepConditionVariableSRW(&m_sourceIdle, &m_lock, UNREGISTER_CANCEL_INTERVAL_MILLIS, 0);
+    }
+
+    ReleaseSRWLockExclusive(&m_lock);
+}
+
+///
+/// \return The pool reading the log files of the sources.
+///
+LogFileReaderPool&
+DirectoryWatchEngine::GetReaderPool()
+{
+    return *m_readerPool;
+}
+
+///
+/// Queues the work of a source, unless it's already queued. If it's running,
+/// it's queued again once it finishes. Must be called with m_lock held.
+///
+/// \param Source       The source.
+///
+void
+DirectoryWatchEngine::QueueWork(
+    _In_ Registration* Source
+    )
+{
+    if (Source->IsStopping || Source->IsWorkQueued)
+    {
+        return;
+    }
+
+    if (Source->IsWorkRunning)
+    {
+        Source->IsWorkRequested = true;
+        return;
+    }
+
+    if (!PostQueuedCompletionStatus(m_completionPort, 0, reinterpret_cast<ULONG_PTR>(Source), nullptr))
+    {
+        logWriter.TraceError(
+            Utility::FormatString(
+                L"Failed to queue the handling of log directory changes. Error: %lu",
+                GetLastError()
+            ).c_str()
+        );
+        return;
+    }
+
+    Source->IsWorkQueued = true;
+}
+
+///
+/// Runs the queued work of a source.
+///
+/// \param Source       The source.
+///
+void
+DirectoryWatchEngine::RunWork(
+    _In_ Registration* Source
+    )
+{
+    AcquireSRWLockExclusive(&m_lock);
+
+    Source->IsWorkQueued = false;
+
+    if (Source->IsStopping)
+    {
+        WakeAllConditionVariable(&m_sourceIdle);
+        ReleaseSRWLockExclusive(&m_lock);
+        return;
+    }
+
+    Source->IsWorkRunning = true;
+    Source->IsWorkRequested = false;
+
+    ReleaseSRWLockExclusive(&m_lock);
+
+    try
+    {
+        Source->Owner->OnWork();
+    }
+    catch (std::exception& ex)
+    {
+        logWriter.TraceError(
+            Utility::FormatString(L"Error in log file monitor. Failed to handle log directory changes. %S",
+                ex.what()).c_str()
+        );
+    }
+    catch (...)
+    {
+        logWriter.TraceError(L"Error in log file monitor. Failed to handle log directory changes.");
+    }
+
+    AcquireSRWLockExclusive(&m_lock);
+
+    Source->IsWorkRunning = false;
+
+    if (Source->IsStopping)
+    {
+        WakeAllConditionVariable(&m_sourceIdle);
+    }
+    else if (Source->IsWorkRequested)
+    {
+        Source->IsWorkRequested = false;
+        QueueWork(Source);
+    }
+
+    ReleaseSRWLockExclusive(&m_lock);
+}
+
+///
+/// Stops the timer thread, the workers and the reader pool, and closes the
+/// completion port. The sources must be unregistered.
+///
+void
+DirectoryWatchEngine::Stop()
+{
+    AcquireSRWLockExclusive(&m_lock);
+    m_stopping = true;
+    WakeAllConditionVariable(&m_timerChanged);
+    ReleaseSRWLockExclusive(&m_lock);
+
+    if (m_timerThread)
+    {
+        WaitForThreads({ m_timerThread });
+
+        CloseHandle(m_timerThread);
+        m_timerThread = NULL;
+    }
+
+    //
+    // A packet without key or overlapped stops a worker.
+    //
+    for (size_t i = 0; i < m_workerThreads.size(); i++)
+    {
+        PostQueuedCompletionStatus(m_completionPort, 0, 0, nullptr);
+    }
+
+    if (!m_workerThreads.empty())
+    {
+        WaitForThreads(m_workerThreads);
+
+        for (HANDLE workerThread : m_workerThreads)
+        {
+            CloseHandle(workerThread);
+        }
+
+        m_workerThreads.clear();
+    }
+
+    if (m_completionPort)
+    {
+        CloseHandle(m_completionPort);
+        m_completionPort = NULL;
+    }
+
+    if (m_readerPool)
+    {
+        m_readerPool->Stop();
+    }
+}
+
+///
+/// Waits for threads of the engine to exit. They use the engine, so it isn't
+/// released until they exit; a wait longer than THREAD_EXIT_MAX_WAIT_MILLIS
+/// is traced.
+///
+/// \param Threads      The threads.
+///
+void
+DirectoryWatchEngine::WaitForThreads(
+    _In_ const std::vector<HANDLE>& Threads
+    )
+{
+    DWORD waitResult = WaitForMultipleObjects(
+        static_cast<DWORD>(Threads.size()),
+        Threads.data(),
+        TRUE,
+        THREAD_EXIT_MAX_WAIT_MILLIS);
+
+    if (waitResult == WAIT_TIMEOUT)
+    {
+        logWriter.TraceWarning(L"Still waiting for the log directory watch threads to stop.");
+
+        waitResult = WaitForMultipleObjects(
+            static_cast<DWORD>(Threads.size()),
+            Threads.data(),
+            TRUE,
+            INFINITE);
+    }
+
+    if (waitResult == WAIT_FAILED)
+    {
+        logWriter.TraceError(
+            Utility::FormatString(
+                L"Failed to wait for log directory watch threads to stop. Error: %lu",
+                GetLastError()
+            ).c_str()
+        );
+    }
+}
+
+DWORD
+DirectoryWatchEngine::WorkerStatic(
+    _In_ LPVOID Context
+    )
+{
+    auto pThis = reinterpret_cast<DirectoryWatchEngine*>(Context);
+
+    pThis->Worker();
+
+    return ERROR_SUCCESS;
+}
+
+///
+/// Worker thread routine. Dispatches the completed directory reads and the
+/// queued work of the sources until a stop packet is dequeued.
+///
+void
+DirectoryWatchEngine::Worker()
+{
+    bool isWaitFailing = false;
+
+    while (true)
+    {
+        DWORD bytesTransferred = 0;
+        ULONG_PTR key = 0;
+        LPOVERLAPPED overlapped = nullptr;
+
+        DWORD status = ERROR_SUCCESS;
+
+        if (!GetQueuedCompletionStatus(m_completionPort, &bytesTransferred, &key, &overlapped, INFINITE))
+        {
+            status = GetLastError();
+
+            if (overlapped == nullptr)
+            {
+                //
+                // Nothing was dequeued. The port is only closed once the
+                // workers exited, so the worker keeps serving it: the other
+                // workers can't take over the completions of all the sources.
+                // Only the first failure of a series is traced.
+                //
+                if (!isWaitFailing)
+                {
+                    logWriter.TraceError(
+                        Utility::FormatString(
+                            L"Failed to wait for log directory changes. Error: %lu",
+                            status
+                        ).c_str()
+                    );
+                    isWaitFailing = true;
+                }
+
+                Sleep(WORKER_RETRY_INTERVAL_MILLIS);
+                continue;
+            }
+        }
+
+        isWaitFailing = false;
+
+        if (key == 0)
+        {
+            break;
+        }
+
+        auto source = reinterpret_cast<Registration*>(key);
+
+        if (overlapped == nullptr)
+        {
+            RunWork(source);
+            continue;
+        }
+
+        try
+        {
+            source->Owner->OnDirectoryChangesCompleted(status, bytesTransferred);
+        }
+        catch (std::exception& ex)
+        {
+            logWriter.TraceError(
+                Utility::FormatString(L"Error in log file monitor. Failed to read log directory changes. %S",
+                    ex.what()).c_str()
+            );
+        }
+        catch (...)
+        {
+            logWriter.TraceError(L"Error in log file monitor. Failed to read log directory changes.");
+        }
+
+        AcquireSRWLockExclusive(&m_lock);
+
+        source->PendingReads--;
+
+        if (source->IsStopping)
+        {
+            WakeAllConditionVariable(&m_sourceIdle);
+        }
+
+        ReleaseSRWLockExclusive(&m_lock);
+    }
+}
+
+DWORD
+DirectoryWatchEngine::TimerThreadStatic(
+    _In_ LPVOID Context
+    )
+{
+    auto pThis = reinterpret_cast<DirectoryWatchEngine*>(Context);
+
+    pThis->TimerThread();
+
+    return ERROR_SUCCESS;
+}
+
+///
+/// Timer thread routine. Queues the work of the sources whose timer is due,
+/// and sleeps until the next one.
+///
+void
+DirectoryWatchEngine::TimerThread()
+{
+    AcquireSRWLockExclusive(&m_lock);
+
+    while (!m_stopping)
+    {
+        const UINT64 now = GetTickCount64();
+
+        while (!m_timers.empty() && m_timers.top().DueTimestamp <= now)
+        {
+            std::shared_ptr<Registration> source = m_timers.top().Source;
+            const UINT64 dueTimestamp = m_timers.top().DueTimestamp;
+
+            m_timers.pop();
+
+            if (source->TimerDueTimestamp == dueTimestamp)
+            {
+                source->TimerDueTimestamp = 0;
+                QueueWork(source.get());
+            }
+        }
+
+        DWORD millisecondsToWait = INFINITE;
+
+        if (!m_timers.empty())
+        {
+            const UINT64 untilDue = m_timers.top().DueTimestamp - now;
+            millisecondsToWait = untilDue < INFINITE ? static_cast<DWORD>(untilDue) : INFINITE - 1;
+        }
+
+        SleepConditionVariableSRW(&m_timerChanged, &m_lock, millisecondsToWait, 0);
+    }
+
+    //
+    // Release the sources held by the timers.
+    //
+    while (!m_timers.empty())
+    {
+        m_timers.pop();
+    }
+
+    ReleaseSRWLockExclusive(&m_lock);
+}
@@ -0,0 +1,221 @@
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <queue>
+#include <vector>
+
+class LogFileReaderPool;
+
+///
+/// Engine watching the log directories of all the File sources.
+///
+/// The directory handles of the sources are associated with a single I/O
+/// completion port, served by a small pool of worker threads. The workers
+/// also run the work of the sources: a source signals the engine when it has
+/// change events to handle, or arms its timer for its next periodic task, and
+/// a worker calls it back. The timers of all the sources are kept in a single
+/// queue ordered by due time, served by one timer thread.
+///
+/// The work of a source is never run by two workers at the same time: if it's
+/// signaled while it runs, it runs again once it finishes. Signals received
+/// while the work is queued are coalesced into that run.
+///
+/// The engine also holds the pool of threads reading the log files, shared by
+/// the sources. The threads of the engine and of the pool don't grow with the
+/// number of sources, so a configuration with many mostly idle sources doesn't
+/// cost threads and a timer per source.
+///
+/// The workers of the engine serve all the sources, so the work of a source
+/// must not wait: the reads it schedules are deferred by the reader pool when
+/// the source has too many files in flight.
+///
+class DirectoryWatchEngine final
+{
+ public:
+    ///
+    /// Callbacks of a source registered in the engine.
+    ///
+    class Client
+    {
+     public:
+        virtual ~Client() = default;
+
+        ///
+        /// Called by a worker when a directory read of the source completed.
+        ///
+        /// \param Status               The status of the read.
+        /// \param BytesTransferred     The size of the notifications in the buffer.
+        ///
+        virtual void OnDirectoryChangesCompleted(
+            _In_ DWORD Status,
+            _In_ DWORD BytesTransferred) = 0;
+
+        ///
+        /// Called by a worker when the source was signaled, or its timer is
+        /// due. It's never called concurrently for the same source.
+        ///
+        virtual void OnWork() = 0;
+    };
+
+    ///
+    /// State of a source in the engine. Guarded by the lock of the engine.
+    ///
+    struct Registration
+    {
+        Client* Owner = nullptr;
+
+        HANDLE DirectoryHandle = INVALID_HANDLE_VALUE;
+
+        //
+        // Set when the source is unregistered. Its work isn't run anymore, and
+        // its directory reads can't be issued.
+        //
+        bool IsStopping = false;
+
+        //
+        // Directory reads issued and not dequeued yet from the port.
+        //
+        DWORD PendingReads = 0;
+
+        //
+        // Work scheduling state, like the read scheduling state of the files
+        // in the reader pool.
+        //
+        bool IsWorkQueued = false;
+        bool IsWorkRunning = false;
+        bool IsWorkRequested = false;
+
+        //
+        // Due time of the timer of the source, 0 if it isn't armed.
+        //
+        UINT64 TimerDueTimestamp = 0;
+    };
+
+    static constexpr DWORD MAX_WORKER_COUNT = MAXIMUM_WAIT_OBJECTS;
+    static constexpr DWORD DEFAULT_MAX_WORKER_COUNT = 4;
+
+    static std::shared_ptr<DirectoryWatchEngine> Acquire();
+
+    DirectoryWatchEngine() = delete;
+
+    explicit DirectoryWatchEngine(
+        _In_ DWORD WorkerCount);
+
+    ~DirectoryWatchEngine();
+
+    DirectoryWatchEngine(const DirectoryWatchEngine&) = delete;
+    DirectoryWatchEngine& operator=(const DirectoryWatchEngine&) = delete;
+
+    std::shared_ptr<Registration> Register(
+        _In_ Client* Owner);
+
+    DWORD AssociateDirectory(
+        _In_ const std::shared_ptr<Registration>& Source,
+        _In_ HANDLE DirectoryHandle);
+
+    bool BeginDirectoryRead(
+        _In_ const std::shared_ptr<Registration>& Source);
+
+    void AbortDirectoryRead(
+        _In_ const std::shared_ptr<Registration>& Source);
+
+    void Signal(
+        _In_ const std::shared_ptr<Registration>& Source);
+
+    void SetTimer(
+        _In_ const std::shared_ptr<Registration>& Source,
+        _In_ UINT64 DueTimestamp);
+
+    void Unregister(
+        _In_ const std::shared_ptr<Registration>& Source);
+
+    LogFileReaderPool& GetReaderPool();
+
+    ///
+    /// \return The number of worker threads of the engine.
+    ///
+    size_t GetWorkerCount() const
+    {
+        return m_workerThreads.size();
+    }
+
+ private:
+    static constexpr int THREAD_EXIT_MAX_WAIT_MILLIS = 5 * 1000;
+    static constexpr DWORD UNREGISTER_WARNING_WAIT_MILLIS = 5 * 1000;
+    static constexpr DWORD UNREGISTER_CANCEL_INTERVAL_MILLIS = 100;
+    static constexpr DWORD WORKER_RETRY_INTERVAL_MILLIS = 100;
+
+    struct TimerEntry
+    {
+        UINT64 DueTimestamp;
+        std::shared_ptr<Registration> Source;
+
+        bool operator>(const TimerEntry& Other) const
+        {
+            return DueTimestamp > Other.DueTimestamp;
+        }
+    };
+
+    //
+    // The engine shared by the File sources, alive while a source uses it.
+    //
+    static SRWLOCK s_sharedEngineLock;
+    static std::weak_ptr<DirectoryWatchEngine> s_sharedEngine;
+
+    HANDLE m_completionPort = NULL;
+
+    SRWLOCK m_lock;
+
+    bool m_stopping = false;
+
+    //
+    // Signaled when a timer earlier than the others is armed, or when the
+    // engine is stopping.
+    //
+    CONDITION_VARIABLE m_timerChanged;
+
+    //
+    // Signaled when the work or a directory read of a stopping source ends.
+    //
+    CONDITION_VARIABLE m_sourceIdle;
+
+    //
+    // Armed timers. A timer armed again leaves its previous entry in the
+    // queue, which is skipped when it's due, as it doesn't match the due
+    // time of its source anymore.
+    //
+    std::priority_queue<TimerEntry, std::vector<TimerEntry>, std::greater<TimerEntry>> m_timers;
+
+    std::vector<HANDLE> m_workerThreads;
+
+    HANDLE m_timerThread = NULL;
+
+    std::unique_ptr<LogFileReaderPool> m_readerPool;
+
+    void QueueWork(
+        _In_ Registration* Source);
+
+    void RunWork(
+        _In_ Registration* Source);
+
+    void Stop();
+
+    void WaitForThreads(
+        _In_ const std::vector<HANDLE>& Threads);
+
+    static DWORD WorkerStatic(
+        _In_ LPVOID Context);
+
+    void Worker();
+
+    static DWORD TimerThreadStatic(
+        _In_ LPVOID Context);
+
+    void TimerThread();
+};
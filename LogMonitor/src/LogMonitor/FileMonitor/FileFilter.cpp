@@ -0,0 +1,379 @@
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//
+
+#include "pch.h"  // NOLINT(build/include_subdir)
+#include "FileFilter.h"  // NOLINT(build/include_subdir)
+
+#include <cwctype>
+
+///
+/// Finds the first path separator of a path, by hand as find_first_of is
+/// much slower for two characters.
+///
+static size_t
+FindSeparator(
+    _In_ std::wstring_view Path
+    )
+{
+    for (size_t i = 0; i < Path.size(); i++)
+    {
+        if (Path[i] == L'\\' || Path[i] == L'/')
+        {
+            return i;
+        }
+    }
+
+    return std::wstring_view::npos;
+}
+
+///
+/// \param Filter   The patterns, separated by semicolons. An empty filter
+///                 matches all the files.
+///
+FileFilter::FileFilter(
+    _In_ std::wstring_view Filter
+    )
+{
+    size_t start = 0;
+
+    while (start <= Filter.size())
+    {
+        size_t end = Filter.find(L';', start);
+
+        if (end == std::wstring_view::npos)
+        {
+            end = Filter.size();
+        }
+
+        std::wstring_view patternText = Filter.substr(start, end - start);
+
+        const size_t first = patternText.find_first_not_of(L" \t");
+        const size_t last = patternText.find_last_not_of(L" \t");
+
+        if (first != std::wstring_view::npos)
+        {
+            patternText = patternText.substr(first, last - first + 1);
+
+            if (patternText[0] == L'!')
+            {
+                if (patternText.size() > 1)
+                {
+                    m_excludes.push_back(Compile(patternText.substr(1)));
+                }
+            }
+            else
+            {
+                m_includes.push_back(Compile(patternText));
+            }
+        }
+
+        start = end + 1;
+    }
+
+    //
+    // A filter with exclusions only, or no pattern at all, includes all the
+    // other files.
+    //
+    if (m_includes.empty())
+    {
+        m_includes.push_back(Compile(L"*"));
+    }
+}
+
+///
+/// Checks if a file matches the filter.
+///
+/// \param Path     The path of the file, relative to the monitored directory.
+///
+/// \return true if the file matches any pattern, and no exclusion.
+///
+bool
+FileFilter::Matches(
+    _In_ std::wstring_view Path
+    ) const
+{
+    size_t nameStart = Path.size();
+
+    while (nameStart > 0 && Path[nameStart - 1] != L'\\' && Path[nameStart - 1] != L'/')
+    {
+        nameStart--;
+    }
+
+    const std::wstring_view fileName = Path.substr(nameStart);
+
+    bool isIncluded = false;
+
+    for (const Pattern& pattern : m_includes)
+    {
+        if (MatchPattern(pattern, Path, fileName))
+        {
+            isIncluded = true;
+            break;
+        }
+    }
+
+    if (!isIncluded)
+    {
+        return false;
+    }
+
+    for (const Pattern& pattern : m_excludes)
+    {
+        if (MatchPattern(pattern, Path, fileName))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+///
+/// Folds the case of a character. ASCII characters, the common case, are
+/// folded without calling into the CRT.
+///
+wchar_t
+FileFilter::FoldChar(
+    _In_ wchar_t Ch
+    )
+{
+    if (Ch < 0x80)
+    {
+        return (Ch >= L'a' && Ch <= L'z') ? static_cast<wchar_t>(Ch - L'a' + L'A') : Ch;
+    }
+
+    return static_cast<wchar_t>(std::towupper(Ch));
+}
+
+FileFilter::Pattern
+FileFilter::Compile(
+    _In_ std::wstring_view PatternText
+    )
+{
+    Pattern pattern;
+
+    pattern.Text.reserve(PatternText.size());
+
+    for (wchar_t ch : PatternText)
+    {
+        pattern.Text.push_back(ch == L'/' ? L'\\' : FoldChar(ch));
+    }
+
+    if (pattern.Text.find(L'\\') != std::wstring::npos)
+    {
+        pattern.Type = PatternType::Path;
+
+        size_t start = 0;
+
+        while (start <= pattern.Text.size())
+        {
+            size_t end = pattern.Text.find(L'\\', start);
+
+            if (end == std::wstring::npos)
+            {
+                end = pattern.Text.size();
+            }
+
+            //
+            // Empty segments, like in "logs\\app.log", are ignored.
+            //
+            if (end > start)
+            {
+                pattern.Segments.push_back(pattern.Text.substr(start, end - start));
+            }
+
+            start = end + 1;
+        }
+    }
+    else if (pattern.Text == L"*" || pattern.Text == L"*.*")
+    {
+        pattern.Type = PatternType::Any;
+    }
+    else
+    {
+        const size_t firstNonStar = pattern.Text.find_first_not_of(L'*');
+
+        if (pattern.Text.find_first_of(L"*?", firstNonStar) != std::wstring::npos)
+        {
+            pattern.Type = PatternType::Glob;
+        }
+        else if (firstNonStar > 0)
+        {
+            pattern.Type = PatternType::Suffix;
+            pattern.Text.erase(0, firstNonStar);
+        }
+        else
+        {
+            pattern.Type = PatternType::Literal;
+        }
+    }
+
+    return pattern;
+}
+
+bool
+FileFilter::MatchPattern(
+    _In_ const Pattern& FilePattern,
+    _In_ std::wstring_view Path,
+    _In_ std::wstring_view FileName
+    )
+{
+    switch (FilePattern.Type)
+    {
+        case PatternType::Any:
+            return true;
+
+        case PatternType::Suffix:
+            return FileName.size() >= FilePattern.Text.size() &&
+                EqualsFolded(FileName.substr(FileName.size() - FilePattern.Text.size()), FilePattern.Text);
+
+        case PatternType::Literal:
+            return EqualsFolded(FileName, FilePattern.Text);
+
+        case PatternType::Glob:
+            return MatchGlob(FilePattern.Text, FileName);
+
+        case PatternType::Path:
+            return MatchSegments(FilePattern.Segments, 0, Path);
+    }
+
+    return false;
+}
+
+///
+/// Matches a text with a case-folded pattern with '*' and '?' wildcards.
+/// After a mismatch, it backtracks to the last '*' only, so it takes linear
+/// time for the usual patterns.
+///
+bool
+FileFilter::MatchGlob(
+    _In_ std::wstring_view FoldedPattern,
+    _In_ std::wstring_view Text
+    )
+{
+    size_t patternIndex = 0;
+    size_t textIndex = 0;
+    size_t starIndex = std::wstring_view::npos;
+    size_t starTextIndex = 0;
+
+    while (textIndex < Text.size())
+    {
+        if (patternIndex < FoldedPattern.size() && FoldedPattern[patternIndex] == L'*')
+        {
+            starIndex = patternIndex++;
+            starTextIndex = textIndex;
+        }
+        else if (patternIndex < FoldedPattern.size() &&
+                 (FoldedPattern[patternIndex] == L'?' ||
+                  FoldedPattern[patternIndex] == FoldChar(Text[textIndex])))
+        {
+            patternIndex++;
+            textIndex++;
+        }
+        else if (starIndex != std::wstring_view::npos)
+        {
+            patternIndex = starIndex + 1;
+            textIndex = ++starTextIndex;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    while (patternIndex < FoldedPattern.size() && FoldedPattern[patternIndex] == L'*')
+    {
+        patternIndex++;
+    }
+
+    return patternIndex == FoldedPattern.size();
+}
+
+///
+/// Matches the segments of a path pattern, from SegmentIndex, with the rest
+/// of a relative path.
+///
+bool
+FileFilter::MatchSegments(
+    _In_ const std::vector<std::wstring>& Segments,
+    _In_ size_t SegmentIndex,
+    _In_ std::wstring_view Path
+    )
+{
+    if (SegmentIndex == Segments.size())
+    {
+        return Path.empty();
+    }
+
+    const std::wstring& segment = Segments[SegmentIndex];
+
+    if (segment == L"**")
+    {
+        //
+        // Try "**" as no subdirectory, then as one more each time.
+        //
+        while (true)
+        {
+            if (MatchSegments(Segments, SegmentIndex + 1, Path))
+            {
+                return true;
+            }
+
+            const size_t separator = FindSeparator(Path);
+
+            if (separator == std::wstring_view::npos)
+            {
+                return !Path.empty() && SegmentIndex + 1 == Segments.size();
+            }
+
+            Path = Path.substr(separator + 1);
+        }
+    }
+
+    if (Path.empty())
+    {
+        return false;
+    }
+
+    const size_t separator = FindSeparator(Path);
+
+    if (!MatchGlob(segment, Path.substr(0, separator)))
+    {
+        return false;
+    }
+
+    //
+    // The file name is the last segment of the path, so a pattern like
+    // "logs\**" doesn't match a file named "logs".
+    //
+    if (separator == std::wstring_view::npos)
+    {
+        return SegmentIndex + 1 == Segments.size();
+    }
+
+    return MatchSegments(Segments, SegmentIndex + 1, Path.substr(separator + 1));
+}
+
+bool
+FileFilter::EqualsFolded(
+    _In_ std::wstring_view Text,
+    _In_ std::wstring_view FoldedText
+    )
+{
+    if (Text.size() != FoldedText.size())
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < Text.size(); i++)
+    {
+        if (FoldChar(Text[i]) != FoldedText[i])
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
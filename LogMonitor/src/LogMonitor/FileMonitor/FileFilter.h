@@ -0,0 +1,93 @@
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+///
+/// Filter of the log files of a File source, compiled once from the filter
+/// of the source.
+///
+/// The filter is a list of patterns separated by semicolons, for example
+/// "*.log;*.txt;u_ex*.log". A file matches if it matches any of the patterns,
+/// and none of the patterns starting with '!'. The wildcards are '*', any
+/// characters, and '?', one character.
+///
+/// A pattern without a path separator is matched against the file name, in
+/// any subdirectory. A pattern with separators is matched against the path
+/// relative to the monitored directory, where '*' and '?' don't match a
+/// separator and a "**" segment matches any number of subdirectories, like
+/// "**\archive\*.log".
+///
+/// Names are compared ignoring case. The patterns are case-folded when they
+/// are compiled, and the names while they are compared, so matching doesn't
+/// allocate. Patterns like "*.log" are matched by comparing the end of the
+/// name only.
+///
+class FileFilter final
+{
+ public:
+    explicit FileFilter(
+        _In_ std::wstring_view Filter);
+
+    bool Matches(
+        _In_ std::wstring_view Path) const;
+
+    static wchar_t FoldChar(
+        _In_ wchar_t Ch);
+
+ private:
+    enum class PatternType
+    {
+        // Matches any name, "*" or "*.*".
+        Any,
+
+        // Matches the names ending with Text, like "*.log".
+        Suffix,
+
+        // Matches the name equal to Text.
+        Literal,
+
+        // Matches the names matching the wildcards of Text.
+        Glob,
+
+        // Matches the relative paths matching Segments.
+        Path,
+    };
+
+    struct Pattern
+    {
+        PatternType Type;
+        std::wstring Text;
+        std::vector<std::wstring> Segments;
+    };
+
+    std::vector<Pattern> m_includes;
+    std::vector<Pattern> m_excludes;
+
+    static Pattern Compile(
+        _In_ std::wstring_view PatternText);
+
+    static bool MatchPattern(
+        _In_ const Pattern& FilePattern,
+        _In_ std::wstring_view Path,
+        _In_ std::wstring_view FileName);
+
+    static bool MatchGlob(
+        _In_ std::wstring_view FoldedPattern,
+        _In_ std::wstring_view Text);
+
+    static bool MatchSegments(
+        _In_ const std::vector<std::wstring>& Segments,
+        _In_ size_t SegmentIndex,
+        _In_ std::wstring_view Path);
+
+    static bool EqualsFolded(
+        _In_ std::wstring_view Text,
+        _In_ std::wstring_view FoldedText);
+};
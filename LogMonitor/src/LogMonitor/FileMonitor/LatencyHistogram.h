@@ -0,0 +1,142 @@
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+///
+/// Histogram of latencies in milliseconds, used to report percentiles.
+///
+/// Values below 4 have their own bucket. Larger values are grouped in
+/// buckets of a quarter of their power of two, so a percentile is at most
+/// 25% above the real value, and the histogram has a fixed size whatever
+/// the range of the values.
+///
+/// It isn't thread safe, and it doesn't depend on Windows headers, so it
+/// can be built and tested on any platform.
+///
+class LatencyHistogram final
+{
+ public:
+    ///
+    /// Adds a value to the histogram.
+    ///
+    /// \param Millis   The value.
+    /// \param Count    The number of times the value is added.
+    ///
+    void Record(
+        uint64_t Millis,
+        uint64_t Count = 1)
+    {
+        m_buckets[BucketIndex(Millis)] += Count;
+        m_count += Count;
+    }
+
+    ///
+    /// Gets a percentile of the recorded values.
+    ///
+    /// \param Percent  The percentile to get, between 0 and 100.
+    ///
+    /// \return The largest value of the bucket where the percentile is, or 0
+    ///         if there are no values.
+    ///
+    uint64_t Percentile(
+        double Percent) const
+    {
+        if (m_count == 0)
+        {
+            return 0;
+        }
+
+        uint64_t rank = static_cast<uint64_t>(Percent * m_count / 100.0 + 0.5);
+        if (rank == 0)
+        {
+            rank = 1;
+        }
+        else if (rank > m_count)
+        {
+            rank = m_count;
+        }
+
+        uint64_t accumulated = 0;
+        for (size_t i = 0; i < BUCKETS_COUNT; i++)
+        {
+            accumulated += m_buckets[i];
+            if (accumulated >= rank)
+            {
+                return BucketMaxValue(i);
+            }
+        }
+
+        return BucketMaxValue(BUCKETS_COUNT - 1);
+    }
+
+    uint64_t Count() const
+    {
+        return m_count;
+    }
+
+    void Clear()
+    {
+        m_buckets.fill(0);
+        m_count = 0;
+    }
+
+ private:
+    static constexpr size_t SUB_BUCKETS = 4;
+    static constexpr size_t BUCKETS_COUNT = SUB_BUCKETS + (64 - 2) * SUB_BUCKETS;
+
+    std::array<uint64_t, BUCKETS_COUNT> m_buckets = {};
+    uint64_t m_count = 0;
+
+    static unsigned int HighestBit(
+        uint64_t Value)
+    {
+        unsigned int bit = 0;
+
+        while (Value >>= 1)
+        {
+            bit++;
+        }
+
+        return bit;
+    }
+
+    static size_t BucketIndex(
+        uint64_t Value)
+    {
+        if (Value < SUB_BUCKETS)
+        {
+            return static_cast<size_t>(Value);
+        }
+
+        //
+        // The two bits below the highest one select the quarter.
+        //
+        const unsigned int exponent = HighestBit(Value);
+        const size_t quarter = static_cast<size_t>((Value >> (exponent - 2)) & (SUB_BUCKETS - 1));
+
+        return SUB_BUCKETS + (exponent - 2) * SUB_BUCKETS + quarter;
+    }
+
+    static uint64_t BucketMaxValue(
+        size_t Index)
+    {
+        if (Index < SUB_BUCKETS)
+        {
+            return Index;
+        }
+
+        const unsigned int exponent = static_cast<unsigned int>((Index - SUB_BUCKETS) / SUB_BUCKETS + 2);
+        const uint64_t quarter = (Index - SUB_BUCKETS) % SUB_BUCKETS;
+        const uint64_t bucketStart = (SUB_BUCKETS + quarter) << (exponent - 2);
+        const uint64_t bucketSize = uint64_t(1) << (exponent - 2);
+
+        return bucketStart + (bucketSize - 1);
+    }
+};
@@ -0,0 +1,225 @@
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+#include "LineScanner.h"  // NOLINT(build/include_subdir)
+
+///
+/// The characters that end a line in a LineFramer.
+///
+enum class LineBreakMode
+{
+    //
+    // Any CR or LF ends a line, so LF, CR LF, LF CR and CR new lines are all
+    // supported. Used for the output of the process.
+    //
+    CrOrLf,
+
+    //
+    // Only LF ends a line. A CR just before or just after it is part of the
+    // new line, so CR LF and LF CR new lines are supported too, and any other
+    // CR is kept in the line. Used for the log files.
+    //
+    Lf
+};
+
+///
+/// Splits text into lines as it's read. Every complete line is passed to a
+/// callback as a view, either into the pushed text or into the buffer that
+/// holds the incomplete line carried from the previous push. That buffer
+/// keeps its capacity, so carrying partial lines doesn't reallocate once it
+/// has grown to the longest line.
+///
+/// The new lines are the ones of its LineBreakMode. Empty lines are skipped.
+///
+/// It doesn't depend on Windows headers, so it can be built and tested on
+/// any platform.
+///
+template <typename CharT>
+class LineFramer final
+{
+ public:
+    typedef std::basic_string_view<CharT> StringView;
+
+    LineFramer() = default;
+
+    explicit LineFramer(
+        LineBreakMode Mode) :
+        m_mode(Mode)
+    {
+    }
+
+    ///
+    /// Passes each complete line of Data to OnLine. The text after the last
+    /// line break is kept, and completed by the next push.
+    ///
+    /// \param Data     The text to split.
+    /// \param Size     The number of characters of Data.
+    /// \param OnLine   Callable invoked with a StringView for each line. The
+    ///                 view is only valid during the call.
+    ///
+    template <typename LineCallback>
+    void Push(
+        const CharT* Data,
+        size_t Size,
+        LineCallback&& OnLine)
+    {
+        const CharT* end = Data + Size;
+        const CharT* lineStart = Data;
+
+        //
+        // The LF of the last push may be followed by the CR of a LF CR new line.
+        //
+        if (m_lastPushEndedWithLf && lineStart != end)
+        {
+            if (*lineStart == Cr)
+            {
+                lineStart++;
+            }
+
+            m_lastPushEndedWithLf = false;
+        }
+
+        //
+        // To only find LF, the scanner looks for it in place of CR too.
+        //
+        const CharT scannedCr = (m_mode == LineBreakMode::Lf) ? Lf : Cr;
+
+        while (lineStart != end)
+        {
+            const CharT* lineBreak = LineScanner::FindNextLineBreak(lineStart, end, scannedCr, Lf);
+            if (lineBreak == end)
+            {
+                break;
+            }
+
+            if (!m_partialLine.empty())
+            {
+                m_partialLine.insert(m_partialLine.end(), lineStart, lineBreak);
+                EmitLine(TrimLine(StringView(m_partialLine.data(), m_partialLine.size())), OnLine);
+                m_partialLine.clear();
+            }
+            else
+            {
+                EmitLine(TrimLine(StringView(lineStart, lineBreak - lineStart)), OnLine);
+            }
+
+            lineStart = lineBreak + 1;
+
+            if (m_mode == LineBreakMode::Lf)
+            {
+                if (lineStart == end)
+                {
+                    m_lastPushEndedWithLf = true;
+                }
+                else if (*lineStart == Cr)
+                {
+                    lineStart++;
+                }
+            }
+        }
+
+        m_partialLine.insert(m_partialLine.end(), lineStart, end);
+    }
+
+    ///
+    /// Passes the incomplete line kept from the previous pushes, if any, to
+    /// OnLine. Used when the end of the input is reached.
+    ///
+    template <typename LineCallback>
+    void Flush(
+        LineCallback&& OnLine)
+    {
+        if (!m_partialLine.empty())
+        {
+            EmitLine(TrimLine(StringView(m_partialLine.data(), m_partialLine.size())), OnLine);
+            m_partialLine.clear();
+        }
+    }
+
+    ///
+    /// Passes each line of Text to OnLine, including the text after the
+    /// last line break. Any CR or LF ends a line. It doesn't use or change
+    /// any pushed text.
+    ///
+    template <typename LineCallback>
+    static void ForEachLine(
+        StringView Text,
+        LineCallback&& OnLine)
+    {
+        const CharT* end = Text.data() + Text.size();
+        const CharT* lineStart = Text.data();
+
+        while (lineStart != end)
+        {
+            const CharT* lineBreak = LineScanner::FindNextLineBreak(lineStart, end, Cr, Lf);
+
+            EmitLine(StringView(lineStart, lineBreak - lineStart), OnLine);
+
+            if (lineBreak == end)
+            {
+                break;
+            }
+
+            lineStart = lineBreak + 1;
+        }
+    }
+
+    bool HasPartialLine() const
+    {
+        return !m_partialLine.empty();
+    }
+
+    void Clear()
+    {
+        m_partialLine.clear();
+        m_lastPushEndedWithLf = false;
+    }
+
+ private:
+    static constexpr CharT Cr = static_cast<CharT>('\r');
+    static constexpr CharT Lf = static_cast<CharT>('\n');
+
+    LineBreakMode m_mode = LineBreakMode::CrOrLf;
+
+    std::vector<CharT> m_partialLine;
+
+    //
+    // Set when the last push ended with a LF, so a CR at the start of the
+    // next push is part of the same new line.
+    //
+    bool m_lastPushEndedWithLf = false;
+
+    ///
+    /// Removes the CR of a CR LF new line from the end of a line. With
+    /// LineBreakMode::CrOrLf, a line never ends with a CR.
+    ///
+    StringView TrimLine(
+        StringView Line) const
+    {
+        if (m_mode == LineBreakMode::Lf && !Line.empty() && Line.back() == Cr)
+        {
+            Line.remove_suffix(1);
+        }
+
+        return Line;
+    }
+
+    template <typename LineCallback>
+    static void EmitLine(
+        StringView Line,
+        LineCallback& OnLine)
+    {
+        if (!Line.empty())
+        {
+            OnLine(Line);
+        }
+    }
+};
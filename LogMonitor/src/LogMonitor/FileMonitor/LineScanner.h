@@ -0,0 +1,420 @@
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define LINESCANNER_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+//
+// MSVC allows AVX2 intrinsics in any function. GCC and Clang need the
+// functions using them to be compiled for that target.
+//
+#if defined(LINESCANNER_X86) && !defined(_MSC_VER)
+#define LINESCANNER_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define LINESCANNER_TARGET_AVX2
+#endif
+
+///
+/// Line break scanning used by the log file and process readers. It works on
+/// raw code units (bytes for ANSI and UTF-8, 16-bit units for UTF-16), so
+/// complete lines can be found before decoding them.
+///
+/// Buffers are scanned in blocks of BLOCK_SIZE code units. For each block a
+/// mask with the positions of all its CR and LF units is computed in one pass,
+/// with AVX2 or SSE2 when the CPU supports them, and with a scalar loop
+/// otherwise. The kernel is selected once, at the first scan.
+///
+/// It doesn't depend on Windows headers, so it can be built and tested on
+/// any platform.
+///
+class LineScanner final
+{
+ public:
+    static constexpr size_t BLOCK_SIZE = 64;
+
+    enum class SimdLevel
+    {
+        Scalar,
+        Sse2,
+        Avx2
+    };
+
+    ///
+    /// Finds the first line break (CR or LF) in a buffer of code units.
+    ///
+    /// \param Begin    First code unit of the buffer.
+    /// \param End      One past the last code unit of the buffer.
+    /// \param Cr       Value of the carriage return code unit. Pass the value
+    ///                 of Lf to only find line feeds.
+    /// \param Lf       Value of the line feed code unit.
+    ///
+    /// \return Pointer to the first line break, or End if there is none.
+    ///
+    template <typename UnitT>
+    static const UnitT* FindNextLineBreak(
+        const UnitT* Begin,
+        const UnitT* End,
+        UnitT Cr,
+        UnitT Lf)
+    {
+        const UnitT* it = Begin;
+
+        if constexpr (sizeof(UnitT) <= sizeof(uint16_t))
+        {
+            for (; static_cast<size_t>(End - it) >= BLOCK_SIZE; it += BLOCK_SIZE)
+            {
+                const uint64_t mask = LineBreakMask(it, Cr, Lf);
+                if (mask != 0)
+                {
+                    return it + CountTrailingZeros(mask);
+                }
+            }
+        }
+
+        for (; it != End; ++it)
+        {
+            if (*it == Cr || *it == Lf)
+            {
+                return it;
+            }
+        }
+
+        return End;
+    }
+
+    ///
+    /// Finds the last line break (CR or LF) in a buffer of code units.
+    ///
+    /// \param Begin    First code unit of the buffer.
+    /// \param End      One past the last code unit of the buffer.
+    /// \param Cr       Value of the carriage return code unit. Pass the value
+    ///                 of Lf to only find line feeds.
+    /// \param Lf       Value of the line feed code unit.
+    ///
+    /// \return Pointer to the last line break, or End if there is none.
+    ///
+    template <typename UnitT>
+    static const UnitT* FindLastLineBreak(
+        const UnitT* Begin,
+        const UnitT* End,
+        UnitT Cr,
+        UnitT Lf)
+    {
+        const UnitT* it = End;
+
+        if constexpr (sizeof(UnitT) <= sizeof(uint16_t))
+        {
+            for (; static_cast<size_t>(it - Begin) >= BLOCK_SIZE; it -= BLOCK_SIZE)
+            {
+                const uint64_t mask = LineBreakMask(it - BLOCK_SIZE, Cr, Lf);
+                if (mask != 0)
+                {
+                    return it - BLOCK_SIZE + (BLOCK_SIZE - 1 - CountLeadingZeros(mask));
+                }
+            }
+        }
+
+        for (; it != Begin; --it)
+        {
+            if (it[-1] == Cr || it[-1] == Lf)
+            {
+                return it - 1;
+            }
+        }
+
+        return End;
+    }
+
+    ///
+    /// Gets the positions of all the line breaks in a block of BLOCK_SIZE
+    /// code units of 8 or 16 bits.
+    ///
+    /// \param Block    First code unit of the block.
+    /// \param Cr       Value of the carriage return code unit.
+    /// \param Lf       Value of the line feed code unit.
+    ///
+    /// \return A mask where bit i is set if Block[i] is CR or LF.
+    ///
+    template <typename UnitT>
+    static uint64_t LineBreakMask(
+        const UnitT* Block,
+        UnitT Cr,
+        UnitT Lf)
+    {
+        return LineBreakMask(Block, Cr, Lf, GetSimdLevel());
+    }
+
+    ///
+    /// Same as the other LineBreakMask, with the kernel of the given
+    /// instruction set. Used to compare the kernels; the level must not be
+    /// above the one returned by GetSimdLevel.
+    ///
+    template <typename UnitT>
+    static uint64_t LineBreakMask(
+        const UnitT* Block,
+        UnitT Cr,
+        UnitT Lf,
+        SimdLevel Level)
+    {
+        static_assert(sizeof(UnitT) <= sizeof(uint16_t), "Only 8 and 16 bit code units are supported.");
+
+#ifdef LINESCANNER_X86
+        if constexpr (sizeof(UnitT) == sizeof(uint8_t))
+        {
+            const uint8_t* bytes = reinterpret_cast<const uint8_t*>(Block);
+            if (Level == SimdLevel::Avx2)
+            {
+                return LineBreakMask8Avx2(bytes, static_cast<uint8_t>(Cr), static_cast<uint8_t>(Lf));
+            }
+            if (Level == SimdLevel::Sse2)
+            {
+                return LineBreakMask8Sse2(bytes, static_cast<uint8_t>(Cr), static_cast<uint8_t>(Lf));
+            }
+        }
+        else
+        {
+            const uint16_t* units = reinterpret_cast<const uint16_t*>(Block);
+            if (Level == SimdLevel::Avx2)
+            {
+                return LineBreakMask16Avx2(units, static_cast<uint16_t>(Cr), static_cast<uint16_t>(Lf));
+            }
+            if (Level == SimdLevel::Sse2)
+            {
+                return LineBreakMask16Sse2(units, static_cast<uint16_t>(Cr), static_cast<uint16_t>(Lf));
+            }
+        }
+#else
+        (void)Level;
+#endif
+
+        return LineBreakMaskScalar(Block, Cr, Lf);
+    }
+
+    ///
+    /// Gets the instruction set used to scan, detected on the first call.
+    ///
+    static SimdLevel GetSimdLevel()
+    {
+        static const SimdLevel level = DetectSimdLevel();
+
+        return level;
+    }
+
+    ///
+    /// Byte swaps a UTF-16 code unit. Used to get the values of CR and LF
+    /// in UTF-16 big endian buffers.
+    ///
+    static constexpr uint16_t SwapBytes(uint16_t Unit)
+    {
+        return static_cast<uint16_t>((Unit << 8) | (Unit >> 8));
+    }
+
+    template <typename UnitT>
+    static uint64_t LineBreakMaskScalar(
+        const UnitT* Block,
+        UnitT Cr,
+        UnitT Lf)
+    {
+        uint64_t mask = 0;
+
+        for (size_t i = 0; i < BLOCK_SIZE; i++)
+        {
+            if (Block[i] == Cr || Block[i] == Lf)
+            {
+                mask |= uint64_t(1) << i;
+            }
+        }
+
+        return mask;
+    }
+
+ private:
+    static SimdLevel DetectSimdLevel()
+    {
+#ifdef LINESCANNER_X86
+#if defined(_MSC_VER)
+        int info[4] = {};
+
+        __cpuid(info, 0);
+        const int maxLeaf = info[0];
+
+        __cpuid(info, 1);
+        const bool hasSse2 = (info[3] & (1 << 26)) != 0;
+        const bool hasOsxsave = (info[2] & (1 << 27)) != 0;
+        const bool hasAvx = (info[2] & (1 << 28)) != 0;
+
+        bool hasAvx2 = false;
+        if (maxLeaf >= 7 && hasOsxsave && hasAvx)
+        {
+            //
+            // The OS must save the YMM registers on context switches.
+            //
+            const bool ymmEnabled = (_xgetbv(0) & 0x6) == 0x6;
+
+            __cpuidex(info, 7, 0);
+            hasAvx2 = ymmEnabled && (info[1] & (1 << 5)) != 0;
+        }
+
+        if (hasAvx2)
+        {
+            return SimdLevel::Avx2;
+        }
+
+        return hasSse2 ? SimdLevel::Sse2 : SimdLevel::Scalar;
+#else
+        __builtin_cpu_init();
+
+        if (__builtin_cpu_supports("avx2"))
+        {
+            return SimdLevel::Avx2;
+        }
+
+        return __builtin_cpu_supports("sse2") ? SimdLevel::Sse2 : SimdLevel::Scalar;
+#endif
+#else
+        return SimdLevel::Scalar;
+#endif
+    }
+
+    static unsigned CountTrailingZeros(uint64_t Mask)
+    {
+#if defined(_MSC_VER) && defined(_M_X64)
+        unsigned long index;
+        _BitScanForward64(&index, Mask);
+        return index;
+#elif defined(_MSC_VER)
+        unsigned long index;
+        if (_BitScanForward(&index, static_cast<unsigned long>(Mask)))
+        {
+            return index;
+        }
+        _BitScanForward(&index, static_cast<unsigned long>(Mask >> 32));
+        return index + 32;
+#else
+        return static_cast<unsigned>(__builtin_ctzll(Mask));
+#endif
+    }
+
+    static unsigned CountLeadingZeros(uint64_t Mask)
+    {
+#if defined(_MSC_VER) && defined(_M_X64)
+        unsigned long index;
+        _BitScanReverse64(&index, Mask);
+        return 63 - index;
+#elif defined(_MSC_VER)
+        unsigned long index;
+        if (_BitScanReverse(&index, static_cast<unsigned long>(Mask >> 32)))
+        {
+            return 31 - index;
+        }
+        _BitScanReverse(&index, static_cast<unsigned long>(Mask));
+        return 63 - index;
+#else
+        return static_cast<unsigned>(__builtin_clzll(Mask));
+#endif
+    }
+
+#ifdef LINESCANNER_X86
+    static uint64_t LineBreakMask8Sse2(const uint8_t* Block, uint8_t Cr, uint8_t Lf)
+    {
+        const __m128i cr = _mm_set1_epi8(static_cast<char>(Cr));
+        const __m128i lf = _mm_set1_epi8(static_cast<char>(Lf));
+        uint64_t mask = 0;
+
+        for (size_t i = 0; i < BLOCK_SIZE; i += 16)
+        {
+            const __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Block + i));
+            const __m128i matches = _mm_or_si128(_mm_cmpeq_epi8(data, cr), _mm_cmpeq_epi8(data, lf));
+
+            mask |= static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(matches))) << i;
+        }
+
+        return mask;
+    }
+
+    static uint64_t LineBreakMask16Sse2(const uint16_t* Block, uint16_t Cr, uint16_t Lf)
+    {
+        const __m128i cr = _mm_set1_epi16(static_cast<short>(Cr));
+        const __m128i lf = _mm_set1_epi16(static_cast<short>(Lf));
+        uint64_t mask = 0;
+
+        for (size_t i = 0; i < BLOCK_SIZE; i += 16)
+        {
+            const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Block + i));
+            const __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(Block + i + 8));
+
+            //
+            // Each comparison gives 0xFFFF or 0 per unit. Packing them with signed
+            // saturation gives one byte per unit, in order.
+            //
+            const __m128i matches = _mm_packs_epi16(
+                _mm_or_si128(_mm_cmpeq_epi16(low, cr), _mm_cmpeq_epi16(low, lf)),
+                _mm_or_si128(_mm_cmpeq_epi16(high, cr), _mm_cmpeq_epi16(high, lf)));
+
+            mask |= static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(matches))) << i;
+        }
+
+        return mask;
+    }
+
+    LINESCANNER_TARGET_AVX2
+    static uint64_t LineBreakMask8Avx2(const uint8_t* Block, uint8_t Cr, uint8_t Lf)
+    {
+        const __m256i cr = _mm256_set1_epi8(static_cast<char>(Cr));
+        const __m256i lf = _mm256_set1_epi8(static_cast<char>(Lf));
+        uint64_t mask = 0;
+
+        for (size_t i = 0; i < BLOCK_SIZE; i += 32)
+        {
+            const __m256i data = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(Block + i));
+            const __m256i matches = _mm256_or_si256(_mm256_cmpeq_epi8(data, cr), _mm256_cmpeq_epi8(data, lf));
+
+            mask |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(matches))) << i;
+        }
+
+        return mask;
+    }
+
+    LINESCANNER_TARGET_AVX2
+    static uint64_t LineBreakMask16Avx2(const uint16_t* Block, uint16_t Cr, uint16_t Lf)
+    {
+        const __m256i cr = _mm256_set1_epi16(static_cast<short>(Cr));
+        const __m256i lf = _mm256_set1_epi16(static_cast<short>(Lf));
+        uint64_t mask = 0;
+
+        for (size_t i = 0; i < BLOCK_SIZE; i += 32)
+        {
+            const __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(Block + i));
+            const __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(Block + i + 16));
+
+            //
+            // The AVX2 pack works on each 128-bit lane, so the 64-bit quarters of
+            // the result must be reordered to get the units in order.
+            //
+            const __m256i packed = _mm256_packs_epi16(
+                _mm256_or_si256(_mm256_cmpeq_epi16(low, cr), _mm256_cmpeq_epi16(low, lf)),
+                _mm256_or_si256(_mm256_cmpeq_epi16(high, cr), _mm256_cmpeq_epi16(high, lf)));
+            const __m256i matches = _mm256_permute4x64_epi64(packed, 0xD8);
+
+            mask |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(matches))) << i;
+        }
+
+        return mask;
+    }
+#endif
+};
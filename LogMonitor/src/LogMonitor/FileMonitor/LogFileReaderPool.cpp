@@ -0,0 +1,416 @@
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//
+
+#include "pch.h"  // NOLINT(build/include_subdir)
+#include "LogFileReaderPool.h"  // NOLINT(build/include_subdir)
+
+///
+/// Creates the pool. Its worker threads are started when files are queued.
+///
+LogFileReaderPool::LogFileReaderPool()
+{
+    InitializeSRWLock(&m_lock);
+    InitializeConditionVariable(&m_fileQueued);
+    InitializeConditionVariable(&m_sourceIdle);
+}
+
+LogFileReaderPool::~LogFileReaderPool()
+{
+    Stop();
+}
+
+///
+/// Registers a source in the pool.
+///
+/// \param Read                 Function called by the workers to read a file of the source. It
+///                             returns true if the file has bytes left to read. It must stay valid
+///                             until the source is unregistered.
+/// \param WorkerCount          Maximum number of workers the source needs. The pool has the largest
+///                             worker count of its sources, limited to MAX_WORKER_COUNT.
+/// \param MaxFilesInFlight     Maximum number of files of the source queued or being read at the
+///                             same time.
+///
+/// \return The registration of the source.
+///
+std::shared_ptr<LogFileReaderPool::Registration>
+LogFileReaderPool::Register(
+    _In_ ReadCallback Read,
+    _In_ DWORD WorkerCount,
+    _In_ DWORD MaxFilesInFlight
+    )
+{
+    auto source = std::make_shared<Registration>();
+    source->Read = std::move(Read);
+    source->MaxFilesInFlight = MaxFilesInFlight > 0 ? MaxFilesInFlight : 1;
+
+    if (WorkerCount > MAX_WORKER_COUNT)
+    {
+        WorkerCount = MAX_WORKER_COUNT;
+    }
+
+    AcquireSRWLockExclusive(&m_lock);
+
+    if (WorkerCount > m_maxWorkerCount)
+    {
+        m_maxWorkerCount = WorkerCount;
+    }
+
+    ReleaseSRWLockExclusive(&m_lock);
+
+    return source;
+}
+
+///
+/// Queues a file to be read by the pool. If the file is already queued
+/// nothing is done, and if it's being read, it's queued again once the
+/// read finishes. If the source has MaxFilesInFlight files in flight, the
+/// file is deferred until one of them is done. It never waits.
+///
+/// \param Source           The source of the file.
+/// \param LogFileInfo      The file to read.
+///
+/// \return false if the pool or the source is stopping and the file wasn't queued.
+///
+bool
+LogFileReaderPool::Schedule(
+    _In_ const std::shared_ptr<Registration>& Source,
+    _In_ const std::shared_ptr<LogFileInformation>& LogFileInfo
+    )
+{
+    bool scheduled = false;
+
+    AcquireSRWLockExclusive(&m_lock);
+
+    if (!m_stopping && !Source->IsStopping)
+    {
+        scheduled = true;
+
+        if (LogFileInfo->IsReadQueued)
+        {
+            //
+            // The file is queued or deferred, and the read will see its
+            // changes.
+            //
+        }
+        else if (LogFileInfo->IsBeingRead)
+        {
+            LogFileInfo->IsReadRequested = true;
+        }
+        else if (Source->FilesInFlight >= Source->MaxFilesInFlight)
+        {
+            LogFileInfo->IsReadQueued = true;
+            Source->DeferredFiles.push(LogFileInfo);
+        }
+        else
+        {
+            LogFileInfo->IsReadQueued = true;
+            Source->FilesInFlight++;
+
+            QueueFile(Source, LogFileInfo);
+        }
+    }
+
+    ReleaseSRWLockExclusive(&m_lock);
+
+    return scheduled;
+}
+
+///
+/// Unregisters a source. Its queued and deferred files are discarded, and
+/// its reads in progress are waited to finish, as they use the state of the
+/// source. A wait longer than UNREGISTER_WARNING_WAIT_MILLIS is traced.
+///
+/// \param Source       The source.
+///
+void
+LogFileReaderPool::Unregister(
+    _In_ const std::shared_ptr<Registration>& Source
+    )
+{
+    const UINT64 startTimestamp = GetTickCount64();
+    bool isWaitTraced = false;
+
+    AcquireSRWLockExclusive(&m_lock);
+
+    Source->IsStopping = true;
+
+    for (auto it = m_queuedFiles.begin(); it != m_queuedFiles.end();)
+    {
+        if (it->Source == Source)
+        {
+            it->LogFileInfo->IsReadQueued = false;
+            Source->FilesInFlight--;
+
+            it = m_queuedFiles.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    while (!Source->DeferredFiles.empty())
+    {
+        Source->DeferredFiles.front()->IsReadQueued = false;
+        Source->DeferredFiles.pop();
+    }
+
+    while (Source->FilesBeingRead > 0)
+    {
+        if (!isWaitTraced && GetTickCount64() - startTimestamp >= UNREGISTER_WARNING_WAIT_MILLIS)
+        {
+            logWriter.TraceWarning(L"Still waiting for the reads of a log directory to finish.");
+            isWaitTraced = true;
+        }
+
+        SleepConditionVariableSRW(&m_sourceIdle, &m_lock, UNREGISTER_WARNING_WAIT_MILLIS, 0);
+    }
+
+    ReleaseSRWLockExclusive(&m_lock);
+}
+
+///
+/// Stops the pool, and waits for its workers to exit. The sources must be
+/// unregistered, so no read is in progress. A wait longer than
+/// WORKER_THREAD_EXIT_MAX_WAIT_MILLIS is traced.
+///
+void
+LogFileReaderPool::Stop()
+{
+    AcquireSRWLockExclusive(&m_lock);
+
+    m_stopping = true;
+
+    while (!m_queuedFiles.empty())
+    {
+        m_queuedFiles.front().LogFileInfo->IsReadQueued = false;
+        m_queuedFiles.pop_front();
+    }
+
+    WakeAllConditionVariable(&m_fileQueued);
+
+    ReleaseSRWLockExclusive(&m_lock);
+
+    if (m_workerThreads.empty())
+    {
+        return;
+    }
+
+    DWORD waitResult = WaitForMultipleObjects(
+        static_cast<DWORD>(m_workerThreads.size()),
+        m_workerThreads.data(),
+        TRUE,
+        WORKER_THREAD_EXIT_MAX_WAIT_MILLIS);
+
+    if (waitResult == WAIT_TIMEOUT)
+    {
+        //
+        // The workers use the pool, so it isn't released until they exit.
+        //
+        logWriter.TraceWarning(L"Still waiting for the log file reader threads to stop.");
+
+        waitResult = WaitForMultipleObjects(
+            static_cast<DWORD>(m_workerThreads.size()),
+            m_workerThreads.data(),
+            TRUE,
+            INFINITE);
+    }
+
+    if (waitResult == WAIT_FAILED)
+    {
+        logWriter.TraceError(
+            Utility::FormatString(
+                L"Failed to wait for log file reader threads to stop. Error: %lu",
+                GetLastError()
+            ).c_str()
+        );
+    }
+
+    for (HANDLE workerThread : m_workerThreads)
+    {
+        CloseHandle(workerThread);
+    }
+
+    m_workerThreads.clear();
+}
+
+///
+/// \return The number of worker threads started.
+///
+size_t
+LogFileReaderPool::GetWorkerCount()
+{
+    AcquireSRWLockShared(&m_lock);
+
+    const size_t workerCount = m_workerThreads.size();
+
+    ReleaseSRWLockShared(&m_lock);
+
+    return workerCount;
+}
+
+///
+/// Queues a file at the back of the queue, and wakes a worker. Must be called
+/// with m_lock held, and the file counted in flight.
+///
+/// \param Source           The source of the file.
+/// \param LogFileInfo      The file to read.
+///
+void
+LogFileReaderPool::QueueFile(
+    _In_ const std::shared_ptr<Registration>& Source,
+    _In_ std::shared_ptr<LogFileInformation> LogFileInfo
+    )
+{
+    m_queuedFiles.push_back({ Source, std::move(LogFileInfo) });
+
+    StartWorkerIfNeeded();
+
+    WakeConditionVariable(&m_fileQueued);
+}
+
+///
+/// Starts a worker if there are more queued files than idle workers, and the
+/// pool has less than its maximum number of workers. Must be called with
+/// m_lock held.
+///
+void
+LogFileReaderPool::StartWorkerIfNeeded()
+{
+    if (m_queuedFiles.size() <= m_idleWorkers || m_workerThreads.size() >= m_maxWorkerCount)
+    {
+        return;
+    }
+
+    HANDLE workerThread = CreateThread(
+        nullptr,
+        0,
+        (LPTHREAD_START_ROUTINE)&LogFileReaderPool::WorkerStatic,
+        this,
+        0,
+        nullptr);
+    if (!workerThread)
+    {
+        //
+        // The file is read by a running worker, if any.
+        //
+        logWriter.TraceError(
+            Utility::FormatString(
+                L"Failed to start a log file reader thread. Error: %lu",
+                GetLastError()
+            ).c_str()
+        );
+        return;
+    }
+
+    m_workerThreads.push_back(workerThread);
+}
+
+DWORD
+LogFileReaderPool::WorkerStatic(
+    _In_ LPVOID Context
+    )
+{
+    auto pThis = reinterpret_cast<LogFileReaderPool*>(Context);
+
+    pThis->Worker();
+
+    return ERROR_SUCCESS;
+}
+
+///
+/// Worker thread routine. Reads the queued files until the pool is stopped.
+///
+void
+LogFileReaderPool::Worker()
+{
+    AcquireSRWLockExclusive(&m_lock);
+
+    while (true)
+    {
+        m_idleWorkers++;
+
+        while (m_queuedFiles.empty() && !m_stopping)
+        {
+            SleepConditionVariableSRW(&m_fileQueued, &m_lock, INFINITE, 0);
+        }
+
+        m_idleWorkers--;
+
+        if (m_stopping)
+        {
+            break;
+        }
+
+        std::shared_ptr<Registration> source = std::move(m_queuedFiles.front().Source);
+        std::shared_ptr<LogFileInformation> logFileInfo = std::move(m_queuedFiles.front().LogFileInfo);
+        m_queuedFiles.pop_front();
+
+        logFileInfo->IsReadQueued = false;
+        logFileInfo->IsBeingRead = true;
+        source->FilesBeingRead++;
+
+        ReleaseSRWLockExclusive(&m_lock);
+
+        bool isReadIncomplete = false;
+
+        try
+        {
+            isReadIncomplete = source->Read(logFileInfo);
+        }
+        catch (std::exception& ex)
+        {
+            logWriter.TraceError(
+                Utility::FormatString(L"Error in log file monitor. Failed to read a log file. %S", ex.what()).c_str()
+            );
+        }
+        catch (...)
+        {
+            logWriter.TraceError(L"Error in log file monitor. Failed to read a log file.");
+        }
+
+        AcquireSRWLockExclusive(&m_lock);
+
+        logFileInfo->IsBeingRead = false;
+        source->FilesBeingRead--;
+
+        if ((logFileInfo->IsReadRequested || isReadIncomplete) && !source->IsStopping)
+        {
+            //
+            // The file changed while it was being read, or its read budget
+            // was used before its end. It keeps its place in flight, and goes
+            // to the back of the queue.
+            //
+            logFileInfo->IsReadRequested = false;
+            logFileInfo->IsReadQueued = true;
+
+            QueueFile(source, std::move(logFileInfo));
+        }
+        else
+        {
+            logFileInfo->IsReadRequested = false;
+            source->FilesInFlight--;
+
+            if (source->IsStopping)
+            {
+                WakeAllConditionVariable(&m_sourceIdle);
+            }
+            else if (!source->DeferredFiles.empty())
+            {
+                //
+                // The file takes the place of the one done.
+                //
+                std::shared_ptr<LogFileInformation> deferredFile = std::move(source->DeferredFiles.front());
+                source->DeferredFiles.pop();
+
+                source->FilesInFlight++;
+
+                QueueFile(source, std::move(deferredFile));
+            }
+        }
+    }
+
+    ReleaseSRWLockExclusive(&m_lock);
+}
@@ -0,0 +1,147 @@
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//
+
+#pragma once
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <vector>
+
+struct LogFileInformation;
+
+///
+/// Pool of worker threads that read log files concurrently. It's shared by
+/// the File sources, through the DirectoryWatchEngine.
+///
+/// Files are scheduled by the work of their source, in the workers of the
+/// engine, and read by the first free worker of the pool. A file is never read
+/// by two workers at the same time: if it's scheduled while it's being read,
+/// it's queued again when the read finishes, so reads of the same file keep
+/// their order. Files queued again go to the back of the queue, so a file with
+/// a large backlog doesn't delay the others.
+///
+/// The read function returns true when it stopped before the end of the file,
+/// because the file used its read budget. The file is then queued again at the
+/// back, so the files with pending bytes are read round robin.
+///
+/// The number of files of a source queued or being read is limited to its
+/// MaxFilesInFlight, which bounds the memory used by the read buffers. A file
+/// scheduled past the limit is deferred, and queued once another file of the
+/// source is done. Schedule never waits, so the workers of the engine, which
+/// serve all the sources, are never held by a source with many files.
+///
+/// The workers are started when files are queued and no worker is free to read
+/// them, up to the largest WorkerCount of the sources, so a configuration with
+/// many sources doesn't cost threads per source.
+///
+class LogFileReaderPool final
+{
+ public:
+    typedef std::function<bool(const std::shared_ptr<LogFileInformation>&)> ReadCallback;
+
+    ///
+    /// State of a source in the pool. Guarded by the lock of the pool.
+    ///
+    struct Registration
+    {
+        ReadCallback Read;
+
+        DWORD MaxFilesInFlight = 1;
+
+        //
+        // Files of the source queued or being read, and the ones being read.
+        //
+        DWORD FilesInFlight = 0;
+        DWORD FilesBeingRead = 0;
+
+        //
+        // Files scheduled while the source had MaxFilesInFlight files in
+        // flight. They are queued as the files in flight are done.
+        //
+        std::queue<std::shared_ptr<LogFileInformation>> DeferredFiles;
+
+        //
+        // Set when the source is unregistered. Its files can't be scheduled
+        // anymore.
+        //
+        bool IsStopping = false;
+    };
+
+    static constexpr DWORD MAX_WORKER_COUNT = MAXIMUM_WAIT_OBJECTS;
+
+    LogFileReaderPool();
+
+    ~LogFileReaderPool();
+
+    LogFileReaderPool(const LogFileReaderPool&) = delete;
+    LogFileReaderPool& operator=(const LogFileReaderPool&) = delete;
+
+    std::shared_ptr<Registration> Register(
+        _In_ ReadCallback Read,
+        _In_ DWORD WorkerCount,
+        _In_ DWORD MaxFilesInFlight);
+
+    bool Schedule(
+        _In_ const std::shared_ptr<Registration>& Source,
+        _In_ const std::shared_ptr<LogFileInformation>& LogFileInfo);
+
+    void Unregister(
+        _In_ const std::shared_ptr<Registration>& Source);
+
+    void Stop();
+
+    size_t GetWorkerCount();
+
+ private:
+    static constexpr int WORKER_THREAD_EXIT_MAX_WAIT_MILLIS = 5 * 1000;
+    static constexpr DWORD UNREGISTER_WARNING_WAIT_MILLIS = 5 * 1000;
+
+    struct QueuedFile
+    {
+        std::shared_ptr<Registration> Source;
+        std::shared_ptr<LogFileInformation> LogFileInfo;
+    };
+
+    //
+    // Largest worker count of the sources registered. Guarded by m_lock.
+    //
+    DWORD m_maxWorkerCount = 1;
+
+    //
+    // Workers waiting for a file to be queued. Guarded by m_lock.
+    //
+    DWORD m_idleWorkers = 0;
+
+    bool m_stopping = false;
+
+    SRWLOCK m_lock;
+
+    //
+    // Signaled when a file is queued, or when the pool is stopping.
+    //
+    CONDITION_VARIABLE m_fileQueued;
+
+    //
+    // Signaled when a read of a stopping source ends.
+    //
+    CONDITION_VARIABLE m_sourceIdle;
+
+    std::deque<QueuedFile> m_queuedFiles;
+
+    std::vector<HANDLE> m_workerThreads;
+
+    void QueueFile(
+        _In_ const std::shared_ptr<Registration>& Source,
+        _In_ std::shared_ptr<LogFileInformation> LogFileInfo);
+
+    void StartWorkerIfNeeded();
+
+    static DWORD WorkerStatic(
+        _In_ LPVOID Context);
+
+    void Worker();
+};
@@ -0,0 +1,391 @@
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//
+
+#include "pch.h"  // NOLINT(build/include_subdir)
+#include "LogFileTable.h"  // NOLINT(build/include_subdir)
+
+LogFileTable::LogFileTable()
+{
+    InitializeSRWLock(&m_lock);
+}
+
+///
+/// Case-folds a path, so it can be used as a key. ASCII paths, the common
+/// case, are folded without calling into the NLS functions.
+///
+/// \param Path     The path to fold.
+///
+/// \return The path in upper case.
+///
+std::wstring
+LogFileTable::FoldCase(
+    _In_ const std::wstring& Path
+    )
+{
+    std::wstring key(Path);
+    bool isAscii = true;
+
+    for (wchar_t& ch : key)
+    {
+        if (ch >= L'a' && ch <= L'z')
+        {
+            ch = ch - L'a' + L'A';
+        }
+        else if (ch > 0x7F)
+        {
+            isAscii = false;
+            break;
+        }
+    }
+
+    if (!isAscii)
+    {
+        key = Path;
+
+        const int keySize = LCMapStringEx(
+            LOCALE_NAME_INVARIANT,
+            LCMAP_UPPERCASE,
+            Path.c_str(),
+            static_cast<int>(Path.size()),
+            &key[0],
+            static_cast<int>(key.size()),
+            nullptr,
+            nullptr,
+            0);
+
+        //
+        // Upper case mapping doesn't change the length of the string, but if it
+        // failed, keep the path as it is.
+        //
+        if (keySize != static_cast<int>(Path.size()))
+        {
+            key = Path;
+        }
+    }
+
+    return key;
+}
+
+///
+/// Looks for a file by its long or short path.
+///
+/// \param Path     The relative path of the file.
+///
+/// \return The file, or null if it isn't in the table.
+///
+std::shared_ptr<LogFileInformation>
+LogFileTable::Find(
+    _In_ const std::wstring& Path
+    ) const
+{
+    std::shared_ptr<LogFileInformation> logFileInfo;
+
+    AcquireSRWLockShared(&m_lock);
+
+    Entry* entry = FindEntry(Path);
+
+    if (entry != nullptr)
+    {
+        logFileInfo = entry->LogFileInfo;
+    }
+
+    ReleaseSRWLockShared(&m_lock);
+
+    return logFileInfo;
+}
+
+///
+/// Looks for the long path of a file by its long or short path.
+///
+/// \param Path         The relative path of the file.
+/// \param LongPath     Receives the relative long path of the file, if found.
+///
+/// \return true if the file is in the table.
+///
+bool
+LogFileTable::FindLongPath(
+    _In_ const std::wstring& Path,
+    _Out_ std::wstring& LongPath
+    ) const
+{
+    AcquireSRWLockShared(&m_lock);
+
+    Entry* entry = FindEntry(Path);
+
+    if (entry != nullptr)
+    {
+        LongPath = entry->LongPath;
+    }
+
+    ReleaseSRWLockShared(&m_lock);
+
+    return entry != nullptr;
+}
+
+///
+/// Looks for the long path of a file by its id.
+///
+/// \param FileId       The id of the file.
+/// \param LongPath     Receives the relative long path of the file, if found.
+///
+/// \return true if the file is in the table.
+///
+bool
+LogFileTable::FindLongPathById(
+    _In_ const FILE_ID_INFO& FileId,
+    _Out_ std::wstring& LongPath
+    ) const
+{
+    bool found = false;
+
+    AcquireSRWLockShared(&m_lock);
+
+    auto it = m_byFileId.find(FileId);
+
+    if (it != m_byFileId.end())
+    {
+        LongPath = it->second->LongPath;
+        found = true;
+    }
+
+    ReleaseSRWLockShared(&m_lock);
+
+    return found;
+}
+
+///
+/// Adds a file to the table. A file already in the table with the same long
+/// path is replaced.
+///
+/// \param LongPath     The relative long path of the file.
+/// \param ShortPath    The relative short path of the file.
+/// \param FileId       The id of the file. It can be empty.
+/// \param LogFileInfo  The information of the file.
+///
+void
+LogFileTable::Insert(
+    _In_ const std::wstring& LongPath,
+    _In_ const std::wstring& ShortPath,
+    _In_ const FILE_ID_INFO& FileId,
+    _In_ const std::shared_ptr<LogFileInformation>& LogFileInfo
+    )
+{
+    auto entry = std::make_unique<Entry>();
+
+    entry->LongPath = LongPath;
+    entry->ShortPath = ShortPath;
+    entry->LongPathKey = FoldCase(LongPath);
+    entry->ShortPathKey = FoldCase(ShortPath);
+    entry->FileId = FileId;
+    entry->LogFileInfo = LogFileInfo;
+
+    AcquireSRWLockExclusive(&m_lock);
+
+    auto existing = m_byLongPath.find(entry->LongPathKey);
+
+    if (existing != m_byLongPath.end())
+    {
+        RemoveEntry(existing->second.get());
+    }
+
+    Entry* newEntry = entry.get();
+
+    m_byShortPath[newEntry->ShortPathKey] = newEntry;
+
+    if (!IsFileIdEmpty(FileId))
+    {
+        m_byFileId[FileId] = newEntry;
+    }
+
+    m_byLongPath[newEntry->LongPathKey] = std::move(entry);
+
+    ReleaseSRWLockExclusive(&m_lock);
+}
+
+///
+/// Removes a file from the table.
+///
+/// \param Path     The relative long or short path of the file.
+///
+/// \return The information of the removed file, or null if it wasn't in the table.
+///
+std::shared_ptr<LogFileInformation>
+LogFileTable::Remove(
+    _In_ const std::wstring& Path
+    )
+{
+    std::shared_ptr<LogFileInformation> logFileInfo;
+
+    AcquireSRWLockExclusive(&m_lock);
+
+    Entry* entry = FindEntry(Path);
+
+    if (entry != nullptr)
+    {
+        logFileInfo = RemoveEntry(entry)->LogFileInfo;
+    }
+
+    ReleaseSRWLockExclusive(&m_lock);
+
+    return logFileInfo;
+}
+
+///
+/// Changes the id of a file, when its name now refers to a different file.
+///
+/// \param OldFileId    The id of the file in the table.
+/// \param NewFileId    The new id of the file.
+///
+void
+LogFileTable::ChangeFileId(
+    _In_ const FILE_ID_INFO& OldFileId,
+    _In_ const FILE_ID_INFO& NewFileId
+    )
+{
+    AcquireSRWLockExclusive(&m_lock);
+
+    auto it = m_byFileId.find(OldFileId);
+
+    if (it != m_byFileId.end())
+    {
+        Entry* entry = it->second;
+
+        m_byFileId.erase(it);
+
+        entry->FileId = NewFileId;
+
+        if (!IsFileIdEmpty(NewFileId))
+        {
+            m_byFileId[NewFileId] = entry;
+        }
+    }
+
+    ReleaseSRWLockExclusive(&m_lock);
+}
+
+///
+/// \return The information of all the files in the table.
+///
+std::vector<std::shared_ptr<LogFileInformation>>
+LogFileTable::GetAll() const
+{
+    std::vector<std::shared_ptr<LogFileInformation>> logFiles;
+
+    AcquireSRWLockShared(&m_lock);
+
+    logFiles.reserve(m_byLongPath.size());
+
+    for (const auto& entry : m_byLongPath)
+    {
+        logFiles.push_back(entry.second->LogFileInfo);
+    }
+
+    ReleaseSRWLockShared(&m_lock);
+
+    return logFiles;
+}
+
+size_t
+LogFileTable::Size() const
+{
+    AcquireSRWLockShared(&m_lock);
+
+    const size_t size = m_byLongPath.size();
+
+    ReleaseSRWLockShared(&m_lock);
+
+    return size;
+}
+
+///
+/// Looks for an entry using Path first as a long path, and then as a short
+/// path. Must be called with the lock held.
+///
+LogFileTable::Entry*
+LogFileTable::FindEntry(
+    _In_ const std::wstring& Path
+    ) const
+{
+    const std::wstring key = FoldCase(Path);
+
+    auto longPathIt = m_byLongPath.find(key);
+
+    if (longPathIt != m_byLongPath.end())
+    {
+        return longPathIt->second.get();
+    }
+
+    auto shortPathIt = m_byShortPath.find(key);
+
+    if (shortPathIt != m_byShortPath.end())
+    {
+        return shortPathIt->second;
+    }
+
+    return nullptr;
+}
+
+///
+/// Removes an entry from all the indexes. Must be called with the lock held
+/// exclusively.
+///
+/// \return The removed entry.
+///
+std::unique_ptr<LogFileTable::Entry>
+LogFileTable::RemoveEntry(
+    _In_ Entry* TableEntry
+    )
+{
+    auto shortPathIt = m_byShortPath.find(TableEntry->ShortPathKey);
+
+    if (shortPathIt != m_byShortPath.end() && shortPathIt->second == TableEntry)
+    {
+        m_byShortPath.erase(shortPathIt);
+    }
+
+    auto fileIdIt = m_byFileId.find(TableEntry->FileId);
+
+    if (fileIdIt != m_byFileId.end() && fileIdIt->second == TableEntry)
+    {
+        m_byFileId.erase(fileIdIt);
+    }
+
+    auto longPathIt = m_byLongPath.find(TableEntry->LongPathKey);
+    std::unique_ptr<Entry> entry = std::move(longPathIt->second);
+
+    m_byLongPath.erase(longPathIt);
+
+    return entry;
+}
+
+///
+/// Hashes the volume serial number and the 128-bit file id, as FNV-1a.
+///
+size_t
+LogFileTable::FileIdHash::operator()(
+    const FILE_ID_INFO& FileId
+    ) const
+{
+    UINT64 hash = 14695981039346656037ULL;
+    const BYTE* bytes = reinterpret_cast<const BYTE*>(&FileId);
+
+    for (size_t i = 0; i < sizeof(FILE_ID_INFO); i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+
+    return static_cast<size_t>(hash);
+}
+
+bool
+LogFileTable::IsFileIdEmpty(
+    _In_ const FILE_ID_INFO& FileId
+    )
+{
+    const FILE_ID_INFO emptyFileId = {};
+
+    return memcmp(&FileId, &emptyFileId, sizeof(FILE_ID_INFO)) == 0;
+}
@@ -0,0 +1,118 @@
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct LogFileInformation;
+
+///
+/// Table of the monitored log files of a directory.
+///
+/// Each file has a single entry with its long path, short path and file id,
+/// and can be found in constant time by any of them. Paths are compared case
+/// insensitively, like the file system does: the keys are case-folded once
+/// when the entry is added, so lookups only hash the folded path instead of
+/// comparing it with _wcsicmp at every node of a tree.
+///
+/// Paths are relative to the monitored directory. Files without id (the file
+/// system doesn't support them) are only indexed by path.
+///
+/// The table has its own lock. The change handler is the only one that
+/// adds, removes or renames files. The reader pool workers only change file ids.
+///
+class LogFileTable final
+{
+ public:
+    LogFileTable();
+
+    LogFileTable(const LogFileTable&) = delete;
+    LogFileTable& operator=(const LogFileTable&) = delete;
+
+    std::shared_ptr<LogFileInformation> Find(
+        _In_ const std::wstring& Path) const;
+
+    bool FindLongPath(
+        _In_ const std::wstring& Path,
+        _Out_ std::wstring& LongPath) const;
+
+    bool FindLongPathById(
+        _In_ const FILE_ID_INFO& FileId,
+        _Out_ std::wstring& LongPath) const;
+
+    void Insert(
+        _In_ const std::wstring& LongPath,
+        _In_ const std::wstring& ShortPath,
+        _In_ const FILE_ID_INFO& FileId,
+        _In_ const std::shared_ptr<LogFileInformation>& LogFileInfo);
+
+    std::shared_ptr<LogFileInformation> Remove(
+        _In_ const std::wstring& Path);
+
+    void ChangeFileId(
+        _In_ const FILE_ID_INFO& OldFileId,
+        _In_ const FILE_ID_INFO& NewFileId);
+
+    std::vector<std::shared_ptr<LogFileInformation>> GetAll() const;
+
+    size_t Size() const;
+
+    static std::wstring FoldCase(
+        _In_ const std::wstring& Path);
+
+ private:
+    struct Entry
+    {
+        std::wstring LongPath;
+        std::wstring ShortPath;
+        std::wstring LongPathKey;
+        std::wstring ShortPathKey;
+        FILE_ID_INFO FileId;
+        std::shared_ptr<LogFileInformation> LogFileInfo;
+    };
+
+    struct FileIdHash
+    {
+        size_t operator()(const FILE_ID_INFO& FileId) const;
+    };
+
+    struct FileIdEqual
+    {
+        bool operator()(const FILE_ID_INFO& FileId1, const FILE_ID_INFO& FileId2) const
+        {
+            return memcmp(&FileId1, &FileId2, sizeof(FILE_ID_INFO)) == 0;
+        }
+    };
+
+    mutable SRWLOCK m_lock;
+
+    //
+    // Entries by case-folded long path. This index owns the entries.
+    //
+    std::unordered_map<std::wstring, std::unique_ptr<Entry>> m_byLongPath;
+
+    //
+    // Entries by case-folded short path.
+    //
+    std::unordered_map<std::wstring, Entry*> m_byShortPath;
+
+    //
+    // Entries by file id.
+    //
+    std::unordered_map<FILE_ID_INFO, Entry*, FileIdHash, FileIdEqual> m_byFileId;
+
+    Entry* FindEntry(
+        _In_ const std::wstring& Path) const;
+
+    std::unique_ptr<Entry> RemoveEntry(
+        _In_ Entry* TableEntry);
+
+    static bool IsFileIdEmpty(
+        _In_ const FILE_ID_INFO& FileId);
+};
@@ -253,6 +253,116 @@ bool handleFileLog(
         );
     }
 
+    if (source.contains("readerThreads") && source["readerThreads"].is_number_unsigned()) {
+        Attributes[JSON_TAG_READER_THREADS] = reinterpret_cast<void*>(
+            std::make_unique<DWORD>(source["readerThreads"].get<DWORD>()).release()
+        );
+    }
+
+    if (source.contains("maxFilesInFlight") && source["maxFilesInFlight"].is_number_unsigned()) {
+        Attributes[JSON_TAG_MAX_FILES_IN_FLIGHT] = reinterpret_cast<void*>(
+            std::make_unique<DWORD>(source["maxFilesInFlight"].get<DWORD>()).release()
+        );
+    }
+
+    if (source.contains("modifyCoalescingWindowInMilliseconds")
+        && source["modifyCoalescingWindowInMilliseconds"].is_number_unsigned()) {
+        Attributes[JSON_TAG_MODIFY_COALESCING_WINDOW] = reinterpret_cast<void*>(
+            std::make_unique<DWORD>(source["modifyCoalescingWindowInMilliseconds"].get<DWORD>()).release()
+        );
+    }
+
+    if (source.contains("sweepIntervalInSeconds") && source["sweepIntervalInSeconds"].is_number()) {
+        std::double_t sweepInterval = source["sweepIntervalInSeconds"].get<std::double_t>();
+
+        if (sweepInterval <= 0) {
+            logWriter.TraceError(
+                L"Error parsing configuration file. 'sweepIntervalInSeconds' attribute must be greater than zero"
+            );
+            return false;
+        }
+
+        Attributes[JSON_TAG_SWEEP_INTERVAL] = reinterpret_cast<void*>(
+            std::make_unique<std::double_t>(sweepInterval).release()
+        );
+    }
+
+    if (source.contains("latencyReportIntervalInSeconds")
+        && source["latencyReportIntervalInSeconds"].is_number_unsigned()) {
+        Attributes[JSON_TAG_LATENCY_REPORT_INTERVAL] = reinterpret_cast<void*>(
+            std::make_unique<DWORD>(source["latencyReportIntervalInSeconds"].get<DWORD>()).release()
+        );
+    }
+
+    std::string checkpointFile = getJsonStringCaseInsensitive(source, "checkpointFile");
+    if (!checkpointFile.empty()) {
+        Attributes[JSON_TAG_CHECKPOINT_FILE] = reinterpret_cast<void*>(
+            std::make_unique<std::wstring>(Utility::StringToWString(checkpointFile)).release()
+        );
+    }
+
+    if (source.contains("checkpointIntervalInSeconds") && source["checkpointIntervalInSeconds"].is_number_unsigned()) {
+        Attributes[JSON_TAG_CHECKPOINT_INTERVAL] = reinterpret_cast<void*>(
+            std::make_unique<DWORD>(source["checkpointIntervalInSeconds"].get<DWORD>()).release()
+        );
+    }
+
+    if (source.contains("notificationBufferSizeInKB") && source["notificationBufferSizeInKB"].is_number_unsigned()) {
+        Attributes[JSON_TAG_NOTIFICATION_BUFFER_SIZE] = reinterpret_cast<void*>(
+            std::make_unique<DWORD>(source["notificationBufferSizeInKB"].get<DWORD>()).release()
+        );
+    }
+
+    if (source.contains("maxNotificationBufferSizeInKB")
+        && source["maxNotificationBufferSizeInKB"].is_number_unsigned()) {
+        Attributes[JSON_TAG_MAX_NOTIFICATION_BUFFER_SIZE] = reinterpret_cast<void*>(
+            std::make_unique<DWORD>(source["maxNotificationBufferSizeInKB"].get<DWORD>()).release()
+        );
+    }
+
+    if (source.contains("headerFingerprintSizeInBytes")
+        && source["headerFingerprintSizeInBytes"].is_number_unsigned()) {
+        Attributes[JSON_TAG_HEADER_FINGERPRINT_SIZE] = reinterpret_cast<void*>(
+            std::make_unique<DWORD>(source["headerFingerprintSizeInBytes"].get<DWORD>()).release()
+        );
+    }
+
+    if (source.contains("readBudgetInKB") && source["readBudgetInKB"].is_number_unsigned()) {
+        Attributes[JSON_TAG_READ_BUDGET] = reinterpret_cast<void*>(
+            std::make_unique<DWORD>(source["readBudgetInKB"].get<DWORD>()).release()
+        );
+    }
+
+    if (source.contains("priorities") && source["priorities"].is_array()) {
+        auto priorities = std::make_unique<std::vector<FilePriority>>();
+
+        for (const auto& priority : source["priorities"]) {
+            std::string priorityFilter;
+            if (priority.is_object()) {
+                priorityFilter = getJsonStringCaseInsensitive(priority, "filter", true);
+            }
+
+            if (priorityFilter.empty()
+                || !priority.contains("weight")
+                || !priority["weight"].is_number_unsigned()
+                || priority["weight"].get<DWORD>() == 0) {
+                logWriter.TraceError(
+                    L"Error parsing configuration file. Each of the 'priorities' must have a 'filter'"
+                    L" and a 'weight' greater than zero"
+                );
+                return false;
+            }
+
+            FilePriority filePriority;
+            filePriority.Filter = Utility::StringToWString(priorityFilter);
+            filePriority.Weight = priority["weight"].get<DWORD>();
+
+            priorities->push_back(std::move(filePriority));
+        }
+
+        Attributes[JSON_TAG_PRIORITIES] = reinterpret_cast<void*>(priorities.release());
+    }
+
     auto sourceFile = std::make_shared<SourceFile>();
     if (!SourceFile::Unwrap(Attributes, *sourceFile)) {
         logWriter.TraceError(L"Error parsing configuration file. Invalid File source");
@@ -423,6 +533,11 @@ bool processLogConfig(_In_ const nlohmann::json& logConfig, _Out_ LoggerSettings
         logWriter.TraceWarning(L"LogFormat not found in LogConfig. Using default log format.");
     }
 
+    const nlohmann::json* outputPtr = findJsonKeyCaseInsensitive(obj, "output");
+    if (outputPtr != nullptr && !processOutputConfig(*outputPtr, Config.Output)) {
+        return false;
+    }
+
     const nlohmann::json* sourcesPtr = findJsonKeyCaseInsensitive(obj, "sources");
     if (sourcesPtr == nullptr || !sourcesPtr->is_array()) {
         logWriter.TraceError(L"Sources array not found or invalid in LogConfig.");
@@ -433,6 +548,206 @@ bool processLogConfig(_In_ const nlohmann::json& logConfig, _Out_ LoggerSettings
     return processSources(*sourcesPtr, Config);
 }
 
+/// <summary>
+/// Processes the optional output section of the configuration, with the
+/// settings of how the log lines are written to stdout.
+/// </summary>
+/// <param name="output">JSON object containing the output settings.</param>
+/// <param name="Output">OutputSettings structure to populate. Settings not present keep their default.</param>
+/// <returns>
+/// Returns true if the output section is valid; otherwise, returns false.
+/// </returns>
+bool processOutputConfig(_In_ const nlohmann::json& output, _Out_ OutputSettings& Output) {
+    if (!output.is_object()) {
+        logWriter.TraceError(L"Error parsing configuration file. 'output' attribute must be an object");
+        return false;
+    }
+
+    const nlohmann::json* flushIntervalPtr = findJsonKeyCaseInsensitive(output, "flushIntervalInMilliseconds");
+    if (flushIntervalPtr != nullptr && flushIntervalPtr->is_number_unsigned()) {
+        Output.FlushIntervalInMilliseconds = flushIntervalPtr->get<DWORD>();
+    }
+
+    const nlohmann::json* flushSizePtr = findJsonKeyCaseInsensitive(output, "flushSizeInKB");
+    if (flushSizePtr != nullptr && flushSizePtr->is_number_unsigned()) {
+        DWORD flushSize = flushSizePtr->get<DWORD>();
+
+        if (flushSize == 0) {
+            logWriter.TraceError(
+                L"Error parsing configuration file. 'flushSizeInKB' attribute must be greater than zero"
+            );
+            return false;
+        }
+
+        Output.FlushSizeInKB = flushSize;
+    }
+
+    const nlohmann::json* queueSizePtr = findJsonKeyCaseInsensitive(output, "queueSizeInKB");
+    if (queueSizePtr != nullptr && queueSizePtr->is_number_unsigned()) {
+        DWORD queueSize = queueSizePtr->get<DWORD>();
+
+        if (queueSize == 0) {
+            logWriter.TraceError(
+                L"Error parsing configuration file. 'queueSizeInKB' attribute must be greater than zero"
+            );
+            return false;
+        }
+
+        Output.QueueSizeInKB = queueSize;
+    }
+
+    std::string overflowPolicy = getJsonStringCaseInsensitive(output, "overflowPolicy");
+    if (!overflowPolicy.empty()) {
+        std::wstring policy = Utility::StringToWString(overflowPolicy);
+        bool isValidPolicy = false;
+
+        for (size_t i = 0; i < _countof(OutputOverflowPolicyNames); i++) {
+            if (_wcsicmp(policy.c_str(), OutputOverflowPolicyNames[i]) == 0) {
+                Output.OverflowPolicy = static_cast<OutputOverflowPolicy>(i);
+                isValidPolicy = true;
+                break;
+            }
+        }
+
+        if (!isValidPolicy) {
+            logWriter.TraceError(
+                Utility::FormatString(
+                    L"Error parsing configuration file. '%S' isn't a valid overflow policy."
+                    L" Valid values are block, dropOldest, dropNewest, sample and spill",
+                    overflowPolicy.c_str()
+                ).c_str()
+            );
+            return false;
+        }
+    }
+
+    const nlohmann::json* sampleRatePtr = findJsonKeyCaseInsensitive(output, "sampleRate");
+    if (sampleRatePtr != nullptr && sampleRatePtr->is_number_unsigned()) {
+        DWORD sampleRate = sampleRatePtr->get<DWORD>();
+
+        if (sampleRate == 0) {
+            logWriter.TraceError(
+                L"Error parsing configuration file. 'sampleRate' attribute must be greater than zero"
+            );
+            return false;
+        }
+
+        Output.SampleRate = sampleRate;
+    }
+
+    const nlohmann::json* dropReportIntervalPtr = findJsonKeyCaseInsensitive(output, "dropReportIntervalInSeconds");
+    if (dropReportIntervalPtr != nullptr && dropReportIntervalPtr->is_number_unsigned()) {
+        Output.DropReportIntervalInSeconds = dropReportIntervalPtr->get<DWORD>();
+    }
+
+    std::string spillDirectory = getJsonStringCaseInsensitive(output, "spillDirectory");
+    if (!spillDirectory.empty()) {
+        Output.SpillDirectory = Utility::StringToWString(spillDirectory);
+    }
+
+    const nlohmann::json* spillMaxSizePtr = findJsonKeyCaseInsensitive(output, "spillMaxSizeInMB");
+    if (spillMaxSizePtr != nullptr && spillMaxSizePtr->is_number_unsigned()) {
+        DWORD spillMaxSize = spillMaxSizePtr->get<DWORD>();
+
+        if (spillMaxSize == 0) {
+            logWriter.TraceError(
+                L"Error parsing configuration file. 'spillMaxSizeInMB' attribute must be greater than zero"
+            );
+            return false;
+        }
+
+        Output.SpillMaxSizeInMB = spillMaxSize;
+    }
+
+    const nlohmann::json* spillMaxAgePtr = findJsonKeyCaseInsensitive(output, "spillMaxAgeInSeconds");
+    if (spillMaxAgePtr != nullptr && spillMaxAgePtr->is_number_unsigned()) {
+        DWORD spillMaxAge = spillMaxAgePtr->get<DWORD>();
+
+        if (spillMaxAge == 0) {
+            logWriter.TraceError(
+                L"Error parsing configuration file. 'spillMaxAgeInSeconds' attribute must be greater than zero"
+            );
+            return false;
+        }
+
+        Output.SpillMaxAgeInSeconds = spillMaxAge;
+    }
+
+    const nlohmann::json* stdoutPtr = findJsonKeyCaseInsensitive(output, "stdout");
+    if (stdoutPtr != nullptr && stdoutPtr->is_boolean()) {
+        Output.WriteToStdout = stdoutPtr->get<bool>();
+    }
+
+    const nlohmann::json* filePtr = findJsonKeyCaseInsensitive(output, "file");
+    if (filePtr != nullptr && !processOutputFileConfig(*filePtr, Output.File)) {
+        return false;
+    }
+
+    if (!Output.WriteToStdout && Output.File.Path.empty()) {
+        logWriter.TraceError(
+            L"Error parsing configuration file. 'stdout' can only be false if an output 'file' is set"
+        );
+        return false;
+    }
+
+    return true;
+}
+
+/// <summary>
+/// Processes the optional file object of the output section, with the
+/// settings of the file the log lines are written to, and of its rotation.
+/// </summary>
+/// <param name="file">JSON object containing the output file settings.</param>
+/// <param name="File">OutputFileSettings structure to populate. Settings not present keep their default.</param>
+/// <returns>
+/// Returns true if the file object is valid; otherwise, returns false.
+/// </returns>
+bool processOutputFileConfig(_In_ const nlohmann::json& file, _Out_ OutputFileSettings& File) {
+    if (!file.is_object()) {
+        logWriter.TraceError(L"Error parsing configuration file. 'file' attribute of 'output' must be an object");
+        return false;
+    }
+
+    std::string path = getJsonStringCaseInsensitive(file, "path", true);
+    if (path.empty()) {
+        logWriter.TraceError(L"Error parsing configuration file. 'path' attribute of the output file is required");
+        return false;
+    }
+
+    File.Path = Utility::StringToWString(path);
+
+    const nlohmann::json* maxSizePtr = findJsonKeyCaseInsensitive(file, "maxSizeInMB");
+    if (maxSizePtr != nullptr && maxSizePtr->is_number_unsigned()) {
+        DWORD maxSize = maxSizePtr->get<DWORD>();
+
+        if (maxSize == 0) {
+            logWriter.TraceError(
+                L"Error parsing configuration file. 'maxSizeInMB' attribute must be greater than zero"
+            );
+            return false;
+        }
+
+        File.MaxSizeInMB = maxSize;
+    }
+
+    const nlohmann::json* rotationIntervalPtr = findJsonKeyCaseInsensitive(file, "rotationIntervalInMinutes");
+    if (rotationIntervalPtr != nullptr && rotationIntervalPtr->is_number_unsigned()) {
+        File.RotationIntervalInMinutes = rotationIntervalPtr->get<DWORD>();
+    }
+
+    const nlohmann::json* maxFilesPtr = findJsonKeyCaseInsensitive(file, "maxFiles");
+    if (maxFilesPtr != nullptr && maxFilesPtr->is_number_unsigned()) {
+        File.MaxFiles = maxFilesPtr->get<DWORD>();
+    }
+
+    const nlohmann::json* compressPtr = findJsonKeyCaseInsensitive(file, "compress");
+    if (compressPtr != nullptr && compressPtr->is_boolean()) {
+        File.Compress = compressPtr->get<bool>();
+    }
+
+    return true;
+}
+
 /// <summary>
 /// Iterates through the sources array from the configuration,
 /// parsing and processing each log source based on its type.
@@ -531,14 +846,28 @@ void cleanupAttributes(_In_ AttributesMap& Attributes) {
             delete static_cast<bool*>(attributePair.second);
         } else if (key == JSON_TAG_CUSTOM_LOG_FORMAT ||
                    key == JSON_TAG_DIRECTORY ||
-                   key == JSON_TAG_FILTER) {
+                   key == JSON_TAG_FILTER ||
+                   key == JSON_TAG_CHECKPOINT_FILE) {
             delete static_cast<std::wstring*>(attributePair.second);
         } else if (key == JSON_TAG_CHANNELS) {
             delete static_cast<std::vector<EventLogChannel>*>(attributePair.second);
         } else if (key == JSON_TAG_PROVIDERS) {
             delete static_cast<std::vector<ETWProvider>*>(attributePair.second);
-        } else if (key == JSON_TAG_WAITINSECONDS) {
+        } else if (key == JSON_TAG_WAITINSECONDS ||
+                   key == JSON_TAG_SWEEP_INTERVAL) {
             delete static_cast<std::double_t*>(attributePair.second);
+        } else if (key == JSON_TAG_READER_THREADS ||
+                   key == JSON_TAG_MAX_FILES_IN_FLIGHT ||
+                   key == JSON_TAG_MODIFY_COALESCING_WINDOW ||
+                   key == JSON_TAG_LATENCY_REPORT_INTERVAL ||
+                   key == JSON_TAG_CHECKPOINT_INTERVAL ||
+                   key == JSON_TAG_NOTIFICATION_BUFFER_SIZE ||
+                   key == JSON_TAG_MAX_NOTIFICATION_BUFFER_SIZE ||
+                   key == JSON_TAG_HEADER_FINGERPRINT_SIZE ||
+                   key == JSON_TAG_READ_BUDGET) {
+            delete static_cast<DWORD*>(attributePair.second);
+        } else if (key == JSON_TAG_PRIORITIES) {
+            delete static_cast<std::vector<FilePriority>*>(attributePair.second);
         }
     }
 }
@@ -46,6 +46,16 @@ bool processLogConfig(
     _Out_ LoggerSettings& Config
 );
 
+bool processOutputConfig(
+    _In_ const nlohmann::json& output,
+    _Out_ OutputSettings& Output
+);
+
+bool processOutputFileConfig(
+    _In_ const nlohmann::json& file,
+    _Out_ OutputFileSettings& File
+);
+
 bool processSources(
     _In_ const nlohmann::json& sources,
     _Out_ LoggerSettings& Config
@@ -14,13 +14,16 @@ using namespace std;
 ///
 /// Monitors a log directory for changes to the log files matching the criteria specified by a filter.
 ///
-/// LogFileMonitor starts a monitor thread that waits for file change notifications from ReadDirectoryChangesW
-/// or for a stop event to be set. It also starts a worker thread that processes the change notification events.
+/// LogFileMonitor starts a thread that opens the log directory, waiting for it to be created if needed, and
+/// registers it in the DirectoryWatchEngine shared by all the File sources. The ReadDirectoryChangesW calls
+/// complete in the workers of the engine, which also process the change notification events and the timer of
+/// the source, and schedule the reads of the changed log files in the pool of reader threads of the engine, so
+/// different files are read concurrently.
 ///
-/// The destructor signals the stop event and waits up to LOG_MONITOR_THREAD_EXIT_MAX_WAIT_MILLIS for the monitoring
-/// thread to exit. To prevent the thread from out-living LogFileMonitor, the destructor fails fast
-/// if the wait fails or times out. This also ensures the callback is not being called and will not be
-/// called once LogFileMonitor is destroyed.
+/// The destructor signals the stop event, unregisters the source from the reader pool, which waits for the reads
+/// of its files to finish, and from the engine, which cancels its directory read and waits for its work to
+/// finish, and waits up to LOG_MONITOR_THREAD_EXIT_MAX_WAIT_MILLIS for the start thread to exit. This ensures the callbacks are not being called and will not be called once LogFileMonitor
+/// is destroyed.
 ///
 
 
@@ -31,38 +34,91 @@ using namespace std;
                                   FILE_NOTIFY_CHANGE_SIZE)
 
 ///
-/// Constructor creates a thread to monitor log directory changes and waits until
-/// that thread registers for directory change notifications. This ensures that no
-/// changes to log files are missed once the LogFileMonitor object is created.
+/// Constructor registers the source in the shared directory watch engine, and
+/// creates a thread that opens the log directory and starts watching it.
 ///
 /// \param LogDirectory:        The log directory to be monitored
 /// \param Filter:              The filter to apply when looking fr log files
 /// \param IncludeSubfolders:   TRUE if subdirectories also needs to be monitored
 /// \param WaitInSeconds:       Waiting time in seconds to retry if folder/file to be monitored does not exist
+/// \param Tuning:              Reader threads, change coalescing and sweep settings
 ///
 LogFileMonitor::LogFileMonitor(_In_ const std::wstring& LogDirectory,
                                _In_ const std::wstring& Filter,
                                _In_ bool IncludeSubfolders,
                                _In_ const std::double_t& WaitInSeconds,
                                _In_ std::wstring LogFormat,
-                               _In_ std::wstring CustomLogFormat = L""
+                               _In_ std::wstring CustomLogFormat,
+                               _In_ const FileMonitorTuning& Tuning
                                ) :
                                m_logDirectory(LogDirectory),
                                m_filter(Filter),
                                m_includeSubfolders(IncludeSubfolders),
                                m_waitInSeconds(WaitInSeconds),
                                m_logFormat(LogFormat),
-                               m_customLogFormat(CustomLogFormat)
+                               m_customLogFormat(CustomLogFormat),
+                               m_tuning(Tuning)
 {
     m_stopEvent = NULL;
-    m_overlappedEvent = NULL;
-    m_workerThreadEvent = NULL;
-    m_logFilesChangeHandlerThread = NULL;
     m_dirMonitorStartedEvent = NULL;
     m_logDirMonitorThread = NULL;
     m_logDirHandle = INVALID_HANDLE_VALUE;
 
     InitializeSRWLock(&m_eventQueueLock);
+    InitializeSRWLock(&m_readLatencyLock);
+    InitializeSRWLock(&m_notificationLock);
+
+    if (!(m_tuning.SweepIntervalInSeconds > 0))
+    {
+        m_tuning.SweepIntervalInSeconds = FileMonitorTuning().SweepIntervalInSeconds;
+    }
+
+    if (m_tuning.CheckpointIntervalInSeconds == 0)
+    {
+        m_tuning.CheckpointIntervalInSeconds = 1;
+    }
+
+    if (m_tuning.HeaderFingerprintSizeInBytes > HEADER_FINGERPRINT_MAX_SIZE_BYTES)
+    {
+        m_tuning.HeaderFingerprintSizeInBytes = HEADER_FINGERPRINT_MAX_SIZE_BYTES;
+    }
+
+    for (const auto& priority : m_tuning.Priorities)
+    {
+        DWORD weight = priority.Weight;
+
+        if (weight == 0)
+        {
+            weight = 1;
+        }
+        else if (weight > READ_WEIGHT_MAX)
+        {
+            weight = READ_WEIGHT_MAX;
+        }
+
+        m_priorities.emplace_back(FileFilter(priority.Filter), weight);
+    }
+
+    DWORD notificationBufferSizeInKB = m_tuning.NotificationBufferSizeInKB;
+    DWORD maxNotificationBufferSizeInKB = m_tuning.MaxNotificationBufferSizeInKB;
+
+    if (notificationBufferSizeInKB < NOTIFICATION_BUFFER_MIN_SIZE_KB)
+    {
+        notificationBufferSizeInKB = NOTIFICATION_BUFFER_MIN_SIZE_KB;
+    }
+
+    if (maxNotificationBufferSizeInKB > NOTIFICATION_BUFFER_MAX_SIZE_KB)
+    {
+        maxNotificationBufferSizeInKB = NOTIFICATION_BUFFER_MAX_SIZE_KB;
+    }
+
+    if (notificationBufferSizeInKB > maxNotificationBufferSizeInKB)
+    {
+        notificationBufferSizeInKB = maxNotificationBufferSizeInKB;
+    }
+
+    m_notificationBufferSize = notificationBufferSizeInKB * 1024;
+    m_maxNotificationBufferSize = maxNotificationBufferSizeInKB * 1024;
 
     // By default, the name is limited to MAX_PATH characters. To extend this limit to 32,767 wide characters,
     // we prepend "\?" to the path. Prepending the string "\?" does not allow access to the root directory
@@ -70,23 +126,40 @@ LogFileMonitor::LogFileMonitor(_In_ const std::wstring& LogDirectory,
     bool isRootFolder = FileMonitorUtilities::CheckIsRootFolder(m_logDirectory);
     m_logDirectory = isRootFolder ? m_logDirectory : PREFIX_EXTENDED_PATH + m_logDirectory;
 
-    if (m_filter.empty())
-    {
-        m_filter = L"*";
-    }
-
     m_stopEvent = FileMonitorUtilities::CreateFileMonitorEvent(TRUE, FALSE);
 
-    m_overlappedEvent = FileMonitorUtilities::CreateFileMonitorEvent(TRUE, TRUE);
-
-    m_overlapped.hEvent = m_overlappedEvent;
-
-    m_workerThreadEvent = FileMonitorUtilities::CreateFileMonitorEvent(TRUE, TRUE);
+    m_overlapped = {};
 
     m_dirMonitorStartedEvent = FileMonitorUtilities::CreateFileMonitorEvent(TRUE, FALSE);
 
     m_readLogFilesFromStart = false;
 
+    if (!m_tuning.CheckpointFile.empty())
+    {
+        m_checkpointStore = std::make_unique<CheckpointStore>(m_tuning.CheckpointFile);
+
+        DWORD status = m_checkpointStore->Load();
+        if (status != ERROR_SUCCESS)
+        {
+            logWriter.TraceError(
+                Utility::FormatString(
+                    L"Failed to load log file checkpoint %ws. Log files will be read as if there was"
+                    L" no checkpoint. Error: %lu",
+                    m_tuning.CheckpointFile.c_str(),
+                    status
+                ).c_str()
+            );
+        }
+    }
+
+    m_watchEngine = DirectoryWatchEngine::Acquire();
+    m_watchRegistration = m_watchEngine->Register(this);
+
+    m_readerRegistration = m_watchEngine->GetReaderPool().Register(
+        [this](const std::shared_ptr<LogFileInformation>& LogFileInfo) { return ReadScheduledLogFile(LogFileInfo); },
+        m_tuning.ReaderThreads,
+        m_tuning.MaxFilesInFlight);
+
     m_logDirMonitorThread = CreateThread(
         nullptr,
         0,
@@ -129,65 +202,89 @@ LogFileMonitor::LogFileMonitor(_In_ const std::wstring& LogDirectory,
 
 LogFileMonitor::~LogFileMonitor()
 {
-    const DWORD eventsCount = 2;
-    HANDLE events[eventsCount] = {m_logDirMonitorThread, m_logFilesChangeHandlerThread};
-
     if(!SetEvent(m_stopEvent))
     {
         logWriter.TraceError(
             Utility::FormatString(L"Failed to signal event to stop log file monitor. %lu", GetLastError()).c_str()
         );
     }
-    else
+
+    //
+    // Discard the queued reads of the files of the source, and wait for the
+    // reads in progress. The reads scheduled by the work of the source from
+    // now on are ignored.
+    //
+    m_watchEngine->GetReaderPool().Unregister(m_readerRegistration);
+
+    //
+    // Cancel the directory read and wait for the work of the source to finish.
+    //
+    m_watchEngine->Unregister(m_watchRegistration);
+
+    //
+    // No file is read anymore, so the incomplete lines kept from the last
+    // reads won't be completed. Once they are written, the checkpoints move
+    // past them.
+    //
+    for (const auto& logFileInfo : m_logFiles.GetAll())
     {
-        //
-        // Wait for directory monitor and change notification handler threads to exit.
-        //
-        DWORD waitResult = WaitForMultipleObjects(eventsCount, events, TRUE, LOG_MONITOR_THREAD_EXIT_MAX_WAIT_MILLIS);
+        AcquireSRWLockExclusive(&logFileInfo->Lock);
 
-        if (waitResult != WAIT_OBJECT_0)
+        try
         {
-            HRESULT hr = (waitResult == WAIT_FAILED) ? HRESULT_FROM_WIN32(GetLastError())
-                                                           : HRESULT_FROM_WIN32(waitResult);
-            if (FAILED(hr))
+            if (logFileInfo->Framer.HasPartialLine() || !logFileInfo->UndecodedBytes.empty())
             {
-                logWriter.TraceError(
-                    Utility::FormatString(
-                        L"Failed to wait for log file monitor to stop. Log directory: %s Error: %lu",
-                        m_logDirectory.c_str(),
-                        hr
-                    ).c_str()
-                );
+                FlushPartialLine(logFileInfo, true);
+
+                if (m_checkpointStore && !logFileInfo->IsRemoved)
+                {
+                    CheckpointLogFile(logFileInfo);
+                }
             }
         }
-    }
+        catch (...)
+        {
+        }
 
-    if (!m_logDirMonitorThread)
-    {
-        CloseHandle(m_logDirMonitorThread);
+        ReleaseSRWLockExclusive(&logFileInfo->Lock);
     }
 
-    if (!m_logFilesChangeHandlerThread)
+    //
+    // Wait for the start thread to exit. It could still be waiting for the log
+    // directory to be created.
+    //
+    DWORD waitResult = WaitForSingleObject(m_logDirMonitorThread, LOG_MONITOR_THREAD_EXIT_MAX_WAIT_MILLIS);
+
+    if (waitResult != WAIT_OBJECT_0)
     {
-        CloseHandle(m_logFilesChangeHandlerThread);
+        logWriter.TraceError(
+            Utility::FormatString(
+                L"Failed to wait for log file monitor to stop. Log directory: %s Error: %lu",
+                m_logDirectory.c_str(),
+                waitResult == WAIT_FAILED ? GetLastError() : waitResult
+            ).c_str()
+        );
     }
 
-    if (!m_dirMonitorStartedEvent)
+    //
+    // Save the offsets of the last reads.
+    //
+    if (m_checkpointStore)
     {
-        CloseHandle(m_dirMonitorStartedEvent);
+        m_checkpointStore->Flush();
     }
 
-    if (!m_workerThreadEvent)
+    if (m_logDirMonitorThread)
     {
-        CloseHandle(m_workerThreadEvent);
+        CloseHandle(m_logDirMonitorThread);
     }
 
-    if (!m_overlappedEvent)
+    if (m_dirMonitorStartedEvent)
     {
-        CloseHandle(m_overlappedEvent);
+        CloseHandle(m_dirMonitorStartedEvent);
     }
 
-    if (!m_stopEvent)
+    if (m_stopEvent)
     {
         CloseHandle(m_stopEvent);
     }
@@ -200,7 +297,7 @@ LogFileMonitor::~LogFileMonitor()
 
 
 ///
-/// Worker routine to monitor log directory changes.
+/// Routine of the start thread, that opens the log directory and starts watching it.
 ///
 /// \param Context: LogFileMonitor object passed in as callback context
 ///
@@ -253,55 +350,80 @@ LogFileMonitor::StartLogFileMonitorStatic(
     }
 }
 
-DWORD LogFileMonitor::EnqueueDirChangeEvents(DirChangeNotificationEvent event, BOOLEAN lock = TRUE) {
-    if (event.Action != EventAction::ReInit && event.Action != EventAction::RenameNew)
+///
+/// Checks if a notified change is of a file matching the filter.
+///
+/// \param FileName     The relative path of the changed file. If it's a short
+///                     path, it's replaced with the long path.
+///
+/// \return true if the file matches the filter.
+///
+bool
+LogFileMonitor::IsChangeOfMonitoredFile(
+    _Inout_ std::wstring& FileName
+    )
+{
+    if (m_filter.Matches(FileName))
     {
-        if (!FileMatchesFilter((LPCWSTR)(event.FileName.c_str()), m_filter.c_str()))
-        {
-            //
-            // It could be because the name was short formatted. Make it long path and try again.
-            //
-            event.FileName = Utility::GetLongPath(m_logDirectory + L'\\' + event.FileName)
-                                        .substr(m_logDirectory.size() + 1);
+        return true;
+    }
 
-            if (!FileMatchesFilter((LPCWSTR)(event.FileName.c_str()), m_filter.c_str()))
-            {
-                return ERROR_NO_MATCH;
-            }
-        }
+    //
+    // It could be because the name was short formatted. Make it long path and try again.
+    //
+    FileName = Utility::GetLongPath(m_logDirectory + L'\\' + FileName).substr(m_logDirectory.size() + 1);
+
+    return m_filter.Matches(FileName);
+}
+
+///
+/// Queues a batch of change events for the change handler, and clears
+/// the batch. If the queue is empty, which is the common case as the handler
+/// takes the whole queue at once, the batches are just swapped.
+///
+/// \param Events       The events to queue.
+/// \param IsLockHeld   true if the caller holds m_eventQueueLock.
+///
+void
+LogFileMonitor::EnqueueDirChangeEvents(
+    _Inout_ DirChangeEventBatch& Events,
+    _In_ bool IsLockHeld
+    )
+{
+    if (Events.Empty())
+    {
+        return;
     }
 
-    if(lock) AcquireSRWLockExclusive(&m_eventQueueLock);
+    if (!IsLockHeld) AcquireSRWLockExclusive(&m_eventQueueLock);
 
-    m_directoryChangeEvents.emplace(event);
+    const bool wasEmpty = m_directoryChangeEvents.Empty();
 
-    if (m_directoryChangeEvents.size() == 1)
+    if (wasEmpty)
     {
-        //wprintf(L"Signalling worker thread to start processing the event queue\n");
-        if(!SetEvent(m_workerThreadEvent))
-        {
-            logWriter.TraceError(
-                Utility::FormatString(
-                    L"Failed to signal worker thread of log changes."
-                    " This may cause lag in log file monitoring or lost log messages."
-                    " Log directory: %ws, Error: %d",
-                    m_logDirectory.c_str(),
-                    GetLastError()
-                ).c_str()
-            );
-        }
+        m_directoryChangeEvents.Swap(Events);
+    }
+    else
+    {
+        m_directoryChangeEvents.Append(Events);
     }
 
-    if(lock) ReleaseSRWLockExclusive(&m_eventQueueLock);
+    if (wasEmpty)
+    {
+        m_watchEngine->Signal(m_watchRegistration);
+    }
 
-    return ERROR_SUCCESS;
+    if (!IsLockHeld) ReleaseSRWLockExclusive(&m_eventQueueLock);
+
+    Events.Clear();
 }
 
 
 ///
-/// Entry for the spawned log file monitor thread. It loops to wait for either the stop event in which case it exits
-/// or for the log file changes. When log file changes are notified, it inserts the changed file information into a
-/// queue, signal the change notification worker thread, resets, and starts the wait again.
+/// Entry for the spawned start thread. It opens the log directory, waiting for it to be created if needed,
+/// associates it with the completion port of the directory watch engine and issues the first
+/// ReadDirectoryChangesW call. The work of the source is then signaled, so it enumerates the log files.
+/// The directory is enumerated once it's watched, so no file created meanwhile is missed.
 ///
 /// \return ERROR_SUCCESS: If log monitoring is started successfully
 ///         Failure:       If log directory monitoring failed.
@@ -310,19 +432,8 @@ DWORD
 LogFileMonitor::StartLogFileMonitor()
 {
     DWORD status = ERROR_SUCCESS;
-    const DWORD eventsCount = 2;
-    bool changeHandlerThreadCreated = false;
-    bool dirMonitorStartedEventSignalled = false;
-
-    //
-    // Order stop event first so that stop is prioritized if both events are already signalled (changes
-    // are available but stop has been called).
-    //
-    HANDLE events[eventsCount] = {m_stopEvent, m_overlapped.hEvent};
-    bool stopWatching = false;
 
     SetEvent(m_dirMonitorStartedEvent);
-    dirMonitorStartedEventSignalled = true;
 
     // Get Log Dir Handle
     HANDLE logDirHandle = FileMonitorUtilities::GetLogDirHandle(m_logDirectory, m_stopEvent, m_waitInSeconds);
@@ -356,227 +467,231 @@ LogFileMonitor::StartLogFileMonitor()
     m_logDirectory = Utility::GetLongPath(m_logDirectory);
     m_shortLogDirectory = Utility::GetShortPath(m_logDirectory);
 
-    status = InitializeDirectoryChangeEventsQueue();
+    status = m_watchEngine->AssociateDirectory(m_watchRegistration, m_logDirHandle);
     if (status != ERROR_SUCCESS)
     {
-        //
-        // Failed to enumerate log files in a directory.
-        // Ignore the failure and continue. Some log file
-        // information will not be monitored.
-        //
         logWriter.TraceError(
             Utility::FormatString(
-                L"Failed to open enumerate log directory. Directory: %ws Error=%d",
+                L"Failed to monitor log directory changes. Log directory: %ws, Error: %d",
                 m_logDirectory.c_str(),
                 status
             ).c_str()
         );
+        return status;
     }
 
-    //
-    // Initialize the list of log file in a given directory and start a worker thread to
-    // process directory change notification events.
-    //
-    while (!stopWatching)
+    AcquireSRWLockExclusive(&m_notificationLock);
+
+    status = ArmDirectoryChangesRead();
+
+    ReleaseSRWLockExclusive(&m_notificationLock);
+
+    if (status == ERROR_SUCCESS)
+    {
+        m_watchEngine->Signal(m_watchRegistration);
+    }
+
+    return status;
+}
+
+
+///
+/// Issues a ReadDirectoryChangesW call on the armed notification buffer. It
+/// completes in a worker of the directory watch engine. Must be called with
+/// m_notificationLock held.
+///
+/// \return ERROR_SUCCESS if the call is pending, ERROR_OPERATION_ABORTED if
+///         the source is stopping, or the error of the call.
+///
+DWORD
+LogFileMonitor::ArmDirectoryChangesRead()
+{
+    DWORD status = ERROR_SUCCESS;
+
+    while (true)
     {
-        std::fill(records.begin(), records.end(), (BYTE)0); // Reset previous entries if any.
-        m_overlapped.Offset = 0;
-        m_overlapped.OffsetHigh = 0;
+        if (!m_watchEngine->BeginDirectoryRead(m_watchRegistration))
+        {
+            return ERROR_OPERATION_ABORTED;
+        }
+
+        std::vector<BYTE>& buffer = m_notificationBuffers[m_armedNotificationBuffer];
+
+        //
+        // The buffer isn't cleared between calls, as only the bytes reported
+        // by the completion are parsed. It's only resized after it grew.
+        //
+        if (buffer.size() != m_notificationBufferSize)
+        {
+            buffer.resize(m_notificationBufferSize);
+        }
+
+        m_overlapped = {};
         BOOL success = ReadDirectoryChangesW(
             m_logDirHandle,
-            records.data(),
-            static_cast<ULONG>(records.size()),
+            buffer.data(),
+            static_cast<ULONG>(buffer.size()),
             m_includeSubfolders,
             LOG_DIR_NOTIFY_FILTERS,
             nullptr,
             &m_overlapped,
             nullptr);
 
-        if (!success)
+        if (success)
         {
-            status = GetLastError();
-            if (status == ERROR_NOTIFY_ENUM_DIR)
-            {
-                status = ERROR_SUCCESS;
-                if (!dirMonitorStartedEventSignalled)
-                {
-                    SetEvent(m_dirMonitorStartedEvent);
-                    dirMonitorStartedEventSignalled = true;
-                }
-
-                //
-                // The change buffer was full and all events were discarded. Scan the directory again
-                // and create file add event for each log file. In cse of failure, just log message
-                // and continue.
-                //
-                DirChangeNotificationEvent changeEvent;
-
-                changeEvent.Timestamp = GetTickCount64();
-                changeEvent.Action = EventAction::ReInit;
+            return ERROR_SUCCESS;
+        }
 
-                EnqueueDirChangeEvents(changeEvent);
+        status = GetLastError();
 
-                continue;
-            }
-            else
-            {
-                logWriter.TraceError(
-                    Utility::FormatString(
-                        L"Failed to monitor log directory changes. Log directory: %ws, Error: %d",
-                        m_logDirectory.c_str(),
-                        status
-                    ).c_str()
-                );
-            }
-        }
+        m_watchEngine->AbortDirectoryRead(m_watchRegistration);
 
-        if (!dirMonitorStartedEventSignalled)
+        if (status == ERROR_NOTIFY_ENUM_DIR)
         {
-            SetEvent(m_dirMonitorStartedEvent);
-            dirMonitorStartedEventSignalled = true;
+            NotificationBufferOverflowHandler();
         }
-
-        if (status == ERROR_SUCCESS)
+        else if (status == ERROR_INVALID_PARAMETER &&
+                 buffer.size() > NETWORK_NOTIFICATION_BUFFER_MAX_SIZE_BYTES)
         {
-            if (!changeHandlerThreadCreated)
-            {
-                m_logFilesChangeHandlerThread = CreateThread(
-                    nullptr,
-                    0,
-                    (LPTHREAD_START_ROUTINE)&LogFileMonitor::LogFilesChangeHandlerStatic,
-                    this,
-                    0,
-                    nullptr);
-                if (!m_logFilesChangeHandlerThread)
-                {
-                    status = GetLastError();
-                    logWriter.TraceError(
-                        Utility::FormatString(
-                            L"Failed to create a thread to read log files from directory: %ws Error=%d",
-                            m_logDirectory.c_str(),
-                            status
-                        ).c_str()
-                    );
-
-                    return status;
-                }
-                else
-                {
-                    changeHandlerThreadCreated = true;
-                }
-            }
-
-            DWORD wait = WaitForMultipleObjects(eventsCount, events, FALSE, INFINITE);
-            switch(wait)
-            {
-                case WAIT_OBJECT_0:
-                {
-                    //
-                    // Clear the event queue
-                    //
-                    AcquireSRWLockExclusive(&m_eventQueueLock);
-
-                    while (m_directoryChangeEvents.size() > 0)
-                    {
-                        m_directoryChangeEvents.pop();
-                    }
-
-                    ReleaseSRWLockExclusive(&m_eventQueueLock);
-
-                    stopWatching = true;
-                }
-                break;
-
-                case WAIT_OBJECT_0 + 1:
-                {
-                    status = LogDirectoryChangeNotificationHandler();
-                }
-                break;
+            //
+            // Directories on a network share don't accept buffers larger
+            // than 64 KB. Stay at that size from now on.
+            //
+            m_notificationBufferSize = NETWORK_NOTIFICATION_BUFFER_MAX_SIZE_BYTES;
+            m_maxNotificationBufferSize = NETWORK_NOTIFICATION_BUFFER_MAX_SIZE_BYTES;
 
-                default:
-                    status = GetLastError();
-                    logWriter.TraceError(
-                        Utility::FormatString(
-                            L"Failed to monitor log directory changes."
-                            L" Wait operation failed. Log directory: %ws, Error: %d",
-                            m_logDirectory.c_str(),
-                            status
-                        ).c_str()
-                    );
-                    stopWatching = true;
-            }
+            logWriter.TraceWarning(
+                Utility::FormatString(
+                    L"Log directory %ws doesn't accept a change notification buffer of %lu KB."
+                    L" Using %lu KB instead.",
+                    m_logDirectory.c_str(),
+                    static_cast<DWORD>(buffer.size() / 1024),
+                    NETWORK_NOTIFICATION_BUFFER_MAX_SIZE_BYTES / 1024
+                ).c_str()
+            );
         }
         else
         {
-            stopWatching = true;
+            logWriter.TraceError(
+                Utility::FormatString(
+                    L"Failed to monitor log directory changes. Log directory: %ws, Error: %d",
+                    m_logDirectory.c_str(),
+                    status
+                ).c_str()
+            );
+            return status;
         }
     }
-
-    return status;
 }
 
 
 ///
-/// Check if the filename matches a filter.
+/// Called by a worker of the directory watch engine when a ReadDirectoryChangesW
+/// call completed. The other notification buffer is armed before the completed
+/// one is parsed, and its changes are queued for the change handler.
 ///
-/// \param FileName         The filename to be evaluated.
-/// \param SearchPattern    The filter to evaluate with.
+/// \param Status               The status of the call.
+/// \param BytesTransferred     The size of the notifications in the buffer.
 ///
-/// \return True if the file matches filter. Otherwise, false
-///
-inline BOOL
-LogFileMonitor::FileMatchesFilter(
-    _In_ LPCWSTR FileName,
-    _In_ LPCWSTR SearchPattern
+void
+LogFileMonitor::OnDirectoryChangesCompleted(
+    _In_ DWORD Status,
+    _In_ DWORD BytesTransferred
     )
 {
-    return PathMatchSpec(FileName, SearchPattern);
-}
-
-
-DWORD
-LogFileMonitor::InitializeMonitoredFilesInfo()
-{
-    DWORD status = ERROR_SUCCESS;
+    if (Status == ERROR_OPERATION_ABORTED)
+    {
+        //
+        // The read was cancelled, the source is stopping.
+        //
+        return;
+    }
 
-    return status;
-}
+    AcquireSRWLockExclusive(&m_notificationLock);
 
+    DWORD pendingNotificationsSize = 0;
 
-DWORD
-LogFileMonitor::LogDirectoryChangeNotificationHandler()
-{
-    DWORD status = ERROR_SUCCESS;
-    DWORD dwBytesTransfered = 0;
-    DWORD dwNextEntryOffset = 0;
+    if (Status == ERROR_NOTIFY_ENUM_DIR || (Status == ERROR_SUCCESS && BytesTransferred == 0))
+    {
+        //
+        // No data means the notifications didn't fit in the buffer.
+        //
+        NotificationBufferOverflowHandler();
+    }
+    else if (Status != ERROR_SUCCESS)
+    {
+        logWriter.TraceError(
+            Utility::FormatString(
+                L"Failed to monitor log directory changes. Log directory: %ws, Error: %d",
+                m_logDirectory.c_str(),
+                Status
+            ).c_str()
+        );
 
-    if (!GetOverlappedResult(m_logDirHandle, &m_overlapped, &dwBytesTransfered, FALSE))
+        ReleaseSRWLockExclusive(&m_notificationLock);
+        return;
+    }
+    else
     {
-        status = GetLastError();
-        return status;
+        //
+        // Arm the other buffer before parsing this one.
+        //
+        pendingNotificationsSize = BytesTransferred;
+        m_armedNotificationBuffer ^= 1;
     }
 
-    if (dwBytesTransfered)
+    ArmDirectoryChangesRead();
+
+    if (pendingNotificationsSize > 0)
     {
-        int i = 0;
-        FILE_NOTIFY_INFORMATION *fileNotificationInfo = reinterpret_cast<PFILE_NOTIFY_INFORMATION>(records.data());
-        WCHAR pszFileName[4096];
-        do
-        {
-            i++;
+        LogDirectoryChangeNotificationHandler(
+            m_notificationBuffers[m_armedNotificationBuffer ^ 1].data(),
+            pendingNotificationsSize);
+    }
 
-            //
-            // Extract the FileName
-            //
-            DWORD dwFileNameLength = fileNotificationInfo->FileNameLength / sizeof(WCHAR);
-            if (dwFileNameLength > 4096)
-            {
-                dwFileNameLength = 4095;
-            }
-            CopyMemory(pszFileName, fileNotificationInfo->FileName, sizeof(WCHAR)*dwFileNameLength);
-            pszFileName[dwFileNameLength] = '\0';
+    ReleaseSRWLockExclusive(&m_notificationLock);
+}
+
+
+DWORD
+LogFileMonitor::InitializeMonitoredFilesInfo()
+{
+    DWORD status = ERROR_SUCCESS;
+
+    return status;
+}
+
+
+///
+/// Queues the changes of a completed change notification buffer.
+///
+/// \param Buffer               The change notification buffer.
+/// \param BytesTransferred     The size of the notifications in the buffer.
+///
+/// \return A DWORD representing the status.
+///
+DWORD
+LogFileMonitor::LogDirectoryChangeNotificationHandler(
+    _In_reads_bytes_(BytesTransferred) const BYTE* Buffer,
+    _In_ DWORD BytesTransferred
+    )
+{
+    DWORD dwNextEntryOffset = 0;
+
+    if (BytesTransferred)
+    {
+        const FILE_NOTIFY_INFORMATION *fileNotificationInfo =
+            reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(Buffer);
 
-            std::wstring fileName = pszFileName;
+        const UINT64 timestamp = GetTickCount64();
+        UINT64 receivedChangeEvents = 0;
+        std::wstring fileName;
+
+        do
+        {
+            fileName.assign(
+                fileNotificationInfo->FileName,
+                fileNotificationInfo->FileNameLength / sizeof(WCHAR));
 
             DirChangeNotificationEvent changeEvent;
 
@@ -614,30 +729,74 @@ LogFileMonitor::LogDirectoryChangeNotificationHandler()
                 }
             }
 
-            if (changeEvent.Action == EventAction::Add ||
-                changeEvent.Action == EventAction::Remove ||
-                changeEvent.Action == EventAction::Modify ||
-                changeEvent.Action == EventAction::RenameOld ||
-                changeEvent.Action == EventAction::RenameNew)
+            //
+            // Renamed files are checked against the filter when they're
+            // handled, as renaming a file can make it match or not.
+            //
+            if (changeEvent.Action == EventAction::RenameNew ||
+                ((changeEvent.Action == EventAction::Add ||
+                  changeEvent.Action == EventAction::Remove ||
+                  changeEvent.Action == EventAction::Modify ||
+                  changeEvent.Action == EventAction::RenameOld) &&
+                 IsChangeOfMonitoredFile(fileName)))
             {
-                changeEvent.FileName = fileName;
-                changeEvent.Timestamp = GetTickCount64();
-
-                EnqueueDirChangeEvents(changeEvent);
+                m_notifiedChangeEvents.Add(changeEvent.Action, fileName, timestamp);
             }
 
+            receivedChangeEvents++;
+
             dwNextEntryOffset = fileNotificationInfo->NextEntryOffset;
-            fileNotificationInfo =
-                (FILE_NOTIFY_INFORMATION*)((LPBYTE)fileNotificationInfo + fileNotificationInfo->NextEntryOffset);
+            fileNotificationInfo = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(
+                reinterpret_cast<const BYTE*>(fileNotificationInfo) + fileNotificationInfo->NextEntryOffset);
 
         } while (dwNextEntryOffset);
+
+        m_receivedChangeEvents += receivedChangeEvents;
+
+        EnqueueDirChangeEvents(m_notifiedChangeEvents);
     }
-    else
+
+    return S_OK;
+}
+
+
+///
+/// Handles the loss of the change notifications because the buffer was full.
+/// The directory is rescanned, and the buffer is doubled for the next calls,
+/// up to its maximum size, so it fits the bursts of the directory.
+///
+void
+LogFileMonitor::NotificationBufferOverflowHandler()
+{
+    FILETIME now;
+    GetSystemTimeAsFileTime(&now);
+
+    const UINT64 overflows = ++m_notificationOverflows;
+    m_lastNotificationOverflowTime = (static_cast<UINT64>(now.dwHighDateTime) << 32) | now.dwLowDateTime;
+
+    DWORD bufferSize = m_notificationBufferSize;
+
+    if (bufferSize < m_maxNotificationBufferSize)
     {
-        logWriter.TraceError(L"Error monitoring log directory. Invalid directory change notification data.");
+        bufferSize = bufferSize > m_maxNotificationBufferSize / 2 ? m_maxNotificationBufferSize : bufferSize * 2;
+        m_notificationBufferSize = bufferSize;
     }
 
-    return S_OK;
+    logWriter.TraceWarning(
+        Utility::FormatString(
+            L"Change notifications of log directory %ws were lost, rescanning it. Overflows: %llu,"
+            L" notification buffer size: %lu KB",
+            m_logDirectory.c_str(),
+            overflows,
+            bufferSize / 1024
+        ).c_str()
+    );
+
+    DirChangeEventBatch events;
+
+    events.Add(EventAction::ReInit, L"", GetTickCount64());
+
+    EnqueueDirChangeEvents(events);
 }
 
 
@@ -645,11 +804,11 @@ DWORD
 LogFileMonitor::InitializeDirectoryChangeEventsQueue()
 {
     DWORD status = ERROR_SUCCESS;
-    std::vector<std::pair<std::wstring, FILE_ID_INFO> > logFiles;
+    std::vector<ListedLogFile> logFiles;
 
     //wprintf(L"InitializeDirectoryChangeEventsQueue\n");
 
-    status = GetFilesInDirectory(m_logDirectory, m_filter, logFiles, m_includeSubfolders);
+    status = GetFilesInDirectory(m_logDirectory, logFiles, m_includeSubfolders);
 
     if (status == ERROR_SUCCESS)
     {
@@ -665,16 +824,31 @@ LogFileMonitor::InitializeDirectoryChangeEventsQueue()
 
         m_readLogFilesFromStart = false;
 
-        for (auto file : logFiles)
+        std::set<std::wstring> checkpointKeys;
+        DirChangeEventBatch events;
+
+        for (const auto& file : logFiles)
         {
-            const std::wstring& fileName = file.first;
-            const FILE_ID_INFO& fileId = file.second;
+            const std::wstring& fileName = file.FullLongPath;
+            const FILE_ID_INFO& fileId = file.FileId;
 
             const std::wstring longPath = fileName.substr(m_logDirectory.size() + 1);
 
-            auto element = GetLogFilesInformationIt(longPath);
+            //
+            // A file with a checkpoint is resumed where the previous run stopped.
+            //
+            FileCheckpoint checkpoint;
+            bool isCheckpointed = false;
+
+            if (m_checkpointStore)
+            {
+                const std::wstring checkpointKey = CheckpointStore::GetKey(fileId, longPath);
+
+                isCheckpointed = m_checkpointStore->Find(checkpointKey, checkpoint);
+                checkpointKeys.insert(checkpointKey);
+            }
 
-            if (element != m_logFilesInformation.end())
+            if (m_logFiles.Find(longPath))
             {
                 //
                 // Log file already exist. Do nothing.
@@ -690,17 +864,18 @@ LogFileMonitor::InitializeDirectoryChangeEventsQueue()
                 logFileInfo->NextReadOffset = 0;
                 logFileInfo->LastReadTimestamp = 0;
 
-                if (!readLogFileFromStart)
+                //
+                // A rescan after lost notifications only opens the files
+                // whose directory entry changed since this listing.
+                //
+                logFileInfo->ListedSize = file.Size;
+                logFileInfo->ListedWriteTime = file.LastWriteTime;
+
+                if (!readLogFileFromStart || isCheckpointed)
                 {
                     LARGE_INTEGER fileSize = {};
 
-                    HANDLE logFile = CreateFileW(fileName.c_str(),
-                                                  GENERIC_READ,
-                                                  FILE_SHARE_READ | FILE_SHARE_WRITE,
-                                                  nullptr,
-                                                  OPEN_EXISTING,
-                                                  FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
-                                                  nullptr);
+                    HANDLE logFile = OpenLogFileHandle(fileName);
                     if (logFile == INVALID_HANDLE_VALUE)
                     {
                         //
@@ -736,26 +911,69 @@ LogFileMonitor::InitializeDirectoryChangeEventsQueue()
                             ).c_str()
                         );
                     }
+                    else if (isCheckpointed)
+                    {
+                        //
+                        // A file smaller than its checkpoint was truncated, and a file
+                        // whose beginning doesn't match the checkpoint fingerprint was
+                        // rewritten. Read them again.
+                        //
+                        UINT64 checkpointOffset =
+                            checkpoint.Offset <= static_cast<UINT64>(fileSize.QuadPart) ? checkpoint.Offset : 0;
+
+                        if (checkpointOffset > 0 && checkpoint.FingerprintSize > 0)
+                        {
+                            UINT64 fingerprint = 0;
+
+                            if (GetHeaderFingerprint(logFile, checkpoint.FingerprintSize, fingerprint) &&
+                                fingerprint == checkpoint.Fingerprint)
+                            {
+                                logFileInfo->FingerprintSize = checkpoint.FingerprintSize;
+                                logFileInfo->Fingerprint = checkpoint.Fingerprint;
+                            }
+                            else
+                            {
+                                checkpointOffset = 0;
+                            }
+                        }
+
+                        logFileInfo->NextReadOffset = checkpointOffset;
+                        logFileInfo->LastObservedSize = fileSize.QuadPart;
+                        logFileInfo->EncodingType = checkpoint.EncodingType;
+
+                        logFileInfo->CheckpointKey = CheckpointStore::GetKey(fileId, longPath);
+                        logFileInfo->CheckpointFileId = fileId;
+                        logFileInfo->CheckpointOffset = checkpointOffset;
+                    }
                     else
                     {
                         logFileInfo->NextReadOffset = fileSize.QuadPart;
+                        logFileInfo->LastObservedSize = fileSize.QuadPart;
                     }
 
-                    CloseHandle(logFile);
+                    //
+                    // Keep the handle, it will be used to tail the file.
+                    //
+                    logFileInfo->FileHandle = logFile;
                 }
 
-                m_longPaths[shortPath] = longPath;
-                m_logFilesInformation[longPath] = std::move(logFileInfo);
-                m_fileIds[fileId] = longPath;
+                logFileInfo->FileId = fileId;
+
+                m_logFiles.Insert(longPath, shortPath, fileId, logFileInfo);
             }
 
-            DirChangeNotificationEvent changeEvent;
+            events.Add(EventAction::Modify, longPath, GetTickCount64());
+        }
 
-            changeEvent.Action = EventAction::Modify;
-            changeEvent.FileName = longPath;
-            changeEvent.Timestamp = GetTickCount64();
+        EnqueueDirChangeEvents(events, true);
 
-            EnqueueDirChangeEvents(changeEvent, FALSE);
+        //
+        // Drop the checkpoints of the files deleted while the tool wasn't running.
+        //
+        if (m_checkpointStore && !m_areCheckpointsPruned)
+        {
+            m_checkpointStore->Prune(checkpointKeys);
+            m_areCheckpointsPruned = true;
         }
 
         ReleaseSRWLockExclusive(&m_eventQueueLock);
@@ -775,80 +993,37 @@ LogFileMonitor::InitializeDirectoryChangeEventsQueue()
 }
 
 
-DWORD
-LogFileMonitor::LogFilesChangeHandlerStatic(
-    _In_ LPVOID Context
-    )
+///
+/// Called by a worker of the directory watch engine when the source was
+/// signaled or its timer is due. It handles the queued change events, then
+/// the periodic tasks that are due, and arms the timer for the next ones.
+///
+void
+LogFileMonitor::OnWork()
 {
-    auto pThis = reinterpret_cast<LogFileMonitor*>(Context);
-    try
-    {
-        DWORD status = pThis->LogFilesChangeHandler();
-        if (status != ERROR_SUCCESS)
-        {
-            logWriter.TraceError(
-                Utility::FormatString(
-                    L"Failed to monitor log directory changes."
-                    L" Log files in a directory %s will not be monitored. Error: %lu",
-                    pThis->m_logDirectory.c_str(),
-                    status
-                ).c_str()
-            );
-        }
-        return status;
-    }
-    catch (std::exception& ex)
-    {
-        logWriter.TraceError(
-            Utility::FormatString(
-                L"Failed to monitor log directory changes. Log files in a directory %s will not be monitored. %S",
-                pThis->m_logDirectory.c_str(),
-                ex.what()
-            ).c_str()
-        );
-        return ERROR_UNHANDLED_EXCEPTION;
-    }
-    catch (...)
+    if (!m_isChangeHandlerStarted)
     {
-        logWriter.TraceError(
-            Utility::FormatString(
-                L"Failed to monitor log directory changes. Log files in a directory %s will not be monitored",
-                pThis->m_logDirectory.c_str()
-            ).c_str()
-        );
-        return ERROR_UNHANDLED_EXCEPTION;
+        StartChangeHandler();
     }
-}
 
+    HandleDirChangeEvents();
 
-DWORD
-LogFileMonitor::LogFilesChangeHandler()
-{
-    DWORD status = ERROR_SUCCESS;
-    bool stopWatching = false;
-    const DWORD eventsCount = 3;
+    HandleTimer();
 
-    LARGE_INTEGER liDueTime;
-    INT64 millisecondsToWait = 1000LL;
-    liDueTime.QuadPart = -millisecondsToWait*10000LL; // wait time in 100 nanoseconds
+    SetChangeHandlerTimer();
+}
 
-    HANDLE timerEvent = CreateWaitableTimer(NULL, FALSE, NULL);
-    if (!timerEvent)
-    {
-        status = GetLastError();
-        logWriter.TraceError(
-            Utility::FormatString(
-                L"Failed to create timer object to monitor log file changes in directory %s. Error: %lu",
-                m_logDirectory.c_str(),
-                status
-            ).c_str()
-        );
-        return status;
-    }
 
-    HANDLE events[eventsCount] = {m_stopEvent, m_workerThreadEvent, timerEvent};
+///
+/// Enumerates the log directory, once it's watched, and schedules the first
+/// periodic tasks.
+///
+void
+LogFileMonitor::StartChangeHandler()
+{
+    m_isChangeHandlerStarted = true;
 
-    status = InitializeDirectoryChangeEventsQueue();
+    DWORD status = InitializeDirectoryChangeEventsQueue();
 
     if (status != ERROR_SUCCESS)
     {
@@ -860,178 +1035,513 @@ LogFileMonitor::LogFilesChangeHandler()
         );
     }
 
-    if (!SetWaitableTimer(timerEvent, &liDueTime, 0, NULL, NULL, 0))
-    {
-        status = GetLastError();
+    const UINT64 now = GetTickCount64();
 
-        logWriter.TraceError(
-            Utility::FormatString(
-                L"Failed to set timer object to monitor log file changes in directory %s. Error: %lu",
-                m_logDirectory.c_str(),
-                status
-            ).c_str()
-        );
-    }
+    m_nextSweepTimestamp = now + static_cast<UINT64>(m_tuning.SweepIntervalInSeconds * 1000);
+    m_nextLatencyReportTimestamp = now + m_tuning.LatencyReportIntervalInSeconds * 1000ULL;
+    m_nextCheckpointTimestamp = now + m_tuning.CheckpointIntervalInSeconds * 1000ULL;
+}
+
+
+///
+/// Handles the queued change events. The whole queue is swapped with a batch
+/// of the change handler, so the directory reads can queue new events while
+/// these are handled.
+///
+void
+LogFileMonitor::HandleDirChangeEvents()
+{
+    DirChangeEventBatch& changeEvents = m_handledChangeEvents;
+    DirChangeNotificationEvent changeEvent;
+
+    AcquireSRWLockExclusive(&m_eventQueueLock);
+
+    changeEvents.Swap(m_directoryChangeEvents);
+
+    ReleaseSRWLockExclusive(&m_eventQueueLock);
 
-    while (!stopWatching)
+    for (size_t i = 0; i < changeEvents.Size(); i++)
     {
-        DWORD wait = WaitForMultipleObjects(eventsCount, events, FALSE, INFINITE);
-        switch(wait)
+        changeEvents.Get(i, changeEvent);
+
+        //
+        // Try to recover the long path. The worst case is when it's already
+        // a long path, and it will make a useless variable reassign.
+        //
+        std::wstring longPath;
+
+        if (m_logFiles.FindLongPath(changeEvent.FileName, longPath))
         {
-            case WAIT_OBJECT_0:
+            changeEvent.FileName = std::move(longPath);
+        }
+
+        switch (changeEvent.Action)
+        {
+            case EventAction::Add:
             {
-                stopWatching = true;
-                CancelWaitableTimer(timerEvent);
+                LogFileAddEventHandler(changeEvent);
+                break;
             }
-            break;
 
-            case WAIT_OBJECT_0 + 1:
+            case EventAction::Modify:
             {
-                AcquireSRWLockExclusive(&m_eventQueueLock);
+                LogFileModifyEventHandler(changeEvent);
+                break;
+            }
 
-                while (m_directoryChangeEvents.size() > 0)
-                {
-                    auto event = m_directoryChangeEvents.front();
-                    m_directoryChangeEvents.pop();
+            case EventAction::Remove:
+            {
+                LogFileRemoveEventHandler(changeEvent);
+                break;
+            }
 
-                    //
-                    // Try to recover the long path. The worst case is when it's already
-                    // a long path, and it will make a useless variable reassign.
-                    //
-                    auto it = m_longPaths.find(event.FileName);
+            case EventAction::RenameOld:
+            {
+                //
+                // Nothing to do
+                //
+                break;
+            }
 
-                    if (it != m_longPaths.end())
-                    {
-                        event.FileName = it->second;
-                    }
+            case EventAction::RenameNew:
+            {
+                LogFileRenameNewEventHandler(changeEvent);
+                break;
+            }
 
-                    ReleaseSRWLockExclusive(&m_eventQueueLock);
+            case EventAction::ReInit:
+            {
+                LogFileReInitEventHandler(changeEvent);
+                break;
+            }
 
-                    switch (event.Action)
-                    {
-                        case EventAction::Add:
-                        {
-                            status = LogFileAddEventHandler(event);
-                            break;
-                        }
+            default:
+                break;
+        }
+    }
 
-                        case EventAction::Modify:
-                        {
-                            status = LogFileModifyEventHandler(event);
-                            break;
-                        }
+    m_dispatchedChangeEvents += changeEvents.Size();
 
-                        case EventAction::Remove:
-                        {
-                            status = LogFileRemoveEventHandler(event);
-                            break;
-                        }
+    changeEvents.Clear();
+}
 
-                        case EventAction::RenameOld:
-                        {
-                            //
-                            // Nothing to do
-                            //
-                            break;
-                        }
 
-                        case EventAction::RenameNew:
-                        {
-                            status = LogFileRenameNewEventHandler(event);
-                            break;
-                        }
+///
+/// Runs the periodic tasks that are due: the deferred reads, the sweep, the
+/// reports, the checkpoint and the next step of the directory rescan.
+///
+void
+LogFileMonitor::HandleTimer()
+{
+    ScheduleDeferredReads();
 
-                        case EventAction::ReInit:
-                        {
-                            status = LogFileReInitEventHandler(event);
-                            break;
-                        }
+    //
+    // The sweep reads the files whose changes weren't notified.
+    // NTFS may not notify size changes of files kept open by
+    // their writer until their metadata is flushed.
+    //
+    const UINT64 now = GetTickCount64();
 
-                        default:
-                            break;
-                    }
+    if (now >= m_nextSweepTimestamp)
+    {
+        for (const auto& logFileInfo : m_logFiles.GetAll())
+        {
+            ScheduleLogFileRead(logFileInfo);
+        }
 
-                    AcquireSRWLockExclusive(&m_eventQueueLock);
-                }
+        m_nextSweepTimestamp = now + static_cast<UINT64>(m_tuning.SweepIntervalInSeconds * 1000);
+    }
 
-                if(!ResetEvent(m_workerThreadEvent))
-                {
-                    status = GetLastError();
+    if (m_tuning.LatencyReportIntervalInSeconds > 0 && now >= m_nextLatencyReportTimestamp)
+    {
+        ReportReadLatency();
+        ReportNotificationOverflows();
+        ReportChangeEvents();
+        ReportLogFileRotations();
+        ReportReadLag();
 
-                    logWriter.TraceError(
-                        Utility::FormatString(
-                            L"Failed to reset event object to monitor log file changes in directory %s. Error: %lu",
-                            m_logDirectory.c_str(),
-                            status
-                        ).c_str()
-                    );
-                    stopWatching = true;
-                }
+        m_nextLatencyReportTimestamp = now + m_tuning.LatencyReportIntervalInSeconds * 1000ULL;
+    }
 
-                if (!SetWaitableTimer(timerEvent, &liDueTime, 0, NULL, NULL, 0))
-                {
-                    status = GetLastError();
+    if (m_checkpointStore && now >= m_nextCheckpointTimestamp)
+    {
+        m_checkpointStore->Flush();
 
-                    logWriter.TraceError(
-                        Utility::FormatString(
-                            L"Failed to set timer object to monitor log file changes in directory %s. Error: %lu",
-                            m_logDirectory.c_str(),
-                            status
-                        ).c_str()
-                    );
-                }
+        m_nextCheckpointTimestamp = now + m_tuning.CheckpointIntervalInSeconds * 1000ULL;
+    }
 
-                ReleaseSRWLockExclusive(&m_eventQueueLock);
-            }
-            break;
+    if (m_rescan)
+    {
+        ContinueDirectoryRescan();
+    }
+}
 
-            case WAIT_OBJECT_0 + 2:
-            {
-                map<std::wstring, std::shared_ptr<LogFileInformation>>::iterator it;
 
-                //wprintf(L"LogFilesChangeHandler: Timer event\n");
+///
+/// Arms the timer of the source for the earliest of the next sweep, the next
+/// latency report, the next checkpoint and the end of the coalescing window
+/// of the deferred reads. While a directory rescan is in progress, the timer
+/// is due right away for its next step; the change events queued meanwhile
+/// are still handled first, as the work of the source handles them before
+/// the periodic tasks.
+///
+void
+LogFileMonitor::SetChangeHandlerTimer()
+{
+    UINT64 dueTimestamp = m_nextSweepTimestamp;
 
-                for ( it = m_logFilesInformation.begin(); it != m_logFilesInformation.end(); it++ )
-                {
-                    ReadLogFile(it->second);
-                }
+    if (m_tuning.LatencyReportIntervalInSeconds > 0 && m_nextLatencyReportTimestamp < dueTimestamp)
+    {
+        dueTimestamp = m_nextLatencyReportTimestamp;
+    }
 
-                if (!SetWaitableTimer(timerEvent, &liDueTime, 0, NULL, NULL, 0))
-                {
-                    status = GetLastError();
+    if (m_checkpointStore && m_nextCheckpointTimestamp < dueTimestamp)
+    {
+        dueTimestamp = m_nextCheckpointTimestamp;
+    }
 
-                    logWriter.TraceError(
-                        Utility::FormatString(
-                            L"Failed to set timer object to monitor log file changes in directory %s. Error: %lu",
-                            m_logDirectory.c_str(),
-                            status
-                        ).c_str()
-                    );
-                }
-            }
-            break;
+    for (const auto& logFileInfo : m_deferredReads)
+    {
+        const UINT64 readTimestamp =
+            logFileInfo->LastScheduledTimestamp + m_tuning.ModifyCoalescingWindowInMilliseconds;
 
-            default:
-            {
-                status = GetLastError();
+        if (readTimestamp < dueTimestamp)
+        {
+            dueTimestamp = readTimestamp;
+        }
+    }
 
-                logWriter.TraceError(
-                    Utility::FormatString(
-                        L"Failed to wait on directory change notification events"
-                        L" to monitor log file changes in directory %s. Error: %lu",
-                        m_logDirectory.c_str(),
-                        status
-                    ).c_str()
-                );
-                stopWatching = true;
-            }
-            break;
+    if (m_rescan)
+    {
+        dueTimestamp = GetTickCount64();
+    }
+
+    m_watchEngine->SetTimer(m_watchRegistration, dueTimestamp);
+}
+
+///
+/// Traces the change notification overflows, if there were new ones since
+/// the last report.
+///
+void
+LogFileMonitor::ReportNotificationOverflows()
+{
+    const UINT64 overflows = m_notificationOverflows;
+
+    if (overflows == m_reportedNotificationOverflows)
+    {
+        return;
+    }
+
+    const UINT64 lastOverflowTime = m_lastNotificationOverflowTime;
+
+    FILETIME lastOverflowFileTime;
+    lastOverflowFileTime.dwHighDateTime = static_cast<DWORD>(lastOverflowTime >> 32);
+    lastOverflowFileTime.dwLowDateTime = static_cast<DWORD>(lastOverflowTime);
+
+    logWriter.TraceInfo(
+        Utility::FormatString(
+            L"Change notification overflows in directory %ws: %llu, last at %ws. Notification buffer size: %lu KB",
+            m_logDirectory.c_str(),
+            overflows,
+            Utility::FileTimeToString(lastOverflowFileTime).c_str(),
+            static_cast<DWORD>(m_notificationBufferSize / 1024)
+        ).c_str()
+    );
+
+    m_reportedNotificationOverflows = overflows;
+}
+
+///
+/// Traces the change notifications received and the change events handled
+/// since the last report. The difference is the modifications coalesced.
+///
+void
+LogFileMonitor::ReportChangeEvents()
+{
+    const UINT64 receivedChangeEvents = m_receivedChangeEvents;
+    const UINT64 dispatchedChangeEvents = m_dispatchedChangeEvents;
+
+    if (receivedChangeEvents == m_reportedReceivedChangeEvents)
+    {
+        return;
+    }
+
+    logWriter.TraceInfo(
+        Utility::FormatString(
+            L"Change events in directory %ws. Received: %llu, dispatched: %llu",
+            m_logDirectory.c_str(),
+            receivedChangeEvents - m_reportedReceivedChangeEvents,
+            dispatchedChangeEvents - m_reportedDispatchedChangeEvents
+        ).c_str()
+    );
+
+    m_reportedReceivedChangeEvents = receivedChangeEvents;
+    m_reportedDispatchedChangeEvents = dispatchedChangeEvents;
+}
+
+///
+/// \return The counters of the rotations of the monitored log files.
+///
+LogFileRotationCounters
+LogFileMonitor::GetRotationCounters() const
+{
+    LogFileRotationCounters counters;
+
+    counters.RenamedFiles = m_renamedLogFiles;
+    counters.ReplacedFiles = m_replacedLogFiles;
+    counters.TruncatedFiles = m_truncatedLogFiles;
+    counters.DrainedBytes = m_drainedLogFileBytes;
+
+    return counters;
+}
+
+///
+/// \return The counters of the rescans of the log directory.
+///
+LogFileRescanCounters
+LogFileMonitor::GetRescanCounters() const
+{
+    LogFileRescanCounters counters;
+
+    counters.Rescans = m_rescans;
+    counters.ListedFiles = m_rescannedListedFiles;
+    counters.ChangedFiles = m_rescannedChangedFiles;
+    counters.AddedFiles = m_rescannedAddedFiles;
+
+    return counters;
+}
+
+///
+/// Traces the rotations of the monitored log files since the last report, if
+/// there were any.
+///
+void
+LogFileMonitor::ReportLogFileRotations()
+{
+    const LogFileRotationCounters rotations = GetRotationCounters();
+
+    if (rotations.RenamedFiles == m_reportedRotations.RenamedFiles &&
+        rotations.ReplacedFiles == m_reportedRotations.ReplacedFiles &&
+        rotations.TruncatedFiles == m_reportedRotations.TruncatedFiles)
+    {
+        return;
+    }
+
+    logWriter.TraceInfo(
+        Utility::FormatString(
+            L"Log file rotations in directory %ws. Renamed: %llu, replaced: %llu, truncated: %llu."
+            L" Bytes read from rotated files: %llu",
+            m_logDirectory.c_str(),
+            rotations.RenamedFiles - m_reportedRotations.RenamedFiles,
+            rotations.ReplacedFiles - m_reportedRotations.ReplacedFiles,
+            rotations.TruncatedFiles - m_reportedRotations.TruncatedFiles,
+            rotations.DrainedBytes - m_reportedRotations.DrainedBytes
+        ).c_str()
+    );
+
+    m_reportedRotations = rotations;
+}
+
+///
+/// \return The bytes the monitored log files were behind their end when they
+///         were last read.
+///
+LogFileReadLag
+LogFileMonitor::GetReadLag() const
+{
+    LogFileReadLag lag;
+
+    for (const auto& logFileInfo : m_logFiles.GetAll())
+    {
+        const UINT64 lagBytes = logFileInfo->LagBytes;
+
+        if (lagBytes == 0)
+        {
+            continue;
+        }
+
+        lag.TotalBytes += lagBytes;
+        lag.LaggingFiles++;
+
+        if (lagBytes > lag.MostLaggingFileBytes)
+        {
+            lag.MostLaggingFileBytes = lagBytes;
+            lag.MostLaggingFile = logFileInfo->FileName;
         }
     }
 
-    CloseHandle(timerEvent);
+    return lag;
+}
 
-    return status;
+///
+/// Traces the bytes the monitored log files are behind their end, if any file
+/// is behind, or if any was in the last report.
+///
+void
+LogFileMonitor::ReportReadLag()
+{
+    const LogFileReadLag lag = GetReadLag();
+
+    if (lag.LaggingFiles == 0)
+    {
+        if (m_reportedReadLag)
+        {
+            logWriter.TraceInfo(
+                Utility::FormatString(
+                    L"Log files in directory %ws caught up with their end.",
+                    m_logDirectory.c_str()
+                ).c_str()
+            );
+
+            m_reportedReadLag = false;
+        }
+
+        return;
+    }
+
+    logWriter.TraceInfo(
+        Utility::FormatString(
+            L"Log files in directory %ws behind their end: %llu, bytes behind: %llu."
+            L" Most behind: %ws, bytes behind: %llu",
+            m_logDirectory.c_str(),
+            static_cast<UINT64>(lag.LaggingFiles),
+            lag.TotalBytes,
+            lag.MostLaggingFile.c_str(),
+            lag.MostLaggingFileBytes
+        ).c_str()
+    );
+
+    m_reportedReadLag = true;
+}
+
+///
+/// Schedules a read of a log file in the reader pool.
+///
+/// \param LogFileInfo     The log file to read.
+///
+void
+LogFileMonitor::ScheduleLogFileRead(
+    _In_ const std::shared_ptr<LogFileInformation>& LogFileInfo
+    )
+{
+    LogFileInfo->LastScheduledTimestamp = GetTickCount64();
+
+    m_watchEngine->GetReaderPool().Schedule(m_readerRegistration, LogFileInfo);
+}
+
+///
+/// Schedules a read of a modified log file. A writer flushing line by line
+/// causes a notification per line, so the reads of a file are scheduled at
+/// most once per coalescing window. A modification inside the window defers
+/// the read to the end of the window.
+///
+/// \param LogFileInfo     The modified log file.
+///
+void
+LogFileMonitor::ScheduleModifiedLogFile(
+    _In_ const std::shared_ptr<LogFileInformation>& LogFileInfo
+    )
+{
+    if (LogFileInfo->IsReadDeferred)
+    {
+        return;
+    }
+
+    if (GetTickCount64() - LogFileInfo->LastScheduledTimestamp < m_tuning.ModifyCoalescingWindowInMilliseconds)
+    {
+        LogFileInfo->IsReadDeferred = true;
+        m_deferredReads.push_back(LogFileInfo);
+        return;
+    }
+
+    ScheduleLogFileRead(LogFileInfo);
+}
+
+///
+/// Schedules the deferred reads whose coalescing window has ended.
+///
+void
+LogFileMonitor::ScheduleDeferredReads()
+{
+    const UINT64 now = GetTickCount64();
+
+    for (size_t i = 0; i < m_deferredReads.size();)
+    {
+        const std::shared_ptr<LogFileInformation> logFileInfo = m_deferredReads[i];
+
+        if (now - logFileInfo->LastScheduledTimestamp < m_tuning.ModifyCoalescingWindowInMilliseconds)
+        {
+            i++;
+            continue;
+        }
+
+        m_deferredReads[i] = std::move(m_deferredReads.back());
+        m_deferredReads.pop_back();
+
+        logFileInfo->IsReadDeferred = false;
+        ScheduleLogFileRead(logFileInfo);
+    }
+}
+
+///
+/// Records the latency of the lines written from a log file, measured from
+/// the last write to the file.
+///
+/// \param LastWriteTime   The last write time of the file, as a FILETIME.
+/// \param LinesCount      The number of lines written.
+///
+void
+LogFileMonitor::RecordReadLatency(
+    _In_ UINT64 LastWriteTime,
+    _In_ UINT64 LinesCount
+    )
+{
+    FILETIME currentFileTime;
+    GetSystemTimeAsFileTime(&currentFileTime);
+
+    const UINT64 currentTime =
+        (static_cast<UINT64>(currentFileTime.dwHighDateTime) << 32) | currentFileTime.dwLowDateTime;
+
+    //
+    // FILETIME is in 100 nanoseconds units.
+    //
+    const UINT64 latencyMillis = currentTime > LastWriteTime ? (currentTime - LastWriteTime) / 10000 : 0;
+
+    AcquireSRWLockExclusive(&m_readLatencyLock);
+    m_readLatency.Record(latencyMillis, LinesCount);
+    ReleaseSRWLockExclusive(&m_readLatencyLock);
+}
+
+///
+/// Traces the percentiles of the latencies recorded since the last report.
+///
+void
+LogFileMonitor::ReportReadLatency()
+{
+    AcquireSRWLockExclusive(&m_readLatencyLock);
+
+    const UINT64 linesCount = m_readLatency.Count();
+    const UINT64 p50 = m_readLatency.Percentile(50);
+    const UINT64 p99 = m_readLatency.Percentile(99);
+    m_readLatency.Clear();
+
+    ReleaseSRWLockExclusive(&m_readLatencyLock);
+
+    if (linesCount == 0)
+    {
+        return;
+    }
+
+    logWriter.TraceInfo(
+        Utility::FormatString(
+            L"Log lines latency in directory %ws. Lines: %llu, p50: %llu ms, p99: %llu ms",
+            m_logDirectory.c_str(),
+            linesCount,
+            p50,
+            p99
+        ).c_str()
+    );
 }
 
 
@@ -1042,9 +1552,20 @@ LogFileMonitor::LogFileAddEventHandler(
 {
     DWORD status = ERROR_SUCCESS;
 
-    auto element = GetLogFilesInformationIt(Event.FileName);
+    std::shared_ptr<LogFileInformation> existingLogFileInfo = m_logFiles.Find(Event.FileName);
+
+    //
+    // The name may now refer to a new file, if the file was rotated and its
+    // rename or removal wasn't seen.
+    //
+    if (existingLogFileInfo &&
+        IsLogFileReplaced(existingLogFileInfo, m_logDirectory + L'\\' + existingLogFileInfo->FileName))
+    {
+        RemoveReplacedLogFile(existingLogFileInfo->FileName);
+        existingLogFileInfo.reset();
+    }
 
-    if (element != m_logFilesInformation.end())
+    if (existingLogFileInfo)
     {
         //
         // Log file already exist. Do nothing.
@@ -1105,12 +1626,14 @@ LogFileMonitor::LogFileAddEventHandler(
                     );
                 }
             }
+            else
+            {
+                logFileInfo->FileId = fileId;
+            }
 
-            status = ReadLogFile(logFileInfo);
+            m_logFiles.Insert(longPath, shortPath, fileId, logFileInfo);
 
-            m_fileIds[fileId] = longPath;
-            m_longPaths[shortPath] = longPath;
-            m_logFilesInformation[longPath] = std::move(logFileInfo);
+            ScheduleLogFileRead(logFileInfo);
         }
     }
 
@@ -1124,37 +1647,31 @@ LogFileMonitor::LogFileRemoveEventHandler(
     )
 {
     DWORD status = ERROR_SUCCESS;
-    bool isShortPath = false;
 
-    auto element = GetLogFilesInformationIt(Event.FileName, &isShortPath);
+    std::shared_ptr<LogFileInformation> logFileInfo = m_logFiles.Remove(Event.FileName);
 
-    if (element != m_logFilesInformation.end())
+    if (logFileInfo)
     {
-        std::wstring longPath = element->second->FileName;
+        //
+        // Wait for a read in progress to finish, and skip the ones already scheduled.
+        //
+        AcquireSRWLockExclusive(&logFileInfo->Lock);
 
-        m_logFilesInformation.erase(element);
+        //
+        // The file may have been deleted or renamed by a rotation after the
+        // application wrote its last lines.
+        //
+        DrainLogFile(logFileInfo);
 
-        auto longPathIterator = (!isShortPath) ? m_longPaths.find(Event.FileName) :
-            std::find_if(
-                m_longPaths.begin(),
-                m_longPaths.end(),
-                [&longPath](const auto& it) { return _wcsicmp(it.second.c_str(), longPath.c_str()) == 0; });
+        logFileInfo->IsRemoved = true;
+        logFileInfo->CloseFileHandle();
 
-        if (longPathIterator != m_longPaths.end())
+        if (m_checkpointStore && !logFileInfo->CheckpointKey.empty())
         {
-            m_longPaths.erase(longPathIterator);
+            m_checkpointStore->Remove(logFileInfo->CheckpointKey);
         }
 
-        auto fileIdIterator =
-            std::find_if(
-                m_fileIds.begin(),
-                m_fileIds.end(),
-                [&longPath](const auto& it) { return _wcsicmp(it.second.c_str(), longPath.c_str()) == 0; });
-
-        if (fileIdIterator != m_fileIds.end())
-        {
-            m_fileIds.erase(fileIdIterator);
-        }
+        ReleaseSRWLockExclusive(&logFileInfo->Lock);
     }
     else
     {
@@ -1167,73 +1684,218 @@ LogFileMonitor::LogFileRemoveEventHandler(
 }
 
 
-DWORD
-LogFileMonitor::LogFileModifyEventHandler(
-    _In_ DirChangeNotificationEvent& Event
+///
+/// Checks if the name of a monitored file now refers to a different file. It
+/// happens when the file was rotated and its rename or removal wasn't seen,
+/// because the notifications were lost, or the rotated file was renamed again
+/// before the rename was handled.
+///
+/// \param LogFileInfo      The monitored file.
+/// \param FullLongPath     The full long path of the monitored file.
+///
+/// \return true if the file with that name has a different id.
+///
+bool
+LogFileMonitor::IsLogFileReplaced(
+    _In_ const std::shared_ptr<LogFileInformation>& LogFileInfo,
+    _In_ const std::wstring& FullLongPath
     )
 {
-    DWORD status = ERROR_SUCCESS;
-
-    auto element = GetLogFilesInformationIt(Event.FileName);
-
-    if (element != m_logFilesInformation.end() &&
-        Event.Timestamp > element->second->LastReadTimestamp)
+    HANDLE file = OpenLogFileHandle(FullLongPath);
+    if (file == INVALID_HANDLE_VALUE)
     {
-        status = ReadLogFile(element->second);
+        return false;
     }
-    else
+
+    FILE_ID_INFO fileId{ 0 };
+    const bool isFileIdRead =
+        ::GetFileInformationByHandleEx(file, FileIdInfo, &fileId, sizeof(FILE_ID_INFO)) != FALSE;
+
+    CloseHandle(file);
+
+    if (!isFileIdRead)
     {
-        //
-        // Log file not found or event is too old.
-        //
+        return false;
     }
 
-    return status;
+    AcquireSRWLockShared(&LogFileInfo->Lock);
+
+    const bool isReplaced = !IsFileIdEmpty(LogFileInfo->FileId) && !FileIdsEqual(LogFileInfo->FileId, fileId);
+
+    ReleaseSRWLockShared(&LogFileInfo->Lock);
+
+    return isReplaced;
 }
 
-DWORD
-LogFileMonitor::LogFileRenameNewEventHandler(
-    _In_ DirChangeNotificationEvent& Event
+///
+/// Stops monitoring a file whose name now refers to a new file. What was
+/// written to the old file is read first, if it's open.
+///
+/// \param FileName     The relative path of the monitored file.
+///
+void
+LogFileMonitor::RemoveReplacedLogFile(
+    _In_ const std::wstring& FileName
     )
 {
-    DWORD status = ERROR_SUCCESS;
+    DirChangeNotificationEvent event;
 
-    const std::wstring fullLongPath = Utility::GetLongPath(m_logDirectory + L'\\' + Event.FileName);
-    const std::wstring longPath = fullLongPath.substr(m_logDirectory.size() + 1);
+    event.FileName = FileName;
+    event.Action = EventAction::Remove;
+    event.Timestamp = GetTickCount64();
 
-    DWORD ftyp = GetFileAttributesW(fullLongPath.c_str());
-    if (ftyp == INVALID_FILE_ATTRIBUTES)
-    {
-        status = GetLastError();
-        logWriter.TraceError(
-            Utility::FormatString(
-                L"Error in log file monitor. Failed to query file attributes. File: %ws. Error: %d",
-                fullLongPath.c_str(),
-                status
-            ).c_str()
-        );
+    LogFileRemoveEventHandler(event);
 
-        return status;
+    m_replacedLogFiles++;
+}
+
+///
+/// Reads what was written to a log file since its last read, before the file
+/// is renamed or stops being monitored. The open handle still reaches the
+/// file after it's renamed or deleted, so the lines written just before a
+/// rotation are written with the name they were written to, including an
+/// incomplete last line. A file that isn't open can't be drained. Must be
+/// called with the file lock held.
+///
+/// \param LogFileInfo     The log file to drain.
+///
+void
+LogFileMonitor::DrainLogFile(
+    _In_ const std::shared_ptr<LogFileInformation>& LogFileInfo
+    )
+{
+    if (LogFileInfo->IsRemoved)
+    {
+        return;
     }
 
-    if (ftyp & FILE_ATTRIBUTE_DIRECTORY)
+    if (LogFileInfo->FileHandle != INVALID_HANDLE_VALUE)
     {
-        if (m_includeSubfolders)
-        {
-            std::vector<std::pair<std::wstring, FILE_ID_INFO>> logFiles;
+        const UINT64 readOffset = LogFileInfo->NextReadOffset;
 
-            GetFilesInDirectory(fullLongPath, m_filter, logFiles, m_includeSubfolders);
+        //
+        // The file can't be read after it's renamed or removed, so it's read to
+        // the end regardless of its read budget.
+        //
+        ReadLogFile(LogFileInfo, 0);
 
-            for (auto file : logFiles)
-            {
-                const std::wstring& fileName = file.first;
-                const FILE_ID_INFO& fileId = file.second;
+        if (LogFileInfo->NextReadOffset > readOffset)
+        {
+            m_drainedLogFileBytes += LogFileInfo->NextReadOffset - readOffset;
+        }
+    }
+
+    FlushPartialLine(LogFileInfo, true);
+}
+
+///
+/// Writes the incomplete line kept from the previous reads of a log file, if
+/// any, as a line of its own. Must be called with the file lock held.
+///
+/// \param LogFileInfo     The log file.
+/// \param IsFileEnded     True if the file won't be read again from the same
+///                        offset. The bytes of a character cut by the last
+///                        read are then written too, otherwise they're kept
+///                        to be decoded with the rest of the character.
+///
+void
+LogFileMonitor::FlushPartialLine(
+    _In_ const std::shared_ptr<LogFileInformation>& LogFileInfo,
+    _In_ bool IsFileEnded
+    )
+{
+    const bool hasUndecodedBytes = IsFileEnded && !LogFileInfo->UndecodedBytes.empty();
+
+    if (!LogFileInfo->Framer.HasPartialLine() && !hasUndecodedBytes)
+    {
+        return;
+    }
+
+    FileLogEntry logEntry = CreateFileLogEntry(LogFileInfo->FileName);
+    auto writeLine = [&](std::string_view Line) { WriteLineToConsole(Line, logEntry); };
+
+    if (hasUndecodedBytes)
+    {
+        const std::string_view decodedContents = ConvertStringToUTF8(
+            LogFileInfo->UndecodedBytes.data(),
+            static_cast<UINT>(LogFileInfo->UndecodedBytes.size()),
+            LogFileInfo->EncodingType,
+            LogFileInfo->DecodedBuffer
+        );
+
+        LogFileInfo->Framer.Push(decodedContents.data(), decodedContents.size(), writeLine);
+        LogFileInfo->UndecodedBytes.clear();
+    }
+
+    LogFileInfo->Framer.Flush(writeLine);
+}
+
+
+DWORD
+LogFileMonitor::LogFileModifyEventHandler(
+    _In_ DirChangeNotificationEvent& Event
+    )
+{
+    DWORD status = ERROR_SUCCESS;
+
+    std::shared_ptr<LogFileInformation> logFileInfo = m_logFiles.Find(Event.FileName);
+
+    if (logFileInfo && Event.Timestamp > logFileInfo->LastReadTimestamp)
+    {
+        ScheduleModifiedLogFile(logFileInfo);
+    }
+    else
+    {
+        //
+        // Log file not found or event is too old.
+        //
+    }
+
+    return status;
+}
+
+DWORD
+LogFileMonitor::LogFileRenameNewEventHandler(
+    _In_ DirChangeNotificationEvent& Event
+    )
+{
+    DWORD status = ERROR_SUCCESS;
+
+    const std::wstring fullLongPath = Utility::GetLongPath(m_logDirectory + L'\\' + Event.FileName);
+    const std::wstring longPath = fullLongPath.substr(m_logDirectory.size() + 1);
+
+    DWORD ftyp = GetFileAttributesW(fullLongPath.c_str());
+    if (ftyp == INVALID_FILE_ATTRIBUTES)
+    {
+        status = GetLastError();
+        logWriter.TraceError(
+            Utility::FormatString(
+                L"Error in log file monitor. Failed to query file attributes. File: %ws. Error: %d",
+                fullLongPath.c_str(),
+                status
+            ).c_str()
+        );
+
+        return status;
+    }
+
+    if (ftyp & FILE_ATTRIBUTE_DIRECTORY)
+    {
+        if (m_includeSubfolders)
+        {
+            std::vector<ListedLogFile> logFiles;
 
-                auto itFileId = m_fileIds.find(fileId);
+            GetFilesInDirectory(fullLongPath, logFiles, m_includeSubfolders);
 
-                if (itFileId != m_fileIds.end())
+            for (const auto& file : logFiles)
+            {
+                const std::wstring& fileName = file.FullLongPath;
+                const FILE_ID_INFO& fileId = file.FileId;
+
+                std::wstring oldName;
+                if (m_logFiles.FindLongPathById(fileId, oldName))
                 {
-                    RenameFileInMaps(fileName, itFileId->second, fileId);
+                    RenameFileInMaps(fileName, oldName, fileId);
                 }
             }
         }
@@ -1243,25 +1905,46 @@ LogFileMonitor::LogFileRenameNewEventHandler(
         FILE_ID_INFO fileId{ 0 };
         GetFileId(fullLongPath, fileId);
 
-        auto it = m_fileIds.find(fileId);
+        std::wstring oldName;
 
-        if (it != m_fileIds.end())
+        if (m_logFiles.FindLongPathById(fileId, oldName))
         {
-            if (FileMatchesFilter(fullLongPath.c_str(), m_filter.c_str()))
+            if (m_filter.Matches(longPath))
             {
-                RenameFileInMaps(fullLongPath, it->second, fileId);
+                RenameFileInMaps(fullLongPath, oldName, fileId);
             }
             else
             {
+                //
+                // The file was rotated out of the filter, like app.log to
+                // app.log.1. If it wasn't open yet, open it with its new name,
+                // so it's drained before it stops being monitored.
+                //
+                std::shared_ptr<LogFileInformation> logFileInfo = m_logFiles.Find(oldName);
+
+                if (logFileInfo)
+                {
+                    AcquireSRWLockExclusive(&logFileInfo->Lock);
+
+                    if (logFileInfo->FileHandle == INVALID_HANDLE_VALUE)
+                    {
+                        logFileInfo->FileHandle = OpenLogFileHandle(fullLongPath);
+                    }
+
+                    ReleaseSRWLockExclusive(&logFileInfo->Lock);
+                }
+
+                m_renamedLogFiles++;
+
                 DirChangeNotificationEvent e = Event;
 
-                e.FileName = it->second;
+                e.FileName = oldName;
                 e.Action = EventAction::Remove;
 
                 LogFileRemoveEventHandler(e);
             }
         }
-        else if (FileMatchesFilter(fullLongPath.c_str(), m_filter.c_str()))
+        else if (m_filter.Matches(longPath))
         {
             DirChangeNotificationEvent e = Event;
 
@@ -1294,14 +1977,43 @@ LogFileMonitor::RenameFileInMaps(
     const std::wstring longPath = NewFullName.substr(m_logDirectory.size() + 1);
     const std::wstring shortPath = Utility::GetShortPath(NewFullName).substr(m_shortLogDirectory.size() + 1);
 
-    auto it = GetLogFilesInformationIt(OldName);
-
-    shared_ptr<LogFileInformation> fileInfo;
-    if (it != m_logFilesInformation.end())
+    shared_ptr<LogFileInformation> fileInfo = m_logFiles.Remove(OldName);
+    if (fileInfo)
     {
-        fileInfo = it->second;
+        AcquireSRWLockExclusive(&fileInfo->Lock);
+
+        //
+        // Read the lines written before the rename with the old name.
+        //
+        DrainLogFile(fileInfo);
+
         fileInfo->FileName = longPath;
-        m_logFilesInformation.erase(it);
+
+        //
+        // The open handle follows the file across renames. Only drop it if
+        // it was opened on a different file than the one being renamed.
+        //
+        if (IsFileIdEmpty(fileInfo->FileId))
+        {
+            fileInfo->FileId = FileId;
+        }
+        else if (!FileIdsEqual(fileInfo->FileId, FileId))
+        {
+            fileInfo->CloseFileHandle();
+        }
+
+        //
+        // The checkpoint is saved again with the new name by the next read.
+        //
+        if (m_checkpointStore && !fileInfo->CheckpointKey.empty())
+        {
+            m_checkpointStore->Remove(fileInfo->CheckpointKey);
+            fileInfo->CheckpointKey.clear();
+        }
+
+        ReleaseSRWLockExclusive(&fileInfo->Lock);
+
+        m_renamedLogFiles++;
     }
     else
     {
@@ -1310,157 +2022,587 @@ LogFileMonitor::RenameFileInMaps(
         fileInfo->EncodingType = LM_FILETYPE::FileTypeUnknown;
         fileInfo->LastReadTimestamp = 0;
         fileInfo->NextReadOffset = 0;
+        fileInfo->FileId = FileId;
     }
 
     //
-    // Try first the case when the long and short path are the same.
+    // A rotation may rename the file over another monitored file, like
+    // app.log.1 when app.log is renamed to it. That file is gone.
     //
-    auto longPathIterator = m_longPaths.find(OldName);
-    if (longPathIterator == m_longPaths.end())
+    if (m_logFiles.Find(longPath))
     {
-        //
-        // Look for the map element with value equal to long path.
-        //
-        longPathIterator =
-            std::find_if(
-                m_longPaths.begin(),
-                m_longPaths.end(),
-                [&OldName](const auto& it) {
-                    return _wcsicmp(it.second.c_str(), OldName.c_str()) == 0;
-                }
-            );
+        RemoveReplacedLogFile(longPath);
     }
 
-    if (longPathIterator != m_longPaths.end())
-    {
-        m_longPaths.erase(longPathIterator);
-    }
-
-    m_logFilesInformation[longPath] = fileInfo;
-    m_longPaths[shortPath] = longPath;
-    m_fileIds[FileId] = longPath;
+    m_logFiles.Insert(longPath, shortPath, FileId, fileInfo);
 }
 
 
+///
+/// Starts a rescan of the log directory, after change notifications were
+/// lost. If a rescan is already in progress, another one is started when it
+/// finishes, as the changes lost now may be in the part already listed.
+///
 DWORD
 LogFileMonitor::LogFileReInitEventHandler(
     _In_ DirChangeNotificationEvent& /* Event */
     )
 {
-    DWORD status = ERROR_SUCCESS;
-    std::vector<std::pair<std::wstring, FILE_ID_INFO>> logFiles;
+    if (m_rescan)
+    {
+        m_isRescanRequested = true;
+    }
+    else
+    {
+        StartDirectoryRescan();
+    }
+
+    return ERROR_SUCCESS;
+}
+
+
+void
+LogFileMonitor::StartDirectoryRescan()
+{
+    m_rescan = std::make_unique<DirectoryEnumerator>(m_logDirectory, m_includeSubfolders);
+    m_rescanGeneration++;
+    m_isRescanRequested = false;
+
+    m_rescanStartTimestamp = GetTickCount64();
+    m_rescanListedFiles = 0;
+    m_rescanChangedFiles = 0;
+    m_rescanAddedFiles = 0;
+}
+
+
+///
+/// Lists the next files of the rescan in progress, for up to
+/// RESCAN_STEP_MAX_MILLIS, and reconciles them with the monitored files.
+///
+void
+LogFileMonitor::ContinueDirectoryRescan()
+{
+    const UINT64 stepEndTimestamp = GetTickCount64() + RESCAN_STEP_MAX_MILLIS;
+
+    std::wstring fullLongPath;
+    WIN32_FIND_DATAW findData;
+
+    while (GetTickCount64() < stepEndTimestamp)
+    {
+        if (!m_rescan->Next(fullLongPath, findData))
+        {
+            FinishDirectoryRescan();
+            break;
+        }
+
+        if (m_filter.Matches(std::wstring_view(fullLongPath).substr(m_logDirectory.size() + 1)))
+        {
+            ReconcileListedLogFile(fullLongPath, findData);
+        }
+    }
+}
+
 
-    status = GetFilesInDirectory(m_logDirectory, m_filter, logFiles, m_includeSubfolders);
+///
+/// Compares a file listed by the rescan with the monitored files. A known file
+/// is read only if its size or last write time changed since it was last
+/// listed, so unchanged files cost neither a read nor an open. An unknown file
+/// is handled like a file renamed into the directory: its id tells whether it's
+/// a monitored file renamed while the notifications were lost, or a new one.
+///
+/// \param FullLongPath     The full long path of the listed file.
+/// \param FindData         The directory entry of the listed file.
+///
+void
+LogFileMonitor::ReconcileListedLogFile(
+    _In_ const std::wstring& FullLongPath,
+    _In_ const WIN32_FIND_DATAW& FindData
+    )
+{
+    const std::wstring longPath = FullLongPath.substr(m_logDirectory.size() + 1);
+
+    const UINT64 size = (static_cast<UINT64>(FindData.nFileSizeHigh) << 32) | FindData.nFileSizeLow;
+    const UINT64 lastWriteTime =
+        (static_cast<UINT64>(FindData.ftLastWriteTime.dwHighDateTime) << 32) |
+        FindData.ftLastWriteTime.dwLowDateTime;
+
+    m_rescanListedFiles++;
+
+    std::shared_ptr<LogFileInformation> logFileInfo = m_logFiles.Find(longPath);
+
+    //
+    // A changed file may be a new file with the same name, if the file was
+    // rotated while the notifications were lost.
+    //
+    if (logFileInfo &&
+        (logFileInfo->ListedSize != size || logFileInfo->ListedWriteTime != lastWriteTime) &&
+        IsLogFileReplaced(logFileInfo, FullLongPath))
+    {
+        RemoveReplacedLogFile(longPath);
+        logFileInfo.reset();
+    }
+
+    if (!logFileInfo)
+    {
+        DirChangeNotificationEvent event;
+
+        event.FileName = longPath;
+        event.Action = EventAction::RenameNew;
+        event.Timestamp = GetTickCount64();
+
+        LogFileRenameNewEventHandler(event);
+
+        logFileInfo = m_logFiles.Find(longPath);
+
+        if (!logFileInfo)
+        {
+            return;
+        }
+
+        m_rescanAddedFiles++;
+    }
+
+    logFileInfo->RescanGeneration = m_rescanGeneration;
+
+    if (logFileInfo->ListedSize != size || logFileInfo->ListedWriteTime != lastWriteTime)
+    {
+        logFileInfo->ListedSize = size;
+        logFileInfo->ListedWriteTime = lastWriteTime;
+
+        m_rescanChangedFiles++;
+
+        ScheduleLogFileRead(logFileInfo);
+    }
+}
+
+
+///
+/// Ends the rescan in progress. The monitored files that weren't listed are
+/// removed, unless they still exist: they may have been added or renamed into
+/// a part of the directory that was already listed. If the listing failed,
+/// no file is removed, as the missing ones may just not have been listed.
+///
+void
+LogFileMonitor::FinishDirectoryRescan()
+{
+    const DWORD status = m_rescan->GetStatus();
+    UINT64 removedFiles = 0;
+
+    m_rescan.reset();
 
     if (status == ERROR_SUCCESS)
     {
-        for (auto file : logFiles)
+        for (const auto& logFileInfo : m_logFiles.GetAll())
         {
-            const std::wstring& fileName = file.first;
-            const FILE_ID_INFO& fileId = file.second;
+            if (logFileInfo->RescanGeneration == m_rescanGeneration)
+            {
+                continue;
+            }
 
-            const std::wstring longPath = fileName.substr(m_logDirectory.size() + 1);
+            const std::wstring fullLongPath = m_logDirectory + L'\\' + logFileInfo->FileName;
+
+            if (GetFileAttributesW(fullLongPath.c_str()) == INVALID_FILE_ATTRIBUTES)
+            {
+                DirChangeNotificationEvent event;
+
+                event.FileName = logFileInfo->FileName;
+                event.Action = EventAction::Remove;
+                event.Timestamp = GetTickCount64();
+
+                LogFileRemoveEventHandler(event);
+
+                removedFiles++;
+            }
+        }
+
+        m_rescans++;
+        m_rescannedListedFiles += m_rescanListedFiles;
+        m_rescannedChangedFiles += m_rescanChangedFiles;
+        m_rescannedAddedFiles += m_rescanAddedFiles;
+
+        logWriter.TraceInfo(
+            Utility::FormatString(
+                L"Rescanned log directory %ws after change notifications were lost. Files listed: %llu,"
+                L" changed: %llu, added: %llu, removed: %llu. Time: %llu ms",
+                m_logDirectory.c_str(),
+                m_rescanListedFiles,
+                m_rescanChangedFiles,
+                m_rescanAddedFiles,
+                removedFiles,
+                GetTickCount64() - m_rescanStartTimestamp
+            ).c_str()
+        );
+    }
+    else
+    {
+        logWriter.TraceError(
+            Utility::FormatString(
+                L"Error in log file monitor. Failed to enumerate log directory %ws. Error: %d",
+                m_logDirectory.c_str(),
+                status
+            ).c_str()
+        );
+    }
+
+    if (m_isRescanRequested)
+    {
+        StartDirectoryRescan();
+    }
+}
+
+
+///
+/// Opens the handle used to tail a log file. If the file name now refers to a
+/// different file than the one tailed before, the file was rotated and the
+/// change handler hasn't handled it yet. The new file isn't opened, so
+/// it's not read as the rest of the old one, and the old file can still be
+/// read when its rename is handled. The new file is then monitored from its
+/// start, as a new file.
+///
+/// \param LogFileInfo      The log file information where the handle is stored.
+/// \param FullLongPath     The full long path of the log file.
+///
+/// \return DWORD with a standard result of the function.
+///
+DWORD
+LogFileMonitor::OpenLogFile(
+    _Inout_ std::shared_ptr<LogFileInformation> LogFileInfo,
+    _In_ const std::wstring& FullLongPath
+    )
+{
+    HANDLE logFile = OpenLogFileHandle(FullLongPath);
+    if (logFile == INVALID_HANDLE_VALUE)
+    {
+        return GetLastError();
+    }
 
-            auto element = GetLogFilesInformationIt(longPath);
+    FILE_ID_INFO fileId{ 0 };
+    if (::GetFileInformationByHandleEx(logFile, FileIdInfo, &fileId, sizeof(FILE_ID_INFO)))
+    {
+        if (!IsFileIdEmpty(LogFileInfo->FileId) && !FileIdsEqual(LogFileInfo->FileId, fileId))
+        {
+            CloseHandle(logFile);
+            return ERROR_FILE_NOT_FOUND;
+        }
+
+        LogFileInfo->FileId = fileId;
+    }
+
+    LogFileInfo->FileHandle = logFile;
 
-            if (element != m_logFilesInformation.end())
+    return ERROR_SUCCESS;
+}
+
+
+///
+/// Reads a log file scheduled in the reader pool, up to its read budget. Runs
+/// in a reader pool worker.
+///
+/// \param LogFileInfo      The log file to read.
+///
+/// \return true if the read stopped before the end of the file, so the file
+///     must be read again.
+///
+bool
+LogFileMonitor::ReadScheduledLogFile(
+    _In_ const std::shared_ptr<LogFileInformation>& LogFileInfo
+    )
+{
+    bool isReadIncomplete = false;
+
+    AcquireSRWLockExclusive(&LogFileInfo->Lock);
+
+    try
+    {
+        if (!LogFileInfo->IsRemoved)
+        {
+            DWORD status = ReadLogFile(LogFileInfo, GetReadBudget(LogFileInfo->FileName));
+
+            isReadIncomplete = status == ERROR_SUCCESS &&
+                LogFileInfo->FileHandle != INVALID_HANDLE_VALUE &&
+                LogFileInfo->NextReadOffset < LogFileInfo->LastObservedSize;
+
+            if (m_checkpointStore)
+            {
+                CheckpointLogFile(LogFileInfo);
+            }
+        }
+    }
+    catch (...)
+    {
+        ReleaseSRWLockExclusive(&LogFileInfo->Lock);
+        throw;
+    }
+
+    ReleaseSRWLockExclusive(&LogFileInfo->Lock);
+
+    return isReadIncomplete;
+}
+
+///
+/// Gets the bytes a reader pool worker reads from a log file before moving to
+/// the next queued file. It's the read budget of the tuning, multiplied by the
+/// weight of the first priority whose filter matches the file.
+///
+/// \param FileName         The relative path of the log file.
+///
+/// \return The read budget in bytes, or 0 if files are read to the end.
+///
+UINT64
+LogFileMonitor::GetReadBudget(
+    _In_ const std::wstring& FileName
+    ) const
+{
+    if (m_tuning.ReadBudgetInKB == 0)
+    {
+        return 0;
+    }
+
+    DWORD weight = 1;
+
+    for (const auto& priority : m_priorities)
+    {
+        if (priority.first.Matches(FileName))
+        {
+            weight = priority.second;
+            break;
+        }
+    }
+
+    return static_cast<UINT64>(m_tuning.ReadBudgetInKB) * 1024 * weight;
+}
+
+///
+/// Saves the read offset of a log file in the checkpoint store, if the file
+/// was read since its last checkpoint. Must be called with the file lock held.
+///
+/// \param LogFileInfo      The log file.
+///
+void
+LogFileMonitor::CheckpointLogFile(
+    _In_ const std::shared_ptr<LogFileInformation>& LogFileInfo
+    )
+{
+    //
+    // The incomplete line kept by the framer isn't written yet, so it's read
+    // again if the monitor resumes from the checkpoint.
+    //
+    const UINT64 checkpointOffset = LogFileInfo->Framer.HasPartialLine() ?
+        LogFileInfo->PartialLineOffset :
+        LogFileInfo->NextReadOffset - LogFileInfo->UndecodedBytes.size();
+
+    if (!LogFileInfo->CheckpointKey.empty() &&
+        LogFileInfo->CheckpointOffset == checkpointOffset &&
+        FileIdsEqual(LogFileInfo->CheckpointFileId, LogFileInfo->FileId))
+    {
+        return;
+    }
+
+    const std::wstring key = CheckpointStore::GetKey(LogFileInfo->FileId, LogFileInfo->FileName);
+
+    //
+    // The file was replaced by another one with the same name.
+    //
+    if (!LogFileInfo->CheckpointKey.empty() && LogFileInfo->CheckpointKey != key)
+    {
+        m_checkpointStore->Remove(LogFileInfo->CheckpointKey);
+    }
+
+    FileCheckpoint checkpoint;
+    checkpoint.FileName = LogFileInfo->FileName;
+    checkpoint.Offset = checkpointOffset;
+    checkpoint.EncodingType = LogFileInfo->EncodingType;
+    checkpoint.FingerprintSize = LogFileInfo->FingerprintSize;
+    checkpoint.Fingerprint = LogFileInfo->Fingerprint;
+
+    m_checkpointStore->Update(key, checkpoint);
+
+    LogFileInfo->CheckpointKey = key;
+    LogFileInfo->CheckpointFileId = LogFileInfo->FileId;
+    LogFileInfo->CheckpointOffset = checkpointOffset;
+}
+
+
+///
+/// Reads the lines written to a log file since its last read. Must be called
+/// with the file lock held.
+///
+/// Once ReadBudget bytes are read, the read stops at the end of the last
+/// complete line, and the rest of the file is left for the next read. An
+/// incomplete line at the end of the file is kept by the framer of the file,
+/// and completed by the next read. It's written on its own once the file
+/// wasn't written to for PARTIAL_LINE_FLUSH_TIMEOUT_MILLIS, or is deleted.
+///
+/// \param LogFileInfo      The log file information.
+/// \param ReadBudget       Bytes to read before stopping. 0 reads to the end.
+///
+/// \return DWORD with a standard result of the function.
+///
+DWORD
+LogFileMonitor::ReadLogFile(
+    _Inout_ std::shared_ptr<LogFileInformation> LogFileInfo,
+    _In_ UINT64 ReadBudget
+    )
+{
+    DWORD status = ERROR_SUCCESS;
+    OVERLAPPED overlapped = { 0, 0, 0, 0, nullptr };
+    BYTE bom[3 * sizeof(char)] = { 0, 0, 0 }; // Bom could be up to 3 bytes size in UTF8.
+    bool wasBomRead = false;
+
+    const std::wstring fullLongPath = m_logDirectory + L'\\' + LogFileInfo->FileName;
+
+    if (LogFileInfo->FileHandle == INVALID_HANDLE_VALUE)
+    {
+        status = OpenLogFile(LogFileInfo, fullLongPath);
+        if (status != ERROR_SUCCESS)
+        {
+            if (status == ERROR_FILE_NOT_FOUND || status == ERROR_PATH_NOT_FOUND)
             {
                 //
-                // Log file already exist. Do nothing.
+                // This errors should not trace anything.
                 //
+                status = ERROR_SUCCESS;
             }
             else
             {
-                auto logFileInfo = std::make_shared<LogFileInformation>();
-
-                const std::wstring shortPath = Utility::GetShortPath(fileName).substr(m_shortLogDirectory.size() + 1);
-
-                logFileInfo->FileName = longPath;
-                logFileInfo->NextReadOffset = 0;
-                logFileInfo->LastReadTimestamp = 0;
-
-                m_longPaths[shortPath] = longPath;
-                m_logFilesInformation[longPath] = std::move(logFileInfo);
-                m_fileIds[fileId] = longPath;
+                logWriter.TraceError(
+                    Utility::FormatString(
+                        L"Error in log file monitor. Failed to open file %ws. Error: %d",
+                        fullLongPath.c_str(),
+                        status
+                    ).c_str()
+                );
             }
+            return status;
         }
     }
-    else
+
+    HANDLE logFile = LogFileInfo->FileHandle;
+
+    //
+    // Query the file metadata first. A single call returns the size, the
+    // last write time and the number of links, so idle files are skipped
+    // without issuing any read.
+    //
+    BY_HANDLE_FILE_INFORMATION fileInformation = {};
+    if (!::GetFileInformationByHandle(logFile, &fileInformation))
     {
+        status = GetLastError();
         logWriter.TraceError(
             Utility::FormatString(
-                L"Error in log file monitor. Failed to enumerate log directory %ws. Error: %d",
-                m_logDirectory.c_str(),
-                GetLastError()
+                L"Error in log file monitor. Failed to query file information. File: %ws. Error: %d",
+                fullLongPath.c_str(),
+                status
             ).c_str()
         );
+
+        //
+        // Reopen the file in the next read.
+        //
+        LogFileInfo->CloseFileHandle();
+        return status;
     }
 
-    map<std::wstring, std::shared_ptr<LogFileInformation>>::iterator it;
+    const UINT64 fileSize =
+        (static_cast<UINT64>(fileInformation.nFileSizeHigh) << 32) | fileInformation.nFileSizeLow;
+    const UINT64 lastWriteTime =
+        (static_cast<UINT64>(fileInformation.ftLastWriteTime.dwHighDateTime) << 32) |
+        fileInformation.ftLastWriteTime.dwLowDateTime;
+
+    //
+    // A file without links was deleted while it was open.
+    //
+    const bool isDeletePending = fileInformation.nNumberOfLinks == 0;
 
-    //wprintf(L"LogFilesChangeHandler: Timer event\n");
+    LogFileInfo->LastObservedSize = fileSize;
+    LogFileInfo->LastWriteTime = lastWriteTime;
 
-    for ( it = m_logFilesInformation.begin(); it != m_logFilesInformation.end(); it++ )
+    if (fileSize == LogFileInfo->NextReadOffset)
     {
-        ReadLogFile(it->second);
-    }
-
-    return status;
-}
+        const UINT64 now = GetTickCount64();
 
+        LogFileInfo->LastReadTimestamp = now;
+        LogFileInfo->LagBytes = 0;
 
-DWORD
-LogFileMonitor::ReadLogFile(
-    _Inout_ std::shared_ptr<LogFileInformation> LogFileInfo
-    )
-{
-    DWORD status = ERROR_SUCCESS;
-    OVERLAPPED overlapped = { 0, 0, 0, 0, nullptr };
-    BYTE bom[3 * sizeof(char)] = { 0, 0, 0 }; // Bom could be up to 3 bytes size in UTF8.
-    bool wasBomRead = false;
+        //
+        // Don't keep large buffers for a file that isn't being written.
+        //
+        if (LogFileInfo->ReadBuffer.size() > READ_BUFFER_MIN_SIZE_BYTES)
+        {
+            std::vector<BYTE>().swap(LogFileInfo->ReadBuffer);
+        }
 
-    const std::wstring fullLongPath = m_logDirectory + L'\\' + LogFileInfo->FileName;
+        if (LogFileInfo->DecodedBuffer.capacity() > READ_BUFFER_MIN_SIZE_BYTES)
+        {
+            std::string().swap(LogFileInfo->DecodedBuffer);
+        }
 
-    HANDLE logFile = CreateFileW(fullLongPath.c_str(),
-                                  GENERIC_READ,
-                                  FILE_SHARE_READ | FILE_SHARE_WRITE,
-                                  nullptr,
-                                  OPEN_EXISTING,
-                                  FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
-                                  nullptr);
-    if (logFile == INVALID_HANDLE_VALUE)
-    {
-        status = GetLastError();
-        if (status == ERROR_FILE_NOT_FOUND || status == ERROR_PATH_NOT_FOUND)
+        //
+        // The writer of a line without a new line at its end may still be
+        // writing it, so it's only written once the file is idle.
+        //
+        if (isDeletePending || now - LogFileInfo->PartialLineTimestamp >= PARTIAL_LINE_FLUSH_TIMEOUT_MILLIS)
         {
-            //
-            // This errors should not trace anything.
-            //
-            status = ERROR_SUCCESS;
+            FlushPartialLine(LogFileInfo, isDeletePending);
         }
-        else
+
+        if (isDeletePending)
         {
-            logWriter.TraceError(
-                Utility::FormatString(
-                    L"Error in log file monitor. Failed to open file %ws. Error: %d",
-                    fullLongPath.c_str(),
-                    status
-                ).c_str()
-            );
+            LogFileInfo->CloseFileHandle();
         }
         return status;
     }
 
-    DWORD dwPtr = SetFilePointer(logFile, 0L, NULL, FILE_BEGIN);
-    if (dwPtr == INVALID_SET_FILE_POINTER)
+    if (fileSize < LogFileInfo->NextReadOffset)
     {
-        logWriter.TraceError(
-            Utility::FormatString(
-                L"Error in log file monitor. SetFilePointer failed. File: %ws. Error: %d",
-                fullLongPath.c_str(),
-                GetLastError()
-            ).c_str()
-        );
+        //
+        // The file was truncated. Everything in it was written after the
+        // last read, so read it again from the start. The incomplete line
+        // of the previous content won't be completed.
+        //
+        FlushPartialLine(LogFileInfo, true);
+
+        LogFileInfo->NextReadOffset = 0;
+        LogFileInfo->EncodingType = LM_FILETYPE::FileTypeUnknown;
+        LogFileInfo->FingerprintSize = 0;
+
+        m_truncatedLogFiles++;
+    }
+    else if (IsLogFileRewritten(LogFileInfo))
+    {
+        //
+        // The file was truncated and written again past the last read
+        // before this read.
+        //
+        FlushPartialLine(LogFileInfo, true);
+
+        LogFileInfo->NextReadOffset = 0;
+        LogFileInfo->EncodingType = LM_FILETYPE::FileTypeUnknown;
+        LogFileInfo->FingerprintSize = 0;
+
+        m_truncatedLogFiles++;
+    }
+
+    //
+    // The read stops at the first line break after readEnd, unless the end
+    // of the file is reached before.
+    //
+    const UINT64 readEnd =
+        (ReadBudget == 0 || fileSize - LogFileInfo->NextReadOffset <= ReadBudget) ?
+        fileSize :
+        LogFileInfo->NextReadOffset + ReadBudget;
+
+    //
+    // Large backlogs, like the ones found when log files are read from the
+    // start, are read through a mapping of the file. Only complete lines are
+    // read there, the remaining bytes are read below. If the file can't be
+    // mapped, everything is read below. The bytes of a character cut by the
+    // last read are only decoded below.
+    //
+    if (readEnd - LogFileInfo->NextReadOffset >= MAPPED_READ_THRESHOLD_BYTES &&
+        LogFileInfo->UndecodedBytes.empty())
+    {
+        ReadLogFileMapped(LogFileInfo, readEnd);
     }
 
     //
@@ -1492,22 +2634,59 @@ LogFileMonitor::ReadLogFile(
         }
     }
 
-    const DWORD bytesToRead = 4096;
-    std::vector<BYTE> logFileContents(
-        static_cast<size_t>(bytesToRead));
+    //
+    // Size the read buffer after the pending bytes, so a small append is read
+    // with a single ReadFile. Backlogs larger than the maximum size are drained
+    // in sequential reads of READ_BUFFER_MAX_SIZE_BYTES.
+    //
+    std::vector<BYTE>& logFileContents = LogFileInfo->ReadBuffer;
+    const DWORD bufferSize = GetReadBufferSize(fileSize - LogFileInfo->NextReadOffset);
+
+    if (logFileContents.size() < bufferSize)
+    {
+        logFileContents.resize(bufferSize);
+    }
+
+    DWORD bytesToRead = 0;
     DWORD bytesRead = 0;
+    bool isReadBudgetUsed = false;
+    bool isReadLimitedToBudget = readEnd < fileSize;
 
-    std::wstring currentLineBuffer;
+    std::string& decodedString = LogFileInfo->DecodedBuffer;
+    LineFramer<char>& lineFramer = LogFileInfo->Framer;
+    UINT64 linesWritten = 0;
 
     //
-    // It's important to catch a possible error inside the loop, to at least print
-    // the content of currentLineBuffer, if it has any.
+    // A possible error inside the loop is caught, so the lines read before it
+    // are accounted, and the incomplete line kept by lineFramer is written
+    // by a later read.
     //
     try
     {
         do
         {
+            //
+            // The bytes of a character cut by the last read go before the
+            // bytes read now.
+            //
+            const DWORD undecodedSize = static_cast<DWORD>(LogFileInfo->UndecodedBytes.size());
+            std::copy(
+                LogFileInfo->UndecodedBytes.begin(),
+                LogFileInfo->UndecodedBytes.end(),
+                logFileContents.begin());
+
             bytesRead = 0;
+            bytesToRead = static_cast<DWORD>(logFileContents.size()) - undecodedSize;
+
+            //
+            // Don't read past the end of the budget, so the read stops close to it.
+            //
+            if (isReadLimitedToBudget &&
+                readEnd > LogFileInfo->NextReadOffset &&
+                readEnd - LogFileInfo->NextReadOffset < bytesToRead)
+            {
+                bytesToRead = static_cast<DWORD>(readEnd - LogFileInfo->NextReadOffset);
+            }
 
             overlapped.Offset = UINT(LogFileInfo->NextReadOffset & 0xFFFFFFFF);
             overlapped.OffsetHigh = UINT(LogFileInfo->NextReadOffset >> 32);
@@ -1516,7 +2695,7 @@ LogFileMonitor::ReadLogFile(
 
             if (!::ReadFile(
                 logFile,
-                logFileContents.data(),
+                logFileContents.data() + undecodedSize,
                 bytesToRead,
                 &bytesRead,
                 &overlapped))
@@ -1544,6 +2723,8 @@ LogFileMonitor::ReadLogFile(
 
             if (bytesRead > 0)
             {
+                const LM_FILETYPE previousEncodingType = LogFileInfo->EncodingType;
+
                 //
                 // Get file type if it's still unknown
                 //
@@ -1587,272 +2768,761 @@ LogFileMonitor::ReadLogFile(
                     foundBomSize = 0;
                 }
 
-                //
-                // Decode read string to UTF16, skipping the BOM if necessary.
-                //
-                const std::wstring decodedString = ConvertStringToUTF16(
-                    logFileContents.data() + foundBomSize,
-                    bytesRead - foundBomSize,
-                    LogFileInfo->EncodingType
-                );
+                //
+                // The encoding is known when there are undecoded bytes, so a
+                // BOM is never found after them.
+                //
+                DWORD bytesToDecode = undecodedSize + bytesRead - foundBomSize;
+
+                //
+                // Once the budget is used, keep the incomplete line at the end
+                // for the next read. A line longer than the buffer is read on.
+                //
+                if (ReadBudget > 0 &&
+                    bytesRead == bytesToRead &&
+                    LogFileInfo->NextReadOffset + bytesRead >= readEnd)
+                {
+                    const size_t completeLinesSize = GetCompleteLinesSize(
+                        logFileContents.data() + foundBomSize,
+                        bytesToDecode,
+                        LogFileInfo->EncodingType);
+
+                    if (completeLinesSize > 0)
+                    {
+                        bytesToDecode = static_cast<DWORD>(completeLinesSize);
+                        bytesRead = foundBomSize + bytesToDecode - undecodedSize;
+                        isReadBudgetUsed = true;
+                    }
+                    else if (bytesToRead < logFileContents.size())
+                    {
+                        //
+                        // A line goes past the end of the budget. Read it
+                        // again with the whole buffer, so it isn't decoded
+                        // in pieces.
+                        //
+                        LogFileInfo->EncodingType = previousEncodingType;
+                        isReadLimitedToBudget = false;
+                        continue;
+                    }
+                }
+
+                //
+                // A character cut by the end of the read is decoded with the
+                // next read, once the rest of it is read.
+                //
+                const size_t decodableSize = GetDecodableSize(
+                    logFileContents.data() + foundBomSize,
+                    bytesToDecode,
+                    LogFileInfo->EncodingType);
+
+                LogFileInfo->UndecodedBytes.assign(
+                    logFileContents.data() + foundBomSize + decodableSize,
+                    logFileContents.data() + foundBomSize + bytesToDecode);
+
+                bytesToDecode = static_cast<DWORD>(decodableSize);
+
+                //
+                // Decode read string to UTF-8, skipping the BOM if necessary.
+                //
+                const std::string_view decodedContents = ConvertStringToUTF8(
+                    logFileContents.data() + foundBomSize,
+                    bytesToDecode,
+                    LogFileInfo->EncodingType,
+                    decodedString
+                );
+
+                //
+                // Write the complete lines to console log. The text after the last new line
+                // is kept by lineFramer, and completed with the content of the next read.
+                //
+                FileLogEntry logEntry = CreateFileLogEntry(LogFileInfo->FileName);
+                const bool hadPartialLine = lineFramer.HasPartialLine();
+
+                lineFramer.Push(
+                    decodedContents.data(),
+                    decodedContents.size(),
+                    [&](std::string_view Line) { WriteLineToConsole(Line, logEntry); linesWritten++; });
+
+                LogFileInfo->PartialLineTimestamp = GetTickCount64();
+
+                UpdatePartialLineOffset(
+                    LogFileInfo,
+                    logFileContents.data() + foundBomSize,
+                    bytesToDecode,
+                    LogFileInfo->NextReadOffset - undecodedSize + foundBomSize,
+                    hadPartialLine);
+            }
+
+            LogFileInfo->NextReadOffset += bytesRead;
+
+            //
+            // A short read means the end of the file was reached, so don't
+            // issue another read just to get ERROR_HANDLE_EOF.
+            //
+        } while (bytesRead == bytesToRead && !isReadBudgetUsed);
+    }
+    catch (...) {}
+
+    //
+    // A deleted file won't be written again, so its last line is complete.
+    //
+    if (isDeletePending)
+    {
+        FlushPartialLine(LogFileInfo, true);
+    }
+
+    //
+    // The backlogs read through a mapping aren't recorded, they would only
+    // measure how old the file is.
+    //
+    if (linesWritten > 0 && m_tuning.LatencyReportIntervalInSeconds > 0)
+    {
+        RecordReadLatency(lastWriteTime, linesWritten);
+    }
+
+    UpdateHeaderFingerprint(LogFileInfo);
+
+    LogFileInfo->LagBytes = LogFileInfo->LastObservedSize > LogFileInfo->NextReadOffset ?
+        LogFileInfo->LastObservedSize - LogFileInfo->NextReadOffset :
+        0;
+
+    //
+    // Release the handle if the file was deleted, so the file system can
+    // remove it, or if the read failed, so it's reopened in the next read.
+    //
+    if (isDeletePending || status != ERROR_SUCCESS)
+    {
+        LogFileInfo->CloseFileHandle();
+    }
+
+    return status;
+}
+
+///
+/// Checks if a log file was rewritten in place since its last read, by
+/// comparing its beginning with the fingerprint taken when it was read. A
+/// file truncated and written again past the last read offset between two
+/// reads looks like an appended file otherwise.
+///
+/// \param LogFileInfo      The log file, with an open file handle.
+///
+/// \return true if the beginning of the file changed.
+///
+bool
+LogFileMonitor::IsLogFileRewritten(
+    _In_ const std::shared_ptr<LogFileInformation>& LogFileInfo
+    )
+{
+    if (LogFileInfo->FingerprintSize == 0)
+    {
+        return false;
+    }
+
+    UINT64 fingerprint = 0;
+
+    //
+    // If the beginning can't be read, assume the file wasn't rewritten.
+    //
+    return GetHeaderFingerprint(LogFileInfo->FileHandle, LogFileInfo->FingerprintSize, fingerprint) &&
+        fingerprint != LogFileInfo->Fingerprint;
+}
+
+///
+/// Takes the fingerprint of the beginning of a log file, once the bytes to
+/// hash were read. Until HeaderFingerprintSizeInBytes bytes were read, the
+/// fingerprint is taken again over the bytes read so far after each read.
+///
+/// \param LogFileInfo      The log file, with an open file handle.
+///
+void
+LogFileMonitor::UpdateHeaderFingerprint(
+    _In_ const std::shared_ptr<LogFileInformation>& LogFileInfo
+    )
+{
+    const DWORD maxSize = m_tuning.HeaderFingerprintSizeInBytes;
+
+    if (maxSize == 0 ||
+        LogFileInfo->FingerprintSize == maxSize ||
+        LogFileInfo->NextReadOffset <= LogFileInfo->FingerprintSize ||
+        LogFileInfo->FileHandle == INVALID_HANDLE_VALUE)
+    {
+        return;
+    }
+
+    const DWORD size =
+        LogFileInfo->NextReadOffset < maxSize ? static_cast<DWORD>(LogFileInfo->NextReadOffset) : maxSize;
+    UINT64 fingerprint = 0;
+
+    if (GetHeaderFingerprint(LogFileInfo->FileHandle, size, fingerprint))
+    {
+        LogFileInfo->FingerprintSize = size;
+        LogFileInfo->Fingerprint = fingerprint;
+    }
+}
+
+///
+/// Hashes the beginning of a file with FNV-1a.
+///
+/// \param File             The file.
+/// \param Size             The number of bytes to hash.
+/// \param Fingerprint      Receives the hash.
+///
+/// \return false if the file couldn't be read, or is shorter than Size.
+///
+bool
+LogFileMonitor::GetHeaderFingerprint(
+    _In_ HANDLE File,
+    _In_ DWORD Size,
+    _Out_ UINT64& Fingerprint
+    )
+{
+    std::vector<BYTE> header(Size);
+    OVERLAPPED overlapped = { 0, 0, 0, 0, nullptr };
+    DWORD bytesRead = 0;
+
+    Fingerprint = 0;
+
+    if (!::ReadFile(File, header.data(), Size, &bytesRead, &overlapped) || bytesRead != Size)
+    {
+        return false;
+    }
+
+    UINT64 hash = 14695981039346656037ULL;
+
+    for (BYTE headerByte : header)
+    {
+        hash ^= headerByte;
+        hash *= 1099511628211ULL;
+    }
+
+    Fingerprint = hash;
+
+    return true;
+}
+
+///
+/// Reads the complete lines between the next read offset and the end of a log
+/// file through a mapping of the file, one window of MAPPED_READ_WINDOW_SIZE_BYTES
+/// at a time. Line breaks are searched in the mapped bytes, so only complete lines
+/// are decoded, and UTF-16LE lines are written straight from the mapping.
+///
+/// A file can't be truncated while a part of it is mapped: the SetEndOfFile of
+/// its writer fails with ERROR_USER_MAPPED_FILE. So each window has a mapping of
+/// its own, that is released before the next window is mapped, and the file is
+/// only mapped while a window is written. A writer that truncates the file,
+/// like a copytruncate rotation, can do it between two windows. The read stops
+/// at the first window past the end of a file that shrank.
+///
+/// \param LogFileInfo      The log file information, with an open file handle.
+/// \param FileSize         The size of the file when the read started, or the
+///                         offset where the read budget of the file ends.
+///
+/// \return DWORD with a standard result of the function.
+///
+DWORD
+LogFileMonitor::ReadLogFileMapped(
+    _Inout_ std::shared_ptr<LogFileInformation> LogFileInfo,
+    _In_ UINT64 FileSize
+    )
+{
+    DWORD status = ERROR_SUCCESS;
+
+    SYSTEM_INFO systemInfo;
+    GetSystemInfo(&systemInfo);
+
+    const UINT64 granularity = systemInfo.dwAllocationGranularity;
+
+    std::string& decodedString = LogFileInfo->DecodedBuffer;
+
+    while (LogFileInfo->NextReadOffset < FileSize)
+    {
+        //
+        // Views must start at a multiple of the allocation granularity.
+        //
+        const UINT64 viewOffset = LogFileInfo->NextReadOffset - (LogFileInfo->NextReadOffset % granularity);
+        const UINT64 remainingSize = FileSize - viewOffset;
+        const SIZE_T viewSize = static_cast<SIZE_T>(
+            remainingSize < MAPPED_READ_WINDOW_SIZE_BYTES ? remainingSize : MAPPED_READ_WINDOW_SIZE_BYTES);
+        const bool isLastView = (viewOffset + viewSize) == FileSize;
+        const UINT64 mappingSize = viewOffset + viewSize;
+
+        //
+        // The file may have been truncated since the last window. What's
+        // left of it is read without the mapping.
+        //
+        LARGE_INTEGER currentFileSize;
+        if (!GetFileSizeEx(LogFileInfo->FileHandle, &currentFileSize) ||
+            static_cast<UINT64>(currentFileSize.QuadPart) < mappingSize)
+        {
+            break;
+        }
+
+        HANDLE mapping = CreateFileMappingW(
+            LogFileInfo->FileHandle,
+            nullptr,
+            PAGE_READONLY,
+            static_cast<DWORD>(mappingSize >> 32),
+            static_cast<DWORD>(mappingSize & 0xFFFFFFFF),
+            nullptr);
+        if (mapping == NULL)
+        {
+            status = GetLastError();
+            logWriter.TraceWarning(
+                Utility::FormatString(
+                    L"Failed to map log file %ws. It will be read without mapping it. Error: %d",
+                    LogFileInfo->FileName.c_str(),
+                    status
+                ).c_str()
+            );
+            break;
+        }
+
+        LPBYTE view = static_cast<LPBYTE>(MapViewOfFile(
+            mapping,
+            FILE_MAP_READ,
+            static_cast<DWORD>(viewOffset >> 32),
+            static_cast<DWORD>(viewOffset & 0xFFFFFFFF),
+            viewSize));
+        const DWORD mapViewError = (view == nullptr) ? GetLastError() : ERROR_SUCCESS;
+
+        //
+        // The view keeps the mapping until it's unmapped.
+        //
+        CloseHandle(mapping);
+
+        if (view == nullptr)
+        {
+            status = mapViewError;
+            logWriter.TraceError(
+                Utility::FormatString(
+                    L"Error in log file monitor. Failed to map a view of file %ws. Error: %d",
+                    LogFileInfo->FileName.c_str(),
+                    status
+                ).c_str()
+            );
+            break;
+        }
+
+        LPBYTE contents = view + (LogFileInfo->NextReadOffset - viewOffset);
+        size_t contentsSize = viewSize - static_cast<size_t>(LogFileInfo->NextReadOffset - viewOffset);
 
-                //
-                // Search 'new line' characters, and if found, print the line.
-                //
-                std::size_t found = decodedString.find_last_of(L"\n\r");
-                std::size_t remainingStringIndex = 0;
+        LogFileInfo->LastReadTimestamp = GetTickCount64();
 
-                if (found != std::string::npos)
-                {
-                    remainingStringIndex = found + 1;
+        //
+        // Get file type if it's still unknown, the same way ReadLogFile does.
+        //
+        if (LogFileInfo->EncodingType == LM_FILETYPE::FileTypeUnknown)
+        {
+            BYTE bom[3 * sizeof(char)] = { 0, 0, 0 }; // Bom could be up to 3 bytes size in UTF8.
+            const UINT sampleSize = static_cast<UINT>(
+                contentsSize < READ_BUFFER_MIN_SIZE_BYTES ? contentsSize : READ_BUFFER_MIN_SIZE_BYTES);
+            UINT foundBomSize = 0;
 
-                    if ((found - 1) >= 0
-                        && (decodedString[(found - 1)] == L'\n' || decodedString[(found - 1)] == L'\r')
-                        && decodedString[(found - 1)] != decodedString[found])
-                    {
-                        //
-                        // Is a CR LF or LF CR new line, and we don't want to print two new lines
-                        //
-                        found--;
-                    }
+            //
+            // If the beginning of the file isn't being read, get the BOM from it.
+            //
+            bool wasBomRead = false;
+            if (LogFileInfo->NextReadOffset >= 3)
+            {
+                OVERLAPPED overlapped = { 0, 0, 0, 0, nullptr };
+                DWORD bytesRead = 0;
 
-                    // TODO(annandaa): handle the writing to file case. The UTF-16 BOM should be added at
-                    // the beginning, and use WriteLog function.
-                    // Also, in the writing to file scenario, instead of print each line here,
-                    // we should store the lines to print, and then, print them once time.
+                wasBomRead = ::ReadFile(LogFileInfo->FileHandle, &bom, sizeof(bom), &bytesRead, &overlapped)
+                    && bytesRead >= (sizeof(bom) - 1); // UTF16 BOM could be only 2 bytes
+            }
 
-                    //
-                    // Write to console log.
-                    //
-                    if (!currentLineBuffer.empty())
-                    {
-                        try
-                        {
-                            currentLineBuffer.insert(
-                                currentLineBuffer.end(),
-                                decodedString.begin(),
-                                decodedString.begin() + found
-                            );
-                            LogFileMonitor::WriteToConsole(currentLineBuffer, LogFileInfo->FileName);
-                        }
-                        catch (...)
-                        {
-                            //
-                            // If insert failed, print them now.
-                            //
-                            LogFileMonitor::WriteToConsole(currentLineBuffer, LogFileInfo->FileName);
+            LogFileInfo->EncodingType = FileTypeFromBuffer(
+                contents,
+                sampleSize,
+                wasBomRead ? bom : contents,
+                wasBomRead ? sizeof(bom) : sampleSize,
+                foundBomSize
+            );
 
-                            std::wstring remainingBuffer = decodedString.substr(0, found);
-                            LogFileMonitor::WriteToConsole(remainingBuffer, LogFileInfo->FileName);
-                        }
+            //
+            // Skip the part of the BOM that is in the content to read.
+            //
+            if (foundBomSize > LogFileInfo->NextReadOffset)
+            {
+                const size_t bomBytesToSkip = static_cast<size_t>(foundBomSize - LogFileInfo->NextReadOffset);
 
-                        currentLineBuffer.clear();
-                    }
-                    else
-                    {
-                        //
-                        // newLineBuffer was empty, so only print the found line.
-                        //
-                        std::wstring foundLineBuffer = decodedString.substr(0, found);
-                        LogFileMonitor::WriteToConsole(foundLineBuffer, LogFileInfo->FileName);
-                    }
-                }
+                contents += bomBytesToSkip;
+                contentsSize -= bomBytesToSkip;
+                LogFileInfo->NextReadOffset += bomBytesToSkip;
+            }
+        }
+
+        size_t completeLinesSize = GetCompleteLinesSize(contents, contentsSize, LogFileInfo->EncodingType);
+
+        if (completeLinesSize == 0)
+        {
+            if (isLastView)
+            {
                 //
-                // If the whole line wasn't printed (the last character wasn't a new line), add the remainder
-                // to currentLineBuffer.
+                // The last line isn't complete yet. It will be read without the mapping.
                 //
-                if(remainingStringIndex < decodedString.size())
-                {
-                    try
-                    {
-                        currentLineBuffer.insert(currentLineBuffer.end(),
-                                                 decodedString.begin() + remainingStringIndex,
-                                                 decodedString.end());
-                    }
-                    catch (...)
-                    {
-                        //
-                        // If insert failed, print buffers now and clear currentLineBuffer.
-                        //
-                        std::wstring remainingBuffer(decodedString.begin() + remainingStringIndex, decodedString.end());
+                UnmapViewOfFile(view);
+                break;
+            }
 
-                        LogFileMonitor::WriteToConsole(currentLineBuffer, LogFileInfo->FileName);
-                        LogFileMonitor::WriteToConsole(remainingBuffer, LogFileInfo->FileName);
-                        currentLineBuffer.clear();
-                    }
-                }
+            //
+            // The line is longer than the view. Write what was mapped of it.
+            //
+            completeLinesSize = contentsSize;
+            if (LogFileInfo->EncodingType == LM_FILETYPE::UTF16LE ||
+                LogFileInfo->EncodingType == LM_FILETYPE::UTF16BE)
+            {
+                completeLinesSize &= ~static_cast<size_t>(1);
             }
+        }
 
-            LogFileInfo->NextReadOffset += bytesRead;
-        } while (bytesRead > 0);
-    }
-    catch (...) {}
+        //
+        // UTF-8 content is already in the format to write, so it's written
+        // from the view without being copied.
+        //
+        const std::string_view lines = ConvertStringToUTF8(
+            contents,
+            static_cast<UINT>(completeLinesSize),
+            LogFileInfo->EncodingType,
+            decodedString);
 
-    if (!currentLineBuffer.empty())
-    {
         //
-        // If we reach EOF, print the last line.
+        // The framer completes the incomplete line kept from the previous
+        // read with the first line, and writes the others from the view.
         //
-        LogFileMonitor::WriteToConsole(currentLineBuffer, LogFileInfo->FileName);
-    }
+        try
+        {
+            FileLogEntry logEntry = CreateFileLogEntry(LogFileInfo->FileName);
+            const bool hadPartialLine = LogFileInfo->Framer.HasPartialLine();
+
+            LogFileInfo->Framer.Push(
+                lines.data(),
+                lines.size(),
+                [&](std::string_view Line) { WriteLineToConsole(Line, logEntry); });
+
+            UpdatePartialLineOffset(
+                LogFileInfo,
+                contents,
+                completeLinesSize,
+                LogFileInfo->NextReadOffset,
+                hadPartialLine);
+        }
+        catch (...)
+        {
+            status = ERROR_UNHANDLED_EXCEPTION;
+        }
+
+        LogFileInfo->NextReadOffset += completeLinesSize;
 
-    CloseHandle(logFile);
+        UnmapViewOfFile(view);
+    }
 
     return status;
 }
 
-void LogFileMonitor::WriteToConsole( _In_ std::wstring Message, _In_ std::wstring FileName) {
-    size_t start = 0;
-    size_t i = 0;
-    wstring msg;
+///
+/// Records where the incomplete line kept by the framer of a log file starts
+/// in the file, after content read from the file was pushed to the framer.
+/// Must be called with the file lock held.
+///
+/// \param LogFileInfo      The log file.
+/// \param Contents         The content pushed to the framer, before decoding.
+/// \param ContentSize      The size of the content.
+/// \param ContentOffset    The offset of the content in the file.
+/// \param HadPartialLine   If the framer kept an incomplete line before the push.
+///
+void
+LogFileMonitor::UpdatePartialLineOffset(
+    _In_ const std::shared_ptr<LogFileInformation>& LogFileInfo,
+    _In_reads_bytes_(ContentSize) const BYTE* Contents,
+    _In_ size_t ContentSize,
+    _In_ UINT64 ContentOffset,
+    _In_ bool HadPartialLine
+    )
+{
+    if (!LogFileInfo->Framer.HasPartialLine())
+    {
+        return;
+    }
 
-    // struct to hold the File log entry and later format print
-    FileLogEntry logEntry;
-    FileLogEntry* pLogEntry = &logEntry;
+    //
+    // Without a line break in the content, the incomplete line started in an
+    // earlier read, or at the start of the content.
+    //
+    const size_t completeLinesSize = GetCompleteLinesSize(Contents, ContentSize, LogFileInfo->EncodingType);
 
-    SYSTEMTIME st;
-    GetSystemTime(&st);
+    if (completeLinesSize > 0 || !HadPartialLine)
+    {
+        LogFileInfo->PartialLineOffset = ContentOffset + completeLinesSize;
+    }
+}
 
-    pLogEntry->source = L"File";
-    pLogEntry->currentTime = Utility::SystemTimeToString(st).c_str();
-
-    while (true) {
-        i = Message.find(L"\n", start);
-        if (i == std::string::npos) {
-            // only one-line log or remaining line without \n
-            msg = Message.substr(start, Message.size() - start);
-        }
-        else {
-            // substr except ith (\n)
-            msg = Message.substr(start, i - start);
-            start = i + 1;
-            // remove \r if any, usually before \n
-            if (msg.size() > 0 && msg.substr(msg.size() - 1) == L"\r") {
-                msg.replace(msg.size() - 1, 1, L"");
-            }
-        }
-        // ignore empty lines
-        if (msg.size() > 0) {
-            // escape backslashes in FileName
-            auto fmtFileName = Utility::ReplaceAll(FileName, L"\\", L"\\\\");
-            pLogEntry->fileName = fmtFileName;
-            pLogEntry->message = msg;
-
-            std::wstring formattedFileEntry;
-            if (Utility::CompareWStrings(m_logFormat, L"Custom")) {
-                formattedFileEntry = Utility::FormatEventLineLog(m_customLogFormat, pLogEntry, pLogEntry->source);
-            } else {
-                std::wstring logFmt;
-                if (Utility::CompareWStrings(m_logFormat, L"XML")) {
-                    logFmt = L"<Log><Source>File</Source>"
-                             L"<LogEntry>"
-                             L"<Logline>%s</Logline>"
-                             L"<FileName>%s</FileName>"
-                             L"</LogEntry>"
-                             L"</Log>";
-                } else {
-                    logFmt = L"{\"Source\": \"File\","
-                             L"\"LogEntry\": {"
-                             L"\"Logline\": \"%s\","
-                             L"\"FileName\": \"%s\""
-                             L"},"
-                             L"\"SchemaVersion\":\"1.0.0\""
-                             L"}";
-                    // sanitize message
-                    Utility::SanitizeJson(msg);
-                    pLogEntry->message = msg;
-                }
+///
+/// Gets the size of the complete lines at the start of a buffer, this is, up
+/// to and including its last LF. Like in the line framer of the file, a CR
+/// alone doesn't end a line.
+///
+/// \param Contents         The buffer, in the file encoding.
+/// \param ContentSize      The size of the buffer in bytes.
+/// \param EncodingType     The encoding of the buffer.
+///
+/// \return The size in bytes of the complete lines, or 0 if there is no line break.
+///
+size_t
+LogFileMonitor::GetCompleteLinesSize(
+    _In_reads_bytes_(ContentSize) const BYTE* Contents,
+    _In_ size_t ContentSize,
+    _In_ LM_FILETYPE EncodingType
+    )
+{
+    if (EncodingType == LM_FILETYPE::UTF16LE || EncodingType == LM_FILETYPE::UTF16BE)
+    {
+        const bool isBigEndian = EncodingType == LM_FILETYPE::UTF16BE;
+        const uint16_t lf = isBigEndian ? LineScanner::SwapBytes(L'\n') : static_cast<uint16_t>(L'\n');
 
-                formattedFileEntry = Utility::FormatString(
-                    logFmt.c_str(),
-                    pLogEntry->message.c_str(),
-                    pLogEntry->fileName.c_str()
-                );
-            }
+        const uint16_t* begin = reinterpret_cast<const uint16_t*>(Contents);
+        const uint16_t* end = begin + ContentSize / sizeof(uint16_t);
+        const uint16_t* lastLineBreak = LineScanner::FindLastLineBreak(begin, end, lf, lf);
 
-            logWriter.WriteConsoleLog(formattedFileEntry);
-        }
-        if (i >= Message.size()) break;
+        return (lastLineBreak == end) ? 0 : (lastLineBreak - begin + 1) * sizeof(uint16_t);
     }
+
+    const BYTE* end = Contents + ContentSize;
+    const BYTE* lastLineBreak = LineScanner::FindLastLineBreak<BYTE>(Contents, end, '\n', '\n');
+
+    return (lastLineBreak == end) ? 0 : lastLineBreak - Contents + 1;
 }
 
-DWORD
-LogFileMonitor::GetFilesInDirectory(
-    _In_ const std::wstring& FolderPath,
-    _In_ const std::wstring& SearchPattern,
-    _Out_ std::vector<std::pair<std::wstring, FILE_ID_INFO>>& Files,
-    _In_ bool ShouldLookInSubfolders
+///
+/// Gets the size of the whole characters at the start of a buffer, leaving
+/// out a character cut by the end of the buffer.
+///
+/// \param Contents         The buffer, in the file encoding.
+/// \param ContentSize      The size of the buffer in bytes.
+/// \param EncodingType     The encoding of the buffer.
+///
+/// \return The size in bytes of the whole characters.
+///
+size_t
+LogFileMonitor::GetDecodableSize(
+    _In_reads_bytes_(ContentSize) const BYTE* Contents,
+    _In_ size_t ContentSize,
+    _In_ LM_FILETYPE EncodingType
     )
 {
-    WIN32_FIND_DATA ffd;
-    DWORD status = ERROR_SUCCESS;
-
-    //
-    // First search through subfolders.
-    //
-    if (ShouldLookInSubfolders)
+    if (EncodingType == LM_FILETYPE::UTF16LE || EncodingType == LM_FILETYPE::UTF16BE)
     {
-        std::wstring toSearch = FolderPath + L"\\*";
-        HANDLE hFind = FindFirstFileW(toSearch.c_str(), &ffd);
-        if (hFind != INVALID_HANDLE_VALUE)
+        //
+        // Leave out the first byte of a code unit, and a high surrogate
+        // without the low surrogate after it.
+        //
+        size_t size = ContentSize & ~static_cast<size_t>(1);
+
+        if (size >= sizeof(uint16_t))
         {
-            do
+            uint16_t lastUnit;
+            memcpy(&lastUnit, Contents + size - sizeof(uint16_t), sizeof(lastUnit));
+
+            if (EncodingType == LM_FILETYPE::UTF16BE)
             {
-                if ((ffd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) && (ffd.cFileName[0] != L'.'))
-                {
-                    std::wstring subfolderPath = FolderPath + L"\\" + ffd.cFileName;
-                    status = GetFilesInDirectory(subfolderPath, SearchPattern, Files, true);
-                }
-            } while (FindNextFile(hFind, &ffd) != 0 && (status == ERROR_SUCCESS));
-            FindClose(hFind);
+                lastUnit = LineScanner::SwapBytes(lastUnit);
+            }
+
+            if (lastUnit >= 0xD800 && lastUnit <= 0xDBFF)
+            {
+                size -= sizeof(uint16_t);
+            }
         }
-        else
+
+        return size;
+    }
+
+    if (EncodingType == LM_FILETYPE::UTF8)
+    {
+        //
+        // Find the lead byte of the last sequence, and leave it out if the
+        // bytes after it are fewer than the ones it starts.
+        //
+        for (size_t length = 1; length <= 4 && length <= ContentSize; length++)
         {
-            status = GetLastError();
+            const BYTE c = Contents[ContentSize - length];
+
+            if ((c & 0xC0) == 0x80)
+            {
+                continue;
+            }
+
+            const size_t sequenceLength =
+                (c >= 0xF0) ? 4 :
+                (c >= 0xE0) ? 3 :
+                (c >= 0xC0) ? 2 :
+                1;
+
+            return (sequenceLength > length) ? ContentSize - length : ContentSize;
         }
     }
-
-    if (status == ERROR_SUCCESS)
+    else if (EncodingType == LM_FILETYPE::ANSI)
     {
         //
-        // Now search for files using SearchPattern
+        // In a double byte code page, leave out a lead byte without its
+        // trail byte. Trail bytes can look like lead bytes, so the bytes are
+        // walked from the last line break, which is never a trail byte.
         //
-        std::wstring toSearch = FolderPath + L"\\" + SearchPattern;
-        HANDLE hFind = FindFirstFileW(toSearch.c_str(), &ffd);
-        if (hFind != INVALID_HANDLE_VALUE)
+        static const bool isDoubleByteCodePage = []()
         {
-            do
+            CPINFO codePageInfo = {};
+            return GetCPInfo(CP_ACP, &codePageInfo) && codePageInfo.MaxCharSize > 1;
+        }();
+
+        if (isDoubleByteCodePage)
+        {
+            size_t i = GetCompleteLinesSize(Contents, ContentSize, EncodingType);
+
+            while (i < ContentSize)
             {
-                //
-                // Filter out the files that do not match the specified filter.
-                //
-                if (!(ffd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
-                    && FileMatchesFilter(ffd.cFileName, SearchPattern.c_str()))
+                if (!IsDBCSLeadByteEx(CP_ACP, Contents[i]))
+                {
+                    i++;
+                }
+                else if (i + 1 < ContentSize)
+                {
+                    i += 2;
+                }
+                else
                 {
-                    std::wstring fileName = FolderPath + L"\\" + ffd.cFileName;
+                    return i;
+                }
+            }
+        }
+    }
+
+    return ContentSize;
+}
 
-                    FILE_ID_INFO fileId{ 0 };
-                    GetFileId(fileName, fileId);
+///
+/// Creates the entry used to format the lines read from a log file.
+///
+/// \param FileName     The relative name of the log file.
+///
+/// \return The entry, with the source, current time and file name set.
+///
+LogFileMonitor::FileLogEntry LogFileMonitor::CreateFileLogEntry(_In_ const std::wstring& FileName) {
+    // struct to hold the File log entry and later format print
+    FileLogEntry logEntry;
 
-                    //wprintf(L"Started monitoring file: %s\n",fileName.c_str());
+    SYSTEMTIME st;
+    GetSystemTime(&st);
 
-                    Files.push_back({ fileName, fileId });
-                }
-            } while (FindNextFile(hFind, &ffd) != 0);
+    logEntry.source = L"File";
+    logEntry.currentTime = Utility::SystemTimeToString(st).c_str();
 
-            status = GetLastError();
+    // escape backslashes in FileName
+    logEntry.fileName = Utility::ReplaceAll(FileName, L"\\", L"\\\\");
+    logEntry.fileNameUtf8 = Utility::WStringToString(logEntry.fileName);
 
-            if (status == ERROR_NO_MORE_FILES)
-            {
-                status = ERROR_SUCCESS;
-            }
+    return logEntry;
+}
 
-            FindClose(hFind);
-        }
+///
+/// Formats a line read from a log file and writes it to console log.
+///
+/// \param Line         The line in UTF-8, without new line characters.
+/// \param LogEntry     The entry created for the log file by CreateFileLogEntry.
+///
+void LogFileMonitor::WriteLineToConsole(_In_ std::string_view Line, _Inout_ FileLogEntry& LogEntry) {
+    if (Utility::CompareWStrings(m_logFormat, L"Custom")) {
+        //
+        // The fields of custom formats are substituted in UTF-16.
+        //
+        LogEntry.message = Utility::StringToWString(std::string(Line));
+
+        logWriter.WriteConsoleLog(
+            Utility::FormatEventLineLog(m_customLogFormat, &LogEntry, LogEntry.source),
+            OutputSource::File);
+        return;
     }
 
+    std::string& formattedFileEntry = LogEntry.formattedLine;
+    formattedFileEntry.clear();
 
-    return status;
+    if (Utility::CompareWStrings(m_logFormat, L"XML")) {
+        //
+        // The line ends at its first null character, as it did when it was
+        // formatted as a C string.
+        //
+        formattedFileEntry += "<Log><Source>File</Source>"
+                              "<LogEntry>"
+                              "<Logline>";
+        formattedFileEntry += Line.substr(0, Line.find('\0'));
+        formattedFileEntry += "</Logline>"
+                              "<FileName>";
+        formattedFileEntry += LogEntry.fileNameUtf8;
+        formattedFileEntry += "</FileName>"
+                              "</LogEntry>"
+                              "</Log>";
+    } else {
+        formattedFileEntry += "{\"Source\": \"File\","
+                              "\"LogEntry\": {"
+                              "\"Logline\": \"";
+        // sanitize message
+        Utility::AppendJsonEscaped(formattedFileEntry, Line);
+        formattedFileEntry += "\","
+                              "\"FileName\": \"";
+        formattedFileEntry += LogEntry.fileNameUtf8;
+        formattedFileEntry += "\""
+                              "},"
+                              "\"SchemaVersion\":\"1.0.0\""
+                              "}";
+    }
+
+    logWriter.WriteConsoleLog(std::string_view(formattedFileEntry), OutputSource::File);
+}
+
+///
+/// Lists the files of a directory that match the filter.
+///
+/// \param FolderPath               The directory, the log directory or one of
+///                                 its subdirectories.
+/// \param Files                    Receives the full path, id, size and last
+///                                 write time of the files.
+/// \param ShouldLookInSubfolders   true to list the subdirectories too.
+///
+/// \return ERROR_SUCCESS, or the error that stopped the listing.
+///
+DWORD
+LogFileMonitor::GetFilesInDirectory(
+    _In_ const std::wstring& FolderPath,
+    _Out_ std::vector<std::pair<std::wstring, FILE_ID_INFO>>& Files,
+    _In_ bool ShouldLookInSubfolders
+    )
+{
+    DirectoryEnumerator enumerator(FolderPath, ShouldLookInSubfolders);
+
+    std::wstring fileName;
+    WIN32_FIND_DATAW findData;
+
+    //
+    // All the files are listed, and the filter is applied to their path
+    // relative to the log directory, as it can have several patterns and
+    // patterns of subdirectories.
+    //
+    while (enumerator.Next(fileName, findData))
+    {
+        if (m_filter.Matches(std::wstring_view(fileName).substr(m_logDirectory.size() + 1)))
+        {
+            FILE_ID_INFO fileId{ 0 };
+            GetFileId(fileName, fileId);
+
+            const UINT64 size = (static_cast<UINT64>(findData.nFileSizeHigh) << 32) | findData.nFileSizeLow;
+            const UINT64 lastWriteTime =
+                (static_cast<UINT64>(findData.ftLastWriteTime.dwHighDateTime) << 32) |
+                findData.ftLastWriteTime.dwLowDateTime;
+
+            Files.push_back({ fileName, fileId, size, lastWriteTime });
+        }
+    }
+
+    return enumerator.GetStatus();
 }
 
 LM_FILETYPE
@@ -1933,100 +3603,122 @@ LogFileMonitor::FileTypeFromBuffer(
 }
 
 
-std::wstring
-LogFileMonitor::ConvertStringToUTF16(
+///
+/// Converts text read from a log file to UTF-8, the encoding its lines are
+/// formatted and written in.
+///
+/// \param StringPtr        The text.
+/// \param StringSize       The size of the text, in bytes.
+/// \param EncodingType     The encoding of the text.
+/// \param Buffer           Buffer the converted text is written to. It's
+///                         reused between calls, to keep its capacity.
+///
+/// \return The text in UTF-8. Valid UTF-8 text is returned as it is, without
+///     being copied to Buffer.
+///
+std::string_view
+LogFileMonitor::ConvertStringToUTF8(
     _In_reads_bytes_(StringSize) LPBYTE StringPtr,
     _In_ UINT StringSize,
-    _In_ LM_FILETYPE EncodingType
+    _In_ LM_FILETYPE EncodingType,
+    _Inout_ std::string& Buffer
     )
 {
-    std::wstring Result;
+    Buffer.clear();
     if (StringSize == 0)
     {
-        return std::wstring();
+        return std::string_view();
     }
 
+    auto appendUtf16 = [&Buffer](LPCWCH WideString, int WideSize)
+    {
+        const int size = WideCharToMultiByte(CP_UTF8, 0, WideString, WideSize, NULL, 0, NULL, NULL);
+        if (size > 0)
+        {
+            Buffer.resize(size);
+            WideCharToMultiByte(CP_UTF8, 0, WideString, WideSize, Buffer.data(), size, NULL, NULL);
+        }
+    };
+
     switch (EncodingType)
     {
     case LM_FILETYPE::UTF16LE:
     {
-        Result = wstring((wchar_t*)StringPtr, (wchar_t*)(StringPtr + StringSize));
+        appendUtf16(reinterpret_cast<LPCWCH>(StringPtr), static_cast<int>(StringSize / sizeof(WCHAR)));
         break;
     }
     case LM_FILETYPE::UTF16BE:
     {
-        Result = wstring((wchar_t*)StringPtr, (wchar_t*)(StringPtr + StringSize));
+        std::wstring littleEndian(reinterpret_cast<wchar_t*>(StringPtr), StringSize / sizeof(WCHAR));
 
         //
         // Reverse each wide character, to make it little endian
         //
-        for (unsigned int i = 0; i < Result.size(); i++)
+        for (unsigned int i = 0; i < littleEndian.size(); i++)
         {
-            Result[i] = (TCHAR)(((Result[i] << 8) & 0xFF00) + ((Result[i] >> 8) & 0xFF));
+            littleEndian[i] = (TCHAR)(((littleEndian[i] << 8) & 0xFF00) + ((littleEndian[i] >> 8) & 0xFF));
         }
+
+        appendUtf16(littleEndian.data(), static_cast<int>(littleEndian.size()));
         break;
     }
     case LM_FILETYPE::UTF8:
     {
-        int size_needed = MultiByteToWideChar(CP_UTF8, 0, (LPCCH)StringPtr, StringSize, NULL, 0);
-        Result.resize(size_needed);
+        if (Utility::IsTextUTF8(reinterpret_cast<LPCSTR>(StringPtr), static_cast<int>(StringSize)))
+        {
+            return std::string_view(reinterpret_cast<const char*>(StringPtr), StringSize);
+        }
+
+        //
+        // Invalid sequences are replaced by U+FFFD, through a conversion to
+        // UTF-16 and back.
+        //
+        const int wideSize = MultiByteToWideChar(CP_UTF8, 0, (LPCCH)StringPtr, StringSize, NULL, 0);
+        std::wstring wideString(wideSize > 0 ? wideSize : 0, L'\0');
 
-        MultiByteToWideChar(CP_UTF8, 0, (LPCCH)StringPtr, StringSize, (LPWSTR)(Result.data()), size_needed);
+        MultiByteToWideChar(CP_UTF8, 0, (LPCCH)StringPtr, StringSize, wideString.data(), wideSize);
+
+        appendUtf16(wideString.data(), static_cast<int>(wideString.size()));
         break;
     }
     default:
     {
-        std::string tempStr((char*)StringPtr, (char*)(StringPtr + StringSize));
         //
-        // ANSI
+        // ANSI, in the code page of the system.
         //
-        Result = wstring(tempStr.begin(), tempStr.end());
+        const int wideSize = MultiByteToWideChar(CP_ACP, 0, (LPCCH)StringPtr, StringSize, NULL, 0);
+        std::wstring wideString(wideSize > 0 ? wideSize : 0, L'\0');
+
+        MultiByteToWideChar(CP_ACP, 0, (LPCCH)StringPtr, StringSize, wideString.data(), wideSize);
+
+        appendUtf16(wideString.data(), static_cast<int>(wideString.size()));
     }
     }
 
-    return Result;
+    return Buffer;
 }
 
 ///
-/// Gets an iterator, using first the Key as if it was a long path, and if it
-/// isn't found recovering the long path using Key as a short path.
+/// Gets the size of the buffer to read the pending bytes of a log file.
 ///
-/// \param Key         The filename to look for.
-/// \param IsShortPath Optional boolean pointer. If it's passed, it will return
-///     false if the key wasn't a short path. Otherwise, will be true.
+/// \param PendingBytes     Bytes between the next read offset and the end of the file.
 ///
-/// \return Iterator to a m_logFilesInformation element.
+/// \return The smallest power of two between READ_BUFFER_MIN_SIZE_BYTES and
+///     READ_BUFFER_MAX_SIZE_BYTES that fits the pending bytes.
 ///
-LogFileMonitor::LogFileInfoMap::iterator
-LogFileMonitor::GetLogFilesInformationIt(
-    _In_ const std::wstring& Key,
-    _Out_opt_ bool* IsShortPath
+DWORD
+LogFileMonitor::GetReadBufferSize(
+    _In_ UINT64 PendingBytes
     )
 {
-    auto element = m_logFilesInformation.find(Key);
-
-    if (element == m_logFilesInformation.end())
-    {
-        auto longPath = m_longPaths.find(Key);
-        if (longPath != m_longPaths.end())
-        {
-            element = m_logFilesInformation.find(longPath->second);
-        }
+    DWORD bufferSize = READ_BUFFER_MIN_SIZE_BYTES;
 
-        if (IsShortPath != NULL)
-        {
-            *IsShortPath = true;
-        }
-    }
-    else
+    while (bufferSize < PendingBytes && bufferSize < READ_BUFFER_MAX_SIZE_BYTES)
     {
-        if (IsShortPath != NULL)
-        {
-            *IsShortPath = false;
-        }
+        bufferSize *= 2;
     }
 
-    return element;
+    return bufferSize;
 }
 
 ///
@@ -2107,6 +3799,48 @@ LogFileMonitor::GetFileId(
     return status;
 }
 
+///
+/// Opens a log file to be read. The file is shared for deletion, so keeping
+/// the handle open doesn't block the application from rotating or deleting it.
+///
+/// \param FullLongPath     The full long path of the file.
+///
+/// \return The file handle, or INVALID_HANDLE_VALUE if it failed.
+///
+HANDLE
+LogFileMonitor::OpenLogFileHandle(
+    _In_ const std::wstring& FullLongPath
+    )
+{
+    return CreateFileW(FullLongPath.c_str(),
+                       GENERIC_READ,
+                       FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                       nullptr,
+                       OPEN_EXISTING,
+                       FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+                       nullptr);
+}
+
+inline bool
+LogFileMonitor::IsFileIdEmpty(
+    _In_ const FILE_ID_INFO& FileId
+    )
+{
+    static const FILE_ID_INFO emptyFileId = {};
+
+    return FileIdsEqual(FileId, emptyFileId);
+}
+
+inline bool
+LogFileMonitor::FileIdsEqual(
+    _In_ const FILE_ID_INFO& FileId1,
+    _In_ const FILE_ID_INFO& FileId2
+    )
+{
+    return FileId1.VolumeSerialNumber == FileId2.VolumeSerialNumber &&
+           memcmp(FileId1.FileId.Identifier, FileId2.FileId.Identifier, sizeof(FileId1.FileId.Identifier)) == 0;
+}
+
 std::wstring LogFileMonitor::FileFieldsMapping(_In_ std::wstring fileFields, _In_ void* pLogEntryData)
 {
     std::wostringstream oss;
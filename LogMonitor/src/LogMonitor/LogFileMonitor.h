@@ -5,10 +5,12 @@
 
 #pragma once
 
-#include <map>
+#include <array>
+#include <atomic>
 #include <memory>
-#include <queue>
+#include <set>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #define REVERSE_BYTE_ORDER_MARK 0xFFFE
@@ -34,30 +36,206 @@ enum LM_FILETYPE
 struct LogFileInformation
 {
     std::wstring FileName;
-    UINT64 NextReadOffset;
-    UINT64 LastReadTimestamp;
-    LM_FILETYPE EncodingType;
+    UINT64 NextReadOffset = 0;
+    std::atomic<UINT64> LastReadTimestamp{ 0 };
+    LM_FILETYPE EncodingType = LM_FILETYPE::FileTypeUnknown;
+
+    //
+    // Held while the file is read by a reader pool worker, and while the
+    // change handler renames or removes it.
+    //
+    SRWLOCK Lock = SRWLOCK_INIT;
+
+    //
+    // Set when the file is removed from the monitored files, so a read that
+    // was already scheduled is skipped. Guarded by Lock.
+    //
+    bool IsRemoved = false;
+
+    //
+    // Read scheduling state. Guarded by the lock of the reader pool.
+    //
+    bool IsReadQueued = false;
+    bool IsBeingRead = false;
+    bool IsReadRequested = false;
+
+    //
+    // When the last read was scheduled, and whether a read is waiting for the
+    // modification coalescing window to end. Only used by the change
+    // handler.
+    //
+    UINT64 LastScheduledTimestamp = 0;
+    bool IsReadDeferred = false;
+
+    //
+    // Size and last write time of the file in its directory entry when the
+    // directory was last rescanned, and the rescan that listed it. Only used
+    // by the change handler.
+    //
+    UINT64 ListedSize = 0;
+    UINT64 ListedWriteTime = 0;
+    UINT64 RescanGeneration = 0;
+
+    //
+    // Handle kept open between reads, so an idle file only costs a size
+    // check per tick. It's opened with FILE_SHARE_DELETE, so it doesn't
+    // prevent the application from deleting or rotating the file.
+    //
+    HANDLE FileHandle = INVALID_HANDLE_VALUE;
+
+    //
+    // Id of the file FileHandle was opened on. Used to detect that the
+    // name now refers to a different file when the handle is reopened.
+    //
+    FILE_ID_INFO FileId = {};
+
+    //
+    // Size and last write time seen in the last metadata query. Used to
+    // skip files that didn't change without issuing any read.
+    //
+    UINT64 LastObservedSize = 0;
+    UINT64 LastWriteTime = 0;
+
+    //
+    // Hash of the first FingerprintSize bytes read from the file, used to
+    // tell a file rewritten in place from a file appended to. Guarded by
+    // Lock.
+    //
+    DWORD FingerprintSize = 0;
+    UINT64 Fingerprint = 0;
+
+    //
+    // Bytes between the next read offset and the end of the file when it
+    // was last read. Set by the reader pool workers, and read when the lag
+    // is reported.
+    //
+    std::atomic<UINT64> LagBytes{ 0 };
+
+    //
+    // Buffer reused across reads. It's sized after the bytes pending to be
+    // read, and released when the file becomes idle.
+    //
+    std::vector<BYTE> ReadBuffer;
+
+    //
+    // Splits the decoded content of the reads into lines, and the buffer the
+    // content is decoded to, both reused across reads. The incomplete line
+    // at the end of a read is kept by the framer and completed by the next
+    // read. It's written on its own once the file wasn't written to for a
+    // while after PartialLineTimestamp, or when the file stops being read
+    // under its name. PartialLineOffset is where the incomplete line starts
+    // in the file, so the checkpoint doesn't skip it. Guarded by Lock.
+    //
+    LineFramer<char> Framer{ LineBreakMode::Lf };
+    std::string DecodedBuffer;
+    UINT64 PartialLineTimestamp = 0;
+    UINT64 PartialLineOffset = 0;
+
+    //
+    // Bytes at the end of the last read that don't make a whole character,
+    // because the rest of it wasn't read yet. They're decoded with the next
+    // read. Guarded by Lock.
+    //
+    std::vector<BYTE> UndecodedBytes;
+
+    //
+    // Key, file id and offset of the last checkpoint of the file, used to
+    // update the checkpoint only when the file was read. Guarded by Lock.
+    //
+    std::wstring CheckpointKey;
+    FILE_ID_INFO CheckpointFileId = {};
+    UINT64 CheckpointOffset = 0;
+
+    LogFileInformation() = default;
+    LogFileInformation(const LogFileInformation&) = delete;
+    LogFileInformation& operator=(const LogFileInformation&) = delete;
+
+    ~LogFileInformation()
+    {
+        CloseFileHandle();
+    }
+
+    void CloseFileHandle()
+    {
+        if (FileHandle != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(FileHandle);
+            FileHandle = INVALID_HANDLE_VALUE;
+        }
+    }
 };
 
-enum class EventAction
+///
+/// Counters of the rotations of the monitored log files.
+///
+struct LogFileRotationCounters
 {
-    Add = 0,
-    Modify = 1,
-    Remove = 2,
-    RenameOld = 3,
-    RenameNew = 4,
-    ReInit = 5,
-    Unknown = 5,
+    //
+    // Monitored files renamed, including the ones renamed out of the filter.
+    //
+    UINT64 RenamedFiles = 0;
+
+    //
+    // Monitored files replaced by a new file with the same name, whose
+    // rename or removal wasn't seen.
+    //
+    UINT64 ReplacedFiles = 0;
+
+    //
+    // Monitored files truncated or rewritten in place.
+    //
+    UINT64 TruncatedFiles = 0;
+
+    //
+    // Bytes read from files when they were renamed or stopped being
+    // monitored, that were written after their last read.
+    //
+    UINT64 DrainedBytes = 0;
 };
 
-struct DirChangeNotificationEvent
+///
+/// Counters of the rescans of the log directory, after change notifications
+/// were lost.
+///
+struct LogFileRescanCounters
 {
-    std::wstring FileName;
-    EventAction Action;
-    UINT64 Timestamp;
+    //
+    // Rescans finished.
+    //
+    UINT64 Rescans = 0;
+
+    //
+    // Files listed by the rescans, and the ones whose directory entry changed
+    // since they were last listed, or that weren't monitored yet. Only these
+    // are opened and read.
+    //
+    UINT64 ListedFiles = 0;
+    UINT64 ChangedFiles = 0;
+    UINT64 AddedFiles = 0;
 };
 
-class LogFileMonitor final
+///
+/// Bytes the monitored log files are behind their end.
+///
+struct LogFileReadLag
+{
+    //
+    // Sum of the bytes pending to be read, and the files with bytes pending.
+    //
+    UINT64 TotalBytes = 0;
+    size_t LaggingFiles = 0;
+
+    //
+    // The file with the most bytes pending to be read.
+    //
+    std::wstring MostLaggingFile;
+    UINT64 MostLaggingFileBytes = 0;
+};
+
+class CheckpointStore;
+class DirectoryEnumerator;
+
+class LogFileMonitor final : private DirectoryWatchEngine::Client
 {
  public:
     LogFileMonitor() = delete;
@@ -68,126 +246,326 @@ class LogFileMonitor final
         _In_ bool IncludeSubfolders,
         _In_ const std::double_t &WaitInSeconds,
         _In_ std::wstring LogFormat,
-        _In_ std::wstring CustomLogFormat);
+        _In_ std::wstring CustomLogFormat,
+        _In_ const FileMonitorTuning &Tuning = FileMonitorTuning());
 
     ~LogFileMonitor();
 
     static std::wstring FileFieldsMapping(_In_ std::wstring eventFields, _In_ void* pLogEntryData);
 
+    ///
+    /// \return The times change notifications were lost because the
+    ///         notification buffer was full.
+    ///
+    UINT64 GetNotificationOverflows() const
+    {
+        return m_notificationOverflows;
+    }
+
+    LogFileRotationCounters GetRotationCounters() const;
+
+    LogFileRescanCounters GetRescanCounters() const;
+
+    LogFileReadLag GetReadLag() const;
+
  private:
     static constexpr int LOG_MONITOR_THREAD_EXIT_MAX_WAIT_MILLIS = 5 * 1000;
-    static constexpr int RECORDS_BUFFER_SIZE_BYTES = 8 * 1024;
+    static constexpr DWORD NOTIFICATION_BUFFER_MIN_SIZE_KB = 4;
+    static constexpr DWORD NOTIFICATION_BUFFER_MAX_SIZE_KB = 64 * 1024;
+    static constexpr DWORD NETWORK_NOTIFICATION_BUFFER_MAX_SIZE_BYTES = 64 * 1024;
+    static constexpr DWORD READ_BUFFER_MIN_SIZE_BYTES = 64 * 1024;
+    static constexpr DWORD READ_BUFFER_MAX_SIZE_BYTES = 1024 * 1024;
+    static constexpr UINT64 MAPPED_READ_THRESHOLD_BYTES = 8 * 1024 * 1024;
+    static constexpr DWORD MAPPED_READ_WINDOW_SIZE_BYTES = 4 * 1024 * 1024;
+    static constexpr UINT64 RESCAN_STEP_MAX_MILLIS = 10;
+    static constexpr DWORD HEADER_FINGERPRINT_MAX_SIZE_BYTES = 64 * 1024;
+    static constexpr DWORD READ_WEIGHT_MAX = 64;
+    static constexpr UINT64 PARTIAL_LINE_FLUSH_TIMEOUT_MILLIS = 1000;
 
     std::wstring m_logDirectory;
     std::wstring m_shortLogDirectory;
-    std::wstring m_filter;
+    FileFilter m_filter;
     std::double_t m_waitInSeconds;
     bool m_includeSubfolders;
     std::wstring m_logFormat;
     std::wstring m_customLogFormat;
+    FileMonitorTuning m_tuning;
+
+    //
+    // Filters of the priorities in the tuning, with the weight of the files
+    // they match.
+    //
+    std::vector<std::pair<FileFilter, DWORD>> m_priorities;
+
+    //
+    // Whether the last report found files behind their end, so the report
+    // after they caught up says so.
+    //
+    bool m_reportedReadLag = false;
+
+    //
+    // A log file listed in the log directory, with the size and last write
+    // time of its directory entry.
+    //
+    struct ListedLogFile
+    {
+        std::wstring FullLongPath;
+        FILE_ID_INFO FileId;
+        UINT64 Size;
+        UINT64 LastWriteTime;
+    };
 
     struct FileLogEntry {
         std::wstring source;
         std::wstring currentTime;
         std::wstring fileName;
         std::wstring message;
+
+        //
+        // File name in UTF-8, and the buffer the lines are formatted in,
+        // reused between the lines of a read.
+        //
+        std::string fileNameUtf8;
+        std::string formattedLine;
     };
 
     //
-    // Signaled by destructor to request the spawned thread to stop.
+    // Signaled by destructor to request the start thread to stop waiting for
+    // the log directory.
     //
     HANDLE m_stopEvent;
 
     HANDLE m_dirMonitorStartedEvent;
 
-    HANDLE m_workerThreadEvent;
-
     HANDLE m_logDirHandle;
 
+    //
+    // The engine watching the directories of all the File sources, and the
+    // registration of this one. The directory reads complete, and the change
+    // events are handled, in the workers of the engine.
+    //
+    std::shared_ptr<DirectoryWatchEngine> m_watchEngine;
+    std::shared_ptr<DirectoryWatchEngine::Registration> m_watchRegistration;
+
     OVERLAPPED m_overlapped;
-    HANDLE m_overlappedEvent;
 
+    //
+    // Change notification buffers. While the notifications of one buffer are
+    // parsed, the next ReadDirectoryChangesW call is already pending on the
+    // other one, so the changes happening meanwhile are captured instead of
+    // accumulating in the kernel until the buffer is armed again.
     //
     // Must be DWORD aligned so allocated on the heap.
     //
-    std::vector<BYTE> records = std::vector<BYTE>(RECORDS_BUFFER_SIZE_BYTES);
+    // Guarded by m_notificationLock. The read armed on the other buffer can
+    // complete in another worker while a buffer is parsed; that worker waits
+    // for the parsing to end, so the changes are queued in order.
+    //
+    std::array<std::vector<BYTE>, 2> m_notificationBuffers;
+    size_t m_armedNotificationBuffer = 0;
+    SRWLOCK m_notificationLock;
 
     //
-    // Handle to an event subscriber thread.
+    // Size of the change notification buffer for the next ReadDirectoryChangesW
+    // call. It's doubled every time the buffer overflows, up to the maximum.
     //
-    HANDLE m_logDirMonitorThread;
+    std::atomic<DWORD> m_notificationBufferSize{ 0 };
+    DWORD m_maxNotificationBufferSize = 0;
+
+    //
+    // Times the change notification buffer overflowed, and the system time
+    // of the last overflow, as a FILETIME. Reported by the change handler
+    // along with the latencies.
+    //
+    std::atomic<UINT64> m_notificationOverflows{ 0 };
+    std::atomic<UINT64> m_lastNotificationOverflowTime{ 0 };
+    UINT64 m_reportedNotificationOverflows = 0;
+
+    //
+    // Change notifications received, and change events dispatched to their
+    // handler once duplicated modifications were coalesced. Reported by the
+    // change handler along with the latencies.
+    //
+    std::atomic<UINT64> m_receivedChangeEvents{ 0 };
+    std::atomic<UINT64> m_dispatchedChangeEvents{ 0 };
+    UINT64 m_reportedReceivedChangeEvents = 0;
+    UINT64 m_reportedDispatchedChangeEvents = 0;
+
+    //
+    // Rotations of the monitored files. The truncations are counted by the
+    // reader pool workers, the rest by the change handler, which
+    // reports them along with the latencies.
+    //
+    std::atomic<UINT64> m_renamedLogFiles{ 0 };
+    std::atomic<UINT64> m_replacedLogFiles{ 0 };
+    std::atomic<UINT64> m_truncatedLogFiles{ 0 };
+    std::atomic<UINT64> m_drainedLogFileBytes{ 0 };
+    LogFileRotationCounters m_reportedRotations;
 
     //
-    // Handle to an change notification event handler thread.
+    // Handle to the thread opening the log directory, waiting for it to be
+    // created if needed. It exits once the directory is watched.
     //
-    HANDLE m_logFilesChangeHandlerThread;
+    HANDLE m_logDirMonitorThread;
 
     SRWLOCK m_eventQueueLock;
 
     //
-    // Case insensitive comparison
+    // Set once the work of the source ran for the first time, and enumerated
+    // the log directory. Only used by the work of the source.
     //
-    struct ci_less
-    {
-        bool operator()(const std::wstring &s1, const std::wstring &s2) const
-        {
-            return _wcsicmp(s1.c_str(), s2.c_str()) < 0;
-        }
-    };
+    bool m_isChangeHandlerStarted = false;
 
-    typedef std::map<std::wstring, std::shared_ptr<LogFileInformation>, ci_less> LogFileInfoMap;
+    //
+    // Registration of the source in the reader pool of the engine, which
+    // reads the log files concurrently. The change handler schedules the
+    // reads.
+    //
+    std::shared_ptr<LogFileReaderPool::Registration> m_readerRegistration;
+
+    //
+    // The monitored files, by long path, short path and file id.
+    //
+    LogFileTable m_logFiles;
 
-    LogFileInfoMap m_logFilesInformation;
+    //
+    // Files with a read waiting for the modification coalescing window to end.
+    //
+    std::vector<std::shared_ptr<LogFileInformation>> m_deferredReads;
 
-    std::map<std::wstring, std::wstring, ci_less> m_longPaths;
+    UINT64 m_nextSweepTimestamp = 0;
+    UINT64 m_nextLatencyReportTimestamp = 0;
+    UINT64 m_nextCheckpointTimestamp = 0;
 
     //
-    // FILE_ID_INFO comparison
+    // Read offsets saved across restarts. Null if checkpoints are disabled.
     //
-    struct file_id_less
-    {
-        bool operator()(const FILE_ID_INFO &id1, const FILE_ID_INFO &id2) const
-        {
-            return id1.VolumeSerialNumber < id2.VolumeSerialNumber ||
-                   (id1.VolumeSerialNumber == id2.VolumeSerialNumber &&
-                    memcmp(id1.FileId.Identifier, id2.FileId.Identifier, sizeof(id1.FileId.Identifier)) < 0);
-        }
-    };
+    std::unique_ptr<CheckpointStore> m_checkpointStore;
+
+    //
+    // Set once the checkpoints of the files that no longer exist were removed,
+    // after the first enumeration of the directory.
+    //
+    bool m_areCheckpointsPruned = false;
+
+    //
+    // Listing of the directory rescan in progress, started when change
+    // notifications were lost. It's listed in steps between the change
+    // notifications, so the files keep being tailed during the rescan.
+    // Null when there's no rescan in progress.
+    //
+    std::unique_ptr<DirectoryEnumerator> m_rescan;
+    UINT64 m_rescanGeneration = 0;
+    bool m_isRescanRequested = false;
+
+    UINT64 m_rescanStartTimestamp = 0;
+    UINT64 m_rescanListedFiles = 0;
+    UINT64 m_rescanChangedFiles = 0;
+    UINT64 m_rescanAddedFiles = 0;
 
-    std::map<FILE_ID_INFO, std::wstring, file_id_less> m_fileIds;
+    //
+    // Totals of the rescans finished, updated by the change handler.
+    //
+    std::atomic<UINT64> m_rescans{ 0 };
+    std::atomic<UINT64> m_rescannedListedFiles{ 0 };
+    std::atomic<UINT64> m_rescannedChangedFiles{ 0 };
+    std::atomic<UINT64> m_rescannedAddedFiles{ 0 };
 
-    std::queue<DirChangeNotificationEvent> m_directoryChangeEvents;
+    //
+    // Time from the last write to a log file to the write of its lines to
+    // stdout, recorded by the readers. Guarded by m_readLatencyLock.
+    //
+    LatencyHistogram m_readLatency;
+    SRWLOCK m_readLatencyLock;
+
+    //
+    // Change events waiting to be handled. Guarded by m_eventQueueLock. The
+    // work of the source swaps the whole batch with its own when signaled.
+    //
+    DirChangeEventBatch m_directoryChangeEvents;
+
+    //
+    // The queued events are swapped into this batch, and handled one by one.
+    // It's reused, so its memory is too. Only used by the change handler.
+    //
+    DirChangeEventBatch m_handledChangeEvents;
+
+    //
+    // Events of the notification buffer being parsed, queued all at once.
+    // Guarded by m_notificationLock.
+    //
+    DirChangeEventBatch m_notifiedChangeEvents;
 
     bool m_readLogFilesFromStart;
 
-    DWORD EnqueueDirChangeEvents(DirChangeNotificationEvent event, BOOLEAN lock);
+    void EnqueueDirChangeEvents(
+        _Inout_ DirChangeEventBatch &Events,
+        _In_ bool IsLockHeld = false);
+
+    bool IsChangeOfMonitoredFile(
+        _Inout_ std::wstring &FileName);
 
     DWORD StartLogFileMonitor();
 
     static DWORD StartLogFileMonitorStatic(
         _In_ LPVOID Context);
 
-    static inline BOOL FileMatchesFilter(
-        _In_ LPCWSTR FileName,
-        _In_ LPCWSTR SearchPattern);
-
     DWORD InitializeMonitoredFilesInfo();
 
-    DWORD LogDirectoryChangeNotificationHandler();
+    DWORD ArmDirectoryChangesRead();
 
-    static DWORD LogFilesChangeHandlerStatic(
-        _In_ LPVOID Context);
+    void OnDirectoryChangesCompleted(
+        _In_ DWORD Status,
+        _In_ DWORD BytesTransferred) override;
+
+    void OnWork() override;
+
+    DWORD LogDirectoryChangeNotificationHandler(
+        _In_reads_bytes_(BytesTransferred) const BYTE* Buffer,
+        _In_ DWORD BytesTransferred);
 
-    DWORD LogFilesChangeHandler();
+    void NotificationBufferOverflowHandler();
+
+    void ReportNotificationOverflows();
+
+    void ReportChangeEvents();
+
+    void ReportLogFileRotations();
+
+    void ReportReadLag();
+
+    void StartChangeHandler();
+
+    void HandleDirChangeEvents();
+
+    void HandleTimer();
 
     DWORD InitializeDirectoryChangeEventsQueue();
 
-    static DWORD GetFilesInDirectory(
+    DWORD GetFilesInDirectory(
         _In_ const std::wstring &FolderPath,
-        _In_ const std::wstring &SearchPattern,
-        _Out_ std::vector<std::pair<std::wstring, FILE_ID_INFO>> &Files,
+        _Out_ std::vector<ListedLogFile> &Files,
         _In_ bool ShouldLookInSubfolders);
 
+    void SetChangeHandlerTimer();
+
+    void ScheduleLogFileRead(
+        _In_ const std::shared_ptr<LogFileInformation> &LogFileInfo);
+
+    void ScheduleModifiedLogFile(
+        _In_ const std::shared_ptr<LogFileInformation> &LogFileInfo);
+
+    void ScheduleDeferredReads();
+
+    void RecordReadLatency(
+        _In_ UINT64 LastWriteTime,
+        _In_ UINT64 LinesCount);
+
+    void ReportReadLatency();
+
+    void CheckpointLogFile(
+        _In_ const std::shared_ptr<LogFileInformation> &LogFileInfo);
+
     DWORD LogFileAddEventHandler(DirChangeNotificationEvent &Event);
 
     DWORD LogFileRemoveEventHandler(DirChangeNotificationEvent &Event);
@@ -196,6 +574,20 @@ class LogFileMonitor final
 
     DWORD LogFileRenameNewEventHandler(DirChangeNotificationEvent &Event);
 
+    bool IsLogFileReplaced(
+        _In_ const std::shared_ptr<LogFileInformation> &LogFileInfo,
+        _In_ const std::wstring &FullLongPath);
+
+    void RemoveReplacedLogFile(
+        _In_ const std::wstring &FileName);
+
+    void DrainLogFile(
+        _In_ const std::shared_ptr<LogFileInformation> &LogFileInfo);
+
+    void FlushPartialLine(
+        _In_ const std::shared_ptr<LogFileInformation> &LogFileInfo,
+        _In_ bool IsFileEnded);
+
     void RenameFileInMaps(
         _In_ const std::wstring &NewFullName,
         _In_ const std::wstring &OldName,
@@ -203,12 +595,68 @@ class LogFileMonitor final
 
     DWORD LogFileReInitEventHandler(DirChangeNotificationEvent &Event);
 
+    void StartDirectoryRescan();
+
+    void ContinueDirectoryRescan();
+
+    void ReconcileListedLogFile(
+        _In_ const std::wstring &FullLongPath,
+        _In_ const WIN32_FIND_DATAW &FindData);
+
+    void FinishDirectoryRescan();
+
+    DWORD OpenLogFile(
+        _Inout_ std::shared_ptr<LogFileInformation> LogFileInfo,
+        _In_ const std::wstring &FullLongPath);
+
+    bool ReadScheduledLogFile(
+        _In_ const std::shared_ptr<LogFileInformation> &LogFileInfo);
+
+    UINT64 GetReadBudget(
+        _In_ const std::wstring &FileName) const;
+
     DWORD ReadLogFile(
-        _Inout_ std::shared_ptr<LogFileInformation> LogFileInfo);
+        _Inout_ std::shared_ptr<LogFileInformation> LogFileInfo,
+        _In_ UINT64 ReadBudget);
+
+    bool IsLogFileRewritten(
+        _In_ const std::shared_ptr<LogFileInformation> &LogFileInfo);
+
+    void UpdateHeaderFingerprint(
+        _In_ const std::shared_ptr<LogFileInformation> &LogFileInfo);
+
+    static bool GetHeaderFingerprint(
+        _In_ HANDLE File,
+        _In_ DWORD Size,
+        _Out_ UINT64 &Fingerprint);
+
+    DWORD ReadLogFileMapped(
+        _Inout_ std::shared_ptr<LogFileInformation> LogFileInfo,
+        _In_ UINT64 FileSize);
+
+    static void UpdatePartialLineOffset(
+        _In_ const std::shared_ptr<LogFileInformation>& LogFileInfo,
+        _In_reads_bytes_(ContentSize) const BYTE* Contents,
+        _In_ size_t ContentSize,
+        _In_ UINT64 ContentOffset,
+        _In_ bool HadPartialLine);
+
+    static size_t GetCompleteLinesSize(
+        _In_reads_bytes_(ContentSize) const BYTE* Contents,
+        _In_ size_t ContentSize,
+        _In_ LM_FILETYPE EncodingType);
+
+    static size_t GetDecodableSize(
+        _In_reads_bytes_(ContentSize) const BYTE* Contents,
+        _In_ size_t ContentSize,
+        _In_ LM_FILETYPE EncodingType);
+
+    static FileLogEntry CreateFileLogEntry(
+        _In_ const std::wstring &FileName);
 
-    void WriteToConsole(
-        _In_ std::wstring Message,
-        _In_ std::wstring FileName);
+    void WriteLineToConsole(
+        _In_ std::string_view Line,
+        _Inout_ FileLogEntry &LogEntry);
 
     LM_FILETYPE FileTypeFromBuffer(
         _In_reads_bytes_(ContentSize) LPBYTE FileContents,
@@ -217,17 +665,27 @@ class LogFileMonitor final
         _In_ UINT BomSize,
         _Out_ UINT &FoundBomSize);
 
-    std::wstring ConvertStringToUTF16(
+    static std::string_view ConvertStringToUTF8(
         _In_reads_bytes_(StringSize) LPBYTE StringPtr,
         _In_ UINT StringSize,
-        _In_ LM_FILETYPE EncodingType);
+        _In_ LM_FILETYPE EncodingType,
+        _Inout_ std::string &Buffer);
 
-    LogFileInfoMap::iterator GetLogFilesInformationIt(
-        _In_ const std::wstring &Key,
-        _Out_opt_ bool *IsShortPath = NULL);
+    static DWORD GetReadBufferSize(
+        _In_ UINT64 PendingBytes);
 
     static DWORD GetFileId(
         _In_ const std::wstring &FullLongPath,
         _Out_ FILE_ID_INFO &FileId,
         _In_opt_ HANDLE Handle = INVALID_HANDLE_VALUE);
+
+    static HANDLE OpenLogFileHandle(
+        _In_ const std::wstring &FullLongPath);
+
+    static inline bool IsFileIdEmpty(
+        _In_ const FILE_ID_INFO &FileId);
+
+    static inline bool FileIdsEqual(
+        _In_ const FILE_ID_INFO &FileId1,
+        _In_ const FILE_ID_INFO &FileId2);
 };
@@ -6,6 +6,9 @@
 #pragma once
 
 #include <cstdio>
+#include <memory>
+#include <string>
+#include <string_view>
 
 class LogWriter final
 {
@@ -14,29 +17,103 @@ class LogWriter final
     {
         InitializeSRWLock(&m_stdoutLock);
 
-        DWORD dwMode;
-
-        if (!GetConsoleMode(GetStdHandle(STD_OUTPUT_HANDLE), &dwMode))
-        {
-            m_isConsole = false;
-        }
-
-        m_isConsole = true;
-
         _setmode(_fileno(stdout), _O_U8TEXT);
     };
 
     ~LogWriter() {}
 
  private:
+    static constexpr DWORD FLUSH_MAX_WAIT_MILLIS = 2 * 1000;
+
+    //
+    // The lines are terminated by CRLF, as the CRT writes them in text mode
+    // before the writer thread is started.
+    //
+    static constexpr std::string_view LINE_TERMINATOR = "\r\n";
+
     SRWLOCK m_stdoutLock;
-    bool m_isConsole;
 
-    void FlushStdOut()
+    //
+    // Writer of the lines to stdout, once started. It's started before the
+    // monitors, and lives as long as the LogWriter, so it's read without
+    // holding the lock.
+    //
+    std::unique_ptr<OutputWriter> m_outputWriter;
+
+ public:
+    ///
+    /// Starts the thread writing the lines to stdout in batches. Until it's
+    /// started, or if it can't be, each line is written and flushed by the
+    /// thread producing it. It must be called once, before the monitors start.
+    ///
+    /// \param Settings     The flush interval and size, queue size, overflow
+    ///                     policy and output file of the writer.
+    ///
+    /// \return true if the writer thread was started.
+    ///
+    bool StartOutputWriter(
+        _In_ const OutputSettings& Settings
+    )
     {
-        if (m_isConsole)
+        try
         {
+            //
+            // The lines already written by the CRT must reach stdout before
+            // the ones of the writer thread.
+            //
             fflush(stdout);
+
+            m_outputWriter = std::make_unique<OutputWriter>(
+                Settings.WriteToStdout ? GetStdHandle(STD_OUTPUT_HANDLE) : INVALID_HANDLE_VALUE,
+                Settings);
+        }
+        catch (std::exception& ex)
+        {
+            TraceError(
+                Utility::FormatString(L"Failed to start the output writer. %S", ex.what()).c_str()
+            );
+
+            return false;
+        }
+
+        return true;
+    }
+
+    ///
+    /// Waits for the lines written so far to reach stdout, before the
+    /// process exits.
+    ///
+    void FlushOutput()
+    {
+        if (m_outputWriter)
+        {
+            m_outputWriter->Flush(FLUSH_MAX_WAIT_MILLIS);
+        }
+        else
+        {
+            AcquireSRWLockExclusive(&m_stdoutLock);
+
+            fflush(stdout);
+
+            ReleaseSRWLockExclusive(&m_stdoutLock);
+        }
+    }
+
+    ///
+    /// Like FlushOutput, but it doesn't wait for a lock held by another
+    /// thread, or by the thread it interrupted. Used by the signal handler.
+    ///
+    void TryFlushOutput()
+    {
+        if (m_outputWriter)
+        {
+            m_outputWriter->TryFlush(FLUSH_MAX_WAIT_MILLIS);
+        }
+        else if (TryAcquireSRWLockExclusive(&m_stdoutLock))
+        {
+            fflush(stdout);
+
+            ReleaseSRWLockExclusive(&m_stdoutLock);
         }
     }
 
@@ -60,30 +137,82 @@ class LogWriter final
         return result;
     }
 
-    void WriteConsoleLog(
-        _In_ const std::wstring&& LogMessage
+    ///
+    /// Writes UTF-8 text, that ends with a line terminator, to stdout.
+    ///
+    void WriteOutput(
+        _In_ OutputSource Source,
+        _In_ std::string_view Text
     )
     {
-        AcquireSRWLockExclusive(&m_stdoutLock);
+        if (m_outputWriter)
+        {
+            m_outputWriter->Write(Source, Text);
+            return;
+        }
 
-        wprintf(L"%s\n", LogMessage.c_str());
-        FlushStdOut();
+        DWORD bytesWritten;
 
-        ReleaseSRWLockExclusive(&m_stdoutLock);
+        WriteLog(
+            GetStdHandle(STD_OUTPUT_HANDLE),
+            Text.data(),
+            static_cast<DWORD>(Text.size()),
+            &bytesWritten,
+            NULL);
+    }
+
+    void WriteConsoleLog(
+        _In_ const std::wstring&& LogMessage,
+        _In_ OutputSource Source = OutputSource::LogMonitor
+    )
+    {
+        WriteConsoleLog(LogMessage, Source);
     }
 
     void WriteConsoleLog(
-        _In_ const std::wstring& LogMessage
+        _In_ const std::wstring& LogMessage,
+        _In_ OutputSource Source = OutputSource::LogMonitor
     )
     {
+        if (m_outputWriter)
+        {
+            m_outputWriter->Write(Source, Utility::WStringToString(LogMessage), LINE_TERMINATOR);
+            return;
+        }
+
+        //
+        // Without the writer thread nothing would flush the line later, so
+        // it's flushed now, whether stdout is a console or a pipe.
+        //
         AcquireSRWLockExclusive(&m_stdoutLock);
 
         wprintf(L"%s\n", LogMessage.c_str());
-        FlushStdOut();
+        fflush(stdout);
 
         ReleaseSRWLockExclusive(&m_stdoutLock);
     }
 
+    ///
+    /// Writes a line, already encoded in UTF-8, to stdout. The writer thread
+    /// writes its bytes as they are, so it isn't converted again.
+    ///
+    void WriteConsoleLog(
+        _In_ std::string_view LogMessage,
+        _In_ OutputSource Source = OutputSource::LogMonitor
+    )
+    {
+        if (m_outputWriter)
+        {
+            m_outputWriter->Write(Source, LogMessage, LINE_TERMINATOR);
+            return;
+        }
+
+        //
+        // stdout is in wide text mode, so the CRT only takes UTF-16 text.
+        //
+        WriteConsoleLog(Utility::StringToWString(std::string(LogMessage)));
+    }
+
     void TraceError(
         _In_ LPCWSTR Message
     )
@@ -98,6 +227,38 @@ class LogWriter final
         WriteConsoleLog(formattedMessage);
     }
 
+    ///
+    /// Like TraceError, but it doesn't wait for a lock held by another thread,
+    /// or by the thread it interrupted, and the trace is lost then. Used by
+    /// the signal handler.
+    ///
+    void TryTraceError(
+        _In_ LPCWSTR Message
+    )
+    {
+        SYSTEMTIME st;
+        GetSystemTime(&st);
+
+        std::wstring formattedMessage = Utility::FormatString(L"[%s][LOGMONITOR] ERROR: %s",
+            Utility::SystemTimeToString(st).c_str(),
+            Message);
+
+        if (m_outputWriter)
+        {
+            m_outputWriter->TryWrite(
+                OutputSource::LogMonitor,
+                Utility::WStringToString(formattedMessage),
+                LINE_TERMINATOR);
+        }
+        else if (TryAcquireSRWLockExclusive(&m_stdoutLock))
+        {
+            wprintf(L"%s\n", formattedMessage.c_str());
+            fflush(stdout);
+
+            ReleaseSRWLockExclusive(&m_stdoutLock);
+        }
+    }
+
     void TraceWarning(
         _In_ LPCWSTR Message
     )
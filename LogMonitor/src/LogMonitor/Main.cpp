@@ -31,10 +31,18 @@ std::wstring logFormat, processMonitorCustomFormat;
 /// \return None
 ///
 void signalHandler(int signum) {
-    logWriter.TraceError(
+    logWriter.TryTraceError(
         Utility::FormatString(L"Catastrophic failure! Signal received: %d", signum).c_str()
     );
 
+    //
+    // The lines pending in the output writer, including this one, are
+    // written before the program is terminated. The signal may have
+    // interrupted a thread holding the lock of the writer, so neither the
+    // trace nor the flush wait for it.
+    //
+    logWriter.TryFlushOutput();
+
     // Terminate the program
     std::exit(signum);
 }
@@ -57,7 +65,13 @@ BOOL WINAPI ControlHandle(_In_ DWORD dwCtrlType)
         case CTRL_LOGOFF_EVENT:
         case CTRL_SHUTDOWN_EVENT:
         {
-            wprintf(L"\nCTRL signal received. The process will now terminate.\n");
+            logWriter.TraceInfo(L"CTRL signal received. The process will now terminate.");
+
+            //
+            // The lines still pending in the output writer, including this
+            // one, are written before the process is terminated.
+            //
+            logWriter.FlushOutput();
 
             SetEvent(g_hStopEvent);
             g_hStopEvent = INVALID_HANDLE_VALUE;
@@ -134,7 +148,8 @@ void InitializeFileMonitor(std::shared_ptr<SourceFile> sourceFile)
             sourceFile->IncludeSubdirectories,
             sourceFile->WaitInSeconds,
             logFormat,
-            sourceFile->CustomLogFormat
+            sourceFile->CustomLogFormat,
+            sourceFile->Tuning
         );
         g_logfileMonitors.push_back(std::move(logfileMon));
     }
@@ -417,6 +432,11 @@ int __cdecl wmain(int argc, WCHAR *argv[])
     //read the config file
     bool configFileReadSuccess = ReadConfigFile((PWCHAR)resolvedConfigPath.c_str(), settings);
 
+    //
+    // From now on, the lines are written to stdout by the writer thread.
+    //
+    logWriter.StartOutputWriter(settings.Output);
+
     //start the monitors
     if (configFileReadSuccess)
     {
@@ -478,5 +498,12 @@ int __cdecl wmain(int argc, WCHAR *argv[])
         g_hStopEvent = INVALID_HANDLE_VALUE;
     }
 
+    //
+    // Write the lines still pending in the output writer, like the last
+    // lines of the child process, before the process exits. The destructor
+    // of logWriter doesn't run if the process is terminated meanwhile.
+    //
+    logWriter.FlushOutput();
+
     return exitcode;
 }
@@ -0,0 +1,448 @@
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//
+
+#include "pch.h"  // NOLINT(build/include_subdir)
+#include "OutputFileSink.h"  // NOLINT(build/include_subdir)
+
+///
+/// Opens the file, appending to its current content, and starts the
+/// compression thread if the rotated files are compressed.
+///
+/// \param Settings     Path, max size, rotation interval, max files and
+///                     compression of the file.
+///
+OutputFileSink::OutputFileSink(
+    _In_ const OutputFileSettings& Settings
+    ) :
+    m_path(Settings.Path),
+    m_maxSize(static_cast<UINT64>(Settings.MaxSizeInMB) * 1024 * 1024),
+    m_rotationIntervalInMilliseconds(static_cast<UINT64>(Settings.RotationIntervalInMinutes) * 60 * 1000),
+    m_maxFiles(Settings.MaxFiles),
+    m_compress(Settings.Compress)
+{
+    InitializeSRWLock(&m_compressionLock);
+    InitializeConditionVariable(&m_compressionQueued);
+
+    const DWORD error = OpenFile();
+    if (error != ERROR_SUCCESS)
+    {
+        throw std::system_error(std::error_code(error, std::system_category()), "CreateFileW");
+    }
+
+    if (m_compress)
+    {
+        m_compressionThread = CreateThread(
+            nullptr,
+            0,
+            (LPTHREAD_START_ROUTINE)&OutputFileSink::CompressionThreadStatic,
+            this,
+            0,
+            nullptr);
+        if (!m_compressionThread)
+        {
+            const DWORD threadError = GetLastError();
+
+            CloseHandle(m_fileHandle);
+
+            throw std::system_error(std::error_code(threadError, std::system_category()), "CreateThread");
+        }
+    }
+}
+
+///
+/// Closes the file, and stops the compression thread. The rotated files not
+/// compressed yet are left as they are.
+///
+OutputFileSink::~OutputFileSink()
+{
+    if (m_fileHandle != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(m_fileHandle);
+    }
+
+    if (!m_compressionThread)
+    {
+        return;
+    }
+
+    AcquireSRWLockExclusive(&m_compressionLock);
+
+    m_stopping = true;
+    WakeConditionVariable(&m_compressionQueued);
+
+    ReleaseSRWLockExclusive(&m_compressionLock);
+
+    if (WaitForSingleObject(m_compressionThread, THREAD_EXIT_MAX_WAIT_MILLIS) != WAIT_OBJECT_0)
+    {
+        //
+        // The compression of a large file is still running. The process is
+        // exiting, as the sink lives as long as the OutputWriter.
+        //
+        return;
+    }
+
+    CloseHandle(m_compressionThread);
+
+    for (HANDLE fileHandle : m_filesToCompress)
+    {
+        CloseHandle(fileHandle);
+    }
+}
+
+///
+/// Writes a batch of lines to the file, rotating it first if it's due. It's
+/// only called by the writer thread of the OutputWriter.
+///
+/// \param Data     The lines to write.
+/// \param Size     The size of the lines.
+///
+/// \return ERROR_SUCCESS, or the error of the file.
+///
+DWORD
+OutputFileSink::Write(
+    _In_ const char* Data,
+    _In_ size_t Size
+    )
+{
+    if (Size == 0)
+    {
+        return ERROR_SUCCESS;
+    }
+
+    //
+    // A batch isn't split between two files, so a batch larger than the max
+    // size is written alone to a new file. After a failed rotation, the next
+    // one waits for the retry interval.
+    //
+    if (m_fileHandle != INVALID_HANDLE_VALUE && m_fileSize > 0 &&
+        (m_fileSize + Size > m_maxSize ||
+         (m_rotationIntervalInMilliseconds > 0 &&
+          GetTickCount64() - m_openTimestamp >= m_rotationIntervalInMilliseconds)) &&
+        (m_rotationFailureTimestamp == 0 ||
+         GetTickCount64() - m_rotationFailureTimestamp >= ROTATION_RETRY_INTERVAL_MILLIS))
+    {
+        Rotate();
+    }
+
+    if (m_fileHandle == INVALID_HANDLE_VALUE)
+    {
+        //
+        // The file couldn't be opened again after it was rotated. It's
+        // retried with the next batches.
+        //
+        const DWORD error = OpenFile();
+        if (error != ERROR_SUCCESS)
+        {
+            return error;
+        }
+    }
+
+    //
+    // The rotation interval starts with the first line of the file.
+    //
+    if (m_fileSize == 0)
+    {
+        m_openTimestamp = GetTickCount64();
+    }
+
+    ExtendAllocation(m_fileSize + Size);
+
+    while (Size > 0)
+    {
+        DWORD bytesToWrite = Size > MAXDWORD ? MAXDWORD : static_cast<DWORD>(Size);
+        DWORD bytesWritten = 0;
+
+        if (!WriteFile(m_fileHandle, Data, bytesToWrite, &bytesWritten, NULL))
+        {
+            return GetLastError();
+        }
+
+        Data += bytesWritten;
+        Size -= bytesWritten;
+        m_fileSize += bytesWritten;
+    }
+
+    return ERROR_SUCCESS;
+}
+
+///
+/// Opens the file, or creates it, and moves to its end.
+///
+/// \return ERROR_SUCCESS, or the error of the file.
+///
+DWORD
+OutputFileSink::OpenFile()
+{
+    //
+    // The file is shared for reading, so it can be followed while it's
+    // written, and for deleting, so other tools can rotate it too.
+    //
+    m_fileHandle = CreateFileW(
+        m_path.c_str(),
+        GENERIC_WRITE,
+        FILE_SHARE_READ | FILE_SHARE_DELETE,
+        NULL,
+        OPEN_ALWAYS,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+        NULL);
+    if (m_fileHandle == INVALID_HANDLE_VALUE)
+    {
+        return GetLastError();
+    }
+
+    LARGE_INTEGER fileSize = {};
+    const LARGE_INTEGER distanceToMove = {};
+
+    if (!GetFileSizeEx(m_fileHandle, &fileSize) ||
+        !SetFilePointerEx(m_fileHandle, distanceToMove, NULL, FILE_END))
+    {
+        const DWORD error = GetLastError();
+
+        CloseHandle(m_fileHandle);
+        m_fileHandle = INVALID_HANDLE_VALUE;
+
+        return error;
+    }
+
+    m_fileSize = static_cast<UINT64>(fileSize.QuadPart);
+    m_allocatedSize = m_fileSize;
+    m_openTimestamp = GetTickCount64();
+
+    return ERROR_SUCCESS;
+}
+
+///
+/// Closes the file and renames it to the first rotated file, after shifting
+/// the previous ones, and queues it to be compressed. The next batch opens a
+/// new file.
+///
+void
+OutputFileSink::Rotate()
+{
+    CloseHandle(m_fileHandle);
+    m_fileHandle = INVALID_HANDLE_VALUE;
+
+    if (m_maxFiles == 0)
+    {
+        //
+        // No rotated file is kept, so the file starts again empty.
+        //
+        if (!DeleteFileW(m_path.c_str()))
+        {
+            RecordRotationFailure(GetLastError());
+            return;
+        }
+
+        m_rotationFailureTimestamp = 0;
+        return;
+    }
+
+    //
+    // Only the rotated files that exist are shifted, up to the last one,
+    // which is replaced.
+    //
+    DWORD lastGeneration = 1;
+
+    while (lastGeneration < m_maxFiles &&
+           GetFileAttributesW(GetRotatedPath(lastGeneration).c_str()) != INVALID_FILE_ATTRIBUTES)
+    {
+        lastGeneration++;
+    }
+
+    for (DWORD generation = lastGeneration; generation > 1; generation--)
+    {
+        MoveFileExW(
+            GetRotatedPath(generation - 1).c_str(),
+            GetRotatedPath(generation).c_str(),
+            MOVEFILE_REPLACE_EXISTING);
+    }
+
+    const std::wstring rotatedPath = GetRotatedPath(1);
+
+    if (!MoveFileExW(m_path.c_str(), rotatedPath.c_str(), MOVEFILE_REPLACE_EXISTING))
+    {
+        RecordRotationFailure(GetLastError());
+        return;
+    }
+
+    m_rotationFailureTimestamp = 0;
+
+    if (!m_compress)
+    {
+        return;
+    }
+
+    //
+    // The rotated file is shared for deleting, so it's still rotated again,
+    // or deleted, while it's compressed.
+    //
+    HANDLE rotatedFileHandle = CreateFileW(
+        rotatedPath.c_str(),
+        GENERIC_READ | GENERIC_WRITE,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        NULL,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL,
+        NULL);
+    if (rotatedFileHandle == INVALID_HANDLE_VALUE)
+    {
+        return;
+    }
+
+    AcquireSRWLockExclusive(&m_compressionLock);
+
+    m_filesToCompress.push_back(rotatedFileHandle);
+    WakeConditionVariable(&m_compressionQueued);
+
+    ReleaseSRWLockExclusive(&m_compressionLock);
+}
+
+///
+/// Records a failed rotation. The file keeps growing past its max size until
+/// it can be rotated, and the rotation is retried after
+/// ROTATION_RETRY_INTERVAL_MILLIS rather than with each batch.
+///
+/// \param Error    The error of the rotation.
+///
+void
+OutputFileSink::RecordRotationFailure(
+    _In_ DWORD Error
+    )
+{
+    //
+    // Only the first failure of a row is reported.
+    //
+    if (m_rotationFailureTimestamp == 0)
+    {
+        m_unreportedRotationError = Error;
+    }
+
+    m_rotationFailureTimestamp = GetTickCount64();
+}
+
+///
+/// Takes the error of a failed rotation, once. A rotation that keeps failing
+/// is only reported again after it succeeded. It's only called by the writer
+/// thread of the OutputWriter.
+///
+/// \return The error of the rotation, or ERROR_SUCCESS if there is none to
+///         report.
+///
+DWORD
+OutputFileSink::TakeRotationError()
+{
+    const DWORD error = m_unreportedRotationError;
+    m_unreportedRotationError = ERROR_SUCCESS;
+
+    return error;
+}
+
+///
+/// Allocates the file an extent at a time, up to its max size, so it isn't
+/// extended by each write. The allocation doesn't move the end of the file,
+/// so the readers of the file only see the lines written, and the space past
+/// it is released when the file is closed.
+///
+/// \param RequiredSize     The size of the file after the next write.
+///
+void
+OutputFileSink::ExtendAllocation(
+    _In_ UINT64 RequiredSize
+    )
+{
+    if (RequiredSize <= m_allocatedSize)
+    {
+        return;
+    }
+
+    UINT64 allocationSize = ((RequiredSize + EXTENT_SIZE - 1) / EXTENT_SIZE) * EXTENT_SIZE;
+    allocationSize = max(min(allocationSize, m_maxSize), RequiredSize);
+
+    FILE_ALLOCATION_INFO allocationInfo = {};
+    allocationInfo.AllocationSize.QuadPart = static_cast<LONGLONG>(allocationSize);
+
+    //
+    // The allocation is only an optimization, so if the file system doesn't
+    // take it, the writes extend the file. It isn't retried before the next
+    // extent.
+    //
+    SetFileInformationByHandle(m_fileHandle, FileAllocationInfo, &allocationInfo, sizeof(allocationInfo));
+
+    m_allocatedSize = allocationSize;
+}
+
+///
+/// \return The path of a rotated file, <path>.<generation>.
+///
+std::wstring
+OutputFileSink::GetRotatedPath(
+    _In_ DWORD Generation
+    ) const
+{
+    return m_path + L"." + std::to_wstring(Generation);
+}
+
+DWORD
+OutputFileSink::CompressionThreadStatic(
+    _In_ LPVOID Context
+    )
+{
+    auto sink = reinterpret_cast<OutputFileSink*>(Context);
+
+    sink->CompressionThread();
+
+    return ERROR_SUCCESS;
+}
+
+///
+/// Compresses the rotated files, with the compression of the file system,
+/// so they stay readable as they are.
+///
+void
+OutputFileSink::CompressionThread()
+{
+    AcquireSRWLockExclusive(&m_compressionLock);
+
+    for (;;)
+    {
+        while (m_filesToCompress.empty() && !m_stopping)
+        {
+            SleepConditionVariableSRW(&m_compressionQueued, &m_compressionLock, INFINITE, 0);
+        }
+
+        if (m_stopping)
+        {
+            break;
+        }
+
+        HANDLE fileHandle = m_filesToCompress.front();
+        m_filesToCompress.pop_front();
+
+        ReleaseSRWLockExclusive(&m_compressionLock);
+
+        //
+        // The compression fails on file systems that don't support it, and
+        // the file is then kept as it is.
+        //
+        USHORT compressionFormat = COMPRESSION_FORMAT_DEFAULT;
+        DWORD bytesReturned = 0;
+
+        DeviceIoControl(
+            fileHandle,
+            FSCTL_SET_COMPRESSION,
+            &compressionFormat,
+            sizeof(compressionFormat),
+            NULL,
+            0,
+            &bytesReturned,
+            NULL);
+
+        CloseHandle(fileHandle);
+
+        AcquireSRWLockExclusive(&m_compressionLock);
+    }
+
+    ReleaseSRWLockExclusive(&m_compressionLock);
+}
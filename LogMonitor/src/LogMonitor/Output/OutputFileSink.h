@@ -0,0 +1,109 @@
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//
+
+#pragma once
+
+#include <deque>
+#include <string>
+
+///
+/// File the output writer writes the log lines to, in addition to stdout or
+/// instead of it.
+///
+/// It's written by the writer thread of the OutputWriter, with one write per
+/// batch. The file is allocated in extents ahead of its writes, so a file
+/// growing by a batch at a time isn't extended, and fragmented, by each
+/// write. It's rotated once it reaches its max size, or once it was written
+/// to for the rotation interval: it's renamed to <path>.1, the previous
+/// rotated files are shifted, and the ones past the max files are deleted.
+/// The rotated files can be compressed by the file system, on a separate
+/// thread so the writes don't wait for it. A rotation that fails, like when
+/// another process has the file open without sharing it for deleting, is
+/// retried after ROTATION_RETRY_INTERVAL_MILLIS.
+///
+class OutputFileSink final
+{
+ public:
+    OutputFileSink() = delete;
+
+    explicit OutputFileSink(
+        _In_ const OutputFileSettings& Settings);
+
+    ~OutputFileSink();
+
+    OutputFileSink(const OutputFileSink&) = delete;
+    OutputFileSink& operator=(const OutputFileSink&) = delete;
+
+    DWORD Write(
+        _In_ const char* Data,
+        _In_ size_t Size);
+
+    DWORD TakeRotationError();
+
+ private:
+    static constexpr int THREAD_EXIT_MAX_WAIT_MILLIS = 5 * 1000;
+    static constexpr UINT64 EXTENT_SIZE = 8 * 1024 * 1024;
+    static constexpr UINT64 ROTATION_RETRY_INTERVAL_MILLIS = 60 * 1000;
+
+    std::wstring m_path;
+    UINT64 m_maxSize;
+    UINT64 m_rotationIntervalInMilliseconds;
+    DWORD m_maxFiles;
+    bool m_compress;
+
+    HANDLE m_fileHandle = INVALID_HANDLE_VALUE;
+
+    //
+    // Size written to the file, size allocated to it, and when it was
+    // opened.
+    //
+    UINT64 m_fileSize = 0;
+    UINT64 m_allocatedSize = 0;
+    UINT64 m_openTimestamp = 0;
+
+    //
+    // When the last rotation failed, 0 if it didn't. The error of the first
+    // failure of a row is kept until it's taken to be reported.
+    //
+    UINT64 m_rotationFailureTimestamp = 0;
+    DWORD m_unreportedRotationError = ERROR_SUCCESS;
+
+    SRWLOCK m_compressionLock;
+
+    //
+    // Signaled when a rotated file is queued to be compressed, or the sink is
+    // stopping.
+    //
+    CONDITION_VARIABLE m_compressionQueued;
+
+    //
+    // Handles of the rotated files to compress. They are opened when they
+    // are rotated, so they're compressed even if they are rotated again
+    // before the compression thread gets to them.
+    //
+    std::deque<HANDLE> m_filesToCompress;
+
+    bool m_stopping = false;
+
+    HANDLE m_compressionThread = NULL;
+
+    DWORD OpenFile();
+
+    void Rotate();
+
+    void RecordRotationFailure(
+        _In_ DWORD Error);
+
+    void ExtendAllocation(
+        _In_ UINT64 RequiredSize);
+
+    std::wstring GetRotatedPath(
+        _In_ DWORD Generation) const;
+
+    static DWORD CompressionThreadStatic(
+        _In_ LPVOID Context);
+
+    void CompressionThread();
+};
@@ -0,0 +1,646 @@
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//
+
+#include "pch.h"  // NOLINT(build/include_subdir)
+#include "OutputSpill.h"  // NOLINT(build/include_subdir)
+
+///
+/// Creates the spill directory if it doesn't exist, and starts the spill
+/// thread. The segment files are only created once lines are spilled.
+///
+/// \param Directory                Directory of the segment files.
+/// \param MaxSize                  Maximum disk usage of the segments, in bytes.
+/// \param MaxAgeInMilliseconds     Maximum age of the lines replayed.
+///
+OutputSpill::OutputSpill(
+    _In_ const std::wstring& Directory,
+    _In_ UINT64 MaxSize,
+    _In_ UINT64 MaxAgeInMilliseconds
+    ) :
+    m_directory(Directory),
+    m_maxSize(MaxSize),
+    m_maxAgeInMilliseconds(MaxAgeInMilliseconds)
+{
+    InitializeSRWLock(&m_lock);
+    InitializeConditionVariable(&m_recordsStaged);
+    InitializeConditionVariable(&m_chunkWritten);
+
+    //
+    // A few segments fit in the max size, so the replayed segments are
+    // deleted while the newer ones still take lines.
+    //
+    m_segmentSize = std::clamp(m_maxSize / 4, MIN_SEGMENT_SIZE, MAX_SEGMENT_SIZE);
+
+    if (!CreateDirectoryW(m_directory.c_str(), NULL) && GetLastError() != ERROR_ALREADY_EXISTS)
+    {
+        throw std::system_error(std::error_code(GetLastError(), std::system_category()), "CreateDirectoryW");
+    }
+
+    m_spillThread = CreateThread(
+        nullptr,
+        0,
+        (LPTHREAD_START_ROUTINE)&OutputSpill::SpillThreadStatic,
+        this,
+        0,
+        nullptr);
+    if (!m_spillThread)
+    {
+        throw std::system_error(std::error_code(GetLastError(), std::system_category()), "CreateThread");
+    }
+}
+
+///
+/// Stops the spill thread, and closes the segments, which deletes them. The
+/// lines not replayed are lost.
+///
+OutputSpill::~OutputSpill()
+{
+    AcquireSRWLockExclusive(&m_lock);
+
+    m_stopping = true;
+    WakeConditionVariable(&m_recordsStaged);
+
+    ReleaseSRWLockExclusive(&m_lock);
+
+    if (WaitForSingleObject(m_spillThread, THREAD_EXIT_MAX_WAIT_MILLIS) != WAIT_OBJECT_0)
+    {
+        //
+        // The spill thread is stuck in a write. The segments are deleted when
+        // the process exits and their handles are closed.
+        //
+        return;
+    }
+
+    CloseHandle(m_spillThread);
+
+    for (auto& segment : m_segments)
+    {
+        CloseHandle(segment.FileHandle);
+    }
+}
+
+///
+/// \return The default directory of the segment files, in the temp directory.
+///
+std::wstring
+OutputSpill::GetDefaultDirectory()
+{
+    WCHAR tempPath[MAX_PATH + 1];
+
+    const DWORD length = GetTempPathW(_countof(tempPath), tempPath);
+    if (length == 0 || length > _countof(tempPath))
+    {
+        return L"C:\\LogMonitor\\Spill";
+    }
+
+    return std::wstring(tempPath, length) + L"LogMonitorSpill";
+}
+
+///
+/// Appends a line to the staged records. It's called by the OutputWriter
+/// with its lock held, so it only copies the line.
+///
+/// \param Source           The source of the line.
+/// \param Text             The UTF-8 text of the line.
+/// \param LineTerminator   Appended to the text.
+///
+/// \return true if the line was spilled, false if it was dropped because the
+///         spill reached its max size.
+///
+bool
+OutputSpill::Append(
+    _In_ OutputSource Source,
+    _In_ std::string_view Text,
+    _In_ std::string_view LineTerminator
+    )
+{
+    const size_t lineSize = Text.size() + LineTerminator.size();
+    const size_t recordSize = sizeof(RecordHeader) + lineSize;
+
+    if (lineSize > MAXUINT32)
+    {
+        return false;
+    }
+
+    AcquireSRWLockExclusive(&m_lock);
+
+    //
+    // A single record larger than the max staged size is still staged, the
+    // spill thread writes it alone.
+    //
+    const size_t previousSize = m_stagedRecords.size();
+
+    if (m_usedSize + recordSize > m_maxSize ||
+        (previousSize > 0 && previousSize + recordSize > MAX_STAGED_SIZE))
+    {
+        ReleaseSRWLockExclusive(&m_lock);
+        return false;
+    }
+
+    if (previousSize == 0)
+    {
+        m_stagedTimestamp = GetTickCount64();
+    }
+
+    const RecordHeader header = { static_cast<UINT32>(lineSize), static_cast<UINT32>(Source) };
+
+    m_stagedRecords.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    m_stagedRecords.append(Text.data(), Text.size());
+    m_stagedRecords.append(LineTerminator.data(), LineTerminator.size());
+
+    m_stagedLines[static_cast<size_t>(Source)]++;
+    m_stagedLinesSize += lineSize;
+    m_usedSize += recordSize;
+
+    if (previousSize == 0 || (previousSize < WRITE_SIZE && m_stagedRecords.size() >= WRITE_SIZE))
+    {
+        WakeConditionVariable(&m_recordsStaged);
+    }
+
+    ReleaseSRWLockExclusive(&m_lock);
+
+    return true;
+}
+
+///
+/// Reads the oldest spilled lines, from the segments first, then from the
+/// staged records, which are taken without being written. The segments
+/// older than the max age are discarded first. It's called by the writer
+/// thread of the OutputWriter, the only reader.
+///
+/// \param Lines    The lines read are appended to it, without their headers.
+/// \param MaxSize  Size of the reads of the segments. A larger line is read
+///                 on its own.
+///
+void
+OutputSpill::Read(
+    _Inout_ std::string& Lines,
+    _In_ size_t MaxSize
+    )
+{
+    AcquireSRWLockExclusive(&m_lock);
+
+    for (;;)
+    {
+        //
+        // The last segment can't be closed while the spill thread writes to
+        // it. It stops taking records once it's a quarter of the max age
+        // old, so it's only discarded with the stale lines it has.
+        //
+        const UINT64 now = GetTickCount64();
+
+        while (!m_segments.empty() &&
+               !(m_isWriting && m_segments.size() == 1) &&
+               (now - m_segments.front().Timestamp > m_maxAgeInMilliseconds ||
+                m_segments.front().ReadOffset == m_segments.front().WrittenSize))
+        {
+            DropSegment(m_segments.front());
+            CloseFrontSegment();
+        }
+
+        if (!m_segments.empty() && m_segments.front().ReadOffset < m_segments.front().WrittenSize)
+        {
+            break;
+        }
+
+        if (m_isWriting)
+        {
+            SleepConditionVariableSRW(&m_chunkWritten, &m_lock, INFINITE, 0);
+            continue;
+        }
+
+        if (!m_stagedRecords.empty())
+        {
+            UINT64 readLines[OUTPUT_SOURCE_COUNT] = {};
+            UINT64 readLinesSize = 0;
+
+            ParseRecords(m_stagedRecords, Lines, readLines, readLinesSize);
+
+            m_usedSize -= m_stagedRecords.size();
+            m_stagedRecords.clear();
+            std::fill(std::begin(m_stagedLines), std::end(m_stagedLines), 0);
+            m_stagedLinesSize = 0;
+        }
+
+        ReleaseSRWLockExclusive(&m_lock);
+        return;
+    }
+
+    //
+    // Only the reader removes the first segment, so it stays valid while
+    // the segment is read without holding the lock.
+    //
+    Segment& segment = m_segments.front();
+    const HANDLE fileHandle = segment.FileHandle;
+    const UINT64 readOffset = segment.ReadOffset;
+    const UINT64 availableSize = segment.WrittenSize - readOffset;
+
+    ReleaseSRWLockExclusive(&m_lock);
+
+    size_t readSize = static_cast<size_t>(min(availableSize, static_cast<UINT64>(MaxSize)));
+    size_t consumedSize = 0;
+    UINT64 readLines[OUTPUT_SOURCE_COUNT] = {};
+    UINT64 readLinesSize = 0;
+    bool succeeded = false;
+
+    for (int attempt = 0; attempt < 2; attempt++)
+    {
+        OVERLAPPED overlapped = {};
+        overlapped.Offset = static_cast<DWORD>(readOffset);
+        overlapped.OffsetHigh = static_cast<DWORD>(readOffset >> 32);
+
+        m_readBuffer.resize(readSize);
+        DWORD bytesRead = 0;
+
+        if (!ReadFile(fileHandle, m_readBuffer.data(), static_cast<DWORD>(readSize), &bytesRead, &overlapped) ||
+            bytesRead != readSize)
+        {
+            break;
+        }
+
+        consumedSize = ParseRecords(m_readBuffer, Lines, readLines, readLinesSize);
+        if (consumedSize > 0)
+        {
+            succeeded = true;
+            break;
+        }
+
+        //
+        // The first record is larger than the read, so it's read on its own.
+        //
+        RecordHeader header;
+        if (readSize < sizeof(header))
+        {
+            break;
+        }
+
+        memcpy(&header, m_readBuffer.data(), sizeof(header));
+        readSize = static_cast<size_t>(min(availableSize, sizeof(header) + static_cast<UINT64>(header.Size)));
+    }
+
+    AcquireSRWLockExclusive(&m_lock);
+
+    if (succeeded)
+    {
+        segment.ReadOffset += consumedSize;
+
+        for (size_t i = 0; i < OUTPUT_SOURCE_COUNT; i++)
+        {
+            segment.Lines[i] -= readLines[i];
+        }
+
+        segment.LinesSize -= readLinesSize;
+
+        //
+        // A replayed segment is deleted right away, so its disk usage is
+        // released.
+        //
+        if (segment.ReadOffset == segment.WrittenSize && !(m_isWriting && m_segments.size() == 1))
+        {
+            CloseFrontSegment();
+        }
+    }
+    else if (!(m_isWriting && m_segments.size() == 1))
+    {
+        //
+        // The rest of a segment that can't be read is lost.
+        //
+        DropSegment(segment);
+        CloseFrontSegment();
+    }
+
+    ReleaseSRWLockExclusive(&m_lock);
+}
+
+///
+/// \return true if no spilled line is left to replay.
+///
+bool
+OutputSpill::IsEmpty()
+{
+    AcquireSRWLockShared(&m_lock);
+
+    bool isEmpty = m_stagedRecords.empty() && !m_isWriting;
+
+    for (const auto& segment : m_segments)
+    {
+        if (segment.ReadOffset < segment.WrittenSize)
+        {
+            isEmpty = false;
+        }
+    }
+
+    ReleaseSRWLockShared(&m_lock);
+
+    return isEmpty;
+}
+
+///
+/// Takes the lines discarded by the max age, or lost by a failed write or
+/// read, since the last call.
+///
+/// \param DroppedLines     The dropped lines are added to it, per source.
+///
+/// \return The size of the dropped lines.
+///
+UINT64
+OutputSpill::TakeDroppedLines(
+    _Inout_ UINT64 (&DroppedLines)[OUTPUT_SOURCE_COUNT]
+    )
+{
+    AcquireSRWLockExclusive(&m_lock);
+
+    for (size_t i = 0; i < OUTPUT_SOURCE_COUNT; i++)
+    {
+        DroppedLines[i] += m_droppedLines[i];
+        m_droppedLines[i] = 0;
+    }
+
+    const UINT64 droppedSize = m_droppedSize;
+    m_droppedSize = 0;
+
+    ReleaseSRWLockExclusive(&m_lock);
+
+    return droppedSize;
+}
+
+///
+/// Creates a segment file.
+///
+/// \param FileHandle   Receives the handle of the segment.
+///
+/// \return ERROR_SUCCESS, or the error of CreateFileW.
+///
+DWORD
+OutputSpill::CreateSegment(
+    _Out_ HANDLE& FileHandle
+    )
+{
+    const std::wstring segmentPath = Utility::FormatString(
+        L"%s\\output-%lu-%llu.spill",
+        m_directory.c_str(),
+        GetCurrentProcessId(),
+        m_nextSegmentId++);
+
+    //
+    // The segments are temporary files deleted when they are closed, so the
+    // file cache doesn't write them to disk unless memory is short, and a
+    // crash doesn't leave them behind.
+    //
+    FileHandle = CreateFileW(
+        segmentPath.c_str(),
+        GENERIC_READ | GENERIC_WRITE,
+        0,
+        NULL,
+        CREATE_ALWAYS,
+        FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE | FILE_FLAG_SEQUENTIAL_SCAN,
+        NULL);
+
+    return FileHandle == INVALID_HANDLE_VALUE ? GetLastError() : ERROR_SUCCESS;
+}
+
+///
+/// Counts the lines of a segment not replayed yet as dropped.
+///
+void
+OutputSpill::DropSegment(
+    _In_ Segment& DroppedSegment
+    )
+{
+    for (size_t i = 0; i < OUTPUT_SOURCE_COUNT; i++)
+    {
+        m_droppedLines[i] += DroppedSegment.Lines[i];
+        DroppedSegment.Lines[i] = 0;
+    }
+
+    m_droppedSize += DroppedSegment.LinesSize;
+    DroppedSegment.LinesSize = 0;
+}
+
+void
+OutputSpill::CloseFrontSegment()
+{
+    Segment& segment = m_segments.front();
+
+    CloseHandle(segment.FileHandle);
+    m_usedSize -= segment.WrittenSize;
+
+    m_segments.pop_front();
+}
+
+///
+/// Appends the lines of the complete records to a buffer.
+///
+/// \param Records          The records to parse.
+/// \param Lines            The lines are appended to it, without their headers.
+/// \param ReadLines        Incremented per source for each line.
+/// \param ReadLinesSize    Incremented by the size of the lines.
+///
+/// \return The size of the complete records. A truncated record at the end
+///         isn't parsed.
+///
+size_t
+OutputSpill::ParseRecords(
+    _In_ std::string_view Records,
+    _Inout_ std::string& Lines,
+    _Inout_ UINT64 (&ReadLines)[OUTPUT_SOURCE_COUNT],
+    _Inout_ UINT64& ReadLinesSize
+    )
+{
+    size_t offset = 0;
+
+    while (Records.size() - offset >= sizeof(RecordHeader))
+    {
+        RecordHeader header;
+        memcpy(&header, Records.data() + offset, sizeof(header));
+
+        if (Records.size() - offset - sizeof(header) < header.Size)
+        {
+            break;
+        }
+
+        Lines.append(Records.data() + offset + sizeof(header), header.Size);
+
+        if (header.Source < OUTPUT_SOURCE_COUNT)
+        {
+            ReadLines[header.Source]++;
+        }
+
+        ReadLinesSize += header.Size;
+        offset += sizeof(header) + header.Size;
+    }
+
+    return offset;
+}
+
+DWORD
+OutputSpill::SpillThreadStatic(
+    _In_ LPVOID Context
+    )
+{
+    auto spill = reinterpret_cast<OutputSpill*>(Context);
+
+    spill->SpillThread();
+
+    return ERROR_SUCCESS;
+}
+
+///
+/// Waits for the staged records to reach the write size, or for the oldest
+/// of them to wait for the write interval, and appends them to the last
+/// segment with one write. The segments are never flushed.
+///
+void
+OutputSpill::SpillThread()
+{
+    AcquireSRWLockExclusive(&m_lock);
+
+    for (;;)
+    {
+        while (m_stagedRecords.empty() && !m_stopping)
+        {
+            SleepConditionVariableSRW(&m_recordsStaged, &m_lock, INFINITE, 0);
+        }
+
+        while (!m_stopping && !m_stagedRecords.empty() && m_stagedRecords.size() < WRITE_SIZE)
+        {
+            const UINT64 elapsed = GetTickCount64() - m_stagedTimestamp;
+            if (elapsed >= WRITE_INTERVAL_MILLIS)
+            {
+                break;
+            }
+
+            SleepConditionVariableSRW(
+                &m_recordsStaged,
+                &m_lock,
+                static_cast<DWORD>(WRITE_INTERVAL_MILLIS - elapsed),
+                0);
+        }
+
+        //
+        // The staged records are lost with the spill when it's stopping, and
+        // they may have been taken by the reader while the thread waited.
+        //
+        if (m_stopping)
+        {
+            break;
+        }
+
+        if (m_stagedRecords.empty())
+        {
+            continue;
+        }
+
+        //
+        // The records start a new segment if the last one is full, or too
+        // old to take more lines.
+        //
+        Segment* segment = nullptr;
+
+        if (!m_segments.empty() &&
+            m_segments.back().WrittenSize + m_stagedRecords.size() <= m_segmentSize &&
+            GetTickCount64() - m_segments.back().Timestamp <= m_maxAgeInMilliseconds / 4)
+        {
+            segment = &m_segments.back();
+        }
+
+        HANDLE fileHandle = segment != nullptr ? segment->FileHandle : INVALID_HANDLE_VALUE;
+        const UINT64 writeOffset = segment != nullptr ? segment->WrittenSize : 0;
+
+        m_writtenRecords.swap(m_stagedRecords);
+
+        UINT64 writtenLines[OUTPUT_SOURCE_COUNT];
+        std::copy(std::begin(m_stagedLines), std::end(m_stagedLines), std::begin(writtenLines));
+        std::fill(std::begin(m_stagedLines), std::end(m_stagedLines), 0);
+
+        const UINT64 writtenLinesSize = m_stagedLinesSize;
+        m_stagedLinesSize = 0;
+
+        const UINT64 timestamp = m_stagedTimestamp;
+
+        m_isWriting = true;
+
+        ReleaseSRWLockExclusive(&m_lock);
+
+        DWORD error = ERROR_SUCCESS;
+
+        if (segment == nullptr)
+        {
+            error = CreateSegment(fileHandle);
+        }
+
+        const char* next = m_writtenRecords.data();
+        size_t remaining = m_writtenRecords.size();
+        UINT64 offset = writeOffset;
+
+        while (error == ERROR_SUCCESS && remaining > 0)
+        {
+            OVERLAPPED overlapped = {};
+            overlapped.Offset = static_cast<DWORD>(offset);
+            overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+
+            DWORD bytesToWrite = remaining > MAXDWORD ? MAXDWORD : static_cast<DWORD>(remaining);
+            DWORD bytesWritten = 0;
+
+            if (!WriteFile(fileHandle, next, bytesToWrite, &bytesWritten, &overlapped))
+            {
+                error = GetLastError();
+                break;
+            }
+
+            next += bytesWritten;
+            remaining -= bytesWritten;
+            offset += bytesWritten;
+        }
+
+        AcquireSRWLockExclusive(&m_lock);
+
+        if (error == ERROR_SUCCESS)
+        {
+            if (segment == nullptr)
+            {
+                segment = &m_segments.emplace_back();
+                segment->FileHandle = fileHandle;
+                segment->Timestamp = timestamp;
+            }
+
+            segment->WrittenSize += m_writtenRecords.size();
+
+            for (size_t i = 0; i < OUTPUT_SOURCE_COUNT; i++)
+            {
+                segment->Lines[i] += writtenLines[i];
+            }
+
+            segment->LinesSize += writtenLinesSize;
+        }
+        else
+        {
+            //
+            // The lines of a chunk that can't be written are lost. A segment
+            // created for it is deleted, and the next chunk of an existing
+            // segment overwrites the part that was written.
+            //
+            if (segment == nullptr && fileHandle != INVALID_HANDLE_VALUE)
+            {
+                CloseHandle(fileHandle);
+            }
+
+            for (size_t i = 0; i < OUTPUT_SOURCE_COUNT; i++)
+            {
+                m_droppedLines[i] += writtenLines[i];
+            }
+
+            m_droppedSize += writtenLinesSize;
+            m_usedSize -= m_writtenRecords.size();
+        }
+
+        m_writtenRecords.clear();
+        m_isWriting = false;
+
+        WakeAllConditionVariable(&m_chunkWritten);
+    }
+
+    ReleaseSRWLockExclusive(&m_lock);
+}
@@ -0,0 +1,182 @@
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//
+
+#pragma once
+
+#include <deque>
+#include <string>
+#include <string_view>
+
+///
+/// Overflow of the output writer to disk.
+///
+/// When the output queue is full, the lines are appended to the spill
+/// instead, and the writer thread replays them, in order, once it has written
+/// the queue. The lines are framed in records and staged in memory. A spill
+/// thread appends the staged records to segment files with large sequential
+/// writes, and the files are never flushed to disk: they are temporary files,
+/// deleted when they are closed, so they mostly live in the file cache.
+///
+/// The disk usage of the spill is capped: a line that doesn't fit anymore is
+/// dropped. The segments older than the max age are discarded before they
+/// are replayed, as their lines are stale.
+///
+class OutputSpill final
+{
+ public:
+    OutputSpill() = delete;
+
+    OutputSpill(
+        _In_ const std::wstring& Directory,
+        _In_ UINT64 MaxSize,
+        _In_ UINT64 MaxAgeInMilliseconds);
+
+    ~OutputSpill();
+
+    OutputSpill(const OutputSpill&) = delete;
+    OutputSpill& operator=(const OutputSpill&) = delete;
+
+    bool Append(
+        _In_ OutputSource Source,
+        _In_ std::string_view Text,
+        _In_ std::string_view LineTerminator);
+
+    void Read(
+        _Inout_ std::string& Lines,
+        _In_ size_t MaxSize);
+
+    bool IsEmpty();
+
+    UINT64 TakeDroppedLines(
+        _Inout_ UINT64 (&DroppedLines)[OUTPUT_SOURCE_COUNT]);
+
+    static std::wstring GetDefaultDirectory();
+
+ private:
+    static constexpr int THREAD_EXIT_MAX_WAIT_MILLIS = 5 * 1000;
+
+    //
+    // The staged records are written once they reach the write size, or once
+    // the oldest of them waited for the write interval. Producers drop their
+    // lines if the disk is so slow that the staged records reach the max.
+    //
+    static constexpr size_t WRITE_SIZE = 1024 * 1024;
+    static constexpr size_t MAX_STAGED_SIZE = 4 * WRITE_SIZE;
+    static constexpr DWORD WRITE_INTERVAL_MILLIS = 1000;
+
+    static constexpr UINT64 MAX_SEGMENT_SIZE = 16 * 1024 * 1024;
+    static constexpr UINT64 MIN_SEGMENT_SIZE = WRITE_SIZE;
+
+    ///
+    /// Header of a line in the spill. The line follows it.
+    ///
+    struct RecordHeader
+    {
+        UINT32 Size;
+        UINT32 Source;
+    };
+
+    ///
+    /// Segment file of the spill.
+    ///
+    struct Segment
+    {
+        HANDLE FileHandle = INVALID_HANDLE_VALUE;
+
+        //
+        // When the oldest record of the segment was appended to the spill.
+        //
+        UINT64 Timestamp = 0;
+
+        UINT64 WrittenSize = 0;
+        UINT64 ReadOffset = 0;
+
+        //
+        // Lines not replayed yet per source, and their size without headers.
+        //
+        UINT64 Lines[OUTPUT_SOURCE_COUNT] = {};
+        UINT64 LinesSize = 0;
+    };
+
+    std::wstring m_directory;
+    UINT64 m_maxSize;
+    UINT64 m_maxAgeInMilliseconds;
+    UINT64 m_segmentSize;
+    UINT64 m_nextSegmentId = 0;
+
+    SRWLOCK m_lock;
+
+    //
+    // Signaled when records are staged, or the spill is stopping.
+    //
+    CONDITION_VARIABLE m_recordsStaged;
+
+    //
+    // Signaled when the spill thread wrote a chunk of records.
+    //
+    CONDITION_VARIABLE m_chunkWritten;
+
+    //
+    // Segments, oldest first. The spill thread appends to the last one.
+    //
+    std::deque<Segment> m_segments;
+
+    //
+    // Records not written yet, with their lines per source and size, and
+    // when the oldest of them was staged.
+    //
+    std::string m_stagedRecords;
+    UINT64 m_stagedLines[OUTPUT_SOURCE_COUNT] = {};
+    UINT64 m_stagedLinesSize = 0;
+    UINT64 m_stagedTimestamp = 0;
+
+    //
+    // Chunk of records being written by the spill thread. Like the batches
+    // of the OutputWriter, it keeps its capacity to be swapped with the
+    // staged records.
+    //
+    std::string m_writtenRecords;
+    bool m_isWriting = false;
+
+    //
+    // Bytes of the segments, chunk being written and staged records.
+    //
+    UINT64 m_usedSize = 0;
+
+    //
+    // Lines discarded or lost by a failed write, not taken yet by the
+    // OutputWriter, and their size.
+    //
+    UINT64 m_droppedLines[OUTPUT_SOURCE_COUNT] = {};
+    UINT64 m_droppedSize = 0;
+
+    bool m_stopping = false;
+
+    //
+    // Buffer the segments are read into. Only used by the reader.
+    //
+    std::string m_readBuffer;
+
+    HANDLE m_spillThread = NULL;
+
+    DWORD CreateSegment(
+        _Out_ HANDLE& FileHandle);
+
+    void DropSegment(
+        _In_ Segment& DroppedSegment);
+
+    void CloseFrontSegment();
+
+    static size_t ParseRecords(
+        _In_ std::string_view Records,
+        _Inout_ std::string& Lines,
+        _Inout_ UINT64 (&ReadLines)[OUTPUT_SOURCE_COUNT],
+        _Inout_ UINT64& ReadLinesSize);
+
+    static DWORD SpillThreadStatic(
+        _In_ LPVOID Context);
+
+    void SpillThread();
+};
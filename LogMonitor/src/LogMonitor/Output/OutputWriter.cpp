@@ -0,0 +1,828 @@
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//
+
+#include "pch.h"  // NOLINT(build/include_subdir)
+#include "OutputWriter.h"  // NOLINT(build/include_subdir)
+
+///
+/// Creates the writer, and starts its writer thread.
+///
+/// \param OutputHandle     Handle the lines are written to, or INVALID_HANDLE_VALUE
+///                         to only write them to the output file. It isn't closed
+///                         by the writer.
+/// \param Settings         Flush interval and size, queue size, overflow policy and
+///                         output file of the writer.
+///
+OutputWriter::OutputWriter(
+    _In_ HANDLE OutputHandle,
+    _In_ const OutputSettings& Settings
+    ) :
+    m_outputHandle(OutputHandle),
+    m_flushIntervalInMilliseconds(Settings.FlushIntervalInMilliseconds),
+    m_flushSize(static_cast<size_t>(Settings.FlushSizeInKB) * 1024),
+    m_maxQueueSize(static_cast<size_t>(Settings.QueueSizeInKB) * 1024),
+    m_overflowPolicy(Settings.OverflowPolicy),
+    m_sampleRate(Settings.SampleRate),
+    m_dropReportIntervalInMilliseconds(static_cast<UINT64>(Settings.DropReportIntervalInSeconds) * 1000)
+{
+    InitializeSRWLock(&m_lock);
+    InitializeConditionVariable(&m_linesAppended);
+    InitializeConditionVariable(&m_batchWritten);
+    InitializeConditionVariable(&m_queueDrained);
+
+    if (m_flushSize == 0)
+    {
+        m_flushSize = 1;
+    }
+
+    if (m_maxQueueSize == 0)
+    {
+        m_maxQueueSize = 1;
+    }
+
+    if (m_sampleRate == 0)
+    {
+        m_sampleRate = 1;
+    }
+
+    if (!Settings.File.Path.empty())
+    {
+        m_fileSink = std::make_unique<OutputFileSink>(Settings.File);
+    }
+
+    if (m_overflowPolicy == OutputOverflowPolicy::Spill)
+    {
+        m_spill = std::make_unique<OutputSpill>(
+            Settings.SpillDirectory.empty() ? OutputSpill::GetDefaultDirectory() : Settings.SpillDirectory,
+            static_cast<UINT64>(Settings.SpillMaxSizeInMB) * 1024 * 1024,
+            static_cast<UINT64>(Settings.SpillMaxAgeInSeconds) * 1000);
+    }
+
+    DWORD consoleMode = 0;
+    m_isConsoleOutput = m_outputHandle != INVALID_HANDLE_VALUE &&
+        GetConsoleMode(m_outputHandle, &consoleMode);
+
+    m_pendingLines.reserve(m_flushSize);
+    m_writtenLines.reserve(m_flushSize);
+
+    m_writerThread = CreateThread(
+        nullptr,
+        0,
+        (LPTHREAD_START_ROUTINE)&OutputWriter::WriterThreadStatic,
+        this,
+        0,
+        nullptr);
+    if (!m_writerThread)
+    {
+        throw std::system_error(std::error_code(GetLastError(), std::system_category()), "CreateThread");
+    }
+}
+
+///
+/// Stops the writer thread, once it has written the pending lines.
+///
+OutputWriter::~OutputWriter()
+{
+    AcquireSRWLockExclusive(&m_lock);
+
+    m_stopping = true;
+    WakeConditionVariable(&m_linesAppended);
+    WakeAllConditionVariable(&m_queueDrained);
+
+    ReleaseSRWLockExclusive(&m_lock);
+
+    //
+    // The writer thread uses the members, so they aren't released until it
+    // exits. If the output is blocked, like a pipe that isn't read, the write
+    // of the writer thread is cancelled, and the batch it was writing dropped.
+    //
+    while (WaitForSingleObject(m_writerThread, THREAD_EXIT_MAX_WAIT_MILLIS) == WAIT_TIMEOUT)
+    {
+        CancelSynchronousIo(m_writerThread);
+    }
+
+    CloseHandle(m_writerThread);
+}
+
+///
+/// Appends text to the pending lines. It's written by the writer thread
+/// once a batch is complete, or the flush interval elapsed. If the queue is
+/// full, the overflow policy decides whether the call blocks, the line is
+/// spilled, or a line is dropped.
+///
+/// \param Source           The source of the line, the drops are counted by source.
+/// \param Text             The UTF-8 text to write. It's written as it is.
+/// \param LineTerminator   Appended to the text. It can be empty if the text
+///                         already ends with a line terminator.
+///
+void
+OutputWriter::Write(
+    _In_ OutputSource Source,
+    _In_ std::string_view Text,
+    _In_ std::string_view LineTerminator
+    )
+{
+    const size_t lineSize = Text.size() + LineTerminator.size();
+
+    if (lineSize == 0)
+    {
+        return;
+    }
+
+    AcquireSRWLockExclusive(&m_lock);
+
+    if (m_spill && (m_isSpilling || !LineFits(lineSize)))
+    {
+        SpillLine(Source, Text, LineTerminator);
+    }
+    else if (ReserveQueueSpace(Source, lineSize))
+    {
+        const size_t previousSize = GetQueuedSize();
+
+        AppendLine(Source, Text, LineTerminator);
+
+        //
+        // The writer thread is only woken when it has to start timing a batch,
+        // or when the batch is complete.
+        //
+        if (previousSize == 0 || (previousSize < m_flushSize && GetQueuedSize() >= m_flushSize))
+        {
+            WakeConditionVariable(&m_linesAppended);
+        }
+    }
+
+    ReleaseSRWLockExclusive(&m_lock);
+}
+
+///
+/// Like Write, but the line is only appended if the lock is free and the
+/// line fits in the queue, so the call never waits. Used where the caller
+/// may have interrupted a thread holding the lock, like a signal handler.
+///
+/// \param Source           The source of the line.
+/// \param Text             The UTF-8 text to write.
+/// \param LineTerminator   Appended to the text.
+///
+/// \return true if the line was appended.
+///
+bool
+OutputWriter::TryWrite(
+    _In_ OutputSource Source,
+    _In_ std::string_view Text,
+    _In_ std::string_view LineTerminator
+    )
+{
+    if (!TryAcquireSRWLockExclusive(&m_lock))
+    {
+        return false;
+    }
+
+    const bool isAppended = !m_isSpilling && LineFits(Text.size() + LineTerminator.size());
+
+    if (isAppended)
+    {
+        AppendLine(Source, Text, LineTerminator);
+        WakeConditionVariable(&m_linesAppended);
+    }
+
+    ReleaseSRWLockExclusive(&m_lock);
+
+    return isAppended;
+}
+
+///
+/// \param Source   The source of the lines.
+///
+/// \return The number of lines of the source dropped by the overflow policy.
+///
+UINT64
+OutputWriter::GetDroppedLines(
+    _In_ OutputSource Source
+    )
+{
+    AcquireSRWLockShared(&m_lock);
+
+    const UINT64 droppedLines = m_droppedLines[static_cast<size_t>(Source)];
+
+    ReleaseSRWLockShared(&m_lock);
+
+    return droppedLines;
+}
+
+///
+/// Applies the overflow policy to a line about to be appended. It's called
+/// with the lock held, which the block policy releases while it waits.
+///
+/// \param Source       The source of the line.
+/// \param LineSize     The size of the line, with its terminator.
+///
+/// \return true if the line can be appended, false if it was dropped.
+///
+bool
+OutputWriter::ReserveQueueSpace(
+    _In_ OutputSource Source,
+    _In_ size_t LineSize
+    )
+{
+    switch (m_overflowPolicy)
+    {
+        case OutputOverflowPolicy::Block:
+            while (!LineFits(LineSize))
+            {
+                //
+                // The writer thread doesn't wait for the flush interval to
+                // write a full queue.
+                //
+                m_flushRequested = true;
+                WakeConditionVariable(&m_linesAppended);
+
+                SleepConditionVariableSRW(&m_queueDrained, &m_lock, INFINITE, 0);
+            }
+            return true;
+
+        case OutputOverflowPolicy::DropOldest:
+            while (!LineFits(LineSize))
+            {
+                DropOldestLine();
+            }
+            return true;
+
+        case OutputOverflowPolicy::Sample:
+            if (GetQueuedSize() + LineSize > m_maxQueueSize / 2 &&
+                m_sampledLines[static_cast<size_t>(Source)]++ % m_sampleRate != 0)
+            {
+                CountDroppedLine(Source);
+                return false;
+            }
+
+            if (!LineFits(LineSize))
+            {
+                CountDroppedLine(Source);
+                return false;
+            }
+            return true;
+
+        case OutputOverflowPolicy::DropNewest:
+        default:
+            if (!LineFits(LineSize))
+            {
+                CountDroppedLine(Source);
+                return false;
+            }
+            return true;
+    }
+}
+
+///
+/// Drops the oldest pending line. The buffer is only compacted once the
+/// dropped lines are half of it, so dropping a line costs no copy of the
+/// lines behind it.
+///
+void
+OutputWriter::DropOldestLine()
+{
+    const PendingLine line = m_pendingIndex.front();
+    m_pendingIndex.pop_front();
+
+    m_pendingOffset += line.Size;
+
+    //
+    // The dropped line won't be written, so Flush doesn't wait for it.
+    //
+    m_writtenBytes += line.Size;
+
+    CountDroppedLine(line.Source);
+
+    if (m_pendingIndex.empty())
+    {
+        m_pendingLines.clear();
+        m_pendingOffset = 0;
+    }
+    else if (m_pendingOffset > m_pendingLines.size() / 2)
+    {
+        m_pendingLines.erase(0, m_pendingOffset);
+        m_pendingOffset = 0;
+    }
+}
+
+void
+OutputWriter::CountDroppedLine(
+    _In_ OutputSource Source
+    )
+{
+    const size_t sourceIndex = static_cast<size_t>(Source);
+
+    m_droppedLines[sourceIndex]++;
+    m_unreportedDrops[sourceIndex]++;
+    m_hasUnreportedDrops = true;
+}
+
+///
+/// Appends a line to the spill. It's called with the lock held.
+///
+void
+OutputWriter::SpillLine(
+    _In_ OutputSource Source,
+    _In_ std::string_view Text,
+    _In_ std::string_view LineTerminator
+    )
+{
+    if (!m_spill->Append(Source, Text, LineTerminator))
+    {
+        CountDroppedLine(Source);
+        return;
+    }
+
+    m_appendedBytes += Text.size() + LineTerminator.size();
+
+    if (!m_isSpilling)
+    {
+        m_isSpilling = true;
+
+        //
+        // The writer thread writes the queue without waiting for the flush
+        // interval, and replays the spill right after it.
+        //
+        m_flushRequested = true;
+        WakeConditionVariable(&m_linesAppended);
+    }
+}
+
+///
+/// Writes the oldest lines of the spill. It's called by the writer thread,
+/// once the queue is written, with the lock held. The lock is released while
+/// the lines are read and written.
+///
+void
+OutputWriter::ReplaySpill()
+{
+    ReleaseSRWLockExclusive(&m_lock);
+
+    m_writtenOffset = 0;
+    m_spill->Read(m_writtenLines, SPILL_READ_SIZE);
+
+    WriteBatch();
+
+    const size_t batchSize = m_writtenLines.size();
+    m_writtenLines.clear();
+
+    AcquireSRWLockExclusive(&m_lock);
+
+    m_writtenBytes += batchSize;
+    WakeAllConditionVariable(&m_batchWritten);
+
+    //
+    // The lines are only spilled with the lock held, so an empty spill stays
+    // empty until the queue takes the lines again.
+    //
+    if (m_spill->IsEmpty())
+    {
+        m_isSpilling = false;
+    }
+}
+
+///
+/// Counts the spilled lines the spill discarded or lost as dropped. It's
+/// called with the lock held.
+///
+void
+OutputWriter::TakeSpillDrops()
+{
+    if (!m_spill)
+    {
+        return;
+    }
+
+    UINT64 droppedLines[OUTPUT_SOURCE_COUNT] = {};
+
+    //
+    // The dropped lines won't be written, so Flush doesn't wait for them.
+    //
+    m_writtenBytes += m_spill->TakeDroppedLines(droppedLines);
+
+    for (size_t i = 0; i < OUTPUT_SOURCE_COUNT; i++)
+    {
+        if (droppedLines[i] > 0)
+        {
+            m_droppedLines[i] += droppedLines[i];
+            m_unreportedDrops[i] += droppedLines[i];
+            m_hasUnreportedDrops = true;
+        }
+    }
+}
+
+///
+/// Appends a line to the pending buffer. It's called with the lock held.
+///
+void
+OutputWriter::AppendLine(
+    _In_ OutputSource Source,
+    _In_ std::string_view Text,
+    _In_ std::string_view LineTerminator
+    )
+{
+    const size_t lineSize = Text.size() + LineTerminator.size();
+
+    if (GetQueuedSize() == 0)
+    {
+        m_pendingTimestamp = GetTickCount64();
+    }
+
+    m_pendingLines.append(Text.data(), Text.size());
+    m_pendingLines.append(LineTerminator.data(), LineTerminator.size());
+    m_appendedBytes += lineSize;
+
+    if (m_overflowPolicy == OutputOverflowPolicy::DropOldest)
+    {
+        m_pendingIndex.push_back({ lineSize, Source });
+    }
+}
+
+///
+/// \return The time the writer thread can wait before the next drop report
+///         is due, INFINITE if there are no drops to report.
+///
+DWORD
+OutputWriter::GetDropReportWait() const
+{
+    if (!m_hasUnreportedDrops)
+    {
+        return INFINITE;
+    }
+
+    const UINT64 elapsed = GetTickCount64() - m_lastDropReportTimestamp;
+    if (elapsed >= m_dropReportIntervalInMilliseconds)
+    {
+        return 0;
+    }
+
+    return static_cast<DWORD>(m_dropReportIntervalInMilliseconds - elapsed);
+}
+
+///
+/// Appends a warning with the lines dropped per source since the last
+/// report, if the report interval elapsed. It's called by the writer thread
+/// with the lock held.
+///
+/// \param Force    Report the drops even if the interval didn't elapse.
+///
+void
+OutputWriter::ReportDrops(
+    _In_ bool Force
+    )
+{
+    if (!m_hasUnreportedDrops || (!Force && GetDropReportWait() != 0))
+    {
+        return;
+    }
+
+    std::wstring dropCounts;
+
+    for (size_t i = 0; i < OUTPUT_SOURCE_COUNT; i++)
+    {
+        if (m_unreportedDrops[i] == 0)
+        {
+            continue;
+        }
+
+        dropCounts += Utility::FormatString(
+            L"%s%s: %llu",
+            dropCounts.empty() ? L"" : L", ",
+            OutputSourceNames[i],
+            m_unreportedDrops[i]);
+
+        m_unreportedDrops[i] = 0;
+    }
+
+    m_hasUnreportedDrops = false;
+    m_lastDropReportTimestamp = GetTickCount64();
+
+    SYSTEMTIME st;
+    GetSystemTime(&st);
+
+    std::wstring report = Utility::FormatString(
+        L"[%s][LOGMONITOR] WARNING: The output can't keep up with the sources."
+        L" Lines dropped since the last report: %s",
+        Utility::SystemTimeToString(st).c_str(),
+        dropCounts.c_str());
+
+    //
+    // The report isn't bounded by the queue, so it's never dropped itself.
+    //
+    AppendLine(OutputSource::LogMonitor, Utility::WStringToString(report), REPORT_LINE_TERMINATOR);
+}
+
+///
+/// Appends a warning when the output file failed to be rotated. The file
+/// sink only reports the first failure of a row. It's called by the writer
+/// thread with the lock held.
+///
+void
+OutputWriter::ReportFileRotationError()
+{
+    if (!m_fileSink)
+    {
+        return;
+    }
+
+    const DWORD error = m_fileSink->TakeRotationError();
+    if (error == ERROR_SUCCESS)
+    {
+        return;
+    }
+
+    SYSTEMTIME st;
+    GetSystemTime(&st);
+
+    std::wstring report = Utility::FormatString(
+        L"[%s][LOGMONITOR] WARNING: The output file can't be rotated, it keeps growing"
+        L" past its max size until it can be. Error: %lu",
+        Utility::SystemTimeToString(st).c_str(),
+        error);
+
+    AppendLine(OutputSource::LogMonitor, Utility::WStringToString(report), REPORT_LINE_TERMINATOR);
+}
+
+///
+/// Waits for the lines appended before the call to be written.
+///
+/// \param TimeoutInMilliseconds    Maximum time to wait.
+///
+/// \return true if the lines were written, or dropped because the write
+///         failed. false if the timeout elapsed.
+///
+bool
+OutputWriter::Flush(
+    _In_ DWORD TimeoutInMilliseconds
+    )
+{
+    AcquireSRWLockExclusive(&m_lock);
+
+    return WaitForAppendedLines(TimeoutInMilliseconds);
+}
+
+///
+/// Like Flush, but returns without waiting if the lock is held. The lock
+/// isn't reentrant, so it's used where the caller may have interrupted a
+/// thread holding it, like a signal handler.
+///
+/// \param TimeoutInMilliseconds    Maximum time to wait.
+///
+/// \return true if the lines were written, or dropped because the write
+///         failed. false if the lock was held or the timeout elapsed.
+///
+bool
+OutputWriter::TryFlush(
+    _In_ DWORD TimeoutInMilliseconds
+    )
+{
+    if (!TryAcquireSRWLockExclusive(&m_lock))
+    {
+        return false;
+    }
+
+    return WaitForAppendedLines(TimeoutInMilliseconds);
+}
+
+///
+/// Waits for the lines appended so far to be written. It's called with the
+/// lock held, and releases it.
+///
+/// \param TimeoutInMilliseconds    Maximum time to wait.
+///
+/// \return true if the lines were written, or dropped because the write
+///         failed. false if the timeout elapsed.
+///
+bool
+OutputWriter::WaitForAppendedLines(
+    _In_ DWORD TimeoutInMilliseconds
+    )
+{
+    const UINT64 startTimestamp = GetTickCount64();
+
+    const UINT64 targetBytes = m_appendedBytes;
+
+    if (m_writtenBytes < targetBytes)
+    {
+        m_flushRequested = true;
+        WakeConditionVariable(&m_linesAppended);
+    }
+
+    while (m_writtenBytes < targetBytes)
+    {
+        const UINT64 elapsed = GetTickCount64() - startTimestamp;
+        if (elapsed >= TimeoutInMilliseconds)
+        {
+            break;
+        }
+
+        SleepConditionVariableSRW(
+            &m_batchWritten,
+            &m_lock,
+            static_cast<DWORD>(TimeoutInMilliseconds - elapsed),
+            0);
+    }
+
+    const bool flushed = m_writtenBytes >= targetBytes;
+
+    ReleaseSRWLockExclusive(&m_lock);
+
+    return flushed;
+}
+
+///
+/// Writes the batch swapped out of the pending lines to the output handle,
+/// and to the file sink. It's called by the writer thread without holding
+/// the lock.
+///
+void
+OutputWriter::WriteBatch()
+{
+    const char* next = m_writtenLines.data() + m_writtenOffset;
+    size_t remaining = m_writtenLines.size() - m_writtenOffset;
+
+    if (m_fileSink)
+    {
+        const DWORD error = m_fileSink->Write(next, remaining);
+        if (error != ERROR_SUCCESS)
+        {
+            m_lastWriteError = error;
+        }
+    }
+
+    if (m_outputHandle == INVALID_HANDLE_VALUE)
+    {
+        return;
+    }
+
+    if (m_isConsoleOutput)
+    {
+        WriteConsoleBatch(next, remaining);
+        return;
+    }
+
+    while (remaining > 0)
+    {
+        DWORD bytesToWrite = remaining > MAXDWORD ? MAXDWORD : static_cast<DWORD>(remaining);
+        DWORD bytesWritten = 0;
+
+        if (!WriteFile(m_outputHandle, next, bytesToWrite, &bytesWritten, NULL))
+        {
+            //
+            // The error can't be reported to the output itself, so the batch
+            // is dropped, and the error kept for GetLastWriteError.
+            //
+            m_lastWriteError = GetLastError();
+            break;
+        }
+
+        next += bytesWritten;
+        remaining -= bytesWritten;
+    }
+}
+
+///
+/// Writes a batch to the console, converted to UTF-16. The batch is made of
+/// whole lines, so no character is split by the conversion.
+///
+/// \param Lines    The UTF-8 lines of the batch.
+/// \param Size     The size of the lines in bytes.
+///
+void
+OutputWriter::WriteConsoleBatch(
+    _In_reads_(Size) const char* Lines,
+    _In_ size_t Size
+    )
+{
+    while (Size > 0)
+    {
+        //
+        // Convert at most INT_MAX bytes at a time, cut at a line break.
+        //
+        size_t chunkSize = Size;
+        if (chunkSize > INT_MAX)
+        {
+            const std::string_view chunk(Lines, INT_MAX);
+            const size_t lastLineBreak = chunk.find_last_of('\n');
+
+            chunkSize = (lastLineBreak == std::string_view::npos) ? INT_MAX : lastLineBreak + 1;
+        }
+
+        const int wideSize = MultiByteToWideChar(CP_UTF8, 0, Lines, static_cast<int>(chunkSize), NULL, 0);
+        m_consoleLines.resize(wideSize > 0 ? wideSize : 0);
+        MultiByteToWideChar(CP_UTF8, 0, Lines, static_cast<int>(chunkSize), m_consoleLines.data(), wideSize);
+
+        const wchar_t* next = m_consoleLines.data();
+        size_t remaining = m_consoleLines.size();
+
+        while (remaining > 0)
+        {
+            DWORD charsToWrite = remaining > MAXDWORD ? MAXDWORD : static_cast<DWORD>(remaining);
+            DWORD charsWritten = 0;
+
+            if (!WriteConsoleW(m_outputHandle, next, charsToWrite, &charsWritten, NULL))
+            {
+                m_lastWriteError = GetLastError();
+                return;
+            }
+
+            next += charsWritten;
+            remaining -= charsWritten;
+        }
+
+        Lines += chunkSize;
+        Size -= chunkSize;
+    }
+}
+
+DWORD
+OutputWriter::WriterThreadStatic(
+    _In_ LPVOID Context
+    )
+{
+    auto writer = reinterpret_cast<OutputWriter*>(Context);
+
+    writer->WriterThread();
+
+    return ERROR_SUCCESS;
+}
+
+///
+/// Waits for a batch to be complete, or for its flush interval to elapse, and
+/// writes it. It exits once the writer is stopping and the pending lines are
+/// written. It replays the spill once the queue is written, and appends the
+/// drop reports when they are due, so they are written even if the sources
+/// stopped producing lines.
+///
+void
+OutputWriter::WriterThread()
+{
+    AcquireSRWLockExclusive(&m_lock);
+
+    for (;;)
+    {
+        TakeSpillDrops();
+        ReportDrops(m_stopping);
+        ReportFileRotationError();
+
+        while (GetQueuedSize() == 0 && !m_isSpilling && !m_stopping)
+        {
+            SleepConditionVariableSRW(&m_linesAppended, &m_lock, GetDropReportWait(), 0);
+
+            ReportDrops(m_stopping);
+        }
+
+        if (GetQueuedSize() == 0 && !m_isSpilling)
+        {
+            break;
+        }
+
+        //
+        // The spilled lines follow the lines of the queue.
+        //
+        if (GetQueuedSize() == 0)
+        {
+            ReplaySpill();
+            continue;
+        }
+
+        while (!m_stopping && !m_flushRequested && GetQueuedSize() < m_flushSize)
+        {
+            const UINT64 elapsed = GetTickCount64() - m_pendingTimestamp;
+            if (elapsed >= m_flushIntervalInMilliseconds)
+            {
+                break;
+            }
+
+            SleepConditionVariableSRW(
+                &m_linesAppended,
+                &m_lock,
+                static_cast<DWORD>(m_flushIntervalInMilliseconds - elapsed),
+                0);
+        }
+
+        m_flushRequested = false;
+        m_pendingLines.swap(m_writtenLines);
+        m_writtenOffset = m_pendingOffset;
+        m_pendingOffset = 0;
+        m_pendingIndex.clear();
+
+        WakeAllConditionVariable(&m_queueDrained);
+
+        ReleaseSRWLockExclusive(&m_lock);
+
+        WriteBatch();
+
+        const size_t batchSize = m_writtenLines.size() - m_writtenOffset;
+        m_writtenLines.clear();
+
+        AcquireSRWLockExclusive(&m_lock);
+
+        m_writtenBytes += batchSize;
+        WakeAllConditionVariable(&m_batchWritten);
+    }
+
+    ReleaseSRWLockExclusive(&m_lock);
+}
@@ -0,0 +1,281 @@
+//
+// Copyright (c) Microsoft Corporation.
+// Licensed under the MIT license.
+//
+
+#pragma once
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+
+///
+/// Source of a line written to the output. The lines of LogMonitor itself
+/// are the traces of the LogWriter.
+///
+enum class OutputSource
+{
+    LogMonitor = 0,
+    EventLog,
+    File,
+    ETW,
+    Process
+};
+
+///
+/// String names of the OutputSource enum, used in the drop reports
+///
+const LPCWSTR OutputSourceNames[] = {
+    L"LogMonitor",
+    L"EventLog",
+    L"File",
+    L"ETW",
+    L"Process"
+};
+
+constexpr size_t OUTPUT_SOURCE_COUNT = _countof(OutputSourceNames);
+
+class OutputSpill;
+class OutputFileSink;
+
+///
+/// Writer of the log lines to the output: stdout, an OutputFileSink, or both.
+///
+/// The threads producing the lines append them, already formatted, to a
+/// pending buffer. A single writer thread swaps it with the buffer it has just
+/// written, and writes the lines with one WriteFile call. The lines are written
+/// once the pending buffer reaches the flush size, or once the oldest of them
+/// has waited for the flush interval, so a burst of lines costs a few large
+/// writes instead of a locked write and a flush per line.
+///
+/// The lines are written in the order they were appended.
+///
+/// The pending buffer is bounded by the queue size, so a slow reader of the
+/// output can't make it grow without limit. When a line doesn't fit, the
+/// overflow policy either blocks the producer until the writer thread swaps
+/// the buffer out, drops the oldest pending lines, drops the new line, or
+/// samples the lines of each source once the queue is half full. With the
+/// spill policy, the lines go to an OutputSpill on disk instead, until the
+/// writer thread has replayed them all after the queue. The dropped
+/// lines are counted per source, and the writer thread appends a warning with
+/// the counts at most once per report interval.
+///
+class OutputWriter final
+{
+ public:
+    OutputWriter() = delete;
+
+    OutputWriter(
+        _In_ HANDLE OutputHandle,
+        _In_ const OutputSettings& Settings);
+
+    ~OutputWriter();
+
+    OutputWriter(const OutputWriter&) = delete;
+    OutputWriter& operator=(const OutputWriter&) = delete;
+
+    void Write(
+        _In_ OutputSource Source,
+        _In_ std::string_view Text,
+        _In_ std::string_view LineTerminator = std::string_view());
+
+    bool TryWrite(
+        _In_ OutputSource Source,
+        _In_ std::string_view Text,
+        _In_ std::string_view LineTerminator);
+
+    bool Flush(
+        _In_ DWORD TimeoutInMilliseconds);
+
+    bool TryFlush(
+        _In_ DWORD TimeoutInMilliseconds);
+
+    ///
+    /// \return The error of the last write to the output that failed, or
+    ///         ERROR_SUCCESS.
+    ///
+    DWORD GetLastWriteError() const
+    {
+        return m_lastWriteError;
+    }
+
+    UINT64 GetDroppedLines(
+        _In_ OutputSource Source);
+
+ private:
+    static constexpr int THREAD_EXIT_MAX_WAIT_MILLIS = 5 * 1000;
+
+    //
+    // The drop reports are terminated like the lines of the LogWriter.
+    //
+    static constexpr std::string_view REPORT_LINE_TERMINATOR = "\r\n";
+
+    static constexpr size_t SPILL_READ_SIZE = 1024 * 1024;
+
+    ///
+    /// Size and source of a pending line, kept to drop the oldest lines.
+    ///
+    struct PendingLine
+    {
+        size_t Size;
+        OutputSource Source;
+    };
+
+    //
+    // Handle the lines are written to, INVALID_HANDLE_VALUE if they are only
+    // written to the file sink.
+    //
+    HANDLE m_outputHandle;
+
+    //
+    // A console shows the bytes written to it in its code page, so the lines
+    // are converted to UTF-16 and written with WriteConsoleW instead. The
+    // buffer of the conversion is only used by the writer thread.
+    //
+    bool m_isConsoleOutput = false;
+    std::wstring m_consoleLines;
+
+    std::unique_ptr<OutputFileSink> m_fileSink;
+
+    DWORD m_flushIntervalInMilliseconds;
+    size_t m_flushSize;
+
+    size_t m_maxQueueSize;
+    OutputOverflowPolicy m_overflowPolicy;
+    DWORD m_sampleRate;
+    UINT64 m_dropReportIntervalInMilliseconds;
+
+    SRWLOCK m_lock;
+
+    //
+    // Signaled when lines are appended to an empty pending buffer, when it
+    // reaches the flush size, when a flush is requested or when the writer is
+    // stopping.
+    //
+    CONDITION_VARIABLE m_linesAppended;
+
+    //
+    // Signaled when a batch was written.
+    //
+    CONDITION_VARIABLE m_batchWritten;
+
+    //
+    // Signaled when the writer thread swapped the pending buffer out, so the
+    // producers blocked by a full queue can append again.
+    //
+    CONDITION_VARIABLE m_queueDrained;
+
+    //
+    // Lines waiting for the writer thread, and when the oldest of them was
+    // appended. The lines dropped by the drop-oldest policy are skipped by
+    // moving the offset, and only erased once they are half of the buffer.
+    //
+    std::string m_pendingLines;
+    size_t m_pendingOffset = 0;
+    UINT64 m_pendingTimestamp = 0;
+
+    //
+    // Pending lines, oldest first. Only kept with the drop-oldest policy.
+    //
+    std::deque<PendingLine> m_pendingIndex;
+
+    //
+    // Batch being written, from its offset. It's only used by the writer
+    // thread, and keeps its capacity to be swapped with the pending buffer.
+    //
+    std::string m_writtenLines;
+    size_t m_writtenOffset = 0;
+
+    //
+    // Lines dropped per source, in total and since the last report, and
+    // the lines of each source seen by the sample policy.
+    //
+    UINT64 m_droppedLines[OUTPUT_SOURCE_COUNT] = {};
+    UINT64 m_unreportedDrops[OUTPUT_SOURCE_COUNT] = {};
+    UINT64 m_sampledLines[OUTPUT_SOURCE_COUNT] = {};
+    bool m_hasUnreportedDrops = false;
+    UINT64 m_lastDropReportTimestamp = 0;
+
+    //
+    // Spill of the lines that don't fit in the queue, with the spill policy.
+    // Once a line is spilled, the next ones are spilled too until the writer
+    // thread has replayed the spill, so the lines keep their order.
+    //
+    std::unique_ptr<OutputSpill> m_spill;
+    bool m_isSpilling = false;
+
+    //
+    // Total bytes appended, and written, dropped from the queue or dropped
+    // because the write failed. Flush waits for the second to reach the first.
+    //
+    UINT64 m_appendedBytes = 0;
+    UINT64 m_writtenBytes = 0;
+
+    bool m_flushRequested = false;
+    bool m_stopping = false;
+
+    DWORD m_lastWriteError = ERROR_SUCCESS;
+
+    HANDLE m_writerThread = NULL;
+
+    size_t GetQueuedSize() const
+    {
+        return m_pendingLines.size() - m_pendingOffset;
+    }
+
+    bool LineFits(
+        _In_ size_t LineSize) const
+    {
+        //
+        // A line larger than the queue is still appended to an empty queue,
+        // so it doesn't block or get dropped forever. Once the writer is
+        // stopping, the lines aren't bounded anymore.
+        //
+        return m_stopping || GetQueuedSize() == 0 || GetQueuedSize() + LineSize <= m_maxQueueSize;
+    }
+
+    bool ReserveQueueSpace(
+        _In_ OutputSource Source,
+        _In_ size_t LineSize);
+
+    void DropOldestLine();
+
+    void CountDroppedLine(
+        _In_ OutputSource Source);
+
+    void SpillLine(
+        _In_ OutputSource Source,
+        _In_ std::string_view Text,
+        _In_ std::string_view LineTerminator);
+
+    void ReplaySpill();
+
+    void TakeSpillDrops();
+
+    void AppendLine(
+        _In_ OutputSource Source,
+        _In_ std::string_view Text,
+        _In_ std::string_view LineTerminator);
+
+    DWORD GetDropReportWait() const;
+
+    bool WaitForAppendedLines(
+        _In_ DWORD TimeoutInMilliseconds);
+
+    void ReportDrops(
+        _In_ bool Force);
+
+    void ReportFileRotationError();
+
+    void WriteBatch();
+
+    void WriteConsoleBatch(
+        _In_reads_(Size) const char* Lines,
+        _In_ size_t Size);
+
+    static DWORD WriterThreadStatic(
+        _In_ LPVOID Context);
+
+    void WriterThread();
+};
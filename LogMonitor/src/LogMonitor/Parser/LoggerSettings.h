@@ -18,6 +18,31 @@
 #define JSON_TAG_LOG_FORMAT L"logFormat"
 #define JSON_TAG_CUSTOM_LOG_FORMAT L"customLogFormat"
 
+///
+/// Valid output attributes
+///
+#define JSON_TAG_OUTPUT L"output"
+#define JSON_TAG_FLUSH_INTERVAL L"flushIntervalInMilliseconds"
+#define JSON_TAG_FLUSH_SIZE L"flushSizeInKB"
+#define JSON_TAG_QUEUE_SIZE L"queueSizeInKB"
+#define JSON_TAG_OVERFLOW_POLICY L"overflowPolicy"
+#define JSON_TAG_SAMPLE_RATE L"sampleRate"
+#define JSON_TAG_DROP_REPORT_INTERVAL L"dropReportIntervalInSeconds"
+#define JSON_TAG_SPILL_DIRECTORY L"spillDirectory"
+#define JSON_TAG_SPILL_MAX_SIZE L"spillMaxSizeInMB"
+#define JSON_TAG_SPILL_MAX_AGE L"spillMaxAgeInSeconds"
+#define JSON_TAG_STDOUT L"stdout"
+#define JSON_TAG_OUTPUT_FILE L"file"
+
+///
+/// Valid output file attributes
+///
+#define JSON_TAG_PATH L"path"
+#define JSON_TAG_MAX_SIZE L"maxSizeInMB"
+#define JSON_TAG_ROTATION_INTERVAL L"rotationIntervalInMinutes"
+#define JSON_TAG_MAX_FILES L"maxFiles"
+#define JSON_TAG_COMPRESS L"compress"
+
 ///
 /// Valid source attributes
 ///
@@ -30,6 +55,18 @@
 #define JSON_TAG_INCLUDE_SUBDIRECTORIES L"includeSubdirectories"
 #define JSON_TAG_PROVIDERS L"providers"
 #define JSON_TAG_WAITINSECONDS L"waitInSeconds"
+#define JSON_TAG_READER_THREADS L"readerThreads"
+#define JSON_TAG_MAX_FILES_IN_FLIGHT L"maxFilesInFlight"
+#define JSON_TAG_MODIFY_COALESCING_WINDOW L"modifyCoalescingWindowInMilliseconds"
+#define JSON_TAG_SWEEP_INTERVAL L"sweepIntervalInSeconds"
+#define JSON_TAG_LATENCY_REPORT_INTERVAL L"latencyReportIntervalInSeconds"
+#define JSON_TAG_CHECKPOINT_FILE L"checkpointFile"
+#define JSON_TAG_CHECKPOINT_INTERVAL L"checkpointIntervalInSeconds"
+#define JSON_TAG_NOTIFICATION_BUFFER_SIZE L"notificationBufferSizeInKB"
+#define JSON_TAG_MAX_NOTIFICATION_BUFFER_SIZE L"maxNotificationBufferSizeInKB"
+#define JSON_TAG_HEADER_FINGERPRINT_SIZE L"headerFingerprintSizeInBytes"
+#define JSON_TAG_READ_BUDGET L"readBudgetInKB"
+#define JSON_TAG_PRIORITIES L"priorities"
 
 ///
 /// Valid channel attributes
@@ -264,6 +301,63 @@ class SourceEventLog : LogSource
     }
 };
 
+///
+/// Read weight of the log files of a File source matching a filter
+///
+struct FilePriority
+{
+    std::wstring Filter;
+    DWORD Weight = 1;
+};
+
+///
+/// Settings of how the log files of a File source are tailed
+///
+struct FileMonitorTuning
+{
+    // Threads reading the log files of the source concurrently, and the
+    // maximum number of files queued or being read at the same time.
+    DWORD ReaderThreads = 4;
+    DWORD MaxFilesInFlight = 16;
+
+    // Modification notifications of a file received within this window
+    // after a read was scheduled are coalesced into a single read.
+    DWORD ModifyCoalescingWindowInMilliseconds = 50;
+
+    // Interval of the sweep that reads all the files, in case a change
+    // notification was delayed or lost.
+    std::double_t SweepIntervalInSeconds = 1;
+
+    // Interval to report the tailing latency percentiles. 0 disables it.
+    DWORD LatencyReportIntervalInSeconds = 0;
+
+    // File where the read offsets are saved, so a restart resumes the
+    // files where the previous run stopped. Empty disables it.
+    std::wstring CheckpointFile;
+
+    // Interval to save the read offsets to the checkpoint file.
+    DWORD CheckpointIntervalInSeconds = 5;
+
+    // Initial size of the buffer receiving the change notifications of the
+    // directory, and the size it can grow to when notifications are lost
+    // because it was full.
+    DWORD NotificationBufferSizeInKB = 64;
+    DWORD MaxNotificationBufferSizeInKB = 1024;
+
+    // Size of the beginning of each log file whose hash is kept, to tell a
+    // file rewritten in place from a file appended to, and to check that a
+    // file still has the content of its checkpoint. 0 disables it.
+    DWORD HeaderFingerprintSizeInBytes = 0;
+
+    // Bytes read from a log file before the reader moves to the next queued
+    // file, multiplied by the weight of the file. 0 reads files to the end.
+    DWORD ReadBudgetInKB = 16 * 1024;
+
+    // Weights of the files matching each filter. The first matching filter
+    // is used, and files not matching any of them have a weight of 1.
+    std::vector<FilePriority> Priorities;
+};
+
 ///
 /// Represents a Source of File type
 ///
@@ -278,6 +372,8 @@ class SourceFile : LogSource
     // Default wait time: 5minutes
     std::double_t WaitInSeconds = 300;
 
+    FileMonitorTuning Tuning;
+
     static bool Unwrap(
         _In_ AttributesMap& Attributes,
         _Out_ SourceFile& NewSource)
@@ -325,6 +421,117 @@ class SourceFile : LogSource
             NewSource.WaitInSeconds = *(std::double_t*)Attributes[JSON_TAG_WAITINSECONDS];
         }
 
+        //
+        // readerThreads is an optional value
+        //
+        if (Attributes.find(JSON_TAG_READER_THREADS) != Attributes.end()
+            && Attributes[JSON_TAG_READER_THREADS] != nullptr)
+        {
+            NewSource.Tuning.ReaderThreads = *(DWORD*)Attributes[JSON_TAG_READER_THREADS];
+        }
+
+        //
+        // maxFilesInFlight is an optional value
+        //
+        if (Attributes.find(JSON_TAG_MAX_FILES_IN_FLIGHT) != Attributes.end()
+            && Attributes[JSON_TAG_MAX_FILES_IN_FLIGHT] != nullptr)
+        {
+            NewSource.Tuning.MaxFilesInFlight = *(DWORD*)Attributes[JSON_TAG_MAX_FILES_IN_FLIGHT];
+        }
+
+        //
+        // modifyCoalescingWindowInMilliseconds is an optional value
+        //
+        if (Attributes.find(JSON_TAG_MODIFY_COALESCING_WINDOW) != Attributes.end()
+            && Attributes[JSON_TAG_MODIFY_COALESCING_WINDOW] != nullptr)
+        {
+            NewSource.Tuning.ModifyCoalescingWindowInMilliseconds =
+                *(DWORD*)Attributes[JSON_TAG_MODIFY_COALESCING_WINDOW];
+        }
+
+        //
+        // sweepIntervalInSeconds is an optional value
+        //
+        if (Attributes.find(JSON_TAG_SWEEP_INTERVAL) != Attributes.end()
+            && Attributes[JSON_TAG_SWEEP_INTERVAL] != nullptr)
+        {
+            NewSource.Tuning.SweepIntervalInSeconds = *(std::double_t*)Attributes[JSON_TAG_SWEEP_INTERVAL];
+        }
+
+        //
+        // latencyReportIntervalInSeconds is an optional value
+        //
+        if (Attributes.find(JSON_TAG_LATENCY_REPORT_INTERVAL) != Attributes.end()
+            && Attributes[JSON_TAG_LATENCY_REPORT_INTERVAL] != nullptr)
+        {
+            NewSource.Tuning.LatencyReportIntervalInSeconds = *(DWORD*)Attributes[JSON_TAG_LATENCY_REPORT_INTERVAL];
+        }
+
+        //
+        // checkpointFile is an optional value
+        //
+        if (Attributes.find(JSON_TAG_CHECKPOINT_FILE) != Attributes.end()
+            && Attributes[JSON_TAG_CHECKPOINT_FILE] != nullptr)
+        {
+            NewSource.Tuning.CheckpointFile = *(std::wstring*)Attributes[JSON_TAG_CHECKPOINT_FILE];
+        }
+
+        //
+        // checkpointIntervalInSeconds is an optional value
+        //
+        if (Attributes.find(JSON_TAG_CHECKPOINT_INTERVAL) != Attributes.end()
+            && Attributes[JSON_TAG_CHECKPOINT_INTERVAL] != nullptr)
+        {
+            NewSource.Tuning.CheckpointIntervalInSeconds = *(DWORD*)Attributes[JSON_TAG_CHECKPOINT_INTERVAL];
+        }
+
+        //
+        // notificationBufferSizeInKB is an optional value
+        //
+        if (Attributes.find(JSON_TAG_NOTIFICATION_BUFFER_SIZE) != Attributes.end()
+            && Attributes[JSON_TAG_NOTIFICATION_BUFFER_SIZE] != nullptr)
+        {
+            NewSource.Tuning.NotificationBufferSizeInKB = *(DWORD*)Attributes[JSON_TAG_NOTIFICATION_BUFFER_SIZE];
+        }
+
+        //
+        // maxNotificationBufferSizeInKB is an optional value
+        //
+        if (Attributes.find(JSON_TAG_MAX_NOTIFICATION_BUFFER_SIZE) != Attributes.end()
+            && Attributes[JSON_TAG_MAX_NOTIFICATION_BUFFER_SIZE] != nullptr)
+        {
+            NewSource.Tuning.MaxNotificationBufferSizeInKB =
+                *(DWORD*)Attributes[JSON_TAG_MAX_NOTIFICATION_BUFFER_SIZE];
+        }
+
+        //
+        // headerFingerprintSizeInBytes is an optional value
+        //
+        if (Attributes.find(JSON_TAG_HEADER_FINGERPRINT_SIZE) != Attributes.end()
+            && Attributes[JSON_TAG_HEADER_FINGERPRINT_SIZE] != nullptr)
+        {
+            NewSource.Tuning.HeaderFingerprintSizeInBytes = *(DWORD*)Attributes[JSON_TAG_HEADER_FINGERPRINT_SIZE];
+        }
+
+        //
+        // readBudgetInKB is an optional value
+        //
+        if (Attributes.find(JSON_TAG_READ_BUDGET) != Attributes.end()
+            && Attributes[JSON_TAG_READ_BUDGET] != nullptr)
+        {
+            NewSource.Tuning.ReadBudgetInKB = *(DWORD*)Attributes[JSON_TAG_READ_BUDGET];
+        }
+
+        //
+        // priorities is an optional value. Clone the array, the original one
+        // could be deleted.
+        //
+        if (Attributes.find(JSON_TAG_PRIORITIES) != Attributes.end()
+            && Attributes[JSON_TAG_PRIORITIES] != nullptr)
+        {
+            NewSource.Tuning.Priorities = *(std::vector<FilePriority>*)Attributes[JSON_TAG_PRIORITIES];
+        }
+
         //
         // lineLogFormat is an optional value
         //
@@ -474,6 +681,84 @@ class SourceProcess : LogSource
         }
 };
 
+///
+/// What the writer of the output does with a line that doesn't fit in its
+/// queue
+///
+enum class OutputOverflowPolicy
+{
+    Block = 0,
+    DropOldest,
+    DropNewest,
+    Sample,
+    Spill
+};
+
+///
+/// String names of the OutputOverflowPolicy enum, used to parse the config file
+///
+const LPCWSTR OutputOverflowPolicyNames[] = {
+    L"block",
+    L"dropOldest",
+    L"dropNewest",
+    L"sample",
+    L"spill"
+};
+
+///
+/// Settings of the file the log lines are written to
+///
+struct OutputFileSettings
+{
+    // The lines are only written to a file if its path is set.
+    std::wstring Path;
+
+    // The file is rotated once it reaches the max size, or once it was
+    // written to for the rotation interval, if it isn't 0. The rotated files
+    // are renamed to <path>.1 to <path>.<max files>, newest first, and
+    // compressed by the file system if compress is set.
+    DWORD MaxSizeInMB = 100;
+    DWORD RotationIntervalInMinutes = 0;
+    DWORD MaxFiles = 5;
+    bool Compress = false;
+};
+
+///
+/// Settings of how the log lines are written to stdout, and to a file
+///
+struct OutputSettings
+{
+    // The lines are written in batches by a single thread. A batch is
+    // written once it reaches the flush size, or once its first line has
+    // waited for the flush interval.
+    DWORD FlushIntervalInMilliseconds = 100;
+    DWORD FlushSizeInKB = 64;
+
+    // The lines waiting for the writer thread are bounded by the queue size.
+    // Once it's full, the overflow policy either blocks the source until the
+    // writer catches up, or drops lines. With the sample policy, each source
+    // keeps one line out of the sample rate once the queue is half full. The
+    // dropped lines are counted per source, and reported at most once per
+    // report interval.
+    DWORD QueueSizeInKB = 8 * 1024;
+    OutputOverflowPolicy OverflowPolicy = OutputOverflowPolicy::Block;
+    DWORD SampleRate = 10;
+    DWORD DropReportIntervalInSeconds = 10;
+
+    // With the spill policy, the lines that don't fit in the queue are
+    // written to segment files in the spill directory, and replayed once the
+    // queue is written. An empty directory is the default one, in the temp
+    // directory. The lines that don't fit in the max size are dropped, and
+    // the ones older than the max age are discarded before they're replayed.
+    std::wstring SpillDirectory;
+    DWORD SpillMaxSizeInMB = 256;
+    DWORD SpillMaxAgeInSeconds = 300;
+
+    // The lines are written to stdout, to the file, or to both.
+    bool WriteToStdout = true;
+    OutputFileSettings File;
+};
+
 ///
 /// Information about a channel Log
 ///
@@ -481,4 +766,5 @@ typedef struct _LoggerSettings
 {
     std::vector<std::shared_ptr<LogSource> > Sources;
     std::wstring LogFormat = L"JSON";
+    OutputSettings Output;
 } LoggerSettings;
@@ -244,12 +244,20 @@ std::string FormatStandardLog(const std::string& inputLine) {
 ///
 DWORD ReadFromPipe(LPVOID Param)
 {
-    DWORD dwWritten;
-    char chBuf[BUFSIZE + 1] = { 0 };
-    std::string partialLine;
-    HANDLE hParentStdOut = GetStdHandle(STD_OUTPUT_HANDLE);
+    char chBuf[BUFSIZE] = { 0 };
     UNREFERENCED_PARAMETER(Param);
 
+    //
+    // Splits the output into lines, carrying incomplete lines between reads.
+    // Runs of CR and LF characters don't produce empty lines.
+    //
+    LineFramer<char> lineFramer;
+
+    auto writeLine = [&](std::string_view Line) {
+        std::string formatted = FormatProcessLog(std::string(Line));
+        logWriter.WriteOutput(OutputSource::Process, formatted);
+    };
+
     for (;;)
     {
         DWORD bytesRead = 0;
@@ -258,48 +266,11 @@ DWORD ReadFromPipe(LPVOID Param)
         if (!bSuccess || bytesRead == 0)
             break;
 
-        chBuf[bytesRead] = '\0'; // Null-terminate buffer
-        partialLine.append(chBuf);
-
-        size_t start = 0;
-        size_t newlinePos;
-        while ((newlinePos = partialLine.find_first_of("\r\n", start)) != std::string::npos)
-        {
-            std::string line = partialLine.substr(start, newlinePos - start);
-
-            std::string formatted = FormatProcessLog(line);
-            logWriter.WriteLog(
-                hParentStdOut,
-                formatted.c_str(),
-                static_cast<DWORD>(formatted.size()),
-                &dwWritten,
-                NULL);
-
-            // Skip over newline chars
-            start = newlinePos + 1;
-            while (start < partialLine.size() &&
-                (partialLine[start] == '\r' || partialLine[start] == '\n'))
-                ++start;
-        }
-
-        // Keep unprocessed remainder
-        if (start < partialLine.size())
-            partialLine = partialLine.substr(start);
-        else
-            partialLine.clear();
+        lineFramer.Push(chBuf, bytesRead, writeLine);
     }
 
     // Write remaining partial line
-    if (!partialLine.empty())
-    {
-        std::string formatted = FormatProcessLog(partialLine);
-        logWriter.WriteLog(
-            hParentStdOut,
-            formatted.c_str(),
-            static_cast<DWORD>(formatted.size()),
-            &dwWritten,
-            NULL);
-    }
+    lineFramer.Flush(writeLine);
 
     return ERROR_SUCCESS;
 }
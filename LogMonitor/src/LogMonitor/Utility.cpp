@@ -7,9 +7,10 @@
 #include "Utility.h"  // NOLINT(build/include_subdir)
 #include <regex>  // NOLINT(build/include_order)
 #include <string>  // NOLINT(build/include_order)
+#include <string_view>  // NOLINT(build/include_order)
+#include <type_traits>  // NOLINT(build/include_order)
 
 using namespace std;
-using json = nlohmann::json;
 
 
 ///
@@ -261,6 +262,82 @@ bool Utility::isJsonNumber(_In_ std::wstring& str)
     return regex_search(str, isNumber);
 }
 
+namespace
+{
+    ///
+    /// Appends text to a string, escaped to be the content of a JSON string
+    /// the same way nlohmann::json dumps it: quotes, backslashes and control
+    /// characters are escaped, and the other characters are kept as they are,
+    /// so UTF-8 and UTF-16 text can be escaped without being converted. The
+    /// text ends at its first null character.
+    ///
+    template <typename CharT>
+    void AppendJsonEscapedText(
+        _Inout_ std::basic_string<CharT>& Result,
+        _In_ std::basic_string_view<CharT> Text)
+    {
+        typedef std::make_unsigned_t<CharT> UnsignedCharT;
+
+        static const char hexDigits[] = "0123456789abcdef";
+
+        Result.reserve(Result.size() + Text.size());
+
+        for (const CharT c : Text)
+        {
+            const char* escape = nullptr;
+
+            switch (c)
+            {
+            case '\0':
+                return;
+            case '"':
+                escape = "\\\"";
+                break;
+            case '\\':
+                escape = "\\\\";
+                break;
+            case '\b':
+                escape = "\\b";
+                break;
+            case '\f':
+                escape = "\\f";
+                break;
+            case '\n':
+                escape = "\\n";
+                break;
+            case '\r':
+                escape = "\\r";
+                break;
+            case '\t':
+                escape = "\\t";
+                break;
+            default:
+                break;
+            }
+
+            if (escape != nullptr)
+            {
+                Result.push_back(static_cast<CharT>(escape[0]));
+                Result.push_back(static_cast<CharT>(escape[1]));
+            }
+            else if (static_cast<UnsignedCharT>(c) < 0x20)
+            {
+                const UnsignedCharT code = static_cast<UnsignedCharT>(c);
+                const CharT unicodeEscape[] = {
+                    '\\', 'u', '0', '0',
+                    static_cast<CharT>(hexDigits[code >> 4]),
+                    static_cast<CharT>(hexDigits[code & 0xF]) };
+
+                Result.append(unicodeEscape, _countof(unicodeEscape));
+            }
+            else
+            {
+                Result.push_back(c);
+            }
+        }
+    }
+}
+
 ///
 /// helper function to "sanitize" a string to be valid JSON
 /// i.e. escape ", \r, \n and \ within a string
@@ -268,35 +345,22 @@ bool Utility::isJsonNumber(_In_ std::wstring& str)
 ///
 void Utility::SanitizeJson(_Inout_ std::wstring& str)
 {
-    try
-    {
-        std::string utf8 = Utility::WStringToString(str);
-
-        // Remove any embedded nulls
-        utf8.erase(std::find(utf8.begin(), utf8.end(), '\0'), utf8.end());
-
-        // Escape the string using JSON
-        json j = utf8;
-        std::string escapedUtf8 = j.dump();
+    std::wstring escaped;
+    AppendJsonEscapedText<wchar_t>(escaped, str);
 
-        // Strip the outer quotes
-        if (escapedUtf8.length() >= 2 &&
-            escapedUtf8.front() == '"' &&
-            escapedUtf8.back() == '"')
-        {
-            escapedUtf8 = escapedUtf8.substr(1, escapedUtf8.length() - 2);
-        }
+    str = std::move(escaped);
+}
 
-        // Convert back to wide string
-        str = Utility::StringToWString(escapedUtf8);
-    }
-    catch (const std::exception& e)
-    {
-        // Leave str unchanged — emitting unescaped content is better than losing the log line.
-        logWriter.TraceError(
-            Utility::FormatString(L"SanitizeJson failed: %S", e.what()).c_str()
-        );
-    }
+///
+/// Appends UTF-8 text to a string, escaped to be the content of a JSON string.
+/// It's escaped the same way SanitizeJson escapes UTF-16 text.
+///
+/// \param Result       The string to append the escaped text to.
+/// \param Text         The UTF-8 text to escape. It ends at its first null character.
+///
+void Utility::AppendJsonEscaped(_Inout_ std::string& Result, _In_ std::string_view Text)
+{
+    AppendJsonEscapedText<char>(Result, Text);
 }
 
 bool Utility::ConfigAttributeExists(AttributesMap& Attributes, std::wstring attributeName)
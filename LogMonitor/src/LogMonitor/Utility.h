@@ -7,6 +7,7 @@
 
 #include <map>
 #include <string>
+#include <string_view>
 
 //
 // Define the AttributesMap, that is a map<wstring, void*> with case
@@ -69,6 +70,10 @@ class Utility final
     static void SanitizeJson(
         _Inout_ std::wstring &str);
 
+    static void AppendJsonEscaped(
+        _Inout_ std::string& Result,
+        _In_ std::string_view Text);
+
     static bool ConfigAttributeExists(
         _In_ AttributesMap& Attributes,
         _In_ std::wstring attributeName);
@@ -15,9 +15,11 @@
 #include <stdio.h>
 #include <array>
 #include <memory>
+#include <atomic>
 #include <variant>
 #include <cstdint>
 #include <string>
+#include <string_view>
 #include <algorithm>
 #include <sstream>
 #include <vector>
@@ -54,11 +56,24 @@
 #include "Parser/ConfigFileParser.h"  // NOLINT(build/include_subdir)
 #include "Parser/LoggerSettings.h"  // NOLINT(build/include_subdir)
 #include "Parser/JsonFileParser.h"  // NOLINT(build/include_subdir)
+#include "Output/OutputWriter.h"  // NOLINT(build/include_subdir)
+#include "Output/OutputSpill.h"  // NOLINT(build/include_subdir)
+#include "Output/OutputFileSink.h"  // NOLINT(build/include_subdir)
 #include "LogWriter.h"  // NOLINT(build/include_subdir)
 #include "EtwMonitor.h"  // NOLINT(build/include_subdir)
 #include "EventMonitor.h"  // NOLINT(build/include_subdir)
 #include "FileMonitor/FileMonitorUtilities.h"  // NOLINT(build/include_subdir)
+#include "FileMonitor/LineScanner.h"  // NOLINT(build/include_subdir)
+#include "FileMonitor/LineFramer.h"  // NOLINT(build/include_subdir)
+#include "FileMonitor/LogFileReaderPool.h"  // NOLINT(build/include_subdir)
+#include "FileMonitor/LatencyHistogram.h"  // NOLINT(build/include_subdir)
+#include "FileMonitor/LogFileTable.h"  // NOLINT(build/include_subdir)
+#include "FileMonitor/DirectoryEnumerator.h"  // NOLINT(build/include_subdir)
+#include "FileMonitor/DirChangeEventBatch.h"  // NOLINT(build/include_subdir)
+#include "FileMonitor/FileFilter.h"  // NOLINT(build/include_subdir)
+#include "FileMonitor/DirectoryWatchEngine.h"  // NOLINT(build/include_subdir)
 #include "LogFileMonitor.h"  // NOLINT(build/include_subdir)
+#include "FileMonitor/CheckpointStore.h"  // NOLINT(build/include_subdir)
 #include "ProcessMonitor.h"  // NOLINT(build/include_subdir)
 #include "JsonProcessor.h"  // NOLINT(build/include_subdir)
 